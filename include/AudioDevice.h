@@ -79,6 +79,10 @@ public:
 
 	void processNextBuffer();
 
+	// write a buffer rendered by the mixer without pulling it from the
+	// mixer, e.g. from a thread of its own - resamples if necessary
+	void processBuffer( const surroundSampleFrame * _buf );
+
 	virtual void startProcessing()
 	{
 		m_inProcess = true;
@@ -102,6 +106,11 @@ protected:
 	// called by according driver for fetching new sound-data
 	fpp_t getNextBuffer( surroundSampleFrame * _ab );
 
+	// copy or resample a buffer from the mixer to the device's samplerate
+	// returns num of frames in _dst
+	fpp_t convertBuffer( const surroundSampleFrame * _src,
+					surroundSampleFrame * _dst );
+
 	// convert a given audio-buffer to a buffer in signed 16-bit samples
 	// returns num of bytes in outbuf
 	int convertToS16( const surroundSampleFrame * _ab,
@@ -27,6 +27,9 @@
 #define AUDIO_FILE_DEVICE_H
 
 #include <QtCore/QFile>
+#include <QtCore/QSemaphore>
+#include <QtCore/QThread>
+#include <QtCore/QVector>
 
 #include "AudioDevice.h"
 #include "OutputSettings.h"
@@ -49,6 +52,29 @@ public:
 
 
 protected:
+	// encodes a buffer - called from the encoder thread in the order in
+	// which the buffers were written, never concurrently
+	virtual void encodeBuffer( const surroundSampleFrame * _ab,
+						const fpp_t _frames,
+						const float _master_gain ) = 0;
+
+	// waits until all queued buffers are encoded and stops the encoder
+	// thread - subclasses have to call it before finishing their encoder
+	void finishQueue();
+
+	// convert to interleaved integers with TPDF dither, the returned
+	// buffers belong to the device and stay valid until the next call
+	const int_sample_t * quantizeToS16( const surroundSampleFrame * _ab,
+						const fpp_t _frames,
+						const float _master_gain );
+	// 24 bit samples in the upper bits, as libsndfile expects them
+	const int32_t * quantizeToS24( const surroundSampleFrame * _ab,
+						const fpp_t _frames,
+						const float _master_gain );
+	const float * interleave( const surroundSampleFrame * _ab,
+						const fpp_t _frames,
+						const float _master_gain );
+
 	int writeData( const void* data, int len );
 
 	inline bool outputFileOpened() const
@@ -62,8 +88,56 @@ protected:
 	}
 
 private:
+	// queues a copy of the buffer, so rendering goes on while the
+	// previous ones are encoded
+	virtual void writeBuffer( const surroundSampleFrame * _ab,
+						const fpp_t _frames,
+						const float _master_gain );
+
+	void encodeQueuedBuffers();
+	void quantize( const surroundSampleFrame * _ab, const fpp_t _frames,
+					const float _master_gain, const float _scale );
+
+	class EncoderThread : public QThread
+	{
+	public:
+		EncoderThread( AudioFileDevice * device ) :
+			m_device( device )
+		{
+		}
+
+	private:
+		virtual void run()
+		{
+			m_device->encodeQueuedBuffers();
+		}
+
+		AudioFileDevice * m_device;
+	} ;
+
+	struct QueuedBuffer
+	{
+		surroundSampleFrame * frames;
+		fpp_t capacity;
+		fpp_t frameCount;
+		float masterGain;
+		bool last;
+	} ;
+
 	QFile m_outputFile;
 	OutputSettings m_outputSettings;
+
+	EncoderThread m_encoderThread;
+	QVector<QueuedBuffer> m_queue;
+	QSemaphore m_freeBuffers;
+	QSemaphore m_queuedBuffers;
+	int m_writeIndex;
+	int m_readIndex;
+
+	QVector<int32_t> m_intBuffer;
+	QVector<int_sample_t> m_s16Buffer;
+	QVector<float> m_floatBuffer;
+	int m_ditherPos;
 } ;
 
 
@@ -62,7 +62,7 @@ private:
 	SF_INFO  m_sfinfo;
 	SNDFILE* m_sf;
 
-	virtual void writeBuffer(surroundSampleFrame const* _ab,
+	virtual void encodeBuffer(surroundSampleFrame const* _ab,
 						fpp_t const frames,
 						float master_gain) override;
 
@@ -30,6 +30,8 @@
 
 #ifdef LMMS_HAVE_MP3LAME
 
+#include <vector>
+
 #include "AudioFileDevice.h"
 
 #include "lame/lame.h"
@@ -56,7 +58,7 @@ public:
 	}
 
 protected:
-	virtual void writeBuffer( const surroundSampleFrame * /* _buf*/,
+	virtual void encodeBuffer( const surroundSampleFrame * /* _buf*/,
 				  const fpp_t /*_frames*/,
 				  const float /*_master_gain*/ );
 
@@ -67,6 +69,7 @@ private:
 
 private:
 	lame_t m_lame;
+	std::vector<unsigned char> m_encodingBuffer;
 };
 
 #endif
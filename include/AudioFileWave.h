@@ -54,7 +54,7 @@ public:
 
 
 private:
-	virtual void writeBuffer( const surroundSampleFrame * _ab,
+	virtual void encodeBuffer( const surroundSampleFrame * _ab,
 						const fpp_t _frames,
 						float _master_gain );
 
@@ -36,6 +36,7 @@
 class EffectChain;
 class FloatModel;
 class BoolModel;
+class TrackFreeze;
 
 class AudioPort : public ThreadableJob
 {
@@ -83,10 +84,7 @@ public:
 		return m_effects.get();
 	}
 
-	void setNextFxChannel( const fx_ch_t _chnl )
-	{
-		m_nextFxChannel = _chnl;
-	}
+	void setNextFxChannel( const fx_ch_t _chnl );
 
 
 	const QString & name() const
@@ -109,8 +107,34 @@ public:
 	void addPlayHandle( PlayHandle * handle );
 	void removePlayHandle( PlayHandle * handle );
 
+	// what the port sent to its FX channel in the last period or NULL if
+	// it didn't send anything - valid until the next period gets rendered
+	const sampleFrame * lastOutput() const
+	{
+		return m_lastOutput;
+	}
+
+	//! While @p freeze is set, the output of the port comes from it instead
+	//! of the play handles and effects. Must be called inside
+	//! Mixer::requestChangeInModel() and doneChangeInModel().
+	void setFreeze( TrackFreeze * freeze )
+	{
+		m_freeze = freeze;
+	}
+
+	//! Position among the ports sending to the same FX channel when mixing
+	//! them deterministically, see DeterministicRender
+	uint64_t renderOrder() const
+	{
+		return m_renderOrder;
+	}
+
 private:
 	volatile bool m_bufferUsage;
+	// port buffer is known to hold only zeros
+	bool m_bufferSilent;
+	// what got mixed into the FX channel in the last period
+	const sampleFrame * m_lastOutput;
 
 	sampleFrame * m_portBuffer;
 	QMutex m_portBufferLock;
@@ -129,6 +153,10 @@ private:
 	FloatModel * m_panningModel;
 	BoolModel * m_mutedModel;
 
+	uint64_t m_renderOrder;
+
+	TrackFreeze * m_freeze;
+
 	friend class Mixer;
 	friend class MixerWorkerThread;
 
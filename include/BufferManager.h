@@ -34,6 +34,9 @@ class LMMS_EXPORT BufferManager
 public:
 	static void init( fpp_t framesPerPeriod );
 	static sampleFrame * acquire();
+	//! Buffer of one period taken from the PeriodArena - valid until the
+	//! end of the current period and must not be released
+	static sampleFrame * acquireScratch();
 	// audio-buffer-mgm
 	static void clear( sampleFrame * ab, const f_cnt_t frames,
 						const f_cnt_t offset = 0 );
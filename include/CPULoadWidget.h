@@ -34,6 +34,8 @@
 #include "lmms_basics.h"
 
 
+class ProfilerView;
+
 class CPULoadWidget : public QWidget
 {
 	Q_OBJECT
@@ -44,6 +46,8 @@ public:
 
 protected:
 	virtual void paintEvent( QPaintEvent * _ev );
+	// shows or hides the per-node view
+	virtual void mousePressEvent( QMouseEvent * _me );
 
 
 protected slots:
@@ -61,6 +65,8 @@ private:
 
 	QTimer m_updateTimer;
 
+	ProfilerView * m_profilerView;
+
 } ;
 
 
@@ -122,7 +122,9 @@ public:
 	static float runningTime();
 
 	static void triggerFrameCounter();
-	static void resetFrameCounter();
+	// periods is where the counter continues, e.g. when rendering only a
+	// part of the song
+	static void resetFrameCounter( long periods = 0 );
 
 	//Accepts a ControllerConnection * as it may be used in the future.
 	void addConnection( ControllerConnection * );
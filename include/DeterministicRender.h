@@ -0,0 +1,141 @@
+/*
+ * DeterministicRender.h - reproducible rendering independent of thread scheduling
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+
+#ifndef DETERMINISTIC_RENDER_H
+#define DETERMINISTIC_RENDER_H
+
+#include <atomic>
+#include <cstdint>
+
+#include "lmms_export.h"
+
+
+/*! \brief Makes two renders of the same project identical sample by sample
+ *
+ * Usually renders differ in their last bits between runs: sub-notes get
+ * added to their audio port in the order worker threads create them, audio
+ * ports get mixed into their FX channel in the order they finish and all
+ * jobs draw from random generators whose state depends on what ran before
+ * on the same thread. In deterministic mode
+ *  - play handles are summed into their port ordered by their render order,
+ *  - audio ports are summed into their FX channel ordered the same way,
+ *  - the random generator of a thread (fast_rand(), i.e. also
+ *    Oscillator::noiseSample()) is reseeded from the job and the period
+ *    before every job.
+ *
+ * All jobs still run in parallel, the results just don't depend on which
+ * thread processed them anymore.
+ *
+ * The process-global rand() is only seeded once when rendering starts. Code
+ * of LMMS uses fast_rand() instead, but some third-party LADSPA plugins
+ * bundled with LMMS (the noise, grain and disintegrator plugins of CMT and
+ * the noise sources of CAPS) call rand() from worker threads. Projects
+ * using them still render differently between runs.
+ */
+class LMMS_EXPORT DeterministicRender
+{
+public:
+	static bool isEnabled()
+	{
+		return s_enabled;
+	}
+
+	static void setEnabled( bool enabled );
+
+	//! Restart counting periods and play handles, called when an export
+	//! starts so every export of a project sees the same sequence
+	static void restart();
+
+	//! Restart counting objects, called when a project gets created or
+	//! loaded so its objects get the same render orders every time
+	static void startProject()
+	{
+		s_nextObjectOrder = ProjectObjectOrders;
+	}
+
+	//! Called by the mixer after every period
+	static void nextPeriod()
+	{
+		++s_period;
+	}
+
+	//! Render order of a new play handle
+	static uint64_t nextHandleOrder()
+	{
+		return s_nextHandleOrder++;
+	}
+
+	//! Render order of a new audio port, LFO or other part of the project
+	//! drawing random numbers
+	static uint64_t nextObjectOrder()
+	{
+		return ObjectOrders | s_nextObjectOrder++;
+	}
+
+	//! Render order of the @p index th sub-note created by a note
+	static uint64_t childOrder( uint64_t parent, int index );
+
+	//! Render order of an FX channel
+	static uint64_t channelOrder( int index )
+	{
+		return ChannelOrders | index;
+	}
+
+	//! Reseed the random generator of the calling thread for processing the
+	//! job with render order @p order in the current period. Does nothing
+	//! if deterministic mode is disabled.
+	static void seedJob( uint64_t order );
+
+	//! Reseeds like seedJob() and restores the thread's previous state when
+	//! going out of scope - for shared data computed lazily by whichever
+	//! job needs it first
+	class LMMS_EXPORT ScopedSeed
+	{
+	public:
+		ScopedSeed( uint64_t order );
+		~ScopedSeed();
+
+	private:
+		bool m_active;
+		unsigned long m_savedState;
+	} ;
+
+private:
+	// orders of play handles, objects and FX channels never collide
+	static const uint64_t ObjectOrders = uint64_t( 1 ) << 63;
+	static const uint64_t ChannelOrders = uint64_t( 1 ) << 62;
+	// play handles created during an export start counting here
+	static const uint64_t ExportHandleOrders = uint64_t( 1 ) << 32;
+	// objects of a project start counting here, the ones which exist
+	// independent of the project count from 0
+	static const uint64_t ProjectObjectOrders = uint64_t( 1 ) << 32;
+
+	static bool s_enabled;
+	static uint64_t s_period;
+	static std::atomic<uint64_t> s_nextHandleOrder;
+	static std::atomic<uint64_t> s_nextObjectOrder;
+} ;
+
+
+#endif
@@ -59,6 +59,14 @@ public:
 	virtual bool processAudioBuffer( sampleFrame * _buf,
 						const fpp_t _frames ) = 0;
 
+	//! Return true if silent input always gives silent output, without a
+	//! tail or other internal state - the effect chain doesn't run such
+	//! effects on buffers known to be silent
+	virtual bool canSkipSilence() const
+	{
+		return false;
+	}
+
 	inline ch_cnt_t processorCount() const
 	{
 		return m_processors;
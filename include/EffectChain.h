@@ -52,11 +52,25 @@ public:
 	void removeEffect( Effect * _effect );
 	void moveDown( Effect * _effect );
 	void moveUp( Effect * _effect );
-	bool processAudioBuffer( sampleFrame * _buf, const fpp_t _frames, bool hasInputNoise );
+	//! silent tells whether _buf is known to be silent and gets
+	//! cleared if an effect wrote to it
+	bool processAudioBuffer( sampleFrame * _buf, const fpp_t _frames, bool hasInputNoise, bool & silent );
 	void startRunning();
+	//! frames the effects may keep sounding after their input got silent
+	f_cnt_t tailFrames() const;
 
 	void clear();
 
+	bool isEnabled() const
+	{
+		return m_enabledModel.value();
+	}
+
+	bool isEmpty() const
+	{
+		return m_effects.isEmpty();
+	}
+
 
 private:
 	typedef QVector<Effect *> EffectList;
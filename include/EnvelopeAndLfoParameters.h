@@ -55,7 +55,8 @@ public:
 		}
 
 		void trigger();
-		void reset();
+		// restart all LFOs as if they had been running for _frame frames
+		void reset( f_cnt_t _frame = 0 );
 
 		void add( EnvelopeAndLfoParameters * lfo );
 		void remove( EnvelopeAndLfoParameters * lfo );
@@ -162,6 +163,8 @@ private:
 	sample_t * m_lfoShapeData;
 	sample_t m_random;
 	bool m_bad_lfoShapeData;
+	// seeds the random wave, see DeterministicRender
+	uint64_t m_renderOrder;
 	SampleBuffer m_userWave;
 
 	enum LfoShapes
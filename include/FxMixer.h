@@ -31,6 +31,7 @@
 #include "ThreadableJob.h"
 
 #include <atomic>
+#include <vector>
 
 class FxRoute;
 typedef QVector<FxRoute *> FxRouteVector;
@@ -47,6 +48,8 @@ class FxChannel : public ThreadableJob
 		bool m_hasInput;
 		// set to true if any effect in the channel is enabled and running
 		bool m_stillRunning;
+		// set to true while m_buffer is known to hold only zeros
+		bool m_bufferSilent;
 
 		float m_peakLeft;
 		float m_peakRight;
@@ -58,7 +61,6 @@ class FxChannel : public ThreadableJob
 		QString m_name;
 		QMutex m_lock;
 		int m_channelIndex; // what channel index are we
-		bool m_queued; // are we queued up for rendering yet?
 		bool m_muted; // are we muted? updated per period so we don't have to call m_muteModel.value() twice
 
 		// pointers to other channels that this one sends to
@@ -67,13 +69,26 @@ class FxChannel : public ThreadableJob
 		// pointers to other channels that send to this one
 		FxRouteVector m_receives;
 
+		// outputs of audio ports with their render order, summed up by
+		// processChannel() when rendering deterministically
+		std::vector<std::pair<uint64_t, const sampleFrame *> > m_portInputs;
+
 		virtual bool requiresProcessing() const { return true; }
 		void unmuteForSolo();
 
-	
-		std::atomic_int m_dependenciesMet;
-		void incrementDeps();
+		// set up by FxMixer::compileSchedule()
+		bool m_scheduled; // processed at all, i.e. reaches master through unmuted channels
+		bool m_scheduledMuted; // mute state the schedule was compiled with
+		int m_scheduledSenders; // number of senders which are scheduled
+		std::vector<FxChannel *> m_scheduledReceivers;
+
+		// senders still to be processed in this period
+		std::atomic_int m_pendingSenders;
+		// queue receivers for which we were the last missing sender
 		void processed();
+
+		// mix input from senders and run the effect chain
+		void processChannel();
 		
 	private:
 		virtual void doProcessing();
@@ -128,10 +143,13 @@ public:
 	FxMixer();
 	virtual ~FxMixer();
 
-	void mixToChannel( const sampleFrame * _buf, fx_ch_t _ch );
+	void mixToChannel( const sampleFrame * _buf, fx_ch_t _ch, uint64_t order = 0 );
 
 	void prepareMasterMix();
 	void masterMix( sampleFrame * _buf );
+	// apply master volume, mix master channel into _buf and reset all
+	// channels for the next period
+	void finishMasterMix( sampleFrame * _buf );
 
 	virtual void saveSettings( QDomDocument & _doc, QDomElement & _parent );
 	virtual void loadSettings( const QDomElement & _this );
@@ -161,6 +179,13 @@ public:
 	bool isInfiniteLoop(fx_ch_t fromChannel, fx_ch_t toChannel);
 	bool checkInfiniteLoop( FxChannel * from, FxChannel * to );
 
+	// determine if audio sent to fromChannel reaches the master output
+	// unchanged - no effects, no muting and constant unity volumes and sends
+	// along a single route. sanitizesFirst and clamps tell how the NaN
+	// handler treats it on its way.
+	bool isTransparentPath( fx_ch_t fromChannel, bool & sanitizesFirst,
+							bool & clamps ) const;
+
 	// return the FloatModel of fromChannel sending its output to the input of
 	// toChannel. NULL if there is no send.
 	FloatModel * channelSendModel(fx_ch_t fromChannel, fx_ch_t toChannel);
@@ -203,6 +228,18 @@ private:
 	// make sure we have at least num channels
 	void allocateChannelsTo(int num);
 
+	// the routing changed - recompile the schedule and the render graph
+	void invalidateSchedule();
+
+	// order all channels which have to be processed by their distance
+	// from the channels without inputs
+	void compileSchedule();
+
+	// level-ordered, channels without scheduled senders come first
+	std::vector<FxChannel *> m_schedule;
+	int m_scheduleRoots;
+	bool m_scheduleValid;
+
 	int m_lastSoloed;
 
 } ;
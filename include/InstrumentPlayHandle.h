@@ -26,7 +26,11 @@
 #define INSTRUMENT_PLAY_HANDLE_H
 
 #include "PlayHandle.h"
+#include "DeterministicRender.h"
+#include "Engine.h"
 #include "Instrument.h"
+#include "Mixer.h"
+#include "MixHelpers.h"
 #include "NotePlayHandle.h"
 #include "lmms_export.h"
 
@@ -61,8 +65,15 @@ public:
 			}
 		}
 		while( nphsLeft );
-		
+
+		MixerProfiler::Probe probe( Engine::mixer()->profiler(), MixerProfiler::NodeType::Instrument, m_instrument );
+		// the notes processed above left the random generator of this
+		// thread in a state depending on which of them ran here
+		DeterministicRender::ScopedSeed seed( renderOrder() );
 		m_instrument->play( _working_buffer );
+		// checked here while the buffer is still in the cache of this
+		// worker, instruments can't tell whether they have a tail
+		setSilent( MixHelpers::isSilent( _working_buffer, Engine::mixer()->framesPerPeriod() ) );
 	}
 
 	virtual bool isFinished() const
@@ -26,6 +26,8 @@
 #ifndef INSTRUMENT_TRACK_H
 #define INSTRUMENT_TRACK_H
 
+#include <QtXml/QDomDocument>
+
 #include "AudioPort.h"
 #include "GroupBox.h"
 #include "InstrumentFunctions.h"
@@ -61,6 +63,7 @@ class DataFile;
 class PluginView;
 class TabWidget;
 class TrackLabelButton;
+class TrackFreeze;
 class LedCheckBox;
 class QLabel;
 
@@ -152,6 +155,21 @@ public:
 				const Plugin::Descriptor::SubPluginFeatures::Key* key = nullptr,
 				bool keyFromDnd = false);
 
+	// render the track to audio in the background and unload the
+	// instrument when done, the track plays the audio until it gets
+	// changed - returns NULL if rendering couldn't be started
+	TrackFreeze * freeze();
+	// unfreeze or stop rendering
+	void unfreeze();
+
+	bool isFrozen() const;
+
+	// frames notes keep sounding after they got released
+	f_cnt_t releaseFrames() const
+	{
+		return m_soundShaping.releaseFrames();
+	}
+
 	AudioPort * audioPort()
 	{
 		return &m_audioPort;
@@ -236,9 +254,17 @@ protected slots:
 	void updatePitch();
 	void updatePitchRange();
 	void updateEffectChannel();
+	// unfreeze if anything the frozen audio depends on changed
+	void checkFreeze();
+	// swap the instrument for the frozen audio
+	void finishFreeze( bool ok );
 
 
 private:
+	QDomElement saveInstrument( QDomDocument & doc );
+	void loadInstrumentState( const QDomElement & element );
+	void releaseFreeze();
+
 	MidiPort m_midiPort;
 
 	NotePlayHandle* m_notes[NumKeys];
@@ -275,6 +301,11 @@ private:
 
 	Piano m_piano;
 
+	TrackFreeze * m_freeze;
+	// state of the unloaded instrument while frozen
+	QDomDocument m_frozenInstrument;
+	QByteArray m_freezeKey;
+
 
 	friend class InstrumentTrackView;
 	friend class InstrumentTrackWindow;
@@ -325,6 +356,10 @@ protected:
 	virtual void dropEvent( QDropEvent * _de );
 
 
+public slots:
+	void toggleFreeze();
+
+
 private slots:
 	void toggleInstrumentWindow( bool _on );
 	void activityIndicatorPressed();
@@ -335,6 +370,9 @@ private slots:
 	void midiConfigChanged();
 	void muteChanged();
 
+	void cancelFreeze();
+	void freezeRendered( bool ok );
+
 	void assignFxLine( int channelIndex );
 	void createFxLine();
 
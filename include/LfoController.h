@@ -77,6 +77,8 @@ protected:
 
 private:
 	SampleBuffer * m_userDefSampleBuffer;
+	// seeds the random wave, see DeterministicRender
+	uint64_t m_renderOrder;
 
 protected slots:
 	void updatePhase();
@@ -31,6 +31,28 @@ class ValueBuffer;
 namespace MixHelpers
 {
 
+/*! \brief Instruction sets the functions below can be run with
+ *
+ * All of them give bit-identical results. By default the best one
+ * supported by the CPU is used.
+ */
+enum class Implementation
+{
+	Scalar,
+	SSE2,
+	AVX2,
+	AVX512
+} ;
+
+Implementation implementation();
+
+bool isSupported( Implementation impl );
+
+//! Switch to another implementation, e.g. for benchmarking - returns false if the CPU doesn't support it
+bool setImplementation( Implementation impl );
+
+const char * implementationName( Implementation impl );
+
 bool isSilent( const sampleFrame* src, int frames );
 
 bool useNaNHandler();
@@ -70,6 +92,28 @@ void addMultipliedStereo( sampleFrame* dst, const sampleFrame* src, float coeffS
 /*! \brief Multiply dst by coeffDst and add samples from src multiplied by coeffSrc */
 void multiplyAndAddMultiplied( sampleFrame* dst, const sampleFrame* src, float coeffDst, float coeffSrc, int frames );
 
+/*! \brief Compute left/right gains for every frame from volume and panning in percent
+ *
+ * Values of volBuf/panBuf are used instead of volume/panning if given.
+ */
+void volumePanGains( sampleFrame* gains, const ValueBuffer * volBuf, float volume, const ValueBuffer * panBuf, float panning, int frames );
+
+/*! \brief Write the sum of count buffers from srcs to dst, multiplied by gains if not NULL */
+void sumMultipliedByGains( sampleFrame* dst, const sampleFrame* const* srcs, int count, const sampleFrame* gains, int frames );
+
+/*! \brief Convert src multiplied by gain to interleaved integers in [-scale, scale]
+ *
+ * Samples are clipped to [-1, 1] first. If given, dither (two values per
+ * frame, in steps of the output) is added before rounding to nearest.
+ */
+void quantize( int32_t* dst, const sampleFrame* src, float gain, float scale, const float* dither, int frames );
+
+/*! \brief FIR filter for resampling: dst[f] is the sum of src[offsets[f] + k] * coeffs[f * taps + k] for k < taps
+ *
+ * taps has to be a multiple of 8.
+ */
+void convolve( sampleFrame* dst, const sampleFrame* src, const int* offsets, const float* coeffs, int taps, int frames );
+
 /*! \brief Multiply dst by coeffDst and add samples from srcLeft/srcRight multiplied by coeffSrc */
 void multiplyAndAddMultipliedJoined( sampleFrame* dst, const sample_t* srcLeft, const sample_t* srcRight, float coeffDst, float coeffSrc, int frames );
 
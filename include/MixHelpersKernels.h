@@ -0,0 +1,524 @@
+/*
+ * MixHelpersKernels.h - vectorized kernels behind MixHelpers
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+
+#ifndef MIX_HELPERS_KERNELS_H
+#define MIX_HELPERS_KERNELS_H
+
+#include "lmms_basics.h"
+
+
+namespace MixHelpers
+{
+
+/*! \brief Table of the kernels behind the MixHelpers functions
+ *
+ * One table exists per instruction set, the best one supported by the CPU
+ * is picked at startup. All of them produce bit-identical results: they
+ * do the same operations in the same order as the scalar reference, only
+ * several samples at once. Coefficient buffers hold one value per frame.
+ */
+struct Kernels
+{
+	const char * name;
+
+	bool (*isSilent)( const sampleFrame* src, int frames );
+	//! Clamps the buffer, or clears it and returns true if it holds infs/nans
+	bool (*sanitize)( sampleFrame* src, int frames );
+
+	void (*add)( sampleFrame* dst, const sampleFrame* src, int frames );
+	void (*addMultiplied)( sampleFrame* dst, const sampleFrame* src, float coeffSrc, int frames );
+	void (*addSwappedMultiplied)( sampleFrame* dst, const sampleFrame* src, float coeffSrc, int frames );
+	void (*addMultipliedByBuffer)( sampleFrame* dst, const sampleFrame* src, float coeffSrc, const float* coeffSrcBuf, int frames );
+	void (*addMultipliedByBuffers)( sampleFrame* dst, const sampleFrame* src, const float* coeffSrcBuf1, const float* coeffSrcBuf2, int frames );
+	void (*addSanitizedMultiplied)( sampleFrame* dst, const sampleFrame* src, float coeffSrc, int frames );
+	void (*addSanitizedMultipliedByBuffer)( sampleFrame* dst, const sampleFrame* src, float coeffSrc, const float* coeffSrcBuf, int frames );
+	void (*addSanitizedMultipliedByBuffers)( sampleFrame* dst, const sampleFrame* src, const float* coeffSrcBuf1, const float* coeffSrcBuf2, int frames );
+	void (*addMultipliedStereo)( sampleFrame* dst, const sampleFrame* src, float coeffSrcLeft, float coeffSrcRight, int frames );
+	void (*multiplyAndAddMultiplied)( sampleFrame* dst, const sampleFrame* src, float coeffDst, float coeffSrc, int frames );
+	//! Volume and panning in percent, buffers may be NULL
+	void (*volumePanGains)( sampleFrame* gains, const float* volBuf, float volume, const float* panBuf, float panning, int frames );
+	void (*sumMultipliedByGains)( sampleFrame* dst, const sampleFrame* const* srcs, int count, const sampleFrame* gains, int frames );
+	//! Dither holds two values per frame and may be NULL
+	void (*quantize)( int32_t* dst, const sampleFrame* src, float gain, float scale, const float* dither, int frames );
+	//! Taps is a multiple of ConvolveLanes
+	void (*convolve)( sampleFrame* dst, const sampleFrame* src, const int* offsets, const float* coeffs, int taps, int frames );
+} ;
+
+
+//! Every convolve() kernel sums up the products of every ConvolveLanes-th
+//! tap separately and adds up these partial sums in the same order
+const int ConvolveLanes = 8;
+
+
+extern const Kernels scalarKernels;
+#ifdef LMMS_HAVE_SIMD_MIXHELPERS
+extern const Kernels sse2Kernels;
+extern const Kernels avx2Kernels;
+extern const Kernels avx512Kernels;
+#endif
+
+
+
+/*! \brief Kernels for one instruction set
+ *
+ * V describes a vector of V::Width floats, i.e. V::Width / 2 frames, and
+ * provides load/store and the arithmetic used below. Only include this
+ * from the translation unit compiled for that instruction set. Remaining
+ * frames are processed one by one with plain float arithmetic - library
+ * functions are avoided on purpose, as their inline copies compiled with
+ * the instruction set of this unit could end up being used elsewhere.
+ */
+template<class V>
+class VectorKernels
+{
+	typedef typename V::Vec Vec;
+
+	static const int Frames = V::Width / 2;
+
+	static inline bool isFinite( float x )
+	{
+		// false for nans and infs
+		return x - x == 0.0f;
+	}
+
+	static inline int blocks( int frames )
+	{
+		return frames - frames % Frames;
+	}
+
+public:
+	static bool isSilent( const sampleFrame* src, int frames )
+	{
+		const float silenceThreshold = 0.0000001f;
+		const Vec threshold = V::set1( silenceThreshold );
+		const float* s = src[0];
+
+		const int n = blocks( frames );
+		for( int f = 0; f < n; f += Frames )
+		{
+			if( V::anyGreaterEqual( V::abs( V::load( s + f*2 ) ), threshold ) )
+			{
+				return false;
+			}
+		}
+		for( int f = n; f < frames; ++f )
+		{
+			for( int c = 0; c < 2; ++c )
+			{
+				if( src[f][c] >= silenceThreshold || src[f][c] <= -silenceThreshold )
+				{
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	static bool sanitize( sampleFrame* src, int frames )
+	{
+		const Vec lower = V::set1( -1000.0f );
+		const Vec upper = V::set1( 1000.0f );
+		float* s = src[0];
+
+		bool finite = true;
+		const int n = blocks( frames );
+		for( int f = 0; f < n && finite; f += Frames )
+		{
+			const Vec x = V::load( s + f*2 );
+			finite = V::allFinite( x );
+			V::store( s + f*2, V::max( V::min( x, upper ), lower ) );
+		}
+		for( int f = n; f < frames && finite; ++f )
+		{
+			for( int c = 0; c < 2; ++c )
+			{
+				const float x = src[f][c];
+				finite = finite && isFinite( x );
+				src[f][c] = x < -1000.0f ? -1000.0f : ( x > 1000.0f ? 1000.0f : x );
+			}
+		}
+
+		if( !finite )
+		{
+			for( int i = 0; i < frames*2; ++i )
+			{
+				s[i] = 0.0f;
+			}
+		}
+		return !finite;
+	}
+
+	static void add( sampleFrame* dst, const sampleFrame* src, int frames )
+	{
+		float* d = dst[0];
+		const float* s = src[0];
+
+		const int n = blocks( frames );
+		for( int f = 0; f < n; f += Frames )
+		{
+			V::store( d + f*2, V::add( V::load( d + f*2 ), V::load( s + f*2 ) ) );
+		}
+		for( int f = n; f < frames; ++f )
+		{
+			dst[f][0] += src[f][0];
+			dst[f][1] += src[f][1];
+		}
+	}
+
+	static void addMultiplied( sampleFrame* dst, const sampleFrame* src, float coeffSrc, int frames )
+	{
+		const Vec coeff = V::set1( coeffSrc );
+		float* d = dst[0];
+		const float* s = src[0];
+
+		const int n = blocks( frames );
+		for( int f = 0; f < n; f += Frames )
+		{
+			V::store( d + f*2, V::add( V::load( d + f*2 ), V::mul( V::load( s + f*2 ), coeff ) ) );
+		}
+		for( int f = n; f < frames; ++f )
+		{
+			dst[f][0] += src[f][0] * coeffSrc;
+			dst[f][1] += src[f][1] * coeffSrc;
+		}
+	}
+
+	static void addSwappedMultiplied( sampleFrame* dst, const sampleFrame* src, float coeffSrc, int frames )
+	{
+		const Vec coeff = V::set1( coeffSrc );
+		float* d = dst[0];
+		const float* s = src[0];
+
+		const int n = blocks( frames );
+		for( int f = 0; f < n; f += Frames )
+		{
+			V::store( d + f*2, V::add( V::load( d + f*2 ), V::mul( V::swapChannels( V::load( s + f*2 ) ), coeff ) ) );
+		}
+		for( int f = n; f < frames; ++f )
+		{
+			dst[f][0] += src[f][1] * coeffSrc;
+			dst[f][1] += src[f][0] * coeffSrc;
+		}
+	}
+
+	template<bool SANITIZE>
+	static void addMultipliedByBufferT( sampleFrame* dst, const sampleFrame* src, float coeffSrc, const float* coeffSrcBuf, int frames )
+	{
+		const Vec coeff = V::set1( coeffSrc );
+		float* d = dst[0];
+		const float* s = src[0];
+
+		const int n = blocks( frames );
+		for( int f = 0; f < n; f += Frames )
+		{
+			const Vec x = V::load( s + f*2 );
+			const Vec y = V::mul( V::mul( x, coeff ), V::loadPerFrame( coeffSrcBuf + f ) );
+			V::store( d + f*2, V::add( V::load( d + f*2 ), SANITIZE ? V::zeroNonFinite( x, y ) : y ) );
+		}
+		for( int f = n; f < frames; ++f )
+		{
+			for( int c = 0; c < 2; ++c )
+			{
+				const float y = src[f][c] * coeffSrc * coeffSrcBuf[f];
+				dst[f][c] += ( SANITIZE && !isFinite( src[f][c] ) ) ? 0.0f : y;
+			}
+		}
+	}
+
+	template<bool SANITIZE>
+	static void addMultipliedByBuffersT( sampleFrame* dst, const sampleFrame* src, const float* coeffSrcBuf1, const float* coeffSrcBuf2, int frames )
+	{
+		float* d = dst[0];
+		const float* s = src[0];
+
+		const int n = blocks( frames );
+		for( int f = 0; f < n; f += Frames )
+		{
+			const Vec x = V::load( s + f*2 );
+			const Vec y = V::mul( V::mul( x, V::loadPerFrame( coeffSrcBuf1 + f ) ),
+									V::loadPerFrame( coeffSrcBuf2 + f ) );
+			V::store( d + f*2, V::add( V::load( d + f*2 ), SANITIZE ? V::zeroNonFinite( x, y ) : y ) );
+		}
+		for( int f = n; f < frames; ++f )
+		{
+			for( int c = 0; c < 2; ++c )
+			{
+				const float y = src[f][c] * coeffSrcBuf1[f] * coeffSrcBuf2[f];
+				dst[f][c] += ( SANITIZE && !isFinite( src[f][c] ) ) ? 0.0f : y;
+			}
+		}
+	}
+
+	template<bool SANITIZE>
+	static void addMultipliedT( sampleFrame* dst, const sampleFrame* src, float coeffSrcLeft, float coeffSrcRight, int frames )
+	{
+		const Vec coeff = V::set2( coeffSrcLeft, coeffSrcRight );
+		float* d = dst[0];
+		const float* s = src[0];
+
+		const int n = blocks( frames );
+		for( int f = 0; f < n; f += Frames )
+		{
+			const Vec x = V::load( s + f*2 );
+			const Vec y = V::mul( x, coeff );
+			V::store( d + f*2, V::add( V::load( d + f*2 ), SANITIZE ? V::zeroNonFinite( x, y ) : y ) );
+		}
+		for( int f = n; f < frames; ++f )
+		{
+			const float y0 = src[f][0] * coeffSrcLeft;
+			const float y1 = src[f][1] * coeffSrcRight;
+			dst[f][0] += ( SANITIZE && !isFinite( src[f][0] ) ) ? 0.0f : y0;
+			dst[f][1] += ( SANITIZE && !isFinite( src[f][1] ) ) ? 0.0f : y1;
+		}
+	}
+
+	static void addSanitizedMultiplied( sampleFrame* dst, const sampleFrame* src, float coeffSrc, int frames )
+	{
+		addMultipliedT<true>( dst, src, coeffSrc, coeffSrc, frames );
+	}
+
+	static void addMultipliedStereo( sampleFrame* dst, const sampleFrame* src, float coeffSrcLeft, float coeffSrcRight, int frames )
+	{
+		addMultipliedT<false>( dst, src, coeffSrcLeft, coeffSrcRight, frames );
+	}
+
+	static void multiplyAndAddMultiplied( sampleFrame* dst, const sampleFrame* src, float coeffDst, float coeffSrc, int frames )
+	{
+		const Vec cd = V::set1( coeffDst );
+		const Vec cs = V::set1( coeffSrc );
+		float* d = dst[0];
+		const float* s = src[0];
+
+		const int n = blocks( frames );
+		for( int f = 0; f < n; f += Frames )
+		{
+			V::store( d + f*2, V::add( V::mul( V::load( d + f*2 ), cd ), V::mul( V::load( s + f*2 ), cs ) ) );
+		}
+		for( int f = n; f < frames; ++f )
+		{
+			dst[f][0] = dst[f][0]*coeffDst + src[f][0]*coeffSrc;
+			dst[f][1] = dst[f][1]*coeffDst + src[f][1]*coeffSrc;
+		}
+	}
+
+	template<bool VOLBUF, bool PANBUF>
+	static void volumePanGainsT( sampleFrame* gains, const float* volBuf, float volume, const float* panBuf, float panning, int frames )
+	{
+		const Vec percent = V::set1( 0.01f );
+		const Vec one = V::set1( 1.0f );
+		const Vec zero = V::set1( 0.0f );
+		// left: 1 - max( p, 0 ), right: 1 + min( p, 0 ) = 1 - max( -p, 0 )
+		const Vec sign = V::set2( 1.0f, -1.0f );
+		const Vec v = V::set1( volume * 0.01f );
+		const Vec p = V::set1( panning * 0.01f );
+		float* g = gains[0];
+
+		const int n = blocks( frames );
+		for( int f = 0; f < n; f += Frames )
+		{
+			const Vec vf = VOLBUF ? V::mul( V::loadPerFrame( volBuf + f ), percent ) : v;
+			const Vec pf = PANBUF ? V::mul( V::loadPerFrame( panBuf + f ), percent ) : p;
+			V::store( g + f*2, V::mul( V::sub( one, V::max( V::mul( pf, sign ), zero ) ), vf ) );
+		}
+		for( int f = n; f < frames; ++f )
+		{
+			const float vf = ( VOLBUF ? volBuf[f] : volume ) * 0.01f;
+			const float pf = ( PANBUF ? panBuf[f] : panning ) * 0.01f;
+			gains[f][0] = ( 1.0f - ( pf > 0.0f ? pf : 0.0f ) ) * vf;
+			gains[f][1] = ( 1.0f - ( -pf > 0.0f ? -pf : 0.0f ) ) * vf;
+		}
+	}
+
+	static void volumePanGains( sampleFrame* gains, const float* volBuf, float volume, const float* panBuf, float panning, int frames )
+	{
+		if( volBuf && panBuf )
+		{
+			volumePanGainsT<true, true>( gains, volBuf, volume, panBuf, panning, frames );
+		}
+		else if( volBuf )
+		{
+			volumePanGainsT<true, false>( gains, volBuf, volume, panBuf, panning, frames );
+		}
+		else if( panBuf )
+		{
+			volumePanGainsT<false, true>( gains, volBuf, volume, panBuf, panning, frames );
+		}
+		else
+		{
+			volumePanGainsT<false, false>( gains, volBuf, volume, panBuf, panning, frames );
+		}
+	}
+
+	template<bool GAINS>
+	static void sumMultipliedByGainsT( sampleFrame* dst, const sampleFrame* const* srcs, int count, const sampleFrame* gains, int frames )
+	{
+		float* d = dst[0];
+
+		const int n = blocks( frames );
+		for( int f = 0; f < n; f += Frames )
+		{
+			Vec sum = V::set1( 0.0f );
+			for( int i = 0; i < count; ++i )
+			{
+				sum = V::add( sum, V::load( srcs[i][0] + f*2 ) );
+			}
+			V::store( d + f*2, GAINS ? V::mul( sum, V::load( gains[0] + f*2 ) ) : sum );
+		}
+		for( int f = n; f < frames; ++f )
+		{
+			for( int c = 0; c < 2; ++c )
+			{
+				float sum = 0.0f;
+				for( int i = 0; i < count; ++i )
+				{
+					sum += srcs[i][f][c];
+				}
+				dst[f][c] = GAINS ? sum * gains[f][c] : sum;
+			}
+		}
+	}
+
+	static void sumMultipliedByGains( sampleFrame* dst, const sampleFrame* const* srcs, int count, const sampleFrame* gains, int frames )
+	{
+		if( gains )
+		{
+			sumMultipliedByGainsT<true>( dst, srcs, count, gains, frames );
+		}
+		else
+		{
+			sumMultipliedByGainsT<false>( dst, srcs, count, gains, frames );
+		}
+	}
+
+	template<bool DITHER>
+	static void quantizeT( int32_t* dst, const sampleFrame* src, float gain, float scale, const float* dither, int frames )
+	{
+		const Vec g = V::set1( gain );
+		const Vec s = V::set1( scale );
+		const Vec one = V::set1( 1.0f );
+		const Vec minusOne = V::set1( -1.0f );
+		const Vec minusScale = V::set1( -scale );
+		const float* x = src[0];
+
+		const int n = blocks( frames );
+		for( int f = 0; f < n; f += Frames )
+		{
+			const Vec clipped = V::max( V::min( V::mul( V::load( x + f*2 ), g ), one ), minusOne );
+			Vec y = V::mul( clipped, s );
+			if( DITHER )
+			{
+				y = V::max( V::min( V::add( y, V::load( dither + f*2 ) ), s ), minusScale );
+			}
+			V::storeInt( dst + f*2, y );
+		}
+		// written like min/max above, so nans end up the same way
+		for( int i = n*2; i < frames*2; ++i )
+		{
+			float y = x[i] * gain;
+			y = y < 1.0f ? y : 1.0f;
+			y = ( y > -1.0f ? y : -1.0f ) * scale;
+			if( DITHER )
+			{
+				y = y + dither[i];
+				y = y < scale ? y : scale;
+				y = y > -scale ? y : -scale;
+			}
+			dst[i] = V::roundToInt( y );
+		}
+	}
+
+	static void quantize( int32_t* dst, const sampleFrame* src, float gain, float scale, const float* dither, int frames )
+	{
+		if( dither )
+		{
+			quantizeT<true>( dst, src, gain, scale, dither, frames );
+		}
+		else
+		{
+			quantizeT<false>( dst, src, gain, scale, dither, frames );
+		}
+	}
+
+	static void convolve( sampleFrame* dst, const sampleFrame* src, const int* offsets, const float* coeffs, int taps, int frames )
+	{
+		const int Vectors = ConvolveLanes / Frames;
+		for( int f = 0; f < frames; ++f )
+		{
+			const float* s = src[offsets[f]];
+			const float* c = coeffs + f * taps;
+
+			Vec sums[Vectors];
+			for( int v = 0; v < Vectors; ++v )
+			{
+				sums[v] = V::set1( 0.0f );
+			}
+			for( int t = 0; t < taps; t += ConvolveLanes )
+			{
+				for( int v = 0; v < Vectors; ++v )
+				{
+					const int k = t + v * Frames;
+					sums[v] = V::add( sums[v], V::mul( V::load( s + k*2 ), V::loadPerFrame( c + k ) ) );
+				}
+			}
+
+			float lanes[ConvolveLanes][2];
+			for( int v = 0; v < Vectors; ++v )
+			{
+				V::store( lanes[v * Frames], sums[v] );
+			}
+			for( int ch = 0; ch < 2; ++ch )
+			{
+				dst[f][ch] = ( ( lanes[0][ch] + lanes[1][ch] ) + ( lanes[2][ch] + lanes[3][ch] ) ) +
+						( ( lanes[4][ch] + lanes[5][ch] ) + ( lanes[6][ch] + lanes[7][ch] ) );
+			}
+		}
+	}
+
+	static constexpr Kernels table( const char * name )
+	{
+		return Kernels {
+			name,
+			&isSilent,
+			&sanitize,
+			&add,
+			&addMultiplied,
+			&addSwappedMultiplied,
+			&addMultipliedByBufferT<false>,
+			&addMultipliedByBuffersT<false>,
+			&addSanitizedMultiplied,
+			&addMultipliedByBufferT<true>,
+			&addMultipliedByBuffersT<true>,
+			&addMultipliedStereo,
+			&multiplyAndAddMultiplied,
+			&volumePanGains,
+			&sumMultipliedByGains,
+			&quantize,
+			&convolve
+		};
+	}
+} ;
+
+}
+
+#endif
@@ -34,8 +34,8 @@
 
 #include "lmms_basics.h"
 #include "LocklessList.h"
+#include "PlayHandleRegistry.h"
 #include "Note.h"
-#include "fifo_buffer.h"
 #include "MixerProfiler.h"
 
 
@@ -64,6 +64,8 @@ const Octaves BaseOctave = DefaultOctave;
 
 
 class MixerWorkerThread;
+class PeriodFifo;
+class RenderGraph;
 
 
 class LMMS_EXPORT Mixer : public QObject
@@ -192,11 +194,16 @@ public:
 	{
 		requestChangeInModel();
 		m_audioPorts.push_back( _port );
+		invalidateRenderGraph();
 		doneChangeInModel();
 	}
 
 	void removeAudioPort( AudioPort * _port );
 
+	//! Has to be called whenever the routing between audio ports and
+	//! FX channels changes
+	void invalidateRenderGraph();
+
 
 	// MIDI-client-stuff
 	inline const QString & midiClientName() const
@@ -215,7 +222,7 @@ public:
 
 	void removePlayHandle( PlayHandle* handle );
 
-	inline PlayHandleList& playHandles()
+	inline PlayHandleRegistry& playHandles()
 	{
 		return m_playHandles;
 	}
@@ -305,10 +312,7 @@ public:
 		return m_inputBufferFrames[ m_inputBufferRead ];
 	}
 
-	inline const surroundSampleFrame * nextBuffer()
-	{
-		return hasFifoWriter() ? m_fifo->read() : renderNextBuffer();
-	}
+	const surroundSampleFrame * nextBuffer();
 
 	void changeQuality( const struct qualitySettings & _qs );
 
@@ -330,24 +334,22 @@ signals:
 
 
 private:
-	typedef fifoBuffer<surroundSampleFrame *> fifo;
-
 	class fifoWriter : public QThread
 	{
 	public:
-		fifoWriter( Mixer * _mixer, fifo * _fifo );
+		fifoWriter( Mixer * _mixer, PeriodFifo * _fifo );
 
 		void finish();
 
 
 	private:
 		Mixer * m_mixer;
-		fifo * m_fifo;
+		PeriodFifo * m_fifo;
 		volatile bool m_writing;
 
 		virtual void run();
 
-		void write( surroundSampleFrame * buffer );
+		void write( const surroundSampleFrame * buffer );
 
 	} ;
 
@@ -365,6 +367,9 @@ private:
 
 	const surroundSampleFrame * renderNextBuffer();
 
+	void removeFinishedPlayHandles();
+	static void deletePlayHandle( PlayHandle * handle );
+
 	void clearInternal();
 
 	//! Called by the audio thread to give control to other threads,
@@ -395,8 +400,12 @@ private:
 	QVector<MixerWorkerThread *> m_workers;
 	int m_numWorkers;
 
+	// NULL if play handles, audio ports and FX channels are processed
+	// in separate stages
+	RenderGraph * m_renderGraph;
+
 	// playhandle stuff
-	PlayHandleList m_playHandles;
+	PlayHandleRegistry m_playHandles;
 	// place where new playhandles are added temporarily
 	LocklessList<PlayHandle *> m_newPlayHandles;
 	ConstPlayHandleList m_playHandlesToRemove;
@@ -419,7 +428,7 @@ private:
 	QString m_midiClientName;
 
 	// FIFO stuff
-	fifo * m_fifo;
+	PeriodFifo * m_fifo;
 	fifoWriter * m_fifoWriter;
 
 	MixerProfiler m_profiler;
@@ -26,6 +26,14 @@
 #define MIXER_PROFILER_H
 
 #include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QPair>
+#include <QVector>
+
+#include <atomic>
+#include <chrono>
+#include <vector>
 
 #include "lmms_basics.h"
 #include "MicroTimer.h"
@@ -33,6 +41,67 @@
 class MixerProfiler
 {
 public:
+	//! What took the time measured by a Probe
+	enum class NodeType
+	{
+		PlayHandle,	// per type of play handle, not per instance
+		Instrument,
+		Effect,
+		FxChannel,
+		Total		// the whole period
+	} ;
+
+	/*! \brief Measures the time until it goes out of scope
+	 *
+	 * Does nothing unless per-node profiling is enabled. Times include
+	 * those of nested probes, e.g. the one of an FX channel contains the
+	 * times of its effects.
+	 */
+	class Probe
+	{
+	public:
+		Probe( MixerProfiler & profiler, NodeType type, const void * node ) :
+			m_profiler( profiler.nodeProfiling() ? &profiler : NULL ),
+			m_type( type ),
+			m_node( node ),
+			m_start( m_profiler ? Clock::now() : Clock::time_point() )
+		{
+		}
+
+		~Probe()
+		{
+			if( m_profiler )
+			{
+				m_profiler->record( m_type, m_node, std::chrono::duration_cast<std::chrono::nanoseconds>(
+								Clock::now() - m_start ).count() );
+			}
+		}
+
+	private:
+		typedef std::chrono::steady_clock Clock;
+
+		MixerProfiler * m_profiler;
+		NodeType m_type;
+		const void * m_node;
+		Clock::time_point m_start;
+	} ;
+
+	//! Times per period of one node, in microseconds
+	struct NodeStats
+	{
+		NodeType type;
+		//! Only for showing, different nodes may have the same name
+		QString name;
+		//! Unique per node as long as the profiler exists
+		quint64 id;
+		int periods;
+		float mean;
+		float median;
+		float p95;
+		float p99;
+		float max;
+	} ;
+
 	MixerProfiler();
 	~MixerProfiler();
 
@@ -48,13 +117,143 @@ public:
 		return m_cpuLoad;
 	}
 
+	//! Writes the time of every period with the underruns and overruns
+	//! during it, or a per-node report in CSV or JSON including the total
+	//! counts when the mixer is destroyed if the file name ends that way
 	void setOutputFile( const QString& outputFile );
 
+	//! Per-node profiling is on as long as anyone enabled it
+	void enableNodeProfiling( bool enable );
+
+	bool nodeProfiling() const
+	{
+		return m_nodeProfilingUsers.load( std::memory_order_relaxed ) > 0;
+	}
+
+	//! Statistics over the last periods, or all of them if a report is
+	//! written - can be called from any thread
+	QVector<NodeStats> nodeStats() const;
+
+	//! Length of a period in microseconds
+	float periodLength() const
+	{
+		return m_periodLength;
+	}
+
+	static const char * nodeTypeName( NodeType type );
+
+	//! The audio device wanted a period but none was rendered yet
+	void reportUnderrun()
+	{
+		++m_underruns;
+	}
+
+	//! The audio device did not take a period for too long
+	void reportOverrun()
+	{
+		++m_overruns;
+	}
+
+	int underruns() const
+	{
+		return m_underruns;
+	}
+
+	int overruns() const
+	{
+		return m_overruns;
+	}
+
+	//! Clearing, mixing or processing a buffer was skipped because it was
+	//! known to be silent
+	void reportSkippedWork( int count = 1 )
+	{
+		m_skippedWork.fetch_add( count, std::memory_order_relaxed );
+	}
+
+	//! Buffer operations skipped during the last period
+	int skippedWork() const
+	{
+		return m_lastSkippedWork;
+	}
+
 
 private:
+	struct Sample
+	{
+		NodeType type;
+		const void * node;
+		qint64 nanoseconds;
+	} ;
+
+	// samples of one thread, collected by finishPeriod() when all
+	// threads are done with the period
+	struct ThreadLog
+	{
+		std::vector<Sample> samples;
+	} ;
+
+	struct NodeHistory
+	{
+		NodeType type;
+		QString name;
+		quint64 id;
+		// microseconds per period, a ring unless all periods are kept
+		std::vector<float> times;
+		int next;
+		int unseen;
+		qint64 current;
+		bool seen;
+	} ;
+
+	enum ReportFormats
+	{
+		NoReport,
+		CsvReport,
+		JsonReport
+	} ;
+
+	typedef QPair<int, const void *> NodeKey;
+
+	void record( NodeType type, const void * node, qint64 nanoseconds );
+	void collectNodeTimes( qint64 periodNanoseconds );
+	void dropNodeTimes();
+	void writeReport();
+
+	static QString nodeName( NodeType type, const void * node );
+	static NodeStats statsOf( const NodeHistory & node );
+
 	MicroTimer m_periodTimer;
 	int m_cpuLoad;
 	QFile m_outputFile;
+	ReportFormats m_reportFormat;
+
+	// updated from the audio device thread
+	std::atomic_int m_underruns;
+	std::atomic_int m_overruns;
+	// counts as of the last line written per period
+	int m_writtenUnderruns;
+	int m_writtenOverruns;
+
+	// updated from the worker threads
+	std::atomic_int m_skippedWork;
+	int m_lastSkippedWork;
+
+	const int m_id;
+	std::atomic_int m_nodeProfilingUsers;
+	bool m_keepAllPeriods;
+	float m_periodLength;
+
+	QMutex m_logsMutex;
+	std::vector<ThreadLog *> m_threadLogs;
+
+	mutable QMutex m_statsMutex;
+	QHash<NodeKey, NodeHistory> m_nodes;
+	QVector<NodeHistory> m_retiredNodes;
+	quint64 m_lastNodeId;
+
+	static thread_local ThreadLog * s_threadLog;
+	static thread_local int s_threadLogOwner;
 
 };
 
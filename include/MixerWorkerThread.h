@@ -28,7 +28,9 @@
 #include <QtCore/QThread>
 
 #include <atomic>
+#include <vector>
 
+class QMutex;
 class QWaitCondition;
 class Mixer;
 class ThreadableJob;
@@ -38,6 +40,12 @@ class MixerWorkerThread : public QThread
 	Q_OBJECT
 public:
 	// internal representation of the job queue - all functions are thread-safe
+	//
+	// Every participating thread owns a work-stealing deque. Jobs added
+	// while the queue is idle are distributed round-robin over all deques,
+	// jobs added while processing (Dynamic mode) go to the deque of the
+	// adding thread. A thread pops from the bottom of its own deque and
+	// steals from the top of the others' once it runs dry.
 	class JobQueue
 	{
 	public:
@@ -48,26 +56,72 @@ public:
 		} ;
 
 #define JOB_QUEUE_SIZE 8192
-		JobQueue() :
-			m_items(),
-			m_writeIndex( 0 ),
-			m_itemsDone( 0 ),
-			m_opMode( Static )
+		JobQueue( int queues = 1 );
+		~JobQueue();
+
+		//! Set number of deques, must only be called while no thread
+		//! is processing the queue
+		void setQueueCount( int queues );
+
+		int queueCount() const
 		{
-			std::fill(m_items, m_items + JOB_QUEUE_SIZE, nullptr);
+			return m_deques.size();
 		}
 
+		//! Bind calling thread to deque @p index. Threads which are not
+		//! bound use the last deque, which is the one processed inline
+		//! by the thread calling wait().
+		static void setThreadQueue( int index );
+
 		void reset( OperationMode _opMode );
 
 		void addJob( ThreadableJob * _job );
 
+		//! Allow threads to take jobs from the queue
+		void start();
+
+		//! Take and process jobs until no job is left to take
 		void run();
+		//! Help processing jobs until all queued jobs are done
 		void wait();
 
 	private:
-		std::atomic<ThreadableJob*> m_items[JOB_QUEUE_SIZE];
+		// bounded Chase-Lev deque
+		class Deque
+		{
+		public:
+			Deque();
+
+			void clear();
+			bool push( ThreadableJob * _job );
+			ThreadableJob * pop();
+			ThreadableJob * steal();
+
+			bool isEmpty() const
+			{
+				return m_top.load( std::memory_order_acquire ) >=
+					m_bottom.load( std::memory_order_acquire );
+			}
+
+		private:
+			// keep owner and thieves on different cache lines
+			std::atomic_int m_top;
+			char m_pad0[64 - sizeof( std::atomic_int )];
+			std::atomic_int m_bottom;
+			char m_pad1[64 - sizeof( std::atomic_int )];
+			std::atomic<ThreadableJob*> m_items[JOB_QUEUE_SIZE];
+		} ;
+
+		int currentQueue() const;
+		ThreadableJob * takeJob( int _index );
+		void processJob( ThreadableJob * _job );
+
+		std::vector<Deque *> m_deques;
+		int m_nextQueue;
 		std::atomic_int m_writeIndex;
 		std::atomic_int m_itemsDone;
+		std::atomic_int m_activeThreads;
+		std::atomic_bool m_processing;
 		OperationMode m_opMode;
 
 	} ;
@@ -108,10 +162,17 @@ public:
 private:
 	virtual void run();
 
+	unsigned int waitForJobs( unsigned int _generation );
+	static void wakeAll();
+
 	static JobQueue globalJobQueue;
+	static QMutex * queueReadyMutex;
 	static QWaitCondition * queueReadyWaitCond;
 	static QList<MixerWorkerThread *> workerThreads;
+	static std::atomic_uint generation;
+	static std::atomic_int sleepingWorkers;
 
+	int m_index;
 	volatile bool m_quit;
 
 } ;
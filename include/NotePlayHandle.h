@@ -34,7 +34,6 @@
 #include "Track.h"
 #include "MemoryManager.h"
 
-class QReadWriteLock;
 class InstrumentTrack;
 class NotePlayHandle;
 
@@ -301,6 +300,7 @@ private:
 	f_cnt_t m_releaseFramesDone;			// number of frames done after
 											// release of note
 	NotePlayHandleList m_subNotes;			// used for chords and arpeggios
+	int m_subNotesCreated;					// for the render order of sub-notes
 	volatile bool m_released;				// indicates whether note is released
 	bool m_releaseStarted;
 	bool m_hasMidiNote;
@@ -330,13 +330,28 @@ private:
 
 
 const int INITIAL_NPH_CACHE = 256;
-const int NPH_CACHE_INCREMENT = 16;
-
+// the pool hands out and takes back handles in magazines of this size
+const int NPH_MAGAZINE_SIZE = 16;
+// upper limit of magazines, half of them may be filled by growing the pool
+const int NPH_MAX_MAGAZINES = 1024;
+// grow the pool once less full magazines than this are left
+const int NPH_LOW_WATERMARK = 4;
+const int NPH_CACHE_INCREMENT = 4 * NPH_MAGAZINE_SIZE;
+
+/*! \brief Pool of NotePlayHandles without locks
+ *
+ * Every thread keeps two magazines of free handles, so acquiring and
+ * releasing usually doesn't touch shared state at all. Full and empty
+ * magazines are exchanged with a global depot of lock-free stacks.
+ * The pool is grown by a background thread whenever the depot runs low;
+ * only if it runs dry, a handle is allocated directly (a miss).
+ */
 class NotePlayHandleManager
 {
 	MM_OPERATORS
 public:
 	static void init();
+	static void cleanup();
 	static NotePlayHandle * acquire( InstrumentTrack* instrumentTrack,
 					const f_cnt_t offset,
 					const f_cnt_t frames,
@@ -345,13 +360,18 @@ public:
 					int midiEventChannel = -1,
 					NotePlayHandle::Origin origin = NotePlayHandle::OriginPattern );
 	static void release( NotePlayHandle * nph );
-	static void extend( int i );
 
-private:
-	static NotePlayHandle ** s_available;
-	static QReadWriteLock s_mutex;
-	static std::atomic_int s_availableIndex;
-	static int s_size;
+	//! Add @p c handles to the pool - don't call from the audio threads
+	static void extend( int c );
+
+	//! Raw storage for one NotePlayHandle, used by acquire() and release()
+	static void * allocate();
+	static void deallocate( void * ptr );
+
+	//! Number of acquires served from the pool
+	static int hits();
+	//! Number of acquires which had to allocate a new handle
+	static int misses();
 };
 
 
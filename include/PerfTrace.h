@@ -0,0 +1,94 @@
+/*
+ * PerfTrace.h - Timeline of the render pipeline in Chrome trace format
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#ifndef PERFTRACE_H
+#define PERFTRACE_H
+
+#include <atomic>
+#include <chrono>
+
+#include <QtCore/QString>
+
+/// \brief Opt-in timeline of what the audio threads are doing
+///
+/// Spans are recorded into a fixed-size ring buffer of the thread which
+/// recorded them, so the oldest ones get overwritten on long runs. finish()
+/// writes them as Chrome trace events, which can be opened in Perfetto or
+/// chrome://tracing.
+class PerfTrace
+{
+public:
+	/// \brief Records the time between construction and destruction
+	///
+	/// \p name has to stay valid until the trace is written, i.e. be a
+	/// string literal.
+	class Span
+	{
+	public:
+		Span(const char* name) :
+			m_name(isEnabled() ? name : nullptr),
+			m_begin(m_name ? now() : 0)
+		{
+		}
+
+		~Span()
+		{
+			if (m_name)
+			{
+				record(m_name, m_begin, now());
+			}
+		}
+
+	private:
+		const char* m_name;
+		qint64 m_begin;
+	};
+
+	/// Start recording, the trace is written to \p outputFile by finish()
+	static void start(const QString& outputFile);
+
+	/// Stop recording and write the trace, all threads recording spans
+	/// have to be done by now
+	static bool finish();
+
+	static bool isEnabled()
+	{
+		return s_enabled.load(std::memory_order_relaxed);
+	}
+
+	/// Name of the calling thread in the trace
+	static void setThreadName(const QString& name);
+
+private:
+	static qint64 now()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	static void record(const char* name, qint64 begin, qint64 end);
+
+	static std::atomic<bool> s_enabled;
+};
+
+#endif
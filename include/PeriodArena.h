@@ -0,0 +1,74 @@
+/*
+ * PeriodArena.h - thread-local scratch memory which lives for one mixer period
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#ifndef PERIOD_ARENA_H
+#define PERIOD_ARENA_H
+
+#include <cstddef>
+
+#include "lmms_export.h"
+
+
+/*! \brief Scratch memory for audio threads
+ *
+ * Every thread gets its own bump allocator. Memory returned by alloc() is
+ * aligned to a cache line and stays valid until the end of the period in
+ * which it was allocated - it must not be freed. An arena which overflowed
+ * during a period is grown at the beginning of the next one, so after a
+ * few periods rendering doesn't touch the heap for scratch buffers anymore.
+ *
+ * Only use it from threads which render audio, i.e. in between periods
+ * or inside of them - memory allocated in another thread may get reused
+ * while still in use.
+ */
+class LMMS_EXPORT PeriodArena
+{
+public:
+	static void * alloc( size_t bytes );
+
+	template<typename T>
+	static T * alloc( size_t count )
+	{
+		return static_cast<T *>( alloc( sizeof( T ) * count ) );
+	}
+
+	//! Called by the mixer around rendering a period. All memory handed
+	//! out before finishPeriod() may be reused afterwards.
+	static void startPeriod();
+	static void finishPeriod();
+
+	//! Mark the calling thread as audio thread, heap allocations done in
+	//! it while a period is rendered get counted
+	static void markAudioThread();
+	static void countHeapAllocation();
+
+	//! Number of heap allocations in audio threads during the last period
+	static int heapAllocations();
+
+	//! Debug builds only: assert when a period (after warming up) did
+	//! any heap allocation in an audio thread
+	static void setAllocationCheck( bool enabled );
+} ;
+
+
+#endif
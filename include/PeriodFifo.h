@@ -0,0 +1,95 @@
+/*
+ * PeriodFifo.h - FIFO of preallocated period buffers between mixer and audio device
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#ifndef PERIOD_FIFO_H
+#define PERIOD_FIFO_H
+
+#include <atomic>
+
+#include "lmms_basics.h"
+
+
+/*! \brief Single-producer/single-consumer FIFO of audio periods
+ *
+ * All period buffers are allocated once in the constructor and recycled
+ * afterwards, so neither side allocates memory while playing. Reading
+ * never blocks: if no period is ready, a silent buffer is returned and
+ * the read is reported as underrun. The writer waits for a free buffer
+ * by sleeping, so no kernel objects are involved on the reading side.
+ *
+ * A buffer returned by read() stays valid until the next call of read().
+ */
+class PeriodFifo
+{
+public:
+	//! @p size is the number of periods which can be queued
+	PeriodFifo( int size, fpp_t frames );
+	~PeriodFifo();
+
+	//! Copy @p period into the next free buffer, waiting while the FIFO is
+	//! full. Writing NULL tells the reader that no more periods follow.
+	//! Returns false if the reader did not take a period within
+	//! @p maxWaitUs microseconds (overrun).
+	bool write( const surroundSampleFrame * period, int maxWaitUs );
+
+	//! Take the next period - never blocks. @p underrun is set if no
+	//! period was ready and silence is returned instead.
+	const surroundSampleFrame * read( bool & underrun );
+
+	//! Wait until the reader took all written periods
+	void waitUntilRead();
+
+	bool available() const
+	{
+		return m_writeIndex.load( std::memory_order_acquire ) !=
+				m_readIndex.load( std::memory_order_acquire );
+	}
+
+
+private:
+	bool isFull() const
+	{
+		// one more buffer than size: the last read one is still in use
+		return m_writeIndex.load( std::memory_order_relaxed ) -
+			m_readIndex.load( std::memory_order_acquire ) >=
+							(unsigned int) m_size;
+	}
+
+	const int m_size;
+	const fpp_t m_frames;
+
+	surroundSampleFrame * * m_buffers;
+	// buffers as published to the reader, NULL marks the end
+	const surroundSampleFrame * * m_items;
+	surroundSampleFrame * m_silence;
+
+	// keep reader and writer on different cache lines
+	std::atomic_uint m_writeIndex;
+	char m_pad0[64 - sizeof( std::atomic_uint )];
+	std::atomic_uint m_readIndex;
+	char m_pad1[64 - sizeof( std::atomic_uint )];
+
+} ;
+
+
+#endif
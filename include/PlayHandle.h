@@ -148,7 +148,37 @@ public:
 	
 	sampleFrame * buffer();
 
+	//! Whether play() left only zeros in the buffer of this period, so
+	//! audio ports don't have to scan it
+	bool isSilent() const
+	{
+		return m_silent;
+	}
+
+	//! Position among the play handles of the same audio port when mixing
+	//! them deterministically, see DeterministicRender
+	uint64_t renderOrder() const
+	{
+		return m_renderOrder;
+	}
+
+protected:
+	void setRenderOrder( uint64_t order )
+	{
+		m_renderOrder = order;
+	}
+
+	//! To be called by play() if it knows that it didn't write any sound,
+	//! the buffer is assumed to hold sound otherwise
+	void setSilent( bool silent )
+	{
+		m_silent = silent;
+	}
+
 private:
+	// updates the fields the PlayHandleRegistry keeps for us
+	void updateRegistry( sampleFrame * buffer );
+
 	Type m_type;
 	f_cnt_t m_offset;
 	QThread* m_affinity;
@@ -156,7 +186,13 @@ private:
 	sampleFrame* m_playHandleBuffer;
 	bool m_bufferReleased;
 	bool m_usesBuffer;
+	bool m_silent;
 	AudioPort * m_audioPort;
+	// slot in the PlayHandleRegistry, -1 if not registered
+	int m_slot;
+	uint64_t m_renderOrder;
+
+	friend class PlayHandleRegistry;
 } ;
 
 
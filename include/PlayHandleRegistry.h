@@ -0,0 +1,203 @@
+/*
+ * PlayHandleRegistry.h - slot-indexed list of all play handles of the mixer
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#ifndef PLAY_HANDLE_REGISTRY_H
+#define PLAY_HANDLE_REGISTRY_H
+
+#include <vector>
+
+#include "lmms_basics.h"
+#include "PlayHandle.h"
+
+class QThread;
+
+
+/*! \brief All play handles processed by the mixer
+ *
+ * Every play handle gets a slot when being added, so removing it is O(1):
+ * the slot is just cleared. Cleared slots are skipped when iterating and
+ * compacted once per period. Fields which are needed for queueing and
+ * removing handles are kept in contiguous arrays next to the handle
+ * pointers, so these passes don't have to touch the handles themselves.
+ */
+class PlayHandleRegistry
+{
+public:
+	//! Iterates over all handles, skipping cleared slots
+	class ConstIterator
+	{
+	public:
+		ConstIterator( const PlayHandleRegistry * registry, int slot ) :
+			m_registry( registry ),
+			m_slot( slot )
+		{
+			skipEmpty();
+		}
+
+		PlayHandle * operator*() const
+		{
+			return m_registry->m_handles[m_slot];
+		}
+
+		ConstIterator & operator++()
+		{
+			++m_slot;
+			skipEmpty();
+			return *this;
+		}
+
+		bool operator!=( const ConstIterator & other ) const
+		{
+			return m_slot != other.m_slot;
+		}
+
+	private:
+		void skipEmpty()
+		{
+			while( m_slot < m_registry->slots() &&
+					m_registry->m_handles[m_slot] == NULL )
+			{
+				++m_slot;
+			}
+		}
+
+		const PlayHandleRegistry * m_registry;
+		int m_slot;
+	} ;
+
+	PlayHandleRegistry();
+
+	void add( PlayHandle * handle );
+	//! Clear the slot of @p handle, returns false if it isn't registered
+	bool remove( const PlayHandle * handle );
+	void removeSlot( int slot );
+
+	bool contains( const PlayHandle * handle ) const
+	{
+		return handle->m_slot >= 0 && handle->m_slot < slots() &&
+				m_handles[handle->m_slot] == handle;
+	}
+
+	//! Slot of @p handle, -1 if it isn't registered (yet)
+	int slotOf( const PlayHandle * handle ) const
+	{
+		return contains( handle ) ? handle->m_slot : -1;
+	}
+
+	//! Close all gaps left by removed handles, keeping their order
+	void compact();
+
+	//! Queue all handles which require processing on the global job queue
+	//! and mark all others as finished
+	void queueJobs();
+
+	ConstIterator begin() const
+	{
+		return ConstIterator( this, 0 );
+	}
+
+	ConstIterator end() const
+	{
+		return ConstIterator( this, slots() );
+	}
+
+	int size() const
+	{
+		return m_count;
+	}
+
+	bool isEmpty() const
+	{
+		return m_count == 0;
+	}
+
+	//! Number of slots including cleared ones
+	int slots() const
+	{
+		return (int) m_handles.size();
+	}
+
+	PlayHandle * at( int slot ) const
+	{
+		return m_handles[slot];
+	}
+
+	quint8 type( int slot ) const
+	{
+		return m_types[slot];
+	}
+
+	//! Finished state as of the last processing of the handle
+	bool isFinished( int slot ) const
+	{
+		return m_finished[slot];
+	}
+
+	//! Thread the handle has to be removed in, NULL if it doesn't matter
+	const QThread * affinity( int slot ) const
+	{
+		return m_affinities[slot];
+	}
+
+	//! Buffer rendered in this period, NULL if there is none
+	sampleFrame * buffer( int slot ) const
+	{
+		return m_buffers[slot];
+	}
+
+	//! Whether the handle knows its buffer to be silent
+	bool isSilent( int slot ) const
+	{
+		return m_silent[slot];
+	}
+
+	// called by play handles after processing, each writes its own
+	// slot only so this is safe from worker threads
+	void setFinished( int slot, bool finished )
+	{
+		m_finished[slot] = finished;
+	}
+
+	void setBuffer( int slot, sampleFrame * buffer )
+	{
+		m_buffers[slot] = buffer;
+	}
+
+	void setSilent( int slot, bool silent )
+	{
+		m_silent[slot] = silent;
+	}
+
+private:
+	std::vector<PlayHandle *> m_handles;
+	std::vector<quint8> m_types;
+	std::vector<quint8> m_finished;
+	std::vector<const QThread *> m_affinities;
+	std::vector<sampleFrame *> m_buffers;
+	std::vector<quint8> m_silent;
+	int m_count;
+
+} ;
+
+
+#endif
@@ -0,0 +1,92 @@
+/*
+ * PolyphaseResampler.h - windowed-sinc resampler for playing samples
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#ifndef POLYPHASE_RESAMPLER_H
+#define POLYPHASE_RESAMPLER_H
+
+#include <vector>
+
+#include "lmms_basics.h"
+
+
+/*! \brief Interpolates frames at arbitrary positions of a buffer
+ *
+ * There's one resampler per libsamplerate converter type, i.e. per
+ * interpolation of Mixer::qualitySettings, with tables computed at
+ * startup. The sinc ones keep a windowed sinc for a number of positions
+ * in between two frames (phases) and interpolate the filter for the
+ * positions in between those. When reading faster than one frame per
+ * output frame, the filter gets stretched, so it keeps filtering out
+ * what would alias.
+ *
+ * The resampler has no state: it reads all frames it needs around each
+ * position from the buffer given, so it can read from a sample directly
+ * and jump around in it for loops.
+ */
+class PolyphaseResampler
+{
+public:
+	//! Resampler for a libsamplerate converter type
+	static const PolyphaseResampler & forConverter( int converter );
+
+	//! Frames read on each side of a position when reading @p step frames
+	//! per output frame, i.e. from floor( pos ) - reach() + 1 to
+	//! floor( pos ) + reach()
+	int reach( double step ) const;
+
+	//! Write @p frames frames at @p pos, @p pos + @p step, ... of @p src
+	//! to @p dst, @p step may be negative
+	void process( sampleFrame * dst, const sampleFrame * src, double pos,
+					double step, int frames ) const;
+
+private:
+	enum Types
+	{
+		Nearest,
+		Linear,
+		Sinc
+	} ;
+
+	PolyphaseResampler( Types type, int halfTaps = 0, int phases = 0,
+				float cutoff = 0, float beta = 0 );
+
+	//! Filter at distance @p t from the position, 0 <= t
+	inline float filter( float t ) const;
+
+	void processSinc( sampleFrame * dst, const sampleFrame * src,
+				double pos, double step, int frames ) const;
+
+	static const PolyphaseResampler s_resamplers[];
+
+	const Types m_type;
+	const int m_halfTaps;
+	const int m_phases;
+	//! Filter from 0 to m_halfTaps in steps of 1 / m_phases
+	std::vector<float> m_filter;
+	//! Coefficients of all taps per phase, m_phases + 1 rows
+	std::vector<float> m_rows;
+
+} ;
+
+
+#endif
@@ -0,0 +1,71 @@
+/*
+ * ProfilerView.h - window showing the time taken by every node of the mixer
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#ifndef PROFILER_VIEW_H
+#define PROFILER_VIEW_H
+
+#include <QtCore/QHash>
+#include <QtCore/QTimer>
+#include <QWidget>
+
+
+class QLabel;
+class QTreeWidget;
+class QTreeWidgetItem;
+
+
+//! Lists instruments, effects, FX channels and play handles with their
+//! processing times and the underruns and overruns so far, enables
+//! per-node profiling while shown
+class ProfilerView : public QWidget
+{
+	Q_OBJECT
+public:
+	ProfilerView( QWidget * _parent );
+	virtual ~ProfilerView();
+
+
+protected:
+	virtual void showEvent( QShowEvent * _se );
+	virtual void hideEvent( QHideEvent * _he );
+
+
+protected slots:
+	void updateStats();
+
+
+private:
+	void setProfiling( bool _on );
+
+	QTreeWidget * m_nodeList;
+	//! Periods the audio device missed or didn't take in time
+	QLabel * m_xrunLabel;
+	QHash<quint64, QTreeWidgetItem *> m_items;
+	bool m_profiling;
+
+	QTimer m_updateTimer;
+
+} ;
+
+
+#endif
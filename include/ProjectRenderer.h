@@ -25,13 +25,20 @@
 #ifndef PROJECT_RENDERER_H
 #define PROJECT_RENDERER_H
 
+#include <QtCore/QStringList>
+#include <QtCore/QVector>
+
 #include "AudioFileDevice.h"
 #include "lmmsconfig.h"
 #include "Mixer.h"
 #include "OutputSettings.h"
+#include "SegmentedRender.h"
 
 #include "lmms_export.h"
 
+class AudioPort;
+class StemWriter;
+
 class LMMS_EXPORT ProjectRenderer : public QThread
 {
 	Q_OBJECT
@@ -60,13 +67,39 @@ public:
 				const OutputSettings & _os,
 				ExportFileFormats _file_format,
 				const QString & _out_file );
+	// render what each of the given ports sends to the FX mixer into the
+	// according file within a single pass over the song
+	ProjectRenderer( const Mixer::qualitySettings & _qs,
+				const OutputSettings & _os,
+				ExportFileFormats _file_format,
+				const QVector<const AudioPort *> & _ports,
+				const QStringList & _out_files );
+	// only write the mixer output of a segment of the song to _stream_file,
+	// used by the processes of a parallel render - no file device is
+	// created, the mixer just renders for one at the output's sample rate
+	ProjectRenderer( const Mixer::qualitySettings & _qs,
+				const OutputSettings & _os,
+				const SegmentedRender::Segment & _segment,
+				const QString & _stream_file );
 	virtual ~ProjectRenderer();
 
 	bool isReady() const
 	{
-		return m_fileDev != NULL;
+		return m_device != NULL;
 	}
 
+	// whether rendering finished without the output being complete
+	bool hasFailed() const
+	{
+		return m_failed;
+	}
+
+	// render the song in up to _jobs processes at once, which get started
+	// with _process_args plus the options for rendering a segment. If
+	// _verify is set, the result gets compared to a serial render.
+	void setParallelRender( int _jobs, bool _verify,
+					const QStringList & _process_args );
+
 	static ExportFileFormats getFileFormatFromExtension(
 							const QString & _ext );
 
@@ -88,11 +121,30 @@ signals:
 private:
 	virtual void run();
 
+	AudioFileDevice * createFileDevice( const OutputSettings & _os,
+					ExportFileFormats _file_format,
+					const QString & _out_file );
+
+	void renderSegment();
+	bool renderInParallel();
+
+	// what the mixer renders for, m_fileDev unless rendering a segment
+	AudioDevice * m_device;
 	AudioFileDevice * m_fileDev;
+	// one per file when rendering ports - the first one writes to m_fileDev
+	QVector<StemWriter *> m_stems;
+
+	int m_jobs;
+	bool m_verify;
+	QStringList m_processArgs;
+
+	SegmentedRender::Segment m_segment;
+	QString m_streamFile;
 	Mixer::qualitySettings m_qualitySettings;
 
 	volatile int m_progress;
 	volatile bool m_abort;
+	bool m_failed;
 
 } ;
 
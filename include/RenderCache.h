@@ -0,0 +1,183 @@
+/*
+ * RenderCache.h - reuse the output of tracks from earlier exports
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+
+#ifndef RENDER_CACHE_H
+#define RENDER_CACHE_H
+
+#include <QtCore/QBitArray>
+#include <QtCore/QByteArray>
+#include <QtCore/QHash>
+#include <QtCore/QString>
+#include <QtCore/QVector>
+
+#include "lmms_basics.h"
+#include "MidiTime.h"
+
+class AudioPort;
+class QFile;
+class Song;
+class Track;
+
+
+/*! \brief Reuses the output of tracks from an earlier export
+ *
+ * The output of every instrument and sample track of the song (after its
+ * effects, before the FX mixer) is stored in ranges of RangeTacts bars,
+ * one file per range. Each range is keyed by a hash of everything which may
+ * change it:
+ *  - the track's settings, instrument and effects and the size and
+ *    modification time of the files they load,
+ *  - the parts of the track's TCOs within the range or the TailRanges
+ *    ranges before it and the samples they play,
+ *  - all automation up to the end of the range, the controllers, tempo,
+ *    time signature, master pitch, sample rate and quality settings.
+ *
+ * Tracks with models controlled by a peak controller follow the audio of
+ * other tracks and aren't cached.
+ *
+ * Each file also records whether the track was quiet when its range started
+ * (no notes, no effects running, no output) and if not, the key of the range
+ * before. A range which didn't start quiet is only reused if the range before
+ * is, so releases and effect tails of any length are covered.
+ *
+ * When exporting again, a track doesn't play in ranges whose key is found,
+ * their output is read from the memory-mapped file instead. Ranges which
+ * have to be rendered are preceded by pre-roll back to the last range which
+ * started quiet, where the track plays to get its notes and effects into the
+ * right state but its output still comes from the cache.
+ */
+class RenderCache
+{
+public:
+	//! Bars per range
+	static const int RangeTacts = 4;
+	//! Ranges before a range whose notes are part of its key
+	static const int TailRanges = 1;
+
+	//! Look up the ranges of all tracks of @p song exported until @p end
+	//! in directory @p dir
+	RenderCache( const QString & dir, Song * song, const MidiTime & end );
+	//! Drops ranges still being rendered, see finish()
+	~RenderCache();
+
+	//! Use @p dir instead of the configured directory for this session,
+	//! without changing the configuration
+	static void setDirectory( const QString & dir );
+	//! Directory to cache in, empty if caching is disabled
+	static QString directory();
+
+	//! Called by the song at the start of every period
+	void startPeriod();
+
+	//! Called by the song before playing @p tick, which starts at frame
+	//! @p offset of the current period
+	void playTick( tick_t tick, f_cnt_t offset );
+
+	//! Called by the song when the export stopped at @p position, stores
+	//! the ranges rendered up to their end or the end of the song
+	void finish( tick_t position );
+
+	//! Whether the output of @p track comes from the cache at the current
+	//! tick, i.e. it doesn't have to play
+	bool isCached( const Track * track ) const;
+
+	//! Called by @p port with its output of the current period, @p silent
+	//! if there is none. @p quietFrames is the number of frames at the start
+	//! of the period before any note of the port starts, the whole period if
+	//! the port was quiet. Stores the output of ranges to render and replaces
+	//! it in cached ranges. Returns the buffer to send to the FX mixer or
+	//! NULL if there's nothing to send.
+	const sampleFrame * processPort( const AudioPort * port,
+					const sampleFrame * buffer, bool silent,
+					f_cnt_t quietFrames );
+
+	//! Hash of everything the output of @p track depends on over the whole
+	//! song, used for invalidating frozen tracks
+	static QByteArray trackKey( Track * track );
+
+private:
+	//! A part of a period starting at a range boundary or a jump in
+	//! playback
+	struct Segment
+	{
+		f_cnt_t offset;
+		//! range starting here, -1 if we jumped into the middle of one
+		int range;
+		//! whether the range played before was played completely
+		bool previousComplete;
+	} ;
+
+	struct Entry
+	{
+		QVector<QString> keys;
+		QBitArray cached;
+		//! cached ranges the track has to play anyway for pre-roll
+		QBitArray live;
+
+		// only accessed by the job processing the track's audio port
+		QFile * reader;
+		const sampleFrame * data;
+		f_cnt_t frames;
+		f_cnt_t position;
+		QFile * writer;
+		int writerRange;
+		bool writerSilent;
+		bool writerQuiet;
+		//! whether the track was quiet at the end of the last period
+		bool quiet;
+	} ;
+
+	void addTrack( Track * track, AudioPort * port,
+			const QVector<QByteArray> & automationKeys );
+
+	void enterRange( Entry * entry, const Segment & segment, bool quiet );
+	bool openReader( Entry * entry, int range );
+	void closeReader( Entry * entry );
+	void openWriter( Entry * entry, int range, bool quiet );
+	void closeWriter( Entry * entry, bool commit );
+
+	QString fileName( const QString & key ) const;
+	QString tempFileName( const QString & key ) const;
+
+	static const int MaxSegments = 8;
+
+	static QString s_directory;
+
+	QString m_dir;
+	int m_rangeTicks;
+	int m_ranges;
+	int m_endTick;
+
+	QHash<const Track *, Entry *> m_tracks;
+	QHash<const AudioPort *, Entry *> m_ports;
+
+	// state of the song playing, set by the mixer thread
+	tick_t m_lastTick;
+	int m_range;
+	Segment m_segments[MaxSegments];
+	int m_segmentCount;
+} ;
+
+
+#endif
@@ -0,0 +1,119 @@
+/*
+ * RenderGraph.h - dependency graph of play handles, audio ports and FX channels
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#ifndef RENDER_GRAPH_H
+#define RENDER_GRAPH_H
+
+#include <QtCore/QHash>
+#include <QtCore/QVector>
+
+#include <atomic>
+#include <vector>
+
+#include "lmms_basics.h"
+#include "PlayHandle.h"
+#include "ThreadableJob.h"
+
+class AudioPort;
+class FxChannel;
+class PlayHandleRegistry;
+
+
+/*! \brief Renders a whole period as one dependency graph
+ *
+ * Instead of processing all play handles, then all audio ports and then
+ * the FX mixer in barrier-separated stages, every play handle, audio port
+ * and FX channel becomes a node which is queued as soon as all of its
+ * inputs are done. This way the effects of a track can be processed as
+ * soon as its own notes are rendered, independent of other tracks.
+ *
+ * The port and channel part of the graph only changes with the routing,
+ * so it is cached and rebuilt only after invalidate() has been called.
+ * Play handle nodes are attached to their port nodes every period.
+ */
+class RenderGraph
+{
+public:
+	RenderGraph();
+	~RenderGraph();
+
+	//! Mark the graph as outdated - it is rebuilt before the next period
+	void invalidate()
+	{
+		m_valid = false;
+	}
+
+	//! Render all given play handles, audio ports and all FX channels
+	//! and mix the master channel into @p masterOut
+	void render( PlayHandleRegistry & playHandles,
+			const QVector<AudioPort *> & audioPorts,
+			sampleFrame * masterOut );
+
+private:
+	class Node : public ThreadableJob
+	{
+	public:
+		enum Types
+		{
+			PlayHandleNode,
+			AudioPortNode,
+			FxChannelNode
+		} ;
+
+		Node( Types type, ThreadableJob * job );
+
+		bool requiresProcessing() const override
+		{
+			return true;
+		}
+
+		Types m_type;
+		ThreadableJob * m_job;
+		// number of inputs known from the routing
+		int m_dependencies;
+		// inputs which still have to be processed in this period
+		std::atomic_int m_pending;
+		std::vector<Node *> m_successors;
+
+	protected:
+		void doProcessing() override;
+	} ;
+
+	void rebuild( const QVector<AudioPort *> & audioPorts );
+	void clear();
+
+	Node * nodeForHandle( int index );
+
+	bool m_valid;
+
+	std::vector<Node *> m_portNodes;
+	std::vector<Node *> m_channelNodes;
+	QHash<const AudioPort *, Node *> m_nodeOfPort;
+
+	// pool of play handle nodes, only grows
+	std::vector<Node *> m_handleNodes;
+
+} ;
+
+
+#endif
@@ -50,8 +50,22 @@ public:
 	/// Export all unmuted tracks into individual file
 	void renderTracks();
 
+	/// Let renderProject() use up to jobs processes, see ProjectRenderer
+	void setParallelRender( int jobs, bool verify,
+					const QStringList & processArgs );
+
+	/// Let renderProject() only render a segment of the song
+	void setSegment( const SegmentedRender::Segment & segment,
+					const QString & streamFile );
+
 	void abortProcessing();
 
+	/// Whether a render finished with incomplete output
+	bool hasFailed() const
+	{
+		return m_failed;
+	}
+
 signals:
 	void progressChanged( int );
 	void finished();
@@ -64,7 +78,12 @@ private:
 	QString pathForTrack( const Track *track, int num );
 	void restoreMutedState();
 
+	// render all tracks in a single pass if their FX channels don't
+	// change their output, returns false if that's not possible
+	bool renderTracksInOnePass();
+
 	void render( QString outputPath );
+	void startRenderer();
 
 	const Mixer::qualitySettings m_qualitySettings;
 	const Mixer::qualitySettings m_oldQualitySettings;
@@ -76,6 +95,14 @@ private:
 
 	QVector<Track*> m_tracksToRender;
 	QVector<Track*> m_unmuted;
+	bool m_onePass;
+	bool m_failed;
+
+	int m_jobs;
+	bool m_verify;
+	QStringList m_processArgs;
+	SegmentedRender::Segment m_segment;
+	QString m_streamFile;
 } ;
 
 #endif
@@ -28,6 +28,7 @@
 
 #include <QtCore/QReadWriteLock>
 #include <QtCore/QObject>
+#include <QtCore/QSharedPointer>
 
 #include <samplerate.h>
 
@@ -41,6 +42,9 @@
 
 class QPainter;
 class QRect;
+class PolyphaseResampler;
+class SamplePeaks;
+class SampleStream;
 
 // values for buffer margins, used for various libsamplerate interpolation modes
 // the array positions correspond to the converter_type parameter values in libsamplerate
@@ -73,6 +77,8 @@ public:
 		void setFrameIndex( f_cnt_t _index )
 		{
 			m_frameIndex = _index;
+			m_subFrame = 0;
+			m_looped = false;
 		}
 
 		bool isBackwards() const
@@ -93,9 +99,14 @@ public:
 
 	private:
 		f_cnt_t m_frameIndex;
+		// position in between m_frameIndex and the next frame
+		double m_subFrame;
 		const bool m_varyingPitch;
 		bool m_isBackwards;
-		SRC_STATE * m_resamplingData;
+		// whether we got past the loop end already, so frames before the
+		// loop start are followed by the loop end
+		bool m_looped;
+		// libsamplerate converter type, see PolyphaseResampler
 		int m_interpolationMode;
 
 		friend class SampleBuffer;
@@ -206,11 +217,25 @@ public:
 		m_sampleRate = _rate;
 	}
 
+	// NULL for streamed files
 	inline const sampleFrame * data() const
 	{
 		return m_data;
 	}
 
+	// read long audio files from disk while playing instead of decoding
+	// them completely - only for users of play() and visualize(), as
+	// there's no data() then
+	void setStreamingEnabled( bool _enabled )
+	{
+		m_streamingEnabled = _enabled;
+	}
+
+	bool isStreamed() const
+	{
+		return m_stream != NULL;
+	}
+
 	QString openAudioFile() const;
 	QString openAndSetAudioFile();
 	QString openAndSetWaveformFile();
@@ -257,6 +282,9 @@ public:
 
 public slots:
 	void setAudioFile( const QString & _audio_file );
+	// decode an audio file into the sample cache, so buffers using it
+	// load quickly later - may be called from any thread
+	static void preload( const QString & _audio_file );
 	void loadFromBase64( const QString & _data );
 	void setStartFrame( const f_cnt_t _s );
 	void setEndFrame( const f_cnt_t _e );
@@ -269,6 +297,14 @@ private:
 
 	void update( bool _keep_settings = false );
 
+	// try all decoders on _file, _samplerate is set to its sample rate
+	f_cnt_t decodeFile( const QString & _file, sample_rate_t & _samplerate );
+	// resample into newly allocated memory, without any SampleBuffer
+	// updating itself in between
+	static sampleFrame * resampleFrames( const sampleFrame * _data,
+				f_cnt_t _frames, sample_rate_t _src_sr,
+				sample_rate_t _dst_sr, f_cnt_t & _dst_frames );
+
 	void convertIntToFloat ( int_sample_t * & _ibuf, f_cnt_t _frames, int _channels);
 	void directFloatWrite ( sample_t * & _fbuf, f_cnt_t _frames, int _channels);
 
@@ -298,6 +334,38 @@ private:
 	bool m_reversed;
 	float m_frequency;
 	sample_rate_t m_sampleRate;
+	bool m_streamingEnabled;
+	SampleStream * m_stream;
+	// m_data is mapped from the sample cache and read-only
+	bool m_dataCached;
+	// overview for visualize(), built in the background - NULL for short
+	// samples
+	struct PeaksJob;
+	class PeaksTask;
+	QSharedPointer<PeaksJob> m_peaks;
+
+	void releaseData();
+	// reverse m_data, copying it if it's mapped from the cache
+	void reverseData();
+
+	// build the overview of m_data, visualize() draws the frames until
+	// it's done
+	void startPeaks( const QByteArray & _cache_key );
+	// wait for the overview to be built or cancel it, and drop it
+	void stopPeaks();
+
+	// copy frames from the data or the stream
+	void copyFrames( sampleFrame * _dst, f_cnt_t _index, f_cnt_t _frames ) const;
+	// copy frames _index, _index - 1, ...
+	void copyFramesBackwards( sampleFrame * _dst, f_cnt_t _index, f_cnt_t _frames ) const;
+
+	// write _frames frames at _pos, _pos + _step, ... to _dst, positions
+	// after _loopend continue at the loop start or run back through the
+	// loop according to _loopmode
+	void interpolate( sampleFrame * _dst, const PolyphaseResampler & _resampler,
+				double _pos, double _step, fpp_t _frames,
+				LoopMode _loopmode, f_cnt_t _loopstart,
+				f_cnt_t _loopend ) const;
 
 	sampleFrame * getSampleFragment( f_cnt_t _index, f_cnt_t _frames,
 						LoopMode _loopmode,
@@ -0,0 +1,77 @@
+/*
+ * SampleCache.h - on-disk cache of decoded samples
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#ifndef SAMPLE_CACHE_H
+#define SAMPLE_CACHE_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QString>
+
+#include "lmms_basics.h"
+
+
+/*! \brief Decoded samples stored on disk
+ *
+ * SampleBuffer stores audio files decoded and converted to the mixer's
+ * sample rate in files named after a hash of the audio file's content
+ * and the sample rate, buffers playing a sample reversed share the file.
+ * The hash is remembered by the file's path, size and modification time,
+ * so unchanged files aren't read for it again. Cached samples are mapped into memory read-only, so loading them
+ * again doesn't need any decoding and buffers using the same sample - in
+ * this or in other LMMS processes - share the same memory.
+ *
+ * The cache lives in the user's cache directory or the directory set
+ * by mixer/samplecachedir and is limited to mixer/samplecachesize MB,
+ * 0 disables it. The files not used for the longest time get removed
+ * first. The directory is only listed once its size as of the last listing
+ * plus what was written since exceeds the limit.
+ */
+class SampleCache
+{
+public:
+	static bool isEnabled();
+
+	//! Key for @p file decoded at @p sampleRate, empty if the cache is
+	//! disabled or the file can't be read
+	static QByteArray key( const QString & file, sample_rate_t sampleRate );
+
+	//! Map the sample stored under @p key, NULL if there's none
+	static const sampleFrame * acquire( const QByteArray & key,
+							f_cnt_t & frames );
+
+	//! Store @p frames frames of @p data under @p key and map them,
+	//! NULL on failure
+	static const sampleFrame * store( const QByteArray & key,
+				const sampleFrame * data, f_cnt_t frames );
+
+	//! Unmap data returned by acquire() or store()
+	static void release( const sampleFrame * data );
+
+	//! Waveform overview stored next to the sample, see SamplePeaks
+	static QByteArray loadPeaks( const QByteArray & key );
+	static void storePeaks( const QByteArray & key, const QByteArray & peaks );
+
+} ;
+
+
+#endif
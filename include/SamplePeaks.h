@@ -0,0 +1,79 @@
+/*
+ * SamplePeaks.h - multi-resolution overview of a sample
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#ifndef SAMPLE_PEAKS_H
+#define SAMPLE_PEAKS_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QVector>
+
+#include <atomic>
+
+#include "lmms_basics.h"
+
+
+/*! \brief Minimum, maximum and RMS of a sample at several resolutions
+ *
+ * Level 0 holds the peaks of every BaseFrames frames, each further level
+ * combines LevelFactor peaks of the one before. Drawing a sample then
+ * only needs a few peaks per pixel at any zoom level instead of going
+ * through its frames.
+ */
+class SamplePeaks
+{
+public:
+	static const f_cnt_t BaseFrames = 64;
+	static const int LevelFactor = 4;
+
+	struct Peak
+	{
+		float min;
+		float max;
+		float rms;
+	} ;
+
+	//! Load the peaks of @p data from the sample cache or compute and
+	//! store them there, an empty @p cacheKey skips the cache. Returns
+	//! NULL if @p cancelled got set meanwhile.
+	static SamplePeaks * create( const sampleFrame * data, f_cnt_t frames,
+					const QByteArray & cacheKey,
+					const std::atomic_bool * cancelled = NULL );
+
+	//! Peak of channel @p ch in frames [@p from, @p to)
+	Peak peak( f_cnt_t from, f_cnt_t to, int ch ) const;
+
+private:
+	SamplePeaks( f_cnt_t frames );
+
+	bool build( const sampleFrame * data, const std::atomic_bool * cancelled );
+	bool fromByteArray( const QByteArray & array );
+	QByteArray toByteArray() const;
+
+	f_cnt_t m_frames;
+	//! Peaks of both channels interleaved, per level
+	QVector<QVector<Peak> > m_levels;
+
+} ;
+
+
+#endif
@@ -0,0 +1,47 @@
+/*
+ * SamplePreloader.h - decodes the samples of a project in parallel
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#ifndef SAMPLE_PRELOADER_H
+#define SAMPLE_PRELOADER_H
+
+#include <QDomElement>
+
+
+/*! \brief Decodes the samples of a project before its tracks are created
+ *
+ * Sample clips and AudioFileProcessor instruments decode their samples
+ * one after another while the project's tracks get created on the GUI
+ * thread. The preloader decodes them on all cores into the SampleCache
+ * first, so creating the tracks only needs to map them.
+ */
+class SamplePreloader
+{
+public:
+	//! Decode the samples used in @p project, showing the progress,
+	//! returns false if the user cancelled loading
+	static bool preload( const QDomElement & project );
+
+} ;
+
+
+#endif
@@ -0,0 +1,149 @@
+/*
+ * SampleStream.h - stream long audio files from disk
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#ifndef SAMPLE_STREAM_H
+#define SAMPLE_STREAM_H
+
+#include <QtCore/QFile>
+#include <QtCore/QString>
+
+#include <atomic>
+#include <memory>
+
+#include <sndfile.h>
+
+#include "lmms_basics.h"
+
+
+/*! \brief Audio file decoded on demand
+ *
+ * SampleBuffer uses a stream for audio files too long for decoding them
+ * completely. The file is split into blocks of BlockFrames frames. The
+ * first HeadBlocks blocks are decoded when opening and stay in memory,
+ * the others get decoded by a background I/O thread when they're
+ * requested and are dropped again when not used for a while, so at most
+ * CacheBlocks blocks of a stream are in memory.
+ *
+ * read() is called by audio threads. It never blocks or allocates: it
+ * copies what's decoded, asks the I/O thread for the next blocks and
+ * returns silence for blocks not decoded yet - unless rendering faster
+ * than realtime, where it waits for them.
+ *
+ * Frames are indexed as played, i.e. reversed if the stream was opened
+ * reversed, and stay at the file's sample rate.
+ */
+class SampleStream
+{
+public:
+	static const f_cnt_t BlockFrames = 65536;
+	static const int HeadBlocks = 2;
+	static const int CacheBlocks = 24;
+	//! Blocks requested after the one being read
+	static const int ReadAheadBlocks = 4;
+	//! Frames per peak of the waveform overview
+	static const f_cnt_t PeakFrames = 1024;
+
+	//! Open @p file for streaming if decoding it completely would take
+	//! more memory than configured, NULL otherwise or on failure
+	static SampleStream * open( const QString & file, bool reversed );
+	//! Whether a file of @p frames frames would be streamed by open()
+	static bool isStreamed( f_cnt_t frames );
+	~SampleStream();
+
+	f_cnt_t frames() const
+	{
+		return m_frames;
+	}
+
+	sample_rate_t sampleRate() const
+	{
+		return m_sampleRate;
+	}
+
+	//! Copy @p count frames starting at @p index to @p dest, waiting for
+	//! blocks not decoded yet if @p wait is set
+	void read( sampleFrame * dest, f_cnt_t index, f_cnt_t count,
+							bool wait = false );
+
+	//! Request the block containing @p index, e.g. before a loop wraps
+	//! or playback starts in the middle
+	void prefetch( f_cnt_t index );
+
+	//! Minimum and maximum of channel @p ch in frames [@p from, @p to),
+	//! false if the overview didn't get that far yet
+	bool peak( f_cnt_t from, f_cnt_t to, int ch, float & min, float & max ) const;
+
+private:
+	enum BlockStates
+	{
+		BlockEmpty,
+		BlockRequested,
+		BlockLoaded
+	} ;
+
+	struct Block
+	{
+		std::atomic<sampleFrame *> data;
+		std::atomic_int state;
+		//! audio threads reading the block right now
+		std::atomic_int readers;
+		//! I/O thread iteration in which the block was read last
+		std::atomic_int lastUse;
+	} ;
+
+	SampleStream( bool reversed );
+
+	bool openFile( const QString & file );
+	void request( int block );
+	//! Decode frames [@p from, @p from + @p count) of the file
+	void decode( sampleFrame * dest, f_cnt_t from, f_cnt_t count );
+	void loadBlock( int block );
+	void evictBlocks();
+	void scanPeaks();
+
+	//! Called by the I/O thread, returns whether there was anything to do
+	bool service();
+
+	const bool m_reversed;
+	QFile m_file;
+	SNDFILE * m_sndFile;
+	int m_channels;
+	f_cnt_t m_frames;
+	sample_rate_t m_sampleRate;
+
+	int m_blockCount;
+	std::unique_ptr<Block[]> m_blocks;
+	int m_loadedBlocks;
+	float * m_decodeBuffer;
+
+	//! Minimum and maximum per channel and PeakFrames frames of the file
+	std::unique_ptr<float[]> m_peaks;
+	int m_peakCount;
+	std::atomic_int m_peaksDone;
+
+	friend class SampleStreamer;
+
+} ;
+
+
+#endif
@@ -0,0 +1,70 @@
+/*
+ * SegmentedRender.h - splitting a song into segments which can be rendered independently
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#ifndef SEGMENTED_RENDER_H
+#define SEGMENTED_RENDER_H
+
+#include <QtCore/QVector>
+
+#include "lmms_basics.h"
+
+class QIODevice;
+
+
+/*! \brief Rendering a song in segments, e.g. in multiple processes at once
+ *
+ * A song can be split at ticks which begin exactly at a period boundary when
+ * rendering the whole song and where nothing is playing, i.e. no pattern,
+ * sample or automation, no note release and no effect fading out. Each
+ * segment then gets rendered on its own and the mixer output of all segments
+ * put together gives the output of the whole song, as long as nothing in
+ * the song depends on what was rendered before the segment. Segments which
+ * still sound at their end show that this isn't the case.
+ */
+namespace SegmentedRender
+{
+
+struct Segment
+{
+	tick_t start;
+	//! period of a render of the whole song the segment starts with
+	int firstPeriod;
+	//! periods to render - -1 renders until the end of the song
+	int periods;
+} ;
+
+//! Split the song into up to @p count segments of about the same length.
+//! Returns a single segment if there's no way to split it.
+QVector<Segment> split( int count );
+
+//! Render @p segment and write the mixer output into @p stream. Notes and
+//! effects which still sound at the end of the segment keep running until
+//! they are silent - returns the number of frames written for this tail,
+//! which is 0 if the next segment can start cold.
+f_cnt_t render( const Segment & segment, QIODevice & stream,
+						const volatile bool & abort );
+
+}
+
+
+#endif
@@ -39,6 +39,7 @@
 
 class AutomationTrack;
 class Pattern;
+class RenderCache;
 class TimeLineWidget;
 
 
@@ -235,6 +236,20 @@ public:
 		m_renderBetweenMarkers = renderBetweenMarkers;
 	}
 
+	// start the next export at the given position instead of the
+	// beginning of the song, used for rendering the song in segments
+	inline void setExportStart( const MidiTime & start )
+	{
+		m_exportStart = start;
+	}
+
+	// output of tracks reused from earlier exports, NULL if not exporting
+	// or no render cache is configured
+	inline RenderCache * renderCache() const
+	{
+		return m_renderCache;
+	}
+
 	inline PlayModes playMode() const
 	{
 		return m_playMode;
@@ -330,6 +345,11 @@ public:
 		return m_timeSigModel;
 	}
 
+	IntModel & getTempoModel()
+	{
+		return m_tempoModel;
+	}
+
 	void exportProjectMidi(QString const & exportFileName) const;
 
 	inline void setLoadOnLauch(bool value) { m_loadOnLaunch = value; }
@@ -432,6 +452,8 @@ private:
 	volatile bool m_exporting;
 	volatile bool m_exportLoop;
 	volatile bool m_renderBetweenMarkers;
+	MidiTime m_exportStart;
+	RenderCache * m_renderCache;
 	volatile bool m_playing;
 	volatile bool m_paused;
 
@@ -481,6 +503,9 @@ signals:
 	void updateSampleTracks();
 	void stopped();
 	void modified();
+	// emitted on every change, while modified() only gets emitted on the
+	// first one after saving
+	void edited();
 	void projectFileNameChanged();
 } ;
 
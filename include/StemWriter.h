@@ -0,0 +1,85 @@
+/*
+ * StemWriter.h - writes the output of a single audio port to a file while rendering
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#ifndef STEM_WRITER_H
+#define STEM_WRITER_H
+
+#include <QtCore/QSemaphore>
+#include <QtCore/QThread>
+
+#include "lmms_basics.h"
+#include "PeriodFifo.h"
+
+class AudioFileDevice;
+class AudioPort;
+
+
+/*! \brief Writes what an audio port sends to the FX mixer into a file of its own
+ *
+ * Used for exporting tracks into individual files within a single pass over
+ * the song. The rendering thread queues the port's output after each period
+ * and the file gets encoded in a thread of its own, so multiple files get
+ * written in parallel.
+ *
+ * The port's FX channel has to reach the master output unchanged (see
+ * FxMixer::isTransparentPath()) for the file to be the same as rendering the
+ * track solo.
+ */
+class StemWriter : public QThread
+{
+public:
+	//! Doesn't take ownership of @p device
+	StemWriter( AudioFileDevice * device, const AudioPort * port );
+	virtual ~StemWriter();
+
+	AudioFileDevice * device()
+	{
+		return m_device;
+	}
+
+	//! Queue what the port sent to the FX mixer in the period just rendered,
+	//! waits while the writer thread is too far behind
+	void pushPeriod();
+
+	//! Write out all queued periods and stop the writer thread
+	void finish();
+
+
+private:
+	virtual void run();
+
+	AudioFileDevice * m_device;
+	const AudioPort * m_port;
+
+	// how the FX mixer treats NaNs on the way to the master output
+	bool m_sanitizesFirst;
+	bool m_clamps;
+
+	sampleFrame * m_period;
+	PeriodFifo m_fifo;
+	QSemaphore m_queued;
+
+} ;
+
+
+#endif
@@ -0,0 +1,68 @@
+/*
+ * ThreadPolicy.h - CPU placement and scheduling of audio threads
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#ifndef THREAD_POLICY_H
+#define THREAD_POLICY_H
+
+#include <QtCore/QList>
+#include <QtCore/QString>
+
+
+/*! \brief CPU placement and scheduling of the audio threads
+ *
+ * Configured in the "mixer" section of the configuration:
+ *  - "cpuaffinity": list of CPUs like "0-3,8". The thread rendering the
+ *    periods is pinned to the first one, worker n to the (n+1)th one,
+ *    wrapping around if there are more threads than CPUs.
+ *  - "realtime": run the threads with SCHED_FIFO
+ *  - "rtpriority": SCHED_FIFO priority, middle of the range if unset
+ *
+ * The command line options --cpu-affinity and --realtime override these for
+ * the session only, see setOverrides().
+ *
+ * Memory which is allocated by the threads themselves (e.g. their
+ * PeriodArena) is touched first by the pinned thread and thus ends up on
+ * its NUMA node.
+ */
+class ThreadPolicy
+{
+public:
+	//! Read the policy from the configuration
+	static void init();
+
+	//! Use @p cpus instead of the configured CPU list unless it's empty
+	//! and run with SCHED_FIFO at @p priority if it's not empty, without
+	//! changing the configuration. Has to be called before init().
+	static void setOverrides( const QString & cpus, const QString & priority );
+
+	//! Apply the policy to the calling thread and report the effective
+	//! placement. @p index is 0 for the thread rendering the periods and
+	//! n+1 for worker n.
+	static void apply( const QString & name, int index );
+
+	//! Parse a CPU list like "0-3,8", returns an empty list on errors
+	static QList<int> parseCpuList( const QString & list );
+} ;
+
+
+#endif
@@ -0,0 +1,133 @@
+/*
+ * TrackFreeze.h - render an instrument track to audio
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#ifndef TRACK_FREEZE_H
+#define TRACK_FREEZE_H
+
+#include <QtCore/QPair>
+#include <QtCore/QTemporaryFile>
+#include <QtCore/QThread>
+#include <QtCore/QVector>
+
+#include "lmms_basics.h"
+
+class InstrumentTrack;
+class Track;
+
+
+/*! \brief The output of a frozen instrument track
+ *
+ * The render plays the song once from its start to its end with all other
+ * tracks muted and stores what the track's audio port sent to the FX mixer,
+ * i.e. the output of the instrument after sound shaping, volume, panning
+ * and the track's effects, in a memory-mapped temporary file. It runs on a
+ * thread of its own like ProjectRenderer, while the mixer doesn't process
+ * anything else.
+ *
+ * While the track is frozen it doesn't play, its audio port takes the output
+ * from nextPeriod() instead. The track still reports the ticks it would play,
+ * so jumps and loops in the song are followed.
+ */
+class TrackFreeze : public QThread
+{
+	Q_OBJECT
+public:
+	TrackFreeze( InstrumentTrack * track );
+	virtual ~TrackFreeze();
+
+	//! Start rendering the song, rendered() gets emitted when done.
+	//! Returns false if there's no file for the output.
+	bool startRendering();
+	//! Stop rendering and wait for the thread, rendered() doesn't get
+	//! emitted then
+	void abortRendering();
+
+	bool isRendered() const
+	{
+		return m_data != NULL;
+	}
+
+	//! Called by the track before playing @p tick, which starts at frame
+	//! @p offset of the current period
+	void playTick( tick_t tick, f_cnt_t offset );
+
+	//! Called by the audio port of the track in every period, returns the
+	//! frozen output or NULL if the song isn't playing
+	const sampleFrame * nextPeriod();
+
+signals:
+	void progressChanged( int );
+	//! Emitted once rendering is over unless it got aborted, @p ok is
+	//! false if the output couldn't be stored
+	void rendered( bool ok );
+
+private slots:
+	//! Restore what got changed for rendering and map the output
+	void finishRendering();
+
+private:
+	virtual void run();
+
+	//! Frames the played position may differ from the rendered one without
+	//! counting as a jump
+	static const f_cnt_t MaxDrift = 2;
+	static const int MaxSegments = 8;
+
+	//! A part of a period starting at a jump in playback
+	struct Segment
+	{
+		f_cnt_t offset;
+		f_cnt_t position;
+	} ;
+
+	//! Copy @p frames frames starting at @p position, zeros outside of the
+	//! rendered song
+	void copyFrames( sampleFrame * dest, f_cnt_t position, f_cnt_t frames ) const;
+
+	InstrumentTrack * m_track;
+
+	QTemporaryFile m_file;
+	const sampleFrame * m_data;
+	f_cnt_t m_frames;
+
+	//! Frame of the rendered output at which each tick started, -1 if the
+	//! track didn't play it
+	QVector<f_cnt_t> m_tickFrames;
+	bool m_rendering;
+	volatile bool m_abort;
+	volatile bool m_writeFailed;
+	volatile int m_progress;
+
+	//! What to restore after rendering
+	QVector<QPair<Track *, bool> > m_mutedStates;
+	bool m_journalling;
+
+	//! Where the next period continues
+	f_cnt_t m_position;
+	Segment m_segments[MaxSegments];
+	int m_segmentCount;
+
+} ;
+
+
+#endif
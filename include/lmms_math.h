@@ -28,6 +28,7 @@
 
 #include <cstdint>
 #include "lmms_constants.h"
+#include "lmms_export.h"
 #include "lmmsconfig.h"
 #include <QtCore/QtGlobal>
 
@@ -105,10 +106,14 @@ static inline float absFraction( float _x )
 
 
 
+//! State of fast_rand(), kept per thread so the random numbers a job draws
+//! don't depend on other jobs - see DeterministicRender
+LMMS_EXPORT unsigned long & fastRandState();
+
 #define FAST_RAND_MAX 32767
 static inline int fast_rand()
 {
-	static unsigned long next = 1;
+	unsigned long & next = fastRandState();
 	next = next * 1103515245 + 12345;
 	return( (unsigned)( next / 65536 ) % 32768 );
 }
@@ -38,6 +38,11 @@ public:
 	virtual ~AmplifierEffect();
 	virtual bool processAudioBuffer( sampleFrame* buf, const fpp_t frames );
 
+	virtual bool canSkipSilence() const
+	{
+		return true;
+	}
+
 	virtual EffectControls* controls()
 	{
 		return &m_ampControls;
@@ -85,6 +85,8 @@ audioFileProcessor::audioFileProcessor( InstrumentTrack * _instrument_track ) :
 	m_nextPlayStartPoint( 0 ),
 	m_nextPlayBackwards( false )
 {
+	m_sampleBuffer.setStreamingEnabled( true );
+
 	connect( &m_reverseModel, SIGNAL( dataChanged() ),
 				this, SLOT( reverseModelChanged() ) );
 	connect( &m_ampModel, SIGNAL( dataChanged() ),
@@ -33,6 +33,7 @@
 #include "Engine.h"
 #include "InstrumentTrack.h"
 #include "Knob.h"
+#include "lmms_math.h"
 #include "Mixer.h"
 #include "NotePlayHandle.h"
 #include "Oscillator.h"
@@ -240,9 +241,9 @@ void organicInstrument::playNote( NotePlayHandle * _n,
 		for( int i = m_numOscillators - 1; i >= 0; --i )
 		{
 			static_cast<oscPtr *>( _n->m_pluginData )->phaseOffsetLeft[i] 
-				= rand() / ( RAND_MAX + 1.0f );
+				= fast_rand() / ( FAST_RAND_MAX + 1.0f );
 			static_cast<oscPtr *>( _n->m_pluginData )->phaseOffsetRight[i] 
-				= rand() / ( RAND_MAX + 1.0f );
+				= fast_rand() / ( FAST_RAND_MAX + 1.0f );
 			
 			// initialise ocillators
 			
@@ -389,7 +390,7 @@ int organicInstrument::intRand( int min, int max )
 {
 //	int randn = min+int((max-min)*rand()/(RAND_MAX + 1.0));	
 //	cout << randn << endl;
-	int randn = ( rand() % (max - min) ) + min;
+	int randn = ( fast_rand() % (max - min) ) + min;
 	return( randn );
 }
 
@@ -50,6 +50,7 @@ float frnd(float range)
 #include "MidiEvent.h"
 #include "MidiTime.h"
 #include "Mixer.h"
+#include "lmms_math.h"
 
 #include "embed.h"
 
@@ -151,7 +152,7 @@ void SfxrSynth::resetSample( bool restart )
 			phaser_buffer[i]=0.0f;
 
 		for(int i=0;i<32;i++)
-			noise_buffer[i]=frnd(2.0f)-1.0f;
+			noise_buffer[i]=fastRandf(2.0f)-1.0f;
 
 		rep_time=0;
 		rep_limit=(int)(pow(1.0f-s->m_repeatSpeedModel.value(), 2.0f)*20000+32);
@@ -247,7 +248,7 @@ void SfxrSynth::update( sampleFrame * buffer, const int32_t frameNum )
 				phase%=period;
 				if(s->m_waveFormModel.value()==3)
 					for(int i=0;i<32;i++)
-						noise_buffer[i]=frnd(2.0f)-1.0f;
+						noise_buffer[i]=fastRandf(2.0f)-1.0f;
 			}
 			// base waveform
 			float fp=(float)phase/period;
@@ -36,6 +36,7 @@
 #include "Engine.h"
 #include "InstrumentTrack.h"
 #include "Knob.h"
+#include "lmms_math.h"
 #include "Mixer.h"
 #include "NotePlayHandle.h"
 #include "PixmapButton.h"
@@ -256,7 +257,7 @@ static int sid_fillbuffer(unsigned char* sidreg, cSID *sid, int tdelta, short *p
 //  customly added
   int residdelay = 0;
 
-  int badline = rand() % NUMSIDREGS;
+  int badline = fast_rand() % NUMSIDREGS;
 
   for (c = 0; c < NUMSIDREGS; c++)
   {
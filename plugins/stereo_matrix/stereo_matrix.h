@@ -38,6 +38,11 @@ public:
 	virtual bool processAudioBuffer( sampleFrame * _buf,
 		                                          const fpp_t _frames );
 
+	virtual bool canSkipSilence() const
+	{
+		return true;
+	}
+
 	virtual EffectControls * controls()
 	{
 		return( &m_smControls );
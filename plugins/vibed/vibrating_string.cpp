@@ -81,7 +81,7 @@ vibratingString::vibratingString(	float _pitch,
 						_state);
 	
 	m_choice = static_cast<int>( m_oversample * 
-				static_cast<float>( rand() ) / RAND_MAX ); 
+				static_cast<float>( fast_rand() ) / FAST_RAND_MAX ); 
 	
 	m_pickupLoc = static_cast<int>( _pickup * string_length );
 }
@@ -101,8 +101,8 @@ vibratingString::delayLine * vibratingString::initDelayLine( int _len,
 		float offset = 0.0f;
 		for( int i = 0; i < dl->length; i++ )
 		{
-			r = static_cast<float>( rand() ) /
-					RAND_MAX;
+			r = static_cast<float>( fast_rand() ) /
+					FAST_RAND_MAX;
 			offset =  ( m_randomize / 2.0f -
 					m_randomize ) * r;
 			dl->data[i] = offset;
@@ -28,6 +28,7 @@
 #include <stdlib.h>
 
 #include "lmms_basics.h"
+#include "lmms_math.h"
 
 class vibratingString
 {
@@ -125,8 +126,8 @@ private:
 		{
 			for( int i = 0; i < _pick; i++ )
 			{
-				r = static_cast<float>( rand() ) /
-						RAND_MAX;
+				r = static_cast<float>( fast_rand() ) /
+						FAST_RAND_MAX;
 				offset =  ( m_randomize / 2.0f -
 						m_randomize ) * r;
 				_dl->data[i] = _scale *
@@ -135,8 +136,8 @@ private:
 			}
 			for( int i = _pick; i < _dl->length; i++ )
 			{
-				r = static_cast<float>( rand() ) /
-						RAND_MAX;
+				r = static_cast<float>( fast_rand() ) /
+						FAST_RAND_MAX;
 				offset =  ( m_randomize / 2.0f -
 						m_randomize ) * r;
 				_dl->data[i] = _scale * 
@@ -149,8 +150,8 @@ private:
 			{
 				for( int i = _pick; i < _dl->length; i++ )
 				{
-					r = static_cast<float>( rand() ) /
-							RAND_MAX;
+					r = static_cast<float>( fast_rand() ) /
+							FAST_RAND_MAX;
 					offset =  ( m_randomize / 2.0f -
 							m_randomize ) * r;
 					_dl->data[i] = _scale *
@@ -162,8 +163,8 @@ private:
 			{
 				for( int i = 0; i < _len; i++ )
 				{
-					r = static_cast<float>( rand() ) /
-							RAND_MAX;
+					r = static_cast<float>( fast_rand() ) /
+							FAST_RAND_MAX;
 					offset =  ( m_randomize / 2.0f -
 							m_randomize ) * r;
 					_dl->data[i+_pick] = _scale *
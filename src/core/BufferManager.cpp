@@ -29,6 +29,7 @@
 #include "Engine.h"
 #include "Mixer.h"
 #include "MemoryManager.h"
+#include "PeriodArena.h"
 
 static fpp_t framesPerPeriod;
 
@@ -43,6 +44,12 @@ sampleFrame * BufferManager::acquire()
 	return MM_ALLOC( sampleFrame, ::framesPerPeriod );
 }
 
+
+sampleFrame * BufferManager::acquireScratch()
+{
+	return PeriodArena::alloc<sampleFrame>( ::framesPerPeriod );
+}
+
 void BufferManager::clear( sampleFrame *ab, const f_cnt_t frames, const f_cnt_t offset )
 {
 	memset( ab + offset, 0, sizeof( *ab ) * frames );
@@ -170,13 +170,14 @@ void Controller::triggerFrameCounter()
 
 
 
-void Controller::resetFrameCounter()
+void Controller::resetFrameCounter( long periods )
 {
 	for (Controller * controller : s_controllers)
 	{
-		controller->m_bufferLastUpdated = 0;
+		// make sure the buffers get updated for the new position
+		controller->m_bufferLastUpdated = -1;
 	}
-	s_periods = 0;
+	s_periods = periods;
 }
 
 
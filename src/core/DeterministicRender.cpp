@@ -0,0 +1,116 @@
+/*
+ * DeterministicRender.cpp - reproducible rendering independent of thread scheduling
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+
+#include "DeterministicRender.h"
+
+#include "lmms_math.h"
+
+
+namespace
+{
+
+thread_local unsigned long t_fastRandState = 1;
+
+// SplitMix64 finalizer - spreads consecutive orders over the whole range
+inline uint64_t mix( uint64_t x )
+{
+	x += 0x9E3779B97F4A7C15ull;
+	x = ( x ^ ( x >> 30 ) ) * 0xBF58476D1CE4E5B9ull;
+	x = ( x ^ ( x >> 27 ) ) * 0x94D049BB133111EBull;
+	return x ^ ( x >> 31 );
+}
+
+}
+
+
+bool DeterministicRender::s_enabled = false;
+uint64_t DeterministicRender::s_period = 0;
+std::atomic<uint64_t> DeterministicRender::s_nextHandleOrder( 1 );
+std::atomic<uint64_t> DeterministicRender::s_nextObjectOrder( 0 );
+
+
+
+
+unsigned long & fastRandState()
+{
+	return t_fastRandState;
+}
+
+
+
+
+void DeterministicRender::setEnabled( bool enabled )
+{
+	s_enabled = enabled;
+}
+
+
+
+
+void DeterministicRender::restart()
+{
+	s_period = 0;
+	s_nextHandleOrder = ExportHandleOrders;
+}
+
+
+
+
+uint64_t DeterministicRender::childOrder( uint64_t parent, int index )
+{
+	// stay out of the object and channel ranges
+	return mix( parent ^ mix( index + 1 ) ) & ( ChannelOrders - 1 );
+}
+
+
+
+
+void DeterministicRender::seedJob( uint64_t order )
+{
+	if( s_enabled )
+	{
+		t_fastRandState = (unsigned long) mix( order ^ mix( s_period ) );
+	}
+}
+
+
+
+
+DeterministicRender::ScopedSeed::ScopedSeed( uint64_t order ) :
+	m_active( s_enabled ),
+	m_savedState( t_fastRandState )
+{
+	seedJob( order );
+}
+
+
+
+
+DeterministicRender::ScopedSeed::~ScopedSeed()
+{
+	if( m_active )
+	{
+		t_fastRandState = m_savedState;
+	}
+}
@@ -29,7 +29,9 @@
 #include "EffectChain.h"
 #include "Effect.h"
 #include "DummyEffect.h"
+#include "Mixer.h"
 #include "MixHelpers.h"
+#include "PerfTrace.h"
 #include "Song.h"
 
 
@@ -182,22 +184,42 @@ void EffectChain::moveUp( Effect * _effect )
 
 
 
-bool EffectChain::processAudioBuffer( sampleFrame * _buf, const fpp_t _frames, bool hasInputNoise )
+bool EffectChain::processAudioBuffer( sampleFrame * _buf, const fpp_t _frames, bool hasInputNoise, bool & silent )
 {
 	if( m_enabledModel.value() == false )
 	{
 		return false;
 	}
 
-	MixHelpers::sanitize( _buf, _frames );
+	PerfTrace::Span span( "EffectChain::processAudioBuffer" );
+
+	MixerProfiler & profiler = Engine::mixer()->profiler();
+
+	if( silent )
+	{
+		profiler.reportSkippedWork();
+	}
+	else
+	{
+		MixHelpers::sanitize( _buf, _frames );
+	}
 
 	bool moreEffects = false;
 	for( EffectList::Iterator it = m_effects.begin(); it != m_effects.end(); ++it )
 	{
 		if( hasInputNoise || ( *it )->isRunning() )
 		{
-			moreEffects |= ( *it )->processAudioBuffer( _buf, _frames );
+			if( silent && ( *it )->canSkipSilence() )
+			{
+				profiler.reportSkippedWork();
+				continue;
+			}
+			{
+				MixerProfiler::Probe probe( profiler, MixerProfiler::NodeType::Effect, *it );
+				moreEffects |= ( *it )->processAudioBuffer( _buf, _frames );
+			}
 			MixHelpers::sanitize( _buf, _frames );
+			silent = false;
 		}
 	}
 
@@ -224,6 +246,28 @@ void EffectChain::startRunning()
 
 
 
+f_cnt_t EffectChain::tailFrames() const
+{
+	if( m_enabledModel.value() == false )
+	{
+		return 0;
+	}
+
+	f_cnt_t frames = 0;
+	for( const Effect * effect : m_effects )
+	{
+		if( effect->isEnabled() )
+		{
+			frames += effect->timeout() *
+					Engine::mixer()->framesPerPeriod();
+		}
+	}
+	return frames;
+}
+
+
+
+
 void EffectChain::clear()
 {
 	emit aboutToClear();
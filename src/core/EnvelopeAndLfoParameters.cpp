@@ -25,6 +25,7 @@
 #include <QDomElement>
 
 #include "EnvelopeAndLfoParameters.h"
+#include "DeterministicRender.h"
 #include "Engine.h"
 #include "Mixer.h"
 #include "Oscillator.h"
@@ -56,13 +57,13 @@ void EnvelopeAndLfoParameters::LfoInstances::trigger()
 
 
 
-void EnvelopeAndLfoParameters::LfoInstances::reset()
+void EnvelopeAndLfoParameters::LfoInstances::reset( f_cnt_t _frame )
 {
 	QMutexLocker m( &m_lfoListMutex );
 	for( LfoList::Iterator it = m_lfos.begin();
 							it != m_lfos.end(); ++it )
 	{
-		( *it )->m_lfoFrame = 0;
+		( *it )->m_lfoFrame = _frame;
 		( *it )->m_bad_lfoShapeData = true;
 	}
 }
@@ -118,7 +119,8 @@ EnvelopeAndLfoParameters::EnvelopeAndLfoParameters(
 	m_controlEnvAmountModel( false, this, tr( "Modulate env amount" ) ),
 	m_lfoFrame( 0 ),
 	m_lfoAmountIsZero( false ),
-	m_lfoShapeData( NULL )
+	m_lfoShapeData( NULL ),
+	m_renderOrder( DeterministicRender::nextObjectOrder() )
 {
 	m_amountModel.setCenterValue( 0 );
 	m_lfoAmountModel.setCenterValue( 0 );
@@ -243,6 +245,9 @@ inline sample_t EnvelopeAndLfoParameters::lfoShapeSample( fpp_t _frame_offset )
 
 void EnvelopeAndLfoParameters::updateLfoShapeData()
 {
+	// done by the first note of the period which needs the LFO
+	DeterministicRender::ScopedSeed seed( m_renderOrder );
+
 	const fpp_t frames = Engine::mixer()->framesPerPeriod();
 	for( fpp_t offset = 0; offset < frames; ++offset )
 	{
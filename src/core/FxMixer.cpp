@@ -24,11 +24,15 @@
 
 #include <QDomElement>
 
+#include <algorithm>
+
 #include "BufferManager.h"
+#include "DeterministicRender.h"
 #include "FxMixer.h"
 #include "Mixer.h"
 #include "MixerWorkerThread.h"
 #include "MixHelpers.h"
+#include "PerfTrace.h"
 #include "Song.h"
 
 #include "InstrumentTrack.h"
@@ -62,6 +66,7 @@ FxChannel::FxChannel( int idx, Model * _parent ) :
 	m_fxChain( NULL ),
 	m_hasInput( false ),
 	m_stillRunning( false ),
+	m_bufferSilent( true ),
 	m_peakLeft( 0.0f ),
 	m_peakRight( 0.0f ),
 	m_buffer( new sampleFrame[Engine::mixer()->framesPerPeriod()] ),
@@ -71,10 +76,15 @@ FxChannel::FxChannel( int idx, Model * _parent ) :
 	m_name(),
 	m_lock(),
 	m_channelIndex( idx ),
-	m_queued( false ),
-	m_dependenciesMet(0)
+	m_muted( false ),
+	m_scheduled( false ),
+	m_scheduledMuted( false ),
+	m_scheduledSenders( 0 ),
+	m_scheduledReceivers(),
+	m_pendingSenders( 0 )
 {
 	BufferManager::clear( m_buffer, Engine::mixer()->framesPerPeriod() );
+	m_portInputs.reserve( 16 );
 }
 
 
@@ -88,25 +98,15 @@ FxChannel::~FxChannel()
 
 inline void FxChannel::processed()
 {
-	for( const FxRoute * receiverRoute : m_sends )
+	for( FxChannel * receiver : m_scheduledReceivers )
 	{
-		if( receiverRoute->receiver()->m_muted == false )
+		if( --receiver->m_pendingSenders == 0 )
 		{
-			receiverRoute->receiver()->incrementDeps();
+			MixerWorkerThread::addJob( receiver );
 		}
 	}
 }
 
-void FxChannel::incrementDeps()
-{
-	int i = m_dependenciesMet++ + 1;
-	if( i >= m_receives.size() && ! m_queued )
-	{
-		m_queued = true;
-		MixerWorkerThread::addJob( this );
-	}
-}
-
 void FxChannel::unmuteForSolo()
 {
 	//TODO: Recursively activate every channel, this channel sends to
@@ -116,8 +116,35 @@ void FxChannel::unmuteForSolo()
 
 
 void FxChannel::doProcessing()
+{
+	processChannel();
+
+	// increment dependency counter of all receivers
+	processed();
+}
+
+
+
+
+void FxChannel::processChannel()
 {
 	const fpp_t fpp = Engine::mixer()->framesPerPeriod();
+	MixerProfiler & profiler = Engine::mixer()->profiler();
+	MixerProfiler::Probe probe( profiler, MixerProfiler::NodeType::FxChannel, this );
+	PerfTrace::Span span( "FxChannel::processChannel" );
+
+	DeterministicRender::seedJob( DeterministicRender::channelOrder( m_channelIndex ) );
+
+	// all ports sending to us are done, add them in a fixed order
+	if( !m_portInputs.empty() )
+	{
+		std::sort( m_portInputs.begin(), m_portInputs.end() );
+		for( const auto & input : m_portInputs )
+		{
+			MixHelpers::add( m_buffer, input.second, fpp );
+		}
+		m_portInputs.clear();
+	}
 
 	if( m_muted == false )
 	{
@@ -127,7 +154,12 @@ void FxChannel::doProcessing()
 			FloatModel * sendModel = senderRoute->amount();
 			if( ! sendModel ) qFatal( "Error: no send model found from %d to %d", senderRoute->senderIndex(), m_channelIndex );
 
-			if( sender->m_hasInput || sender->m_stillRunning )
+			if( sender->m_bufferSilent )
+			{
+				// adding zeros doesn't change anything
+				profiler.reportSkippedWork();
+			}
+			else if( sender->m_hasInput || sender->m_stillRunning )
 			{
 				// figure out if we're getting sample-exact input
 				ValueBuffer * sendBuf = sendModel->valueBuffer();
@@ -157,6 +189,7 @@ void FxChannel::doProcessing()
 					MixHelpers::addSanitizedMultipliedByBuffer( m_buffer, ch_buf, v, sendBuf, fpp );
 				}
 				m_hasInput = true;
+				m_bufferSilent = false;
 			}
 		}
 
@@ -169,19 +202,24 @@ void FxChannel::doProcessing()
 			m_fxChain.startRunning();
 		}
 
-		m_stillRunning = m_fxChain.processAudioBuffer( m_buffer, fpp, m_hasInput );
+		m_stillRunning = m_fxChain.processAudioBuffer( m_buffer, fpp, m_hasInput, m_bufferSilent );
 
-		Mixer::StereoSample peakSamples = Engine::mixer()->getPeakValues(m_buffer, fpp);
-		m_peakLeft = qMax( m_peakLeft, peakSamples.left * v );
-		m_peakRight = qMax( m_peakRight, peakSamples.right * v );
+		// peaks of silence are zero and wouldn't change anything
+		if( m_bufferSilent )
+		{
+			profiler.reportSkippedWork();
+		}
+		else
+		{
+			Mixer::StereoSample peakSamples = Engine::mixer()->getPeakValues(m_buffer, fpp);
+			m_peakLeft = qMax( m_peakLeft, peakSamples.left * v );
+			m_peakRight = qMax( m_peakRight, peakSamples.right * v );
+		}
 	}
 	else
 	{
 		m_peakLeft = m_peakRight = 0.0f;
 	}
-
-	// increment dependency counter of all receivers
-	processed();
 }
 
 
@@ -189,7 +227,10 @@ void FxChannel::doProcessing()
 FxMixer::FxMixer() :
 	Model( NULL ),
 	JournallingObject(),
-	m_fxChannels()
+	m_fxChannels(),
+	m_schedule(),
+	m_scheduleRoots( 0 ),
+	m_scheduleValid( false )
 {
 	// create master channel
 	createChannel();
@@ -219,6 +260,7 @@ int FxMixer::createChannel()
 	const int index = m_fxChannels.size();
 	// create new channel
 	m_fxChannels.push_back( new FxChannel( index, this ) );
+	invalidateSchedule();
 
 	// reset channel state
 	clearChannel( index );
@@ -339,6 +381,7 @@ void FxMixer::deleteChannel( int index )
 	// actually delete the channel
 	m_fxChannels.remove(index);
 	delete ch;
+	invalidateSchedule();
 
 	for( int i = index; i < m_fxChannels.size(); ++i )
 	{
@@ -418,6 +461,8 @@ void FxMixer::moveChannelLeft( int index )
 	// Update m_channelIndex of both channels
 	m_fxChannels[index]->m_channelIndex = index;
 	m_fxChannels[index - 1]->m_channelIndex = index -1;
+
+	invalidateSchedule();
 }
 
 
@@ -469,6 +514,7 @@ FxRoute * FxMixer::createRoute( FxChannel * from, FxChannel * to, float amount )
 
 	// add us to fxmixer's list
 	Engine::fxMixer()->m_fxRoutes.append( route );
+	invalidateSchedule();
 	Engine::mixer()->doneChangeInModel();
 
 	return route;
@@ -504,6 +550,7 @@ void FxMixer::deleteChannelSend( FxRoute * route )
 	// remove us from fxmixer's list
 	Engine::fxMixer()->m_fxRoutes.remove( Engine::fxMixer()->m_fxRoutes.indexOf( route ) );
 	delete route;
+	invalidateSchedule();
 	Engine::mixer()->doneChangeInModel();
 }
 
@@ -546,6 +593,68 @@ bool FxMixer::checkInfiniteLoop( FxChannel * from, FxChannel * to )
 }
 
 
+// a gain which always is exactly 1, i.e. neither automated, controlled nor
+// linked to another model which could give sample-exact values
+static bool isConstantUnity( const FloatModel & model )
+{
+	return model.value() == 1.0f && !model.isAutomatedOrControlled()
+						&& !model.hasLinkedModels();
+}
+
+
+
+
+bool FxMixer::isTransparentPath( fx_ch_t fromChannel, bool & sanitizesFirst,
+							bool & clamps ) const
+{
+	sanitizesFirst = false;
+	clamps = false;
+
+	if( fromChannel < 0 || fromChannel >= numChannels() )
+	{
+		return false;
+	}
+
+	// routing can't contain loops, so this always ends
+	const FxChannel * ch = m_fxChannels[fromChannel];
+	while( true )
+	{
+		if( ch->m_muteModel.value() ||
+				!isConstantUnity( ch->m_volumeModel ) )
+		{
+			return false;
+		}
+
+		// an enabled but empty effect chain still sanitizes the buffer
+		if( ch->m_fxChain.isEnabled() )
+		{
+			if( !ch->m_fxChain.isEmpty() )
+			{
+				return false;
+			}
+			// until mixed into the next channel, NaNs clear the
+			// whole buffer instead of single samples
+			sanitizesFirst |= ch->m_channelIndex == fromChannel;
+			clamps = true;
+		}
+
+		if( ch->m_channelIndex == 0 )
+		{
+			return true;
+		}
+
+		if( ch->m_sends.size() != 1 ||
+				!isConstantUnity( *ch->m_sends[0]->amount() ) )
+		{
+			return false;
+		}
+		ch = ch->m_sends[0]->receiver();
+	}
+}
+
+
+
+
 // how much does fromChannel send its output to the input of toChannel?
 FloatModel * FxMixer::channelSendModel( fx_ch_t fromChannel, fx_ch_t toChannel )
 {
@@ -569,13 +678,22 @@ FloatModel * FxMixer::channelSendModel( fx_ch_t fromChannel, fx_ch_t toChannel )
 
 
 
-void FxMixer::mixToChannel( const sampleFrame * _buf, fx_ch_t _ch )
+void FxMixer::mixToChannel( const sampleFrame * _buf, fx_ch_t _ch, uint64_t order )
 {
 	if( m_fxChannels[_ch]->m_muteModel.value() == false )
 	{
 		m_fxChannels[_ch]->m_lock.lock();
-		MixHelpers::add( m_fxChannels[_ch]->m_buffer, _buf, Engine::mixer()->framesPerPeriod() );
+		if( DeterministicRender::isEnabled() )
+		{
+			// ports finish in any order, so leave the sum to the channel
+			m_fxChannels[_ch]->m_portInputs.push_back( std::make_pair( order, _buf ) );
+		}
+		else
+		{
+			MixHelpers::add( m_fxChannels[_ch]->m_buffer, _buf, Engine::mixer()->framesPerPeriod() );
+		}
 		m_fxChannels[_ch]->m_hasInput = true;
+		m_fxChannels[_ch]->m_bufferSilent = false;
 		m_fxChannels[_ch]->m_lock.unlock();
 	}
 }
@@ -585,86 +703,198 @@ void FxMixer::mixToChannel( const sampleFrame * _buf, fx_ch_t _ch )
 
 void FxMixer::prepareMasterMix()
 {
+	// usually cleared at the end of the previous period already
+	if( m_fxChannels[0]->m_bufferSilent )
+	{
+		Engine::mixer()->profiler().reportSkippedWork();
+		return;
+	}
 	BufferManager::clear( m_fxChannels[0]->m_buffer,
 					Engine::mixer()->framesPerPeriod() );
+	m_fxChannels[0]->m_bufferSilent = true;
 }
 
 
 
-void FxMixer::masterMix( sampleFrame * _buf )
+void FxMixer::invalidateSchedule()
 {
-	const int fpp = Engine::mixer()->framesPerPeriod();
+	m_scheduleValid = false;
+	Engine::mixer()->invalidateRenderGraph();
+}
 
-	// add the channels that have no dependencies (no incoming senders, ie.
-	// no receives) to the jobqueue. The channels that have receives get
-	// added when their senders get processed, which is detected by
-	// dependency counting.
-	// also instantly add all muted channels as they don't need to care
-	// about their senders, and can just increment the deps of their
-	// recipients right away.
-	MixerWorkerThread::resetJobQueue( MixerWorkerThread::JobQueue::Dynamic );
+
+
+
+void FxMixer::compileSchedule()
+{
 	for( FxChannel * ch : m_fxChannels )
 	{
-		ch->m_muted = ch->m_muteModel.value();
-		if( ch->m_muted ) // instantly "process" muted channels
+		ch->m_scheduled = false;
+		ch->m_scheduledMuted = ch->m_muted;
+		ch->m_scheduledSenders = 0;
+		ch->m_scheduledReceivers.clear();
+	}
+	m_schedule.clear();
+	m_scheduleRoots = 0;
+
+	// only channels whose output reaches master through unmuted channels
+	// have to be processed - collect them by walking the routing backwards
+	FxChannel * master = m_fxChannels[0];
+	if( !master->m_muted )
+	{
+		master->m_scheduled = true;
+		m_schedule.push_back( master );
+	}
+	for( size_t i = 0; i < m_schedule.size(); ++i )
+	{
+		for( const FxRoute * route : m_schedule[i]->m_receives )
+		{
+			FxChannel * sender = route->sender();
+			if( !sender->m_muted && !sender->m_scheduled )
+			{
+				sender->m_scheduled = true;
+				m_schedule.push_back( sender );
+			}
+		}
+	}
+
+	for( FxChannel * ch : m_schedule )
+	{
+		for( const FxRoute * route : ch->m_sends )
 		{
-			ch->processed();
-			ch->done();
+			FxChannel * receiver = route->receiver();
+			if( receiver->m_scheduled )
+			{
+				ch->m_scheduledReceivers.push_back( receiver );
+				++receiver->m_scheduledSenders;
+			}
 		}
-		else if( ch->m_receives.size() == 0 )
+	}
+
+	// sort topologically - taking channels in the order they become
+	// ready puts them in levels, starting with the ones without inputs
+	const size_t count = m_schedule.size();
+	m_schedule.clear();
+	for( FxChannel * ch : m_fxChannels )
+	{
+		ch->m_pendingSenders = ch->m_scheduledSenders;
+		if( ch->m_scheduled && ch->m_scheduledSenders == 0 )
 		{
-			ch->m_queued = true;
-			MixerWorkerThread::addJob( ch );
+			m_schedule.push_back( ch );
 		}
 	}
-	while (m_fxChannels[0]->state() != ThreadableJob::ProcessingState::Done)
+	m_scheduleRoots = m_schedule.size();
+	for( size_t i = 0; i < m_schedule.size(); ++i )
 	{
-		bool found = false;
-		for( FxChannel * ch : m_fxChannels )
+		for( FxChannel * receiver : m_schedule[i]->m_scheduledReceivers )
 		{
-			const auto s = ch->state();
-			if (s == ThreadableJob::ProcessingState::Queued
-				|| s == ThreadableJob::ProcessingState::InProgress)
+			if( --receiver->m_pendingSenders == 0 )
 			{
-				found = true;
-				break;
+				m_schedule.push_back( receiver );
 			}
 		}
-		if( !found )
+	}
+	Q_ASSERT( m_schedule.size() == count );
+	Q_UNUSED( count );
+
+	m_scheduleValid = true;
+}
+
+
+
+
+void FxMixer::masterMix( sampleFrame * _buf )
+{
+	// muted subtrees are left out of the schedule, so it has to be
+	// recompiled whenever a channel gets (un)muted
+	bool mutesChanged = false;
+	for( FxChannel * ch : m_fxChannels )
+	{
+		ch->m_muted = ch->m_muteModel.value();
+		mutesChanged |= ch->m_muted != ch->m_scheduledMuted;
+	}
+	if( !m_scheduleValid || mutesChanged )
+	{
+		compileSchedule();
+	}
+
+	for( FxChannel * ch : m_schedule )
+	{
+		ch->m_pendingSenders = ch->m_scheduledSenders;
+	}
+
+	// queue the channels without inputs - all others get queued by their
+	// last sender, so everything is done after a single dispatch
+	MixerWorkerThread::resetJobQueue( MixerWorkerThread::JobQueue::Dynamic );
+	for( int i = 0; i < m_scheduleRoots; ++i )
+	{
+		MixerWorkerThread::addJob( m_schedule[i] );
+	}
+	MixerWorkerThread::startAndWaitForJobs();
+
+	// channels which aren't processed don't show any output either
+	for( FxChannel * ch : m_fxChannels )
+	{
+		if( !ch->m_scheduled )
 		{
-			break;
+			ch->m_peakLeft = ch->m_peakRight = 0.0f;
 		}
-		MixerWorkerThread::startAndWaitForJobs();
 	}
 
-	// handle sample-exact data in master volume fader
-	ValueBuffer * volBuf = m_fxChannels[0]->m_volumeModel.valueBuffer();
+	finishMasterMix( _buf );
+}
+
 
-	if( volBuf )
+
+
+void FxMixer::finishMasterMix( sampleFrame * _buf )
+{
+	const int fpp = Engine::mixer()->framesPerPeriod();
+	MixerProfiler & profiler = Engine::mixer()->profiler();
+
+	// _buf is cleared already, so there's nothing to do for silence
+	if( m_fxChannels[0]->m_bufferSilent )
 	{
-		for( int f = 0; f < fpp; f++ )
+		profiler.reportSkippedWork();
+	}
+	else
+	{
+		// handle sample-exact data in master volume fader
+		ValueBuffer * volBuf = m_fxChannels[0]->m_volumeModel.valueBuffer();
+
+		if( volBuf )
 		{
-			m_fxChannels[0]->m_buffer[f][0] *= volBuf->values()[f];
-			m_fxChannels[0]->m_buffer[f][1] *= volBuf->values()[f];
+			for( int f = 0; f < fpp; f++ )
+			{
+				m_fxChannels[0]->m_buffer[f][0] *= volBuf->values()[f];
+				m_fxChannels[0]->m_buffer[f][1] *= volBuf->values()[f];
+			}
 		}
-	}
 
-	const float v = volBuf
-		? 1.0f
-		: m_fxChannels[0]->m_volumeModel.value();
-	MixHelpers::addSanitizedMultiplied( _buf, m_fxChannels[0]->m_buffer, v, fpp );
+		const float v = volBuf
+			? 1.0f
+			: m_fxChannels[0]->m_volumeModel.value();
+		MixHelpers::addSanitizedMultiplied( _buf, m_fxChannels[0]->m_buffer, v, fpp );
+	}
 
 	// clear all channel buffers and
 	// reset channel process state
 	for( int i = 0; i < numChannels(); ++i)
 	{
-		BufferManager::clear( m_fxChannels[i]->m_buffer,
-				Engine::mixer()->framesPerPeriod() );
+		if( m_fxChannels[i]->m_bufferSilent )
+		{
+			profiler.reportSkippedWork();
+		}
+		else
+		{
+			BufferManager::clear( m_fxChannels[i]->m_buffer, fpp );
+			m_fxChannels[i]->m_bufferSilent = true;
+		}
 		m_fxChannels[i]->reset();
-		m_fxChannels[i]->m_queued = false;
 		// also reset hasInput
 		m_fxChannels[i]->m_hasInput = false;
-		m_fxChannels[i]->m_dependenciesMet = 0;
+		// left over if the channel wasn't processed
+		m_fxChannels[i]->m_portInputs.clear();
 	}
 }
 
@@ -28,6 +28,7 @@
 #include "embed.h"
 #include "Engine.h"
 #include "InstrumentTrack.h"
+#include "lmms_math.h"
 #include "Mixer.h"
 #include "PresetPreviewPlayHandle.h"
 #include "stdshims.h"
@@ -412,7 +413,7 @@ void InstrumentFunctionArpeggio::processNote( NotePlayHandle * _n )
 		// Skip notes randomly
 		if( m_arpSkipModel.value() )
 		{
-			if( 100 * ( (float) rand() / (float)( RAND_MAX + 1.0f ) ) < m_arpSkipModel.value() )
+			if( 100 * ( (float) fast_rand() / (float)( FAST_RAND_MAX + 1.0f ) ) < m_arpSkipModel.value() )
 			{
 				// update counters
 				frames_processed += arp_frames;
@@ -428,7 +429,7 @@ void InstrumentFunctionArpeggio::processNote( NotePlayHandle * _n )
 
 		if( m_arpMissModel.value() )
 		{
-			if( 100 * ( (float) rand() / (float)( RAND_MAX + 1.0f ) ) < m_arpMissModel.value() )
+			if( 100 * ( (float) fast_rand() / (float)( FAST_RAND_MAX + 1.0f ) ) < m_arpMissModel.value() )
 			{
 				dir = ArpDirRandom;
 			}
@@ -475,7 +476,7 @@ void InstrumentFunctionArpeggio::processNote( NotePlayHandle * _n )
 		else if( dir == ArpDirRandom )
 		{
 			// just pick a random chord-index
-			cur_arp_idx = (int)( range * ( (float) rand() / (float) RAND_MAX ) );
+			cur_arp_idx = (int)( range * ( (float) fast_rand() / (float) FAST_RAND_MAX ) );
 		}
 
 		// Cycle notes
@@ -22,7 +22,6 @@
  *
  */
 
-#include <QtCore/QVarLengthArray>
 #include <QDomElement>
 
 #include "InstrumentSoundShaping.h"
@@ -33,6 +32,7 @@
 #include "Instrument.h"
 #include "InstrumentTrack.h"
 #include "Mixer.h"
+#include "PeriodArena.h"
 #include "stdshims.h"
 
 
@@ -155,8 +155,8 @@ void InstrumentSoundShaping::processAudioBuffer( sampleFrame* buffer,
 
 	if( m_filterEnabledModel.value() )
 	{
-		QVarLengthArray<float> cutBuffer(frames);
-		QVarLengthArray<float> resBuffer(frames);
+		float * cutBuffer = PeriodArena::alloc<float>( frames );
+		float * resBuffer = PeriodArena::alloc<float>( frames );
 
 		int old_filter_cut = 0;
 		int old_filter_res = 0;
@@ -169,11 +169,11 @@ void InstrumentSoundShaping::processAudioBuffer( sampleFrame* buffer,
 
 		if( m_envLfoParameters[Cut]->isUsed() )
 		{
-			m_envLfoParameters[Cut]->fillLevel( cutBuffer.data(), envTotalFrames, envReleaseBegin, frames );
+			m_envLfoParameters[Cut]->fillLevel( cutBuffer, envTotalFrames, envReleaseBegin, frames );
 		}
 		if( m_envLfoParameters[Resonance]->isUsed() )
 		{
-			m_envLfoParameters[Resonance]->fillLevel( resBuffer.data(), envTotalFrames, envReleaseBegin, frames );
+			m_envLfoParameters[Resonance]->fillLevel( resBuffer, envTotalFrames, envReleaseBegin, frames );
 		}
 
 		const float fcv = m_filterCutModel.value();
@@ -248,8 +248,8 @@ void InstrumentSoundShaping::processAudioBuffer( sampleFrame* buffer,
 
 	if( m_envLfoParameters[Volume]->isUsed() )
 	{
-		QVarLengthArray<float> volBuffer(frames);
-		m_envLfoParameters[Volume]->fillLevel( volBuffer.data(), envTotalFrames, envReleaseBegin, frames );
+		float * volBuffer = PeriodArena::alloc<float>( frames );
+		m_envLfoParameters[Volume]->fillLevel( volBuffer, envTotalFrames, envReleaseBegin, frames );
 
 		for( fpp_t frame = 0; frame < frames; ++frame )
 		{
@@ -27,6 +27,7 @@
 #include <QObject>
 
 
+#include "DeterministicRender.h"
 #include "Song.h"
 #include "Mixer.h"
 #include "LfoController.h"
@@ -45,7 +46,8 @@ LfoController::LfoController( Model * _parent ) :
 	m_phaseOffset( 0 ),
 	m_currentPhase( 0 ),
 	m_sampleFunction( &Oscillator::sinSample ),
-	m_userDefSampleBuffer( new SampleBuffer )
+	m_userDefSampleBuffer( new SampleBuffer ),
+	m_renderOrder( DeterministicRender::nextObjectOrder() )
 {
 	setSampleExact( true );
 	connect( &m_waveModel, SIGNAL( dataChanged() ),
@@ -83,6 +85,9 @@ LfoController::~LfoController()
 
 void LfoController::updateValueBuffer()
 {
+	// done by whichever job needs the value first
+	DeterministicRender::ScopedSeed seed( m_renderOrder );
+
 	m_phaseOffset = m_phaseModel.value() / 360.0;
 	float phase = m_currentPhase + m_phaseOffset;
 
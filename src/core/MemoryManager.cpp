@@ -26,6 +26,7 @@
 #include "MemoryManager.h"
 
 #include <QtCore/QtGlobal>
+#include "PeriodArena.h"
 #include "rpmalloc.h"
 
 /// Global static object handling rpmalloc intializing and finalizing
@@ -65,6 +66,7 @@ void* MemoryManager::alloc(size_t size)
 	// Compilers may optimize the instance away otherwise.
 	Q_UNUSED(&local_mm_thread_guard);
 	Q_ASSERT_X(rpmalloc_is_thread_initialized(), "MemoryManager::alloc", "Thread not initialized");
+	PeriodArena::countHeapAllocation();
 	return rpmalloc(size);
 }
 
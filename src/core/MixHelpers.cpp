@@ -27,10 +27,9 @@
 #include <cstdio>
 
 #include "lmms_math.h"
+#include "MixHelpersKernels.h"
 #include "ValueBuffer.h"
 
-#include <cstdio>
-
 
 static bool s_NaNHandler;
 
@@ -61,7 +60,12 @@ static inline void run( sampleFrame* dst, const sample_t* srcLeft, const sample_
 
 
 
-bool isSilent( const sampleFrame* src, int frames )
+// Scalar reference implementation - the vectorized kernels have to give
+// exactly the same results
+namespace Scalar
+{
+
+static bool isSilent( const sampleFrame* src, int frames )
 {
 	const float silenceThreshold = 0.0000001f;
 
@@ -76,35 +80,14 @@ bool isSilent( const sampleFrame* src, int frames )
 	return true;
 }
 
-bool useNaNHandler()
-{
-	return s_NaNHandler;
-}
-
-void setNaNHandler( bool use )
-{
-	s_NaNHandler = use;
-}
-
-/*! \brief Function for sanitizing a buffer of infs/nans - returns true if those are found */
-bool sanitize( sampleFrame * src, int frames )
+static bool sanitize( sampleFrame * src, int frames )
 {
-	if( !useNaNHandler() )
-	{
-		return false;
-	}
-
-	bool found = false;
 	for( int f = 0; f < frames; ++f )
 	{
 		for( int c = 0; c < 2; ++c )
 		{
 			if( isinf( src[f][c] ) || isnan( src[f][c] ) )
 			{
-				#ifdef LMMS_DEBUG
-					printf("Bad data, clearing buffer. frame: ");
-					printf("%d: value %f\n", f, src[f][c]);
-				#endif
 				for( int f = 0; f < frames; ++f )
 				{
 					for( int c = 0; c < 2; ++c )
@@ -112,8 +95,7 @@ bool sanitize( sampleFrame * src, int frames )
 						src[f][c] = 0.0f;
 					}
 				}
-				found = true;
-				return found;
+				return true;
 			}
 			else
 			{
@@ -121,7 +103,7 @@ bool sanitize( sampleFrame * src, int frames )
 			}
 		}
 	}
-	return found;
+	return false;
 }
 
 
@@ -134,7 +116,7 @@ struct AddOp
 	}
 } ;
 
-void add( sampleFrame* dst, const sampleFrame* src, int frames )
+static void add( sampleFrame* dst, const sampleFrame* src, int frames )
 {
 	run<>( dst, src, frames, AddOp() );
 }
@@ -155,7 +137,7 @@ struct AddMultipliedOp
 } ;
 
 
-void addMultiplied( sampleFrame* dst, const sampleFrame* src, float coeffSrc, int frames )
+static void addMultiplied( sampleFrame* dst, const sampleFrame* src, float coeffSrc, int frames )
 {
 	run<>( dst, src, frames, AddMultipliedOp(coeffSrc) );
 }
@@ -174,64 +156,50 @@ struct AddSwappedMultipliedOp
 	const float m_coeff;
 };
 
-void addSwappedMultiplied( sampleFrame* dst, const sampleFrame* src, float coeffSrc, int frames )
+static void addSwappedMultiplied( sampleFrame* dst, const sampleFrame* src, float coeffSrc, int frames )
 {
 	run<>( dst, src, frames, AddSwappedMultipliedOp(coeffSrc) );
 }
 
 
-void addMultipliedByBuffer( sampleFrame* dst, const sampleFrame* src, float coeffSrc, ValueBuffer * coeffSrcBuf, int frames )
+static void addMultipliedByBuffer( sampleFrame* dst, const sampleFrame* src, float coeffSrc, const float* coeffSrcBuf, int frames )
 {
 	for( int f = 0; f < frames; ++f )
 	{
-		dst[f][0] += src[f][0] * coeffSrc * coeffSrcBuf->values()[f];
-		dst[f][1] += src[f][1] * coeffSrc * coeffSrcBuf->values()[f];
+		dst[f][0] += src[f][0] * coeffSrc * coeffSrcBuf[f];
+		dst[f][1] += src[f][1] * coeffSrc * coeffSrcBuf[f];
 	}
 }
 
-void addMultipliedByBuffers( sampleFrame* dst, const sampleFrame* src, ValueBuffer * coeffSrcBuf1, ValueBuffer * coeffSrcBuf2, int frames )
+static void addMultipliedByBuffers( sampleFrame* dst, const sampleFrame* src, const float* coeffSrcBuf1, const float* coeffSrcBuf2, int frames )
 {
 	for( int f = 0; f < frames; ++f )
 	{
-		dst[f][0] += src[f][0] * coeffSrcBuf1->values()[f] * coeffSrcBuf2->values()[f];
-		dst[f][1] += src[f][1] * coeffSrcBuf1->values()[f] * coeffSrcBuf2->values()[f];
+		dst[f][0] += src[f][0] * coeffSrcBuf1[f] * coeffSrcBuf2[f];
+		dst[f][1] += src[f][1] * coeffSrcBuf1[f] * coeffSrcBuf2[f];
 	}
 
 }
 
-void addSanitizedMultipliedByBuffer( sampleFrame* dst, const sampleFrame* src, float coeffSrc, ValueBuffer * coeffSrcBuf, int frames )
+static void addSanitizedMultipliedByBuffer( sampleFrame* dst, const sampleFrame* src, float coeffSrc, const float* coeffSrcBuf, int frames )
 {
-	if ( !useNaNHandler() )
-	{
-		addMultipliedByBuffer( dst, src, coeffSrc, coeffSrcBuf,
-								frames );
-		return;
-	}
-
 	for( int f = 0; f < frames; ++f )
 	{
-		dst[f][0] += ( isinf( src[f][0] ) || isnan( src[f][0] ) ) ? 0.0f : src[f][0] * coeffSrc * coeffSrcBuf->values()[f];
-		dst[f][1] += ( isinf( src[f][1] ) || isnan( src[f][1] ) ) ? 0.0f : src[f][1] * coeffSrc * coeffSrcBuf->values()[f];
+		dst[f][0] += ( isinf( src[f][0] ) || isnan( src[f][0] ) ) ? 0.0f : src[f][0] * coeffSrc * coeffSrcBuf[f];
+		dst[f][1] += ( isinf( src[f][1] ) || isnan( src[f][1] ) ) ? 0.0f : src[f][1] * coeffSrc * coeffSrcBuf[f];
 	}
 }
 
-void addSanitizedMultipliedByBuffers( sampleFrame* dst, const sampleFrame* src, ValueBuffer * coeffSrcBuf1, ValueBuffer * coeffSrcBuf2, int frames )
+static void addSanitizedMultipliedByBuffers( sampleFrame* dst, const sampleFrame* src, const float* coeffSrcBuf1, const float* coeffSrcBuf2, int frames )
 {
-	if ( !useNaNHandler() )
-	{
-		addMultipliedByBuffers( dst, src, coeffSrcBuf1, coeffSrcBuf2,
-								frames );
-		return;
-	}
-
 	for( int f = 0; f < frames; ++f )
 	{
 		dst[f][0] += ( isinf( src[f][0] ) || isnan( src[f][0] ) )
 			? 0.0f
-			: src[f][0] * coeffSrcBuf1->values()[f] * coeffSrcBuf2->values()[f];
+			: src[f][0] * coeffSrcBuf1[f] * coeffSrcBuf2[f];
 		dst[f][1] += ( isinf( src[f][1] ) || isnan( src[f][1] ) )
 			? 0.0f
-			: src[f][1] * coeffSrcBuf1->values()[f] * coeffSrcBuf2->values()[f];
+			: src[f][1] * coeffSrcBuf1[f] * coeffSrcBuf2[f];
 	}
 
 }
@@ -250,14 +218,8 @@ struct AddSanitizedMultipliedOp
 	const float m_coeff;
 };
 
-void addSanitizedMultiplied( sampleFrame* dst, const sampleFrame* src, float coeffSrc, int frames )
+static void addSanitizedMultiplied( sampleFrame* dst, const sampleFrame* src, float coeffSrc, int frames )
 {
-	if ( !useNaNHandler() )
-	{
-		addMultiplied( dst, src, coeffSrc, frames );
-		return;
-	}
-
 	run<>( dst, src, frames, AddSanitizedMultipliedOp(coeffSrc) );
 }
 
@@ -281,7 +243,7 @@ struct AddMultipliedStereoOp
 } ;
 
 
-void addMultipliedStereo( sampleFrame* dst, const sampleFrame* src, float coeffSrcLeft, float coeffSrcRight, int frames )
+static void addMultipliedStereo( sampleFrame* dst, const sampleFrame* src, float coeffSrcLeft, float coeffSrcRight, int frames )
 {
 
 	run<>( dst, src, frames, AddMultipliedStereoOp(coeffSrcLeft, coeffSrcRight) );
@@ -309,20 +271,333 @@ struct MultiplyAndAddMultipliedOp
 } ;
 
 
-void multiplyAndAddMultiplied( sampleFrame* dst, const sampleFrame* src, float coeffDst, float coeffSrc, int frames )
+static void multiplyAndAddMultiplied( sampleFrame* dst, const sampleFrame* src, float coeffDst, float coeffSrc, int frames )
 {
 	run<>( dst, src, frames, MultiplyAndAddMultipliedOp(coeffDst, coeffSrc) );
 }
 
 
 
+static void volumePanGains( sampleFrame* gains, const float* volBuf, float volume, const float* panBuf, float panning, int frames )
+{
+	for( int f = 0; f < frames; ++f )
+	{
+		const float v = ( volBuf ? volBuf[f] : volume ) * 0.01f;
+		const float p = ( panBuf ? panBuf[f] : panning ) * 0.01f;
+		gains[f][0] = ( p <= 0 ? 1.0f : 1.0f - p ) * v;
+		gains[f][1] = ( p >= 0 ? 1.0f : 1.0f + p ) * v;
+	}
+}
+
+
+static void sumMultipliedByGains( sampleFrame* dst, const sampleFrame* const* srcs, int count, const sampleFrame* gains, int frames )
+{
+	for( int f = 0; f < frames; ++f )
+	{
+		for( int c = 0; c < 2; ++c )
+		{
+			float sum = 0.0f;
+			for( int i = 0; i < count; ++i )
+			{
+				sum += srcs[i][f][c];
+			}
+			dst[f][c] = gains ? sum * gains[f][c] : sum;
+		}
+	}
+}
+
+
+static void quantize( int32_t* dst, const sampleFrame* src, float gain, float scale, const float* dither, int frames )
+{
+	for( int i = 0; i < frames*2; ++i )
+	{
+		// comparisons ordered like SSE min/max, so nans are clipped to 1
+		float y = src[0][i] * gain;
+		y = y < 1.0f ? y : 1.0f;
+		y = ( y > -1.0f ? y : -1.0f ) * scale;
+		if( dither )
+		{
+			y = y + dither[i];
+			y = y < scale ? y : scale;
+			y = y > -scale ? y : -scale;
+		}
+		dst[i] = lrintf( y );
+	}
+}
+
+
+static void convolve( sampleFrame* dst, const sampleFrame* src, const int* offsets, const float* coeffs, int taps, int frames )
+{
+	for( int f = 0; f < frames; ++f )
+	{
+		const sampleFrame* s = src + offsets[f];
+		const float* c = coeffs + f * taps;
+		for( int ch = 0; ch < 2; ++ch )
+		{
+			float lanes[ConvolveLanes] = { };
+			for( int k = 0; k < taps; ++k )
+			{
+				lanes[k % ConvolveLanes] += s[k][ch] * c[k];
+			}
+			dst[f][ch] = ( ( lanes[0] + lanes[1] ) + ( lanes[2] + lanes[3] ) ) +
+					( ( lanes[4] + lanes[5] ) + ( lanes[6] + lanes[7] ) );
+		}
+	}
+}
+
+}
+
+
+
+const Kernels scalarKernels =
+{
+	"scalar",
+	&Scalar::isSilent,
+	&Scalar::sanitize,
+	&Scalar::add,
+	&Scalar::addMultiplied,
+	&Scalar::addSwappedMultiplied,
+	&Scalar::addMultipliedByBuffer,
+	&Scalar::addMultipliedByBuffers,
+	&Scalar::addSanitizedMultiplied,
+	&Scalar::addSanitizedMultipliedByBuffer,
+	&Scalar::addSanitizedMultipliedByBuffers,
+	&Scalar::addMultipliedStereo,
+	&Scalar::multiplyAndAddMultiplied,
+	&Scalar::volumePanGains,
+	&Scalar::sumMultipliedByGains,
+	&Scalar::quantize,
+	&Scalar::convolve
+} ;
+
+
+static const Kernels * kernels( Implementation impl )
+{
+	switch( impl )
+	{
+#ifdef LMMS_HAVE_SIMD_MIXHELPERS
+		case Implementation::SSE2: return &sse2Kernels;
+		case Implementation::AVX2: return &avx2Kernels;
+		case Implementation::AVX512: return &avx512Kernels;
+#endif
+		default: return &scalarKernels;
+	}
+}
+
+
+static Implementation bestImplementation()
+{
+	const Implementation candidates[] = { Implementation::AVX512, Implementation::AVX2, Implementation::SSE2 };
+	for( Implementation impl : candidates )
+	{
+		if( isSupported( impl ) )
+		{
+			return impl;
+		}
+	}
+	return Implementation::Scalar;
+}
+
+
+// Start off with the scalar kernels, so calls from other static
+// initializers work, and switch to the best ones the CPU supports during
+// our own static initialization.
+static Implementation s_implementation = Implementation::Scalar;
+static const Kernels * s_kernels = &scalarKernels;
+
+static const bool s_kernelsDetected = setImplementation( bestImplementation() );
+
+
+
+Implementation implementation()
+{
+	return s_implementation;
+}
+
+bool isSupported( Implementation impl )
+{
+	switch( impl )
+	{
+		case Implementation::Scalar:
+			return true;
+#ifdef LMMS_HAVE_SIMD_MIXHELPERS
+#if defined( __GNUC__ )
+		case Implementation::SSE2:
+			__builtin_cpu_init();
+			return __builtin_cpu_supports( "sse2" );
+		case Implementation::AVX2:
+			__builtin_cpu_init();
+			return __builtin_cpu_supports( "avx2" );
+		case Implementation::AVX512:
+			__builtin_cpu_init();
+			return __builtin_cpu_supports( "avx512f" );
+#endif
+#endif
+		default:
+			return false;
+	}
+}
+
+bool setImplementation( Implementation impl )
+{
+	if( !isSupported( impl ) )
+	{
+		return false;
+	}
+	s_implementation = impl;
+	s_kernels = kernels( impl );
+	return true;
+}
+
+const char * implementationName( Implementation impl )
+{
+	return kernels( impl )->name;
+}
+
+
+
+bool isSilent( const sampleFrame* src, int frames )
+{
+	return s_kernels->isSilent( src, frames );
+}
+
+bool useNaNHandler()
+{
+	return s_NaNHandler;
+}
+
+void setNaNHandler( bool use )
+{
+	s_NaNHandler = use;
+}
+
+/*! \brief Function for sanitizing a buffer of infs/nans - returns true if those are found */
+bool sanitize( sampleFrame * src, int frames )
+{
+	if( !useNaNHandler() )
+	{
+		return false;
+	}
+
+	const bool found = s_kernels->sanitize( src, frames );
+#ifdef LMMS_DEBUG
+	if( found )
+	{
+		printf( "Bad data, clearing buffer.\n" );
+	}
+#endif
+	return found;
+}
+
+
+void add( sampleFrame* dst, const sampleFrame* src, int frames )
+{
+	s_kernels->add( dst, src, frames );
+}
+
+
+void addMultiplied( sampleFrame* dst, const sampleFrame* src, float coeffSrc, int frames )
+{
+	s_kernels->addMultiplied( dst, src, coeffSrc, frames );
+}
+
+
+void addSwappedMultiplied( sampleFrame* dst, const sampleFrame* src, float coeffSrc, int frames )
+{
+	s_kernels->addSwappedMultiplied( dst, src, coeffSrc, frames );
+}
+
+
+void addMultipliedByBuffer( sampleFrame* dst, const sampleFrame* src, float coeffSrc, ValueBuffer * coeffSrcBuf, int frames )
+{
+	s_kernels->addMultipliedByBuffer( dst, src, coeffSrc, coeffSrcBuf->values(), frames );
+}
+
+void addMultipliedByBuffers( sampleFrame* dst, const sampleFrame* src, ValueBuffer * coeffSrcBuf1, ValueBuffer * coeffSrcBuf2, int frames )
+{
+	s_kernels->addMultipliedByBuffers( dst, src, coeffSrcBuf1->values(), coeffSrcBuf2->values(), frames );
+}
+
+void addSanitizedMultipliedByBuffer( sampleFrame* dst, const sampleFrame* src, float coeffSrc, ValueBuffer * coeffSrcBuf, int frames )
+{
+	if ( !useNaNHandler() )
+	{
+		addMultipliedByBuffer( dst, src, coeffSrc, coeffSrcBuf,
+								frames );
+		return;
+	}
+
+	s_kernels->addSanitizedMultipliedByBuffer( dst, src, coeffSrc, coeffSrcBuf->values(), frames );
+}
+
+void addSanitizedMultipliedByBuffers( sampleFrame* dst, const sampleFrame* src, ValueBuffer * coeffSrcBuf1, ValueBuffer * coeffSrcBuf2, int frames )
+{
+	if ( !useNaNHandler() )
+	{
+		addMultipliedByBuffers( dst, src, coeffSrcBuf1, coeffSrcBuf2,
+								frames );
+		return;
+	}
+
+	s_kernels->addSanitizedMultipliedByBuffers( dst, src, coeffSrcBuf1->values(), coeffSrcBuf2->values(), frames );
+}
+
+void addSanitizedMultiplied( sampleFrame* dst, const sampleFrame* src, float coeffSrc, int frames )
+{
+	if ( !useNaNHandler() )
+	{
+		addMultiplied( dst, src, coeffSrc, frames );
+		return;
+	}
+
+	s_kernels->addSanitizedMultiplied( dst, src, coeffSrc, frames );
+}
+
+
+void addMultipliedStereo( sampleFrame* dst, const sampleFrame* src, float coeffSrcLeft, float coeffSrcRight, int frames )
+{
+	s_kernels->addMultipliedStereo( dst, src, coeffSrcLeft, coeffSrcRight, frames );
+}
+
+
+void multiplyAndAddMultiplied( sampleFrame* dst, const sampleFrame* src, float coeffDst, float coeffSrc, int frames )
+{
+	s_kernels->multiplyAndAddMultiplied( dst, src, coeffDst, coeffSrc, frames );
+}
+
+
+void volumePanGains( sampleFrame* gains, const ValueBuffer * volBuf, float volume, const ValueBuffer * panBuf, float panning, int frames )
+{
+	s_kernels->volumePanGains( gains, volBuf ? volBuf->values() : NULL, volume,
+					panBuf ? panBuf->values() : NULL, panning, frames );
+}
+
+
+void sumMultipliedByGains( sampleFrame* dst, const sampleFrame* const* srcs, int count, const sampleFrame* gains, int frames )
+{
+	s_kernels->sumMultipliedByGains( dst, srcs, count, gains, frames );
+}
+
+
+void quantize( int32_t* dst, const sampleFrame* src, float gain, float scale, const float* dither, int frames )
+{
+	s_kernels->quantize( dst, src, gain, scale, dither, frames );
+}
+
+
+void convolve( sampleFrame* dst, const sampleFrame* src, const int* offsets, const float* coeffs, int taps, int frames )
+{
+	s_kernels->convolve( dst, src, offsets, coeffs, taps, frames );
+}
+
+
+
 void multiplyAndAddMultipliedJoined( sampleFrame* dst,
 										const sample_t* srcLeft,
 										const sample_t* srcRight,
 										float coeffDst, float coeffSrc, int frames )
 {
-	run<>( dst, srcLeft, srcRight, frames, MultiplyAndAddMultipliedOp(coeffDst, coeffSrc) );
+	run<>( dst, srcLeft, srcRight, frames, Scalar::MultiplyAndAddMultipliedOp(coeffDst, coeffSrc) );
 }
 
 }
-
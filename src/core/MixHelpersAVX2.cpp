@@ -0,0 +1,88 @@
+/*
+ * MixHelpersAVX2.cpp - MixHelpers kernels for AVX2
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+
+#include <immintrin.h>
+
+#include "MixHelpersKernels.h"
+
+
+namespace
+{
+
+struct Avx2
+{
+	typedef __m256 Vec;
+	static const int Width = 8;
+
+	static inline Vec load( const float* p ) { return _mm256_loadu_ps( p ); }
+	static inline void store( float* p, Vec v ) { _mm256_storeu_ps( p, v ); }
+	static inline Vec set1( float x ) { return _mm256_set1_ps( x ); }
+	static inline Vec set2( float left, float right )
+	{
+		return _mm256_setr_ps( left, right, left, right, left, right, left, right );
+	}
+
+	//! Load one value per frame, i.e. duplicate it for both channels
+	static inline Vec loadPerFrame( const float* p )
+	{
+		const __m256i index = _mm256_setr_epi32( 0, 0, 1, 1, 2, 2, 3, 3 );
+		return _mm256_permutevar8x32_ps( _mm256_castps128_ps256( _mm_loadu_ps( p ) ), index );
+	}
+
+	static inline Vec add( Vec a, Vec b ) { return _mm256_add_ps( a, b ); }
+	static inline Vec sub( Vec a, Vec b ) { return _mm256_sub_ps( a, b ); }
+	static inline Vec mul( Vec a, Vec b ) { return _mm256_mul_ps( a, b ); }
+	static inline Vec min( Vec a, Vec b ) { return _mm256_min_ps( a, b ); }
+	static inline Vec max( Vec a, Vec b ) { return _mm256_max_ps( a, b ); }
+	static inline Vec abs( Vec a ) { return _mm256_and_ps( a, _mm256_castsi256_ps( _mm256_set1_epi32( 0x7fffffff ) ) ); }
+	static inline Vec swapChannels( Vec a ) { return _mm256_permute_ps( a, 0xB1 ); }
+
+	//! Round to nearest (even) and store as integers
+	static inline void storeInt( int32_t* p, Vec v )
+	{
+		_mm256_storeu_si256( reinterpret_cast<__m256i*>( p ), _mm256_cvtps_epi32( v ) );
+	}
+	static inline int32_t roundToInt( float x ) { return _mm_cvtss_si32( _mm_set_ss( x ) ); }
+
+	static inline Vec finiteMask( Vec a )
+	{
+		return _mm256_cmp_ps( abs( a ), _mm256_set1_ps( __builtin_inff() ), _CMP_LT_OQ );
+	}
+
+	static inline bool allFinite( Vec a ) { return _mm256_movemask_ps( finiteMask( a ) ) == 0xFF; }
+	static inline bool anyGreaterEqual( Vec a, Vec b ) { return _mm256_movemask_ps( _mm256_cmp_ps( a, b, _CMP_GE_OQ ) ) != 0; }
+
+	//! y where x is finite, 0 elsewhere
+	static inline Vec zeroNonFinite( Vec x, Vec y ) { return _mm256_and_ps( finiteMask( x ), y ); }
+} ;
+
+}
+
+
+namespace MixHelpers
+{
+
+const Kernels avx2Kernels = VectorKernels<Avx2>::table( "AVX2" );
+
+}
@@ -0,0 +1,90 @@
+/*
+ * MixHelpersAVX512.cpp - MixHelpers kernels for AVX-512
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+
+#include <immintrin.h>
+
+#include "MixHelpersKernels.h"
+
+
+namespace
+{
+
+struct Avx512
+{
+	typedef __m512 Vec;
+	static const int Width = 16;
+
+	static inline Vec load( const float* p ) { return _mm512_loadu_ps( p ); }
+	static inline void store( float* p, Vec v ) { _mm512_storeu_ps( p, v ); }
+	static inline Vec set1( float x ) { return _mm512_set1_ps( x ); }
+	static inline Vec set2( float left, float right )
+	{
+		return _mm512_setr_ps( left, right, left, right, left, right, left, right,
+					left, right, left, right, left, right, left, right );
+	}
+
+	//! Load one value per frame, i.e. duplicate it for both channels
+	static inline Vec loadPerFrame( const float* p )
+	{
+		const __m512i index = _mm512_setr_epi32( 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7 );
+		return _mm512_permutexvar_ps( index, _mm512_castps256_ps512( _mm256_loadu_ps( p ) ) );
+	}
+
+	static inline Vec add( Vec a, Vec b ) { return _mm512_add_ps( a, b ); }
+	static inline Vec sub( Vec a, Vec b ) { return _mm512_sub_ps( a, b ); }
+	static inline Vec mul( Vec a, Vec b ) { return _mm512_mul_ps( a, b ); }
+	static inline Vec min( Vec a, Vec b ) { return _mm512_min_ps( a, b ); }
+	static inline Vec max( Vec a, Vec b ) { return _mm512_max_ps( a, b ); }
+	// _mm512_and_ps needs AVX512DQ, so go through the integer unit
+	static inline Vec abs( Vec a )
+	{
+		return _mm512_castsi512_ps( _mm512_and_si512( _mm512_castps_si512( a ), _mm512_set1_epi32( 0x7fffffff ) ) );
+	}
+	static inline Vec swapChannels( Vec a ) { return _mm512_permute_ps( a, 0xB1 ); }
+
+	//! Round to nearest (even) and store as integers
+	static inline void storeInt( int32_t* p, Vec v ) { _mm512_storeu_si512( p, _mm512_cvtps_epi32( v ) ); }
+	static inline int32_t roundToInt( float x ) { return _mm_cvtss_si32( _mm_set_ss( x ) ); }
+
+	static inline __mmask16 finiteMask( Vec a )
+	{
+		return _mm512_cmp_ps_mask( abs( a ), _mm512_set1_ps( __builtin_inff() ), _CMP_LT_OQ );
+	}
+
+	static inline bool allFinite( Vec a ) { return finiteMask( a ) == 0xFFFF; }
+	static inline bool anyGreaterEqual( Vec a, Vec b ) { return _mm512_cmp_ps_mask( a, b, _CMP_GE_OQ ) != 0; }
+
+	//! y where x is finite, 0 elsewhere
+	static inline Vec zeroNonFinite( Vec x, Vec y ) { return _mm512_maskz_mov_ps( finiteMask( x ), y ); }
+} ;
+
+}
+
+
+namespace MixHelpers
+{
+
+const Kernels avx512Kernels = VectorKernels<Avx512>::table( "AVX-512" );
+
+}
@@ -0,0 +1,82 @@
+/*
+ * MixHelpersSSE2.cpp - MixHelpers kernels for SSE2
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+
+#include <emmintrin.h>
+
+#include "MixHelpersKernels.h"
+
+
+namespace
+{
+
+struct Sse2
+{
+	typedef __m128 Vec;
+	static const int Width = 4;
+
+	static inline Vec load( const float* p ) { return _mm_loadu_ps( p ); }
+	static inline void store( float* p, Vec v ) { _mm_storeu_ps( p, v ); }
+	static inline Vec set1( float x ) { return _mm_set1_ps( x ); }
+	static inline Vec set2( float left, float right ) { return _mm_setr_ps( left, right, left, right ); }
+
+	//! Load one value per frame, i.e. duplicate it for both channels
+	static inline Vec loadPerFrame( const float* p )
+	{
+		const Vec v = _mm_castpd_ps( _mm_load_sd( reinterpret_cast<const double*>( p ) ) );
+		return _mm_unpacklo_ps( v, v );
+	}
+
+	static inline Vec add( Vec a, Vec b ) { return _mm_add_ps( a, b ); }
+	static inline Vec sub( Vec a, Vec b ) { return _mm_sub_ps( a, b ); }
+	static inline Vec mul( Vec a, Vec b ) { return _mm_mul_ps( a, b ); }
+	static inline Vec min( Vec a, Vec b ) { return _mm_min_ps( a, b ); }
+	static inline Vec max( Vec a, Vec b ) { return _mm_max_ps( a, b ); }
+	static inline Vec abs( Vec a ) { return _mm_and_ps( a, _mm_castsi128_ps( _mm_set1_epi32( 0x7fffffff ) ) ); }
+	static inline Vec swapChannels( Vec a ) { return _mm_shuffle_ps( a, a, 0xB1 ); }
+
+	//! Round to nearest (even) and store as integers
+	static inline void storeInt( int32_t* p, Vec v ) { _mm_storeu_si128( reinterpret_cast<__m128i*>( p ), _mm_cvtps_epi32( v ) ); }
+	static inline int32_t roundToInt( float x ) { return _mm_cvtss_si32( _mm_set_ss( x ) ); }
+
+	static inline Vec finiteMask( Vec a )
+	{
+		return _mm_cmplt_ps( abs( a ), _mm_set1_ps( __builtin_inff() ) );
+	}
+
+	static inline bool allFinite( Vec a ) { return _mm_movemask_ps( finiteMask( a ) ) == 0xF; }
+	static inline bool anyGreaterEqual( Vec a, Vec b ) { return _mm_movemask_ps( _mm_cmpge_ps( a, b ) ) != 0; }
+
+	//! y where x is finite, 0 elsewhere
+	static inline Vec zeroNonFinite( Vec x, Vec y ) { return _mm_and_ps( finiteMask( x ), y ); }
+} ;
+
+}
+
+
+namespace MixHelpers
+{
+
+const Kernels sse2Kernels = VectorKernels<Sse2>::table( "SSE2" );
+
+}
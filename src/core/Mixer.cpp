@@ -29,9 +29,15 @@
 #include "lmmsconfig.h"
 
 #include "AudioPort.h"
+#include "DeterministicRender.h"
 #include "FxMixer.h"
 #include "MixerWorkerThread.h"
+#include "PeriodArena.h"
+#include "PeriodFifo.h"
+#include "PerfTrace.h"
+#include "RenderGraph.h"
 #include "Song.h"
+#include "ThreadPolicy.h"
 #include "EnvelopeAndLfoParameters.h"
 #include "NotePlayHandle.h"
 #include "ConfigManager.h"
@@ -78,6 +84,7 @@ Mixer::Mixer( bool renderOnly ) :
 	m_writeBuf( NULL ),
 	m_workers(),
 	m_numWorkers( QThread::idealThreadCount()-1 ),
+	m_renderGraph( NULL ),
 	m_newPlayHandles( PlayHandle::MaxNumber ),
 	m_qualitySettings( qualitySettings::Mode_Draft ),
 	m_masterGain( 1.0f ),
@@ -131,7 +138,26 @@ Mixer::Mixer( bool renderOnly ) :
 	}
 
 	// allocte the FIFO from the determined size
-	m_fifo = new fifo( fifoSize );
+	m_fifo = new PeriodFifo( fifoSize, m_framesPerPeriod );
+
+	// Hidden setting: assert on heap allocations while rendering (only
+	// in debug builds)
+	PeriodArena::setAllocationCheck( ConfigManager::inst()->value(
+				"mixer", "checkallocations" ).toInt() );
+
+	// render the same project to the same samples every time, see
+	// DeterministicRender - --deterministic enables it for the session
+	if( ConfigManager::inst()->value( "mixer", "deterministic" ).toInt() )
+	{
+		DeterministicRender::setEnabled( true );
+	}
+
+	// Hidden setting: process play handles, audio ports and FX channels
+	// as one dependency graph instead of three separate stages
+	if( ConfigManager::inst()->value( "mixer", "rendergraph" ).toInt() )
+	{
+		m_renderGraph = new RenderGraph;
+	}
 
 	// now that framesPerPeriod is fixed initialize global BufferManager
 	BufferManager::init( m_framesPerPeriod );
@@ -146,6 +172,8 @@ Mixer::Mixer( bool renderOnly ) :
 		m_bufferPool.push_back( m_readBuf );
 	}
 
+	ThreadPolicy::init();
+
 	for( int i = 0; i < m_numWorkers+1; ++i )
 	{
 		MixerWorkerThread * wt = new MixerWorkerThread( this );
@@ -180,15 +208,13 @@ Mixer::~Mixer()
 		m_workers[w]->wait( 500 );
 	}
 
-	while( m_fifo->available() )
-	{
-		delete[] m_fifo->read();
-	}
 	delete m_fifo;
 
 	delete m_midiClient;
 	delete m_audioDev;
 
+	delete m_renderGraph;
+
 	for( int i = 0; i < 3; i++ )
 	{
 		MemoryHelper::alignedFree( m_bufferPool[i] );
@@ -341,9 +367,12 @@ void Mixer::pushInputFrames( sampleFrame * _ab, const f_cnt_t _frames )
 
 const surroundSampleFrame * Mixer::renderNextBuffer()
 {
+	PerfTrace::Span span( "Mixer::renderNextBuffer" );
 	m_profiler.startPeriod();
 
 	s_renderingThread = true;
+	PeriodArena::markAudioThread();
+	PeriodArena::startPeriod();
 
 	static Song::PlayPos last_metro_pos = -1;
 
@@ -388,26 +417,24 @@ const surroundSampleFrame * Mixer::renderNextBuffer()
 	}
 
 	// remove all play-handles that have to be deleted and delete
-	// them if they still exist...
-	// maybe this algorithm could be optimized...
-	ConstPlayHandleList::Iterator it_rem = m_playHandlesToRemove.begin();
-	while( it_rem != m_playHandlesToRemove.end() )
+	// them if they still exist - first unregister all of them, as the
+	// list may contain a handle more than once
+	for( ConstPlayHandleList::Iterator it = m_playHandlesToRemove.begin();
+					it != m_playHandlesToRemove.end(); ++it )
 	{
-		PlayHandleList::Iterator it = std::find( m_playHandles.begin(), m_playHandles.end(), *it_rem );
-
-		if( it != m_playHandles.end() )
+		if( !m_playHandles.remove( *it ) )
 		{
-			( *it )->audioPort()->removePlayHandle( ( *it ) );
-			if( ( *it )->type() == PlayHandle::TypeNotePlayHandle )
-			{
-				NotePlayHandleManager::release( (NotePlayHandle*) *it );
-			}
-			else delete *it;
-			m_playHandles.erase( it );
+			*it = NULL;
 		}
-
-		it_rem = m_playHandlesToRemove.erase( it_rem );
 	}
+	for( const PlayHandle * handle : m_playHandlesToRemove )
+	{
+		if( handle )
+		{
+			deletePlayHandle( const_cast<PlayHandle *>( handle ) );
+		}
+	}
+	m_playHandlesToRemove.clear();
 
 	// rotate buffers
 	m_writeBuffer = ( m_writeBuffer + 1 ) % m_poolDepth;
@@ -423,61 +450,67 @@ const surroundSampleFrame * Mixer::renderNextBuffer()
 	FxMixer * fxMixer = Engine::fxMixer();
 	fxMixer->prepareMasterMix();
 
+	// the random generator of this thread is in whatever state the last
+	// job processed here left it
+	DeterministicRender::seedJob( 0 );
+
 	// create play-handles for new notes, samples etc.
-	song->processNextBuffer();
+	{
+		PerfTrace::Span span( "Song::processNextBuffer" );
+		song->processNextBuffer();
+	}
 
 	// add all play-handles that have to be added
 	for( LocklessListElement * e = m_newPlayHandles.popList(); e; )
 	{
-		m_playHandles += e->value;
+		m_playHandles.add( e->value );
 		LocklessListElement * next = e->next;
 		m_newPlayHandles.free( e );
 		e = next;
 	}
 
-	// STAGE 1: run and render all play handles
-	MixerWorkerThread::fillJobQueue<PlayHandleList>( m_playHandles );
-	MixerWorkerThread::startAndWaitForJobs();
+	if( m_renderGraph )
+	{
+		// STAGES 1-3 fused: each play handle, audio port and FX channel
+		// is processed as soon as all of its inputs are done
+		PerfTrace::Span span( "RenderGraph::render" );
+		m_renderGraph->render( m_playHandles, m_audioPorts, m_writeBuf );
 
-	// removed all play handles which are done
-	for( PlayHandleList::Iterator it = m_playHandles.begin();
-						it != m_playHandles.end(); )
+		removeFinishedPlayHandles();
+	}
+	else
 	{
-		if( ( *it )->affinityMatters() &&
-			( *it )->affinity() != QThread::currentThread() )
+		// STAGE 1: run and render all play handles
 		{
-			++it;
-			continue;
+			PerfTrace::Span span( "Play handles" );
+			MixerWorkerThread::resetJobQueue();
+			m_playHandles.queueJobs();
+			MixerWorkerThread::startAndWaitForJobs();
 		}
-		if( ( *it )->isFinished() )
-		{
-			( *it )->audioPort()->removePlayHandle( ( *it ) );
-			if( ( *it )->type() == PlayHandle::TypeNotePlayHandle )
-			{
-				NotePlayHandleManager::release( (NotePlayHandle*) *it );
-			}
-			else delete *it;
-			it = m_playHandles.erase( it );
-		}
-		else
+
+		// removed all play handles which are done
+		removeFinishedPlayHandles();
+
+		// STAGE 2: process effects of all instrument- and sampletracks
 		{
-			++it;
+			PerfTrace::Span span( "Audio ports" );
+			MixerWorkerThread::fillJobQueue<QVector<AudioPort *> >( m_audioPorts );
+			MixerWorkerThread::startAndWaitForJobs();
 		}
-	}
-
-	// STAGE 2: process effects of all instrument- and sampletracks
-	MixerWorkerThread::fillJobQueue<QVector<AudioPort *> >( m_audioPorts );
-	MixerWorkerThread::startAndWaitForJobs();
 
 
-	// STAGE 3: do master mix in FX mixer
-	fxMixer->masterMix( m_writeBuf );
+		// STAGE 3: do master mix in FX mixer
+		PerfTrace::Span span( "FxMixer::masterMix" );
+		fxMixer->masterMix( m_writeBuf );
+	}
 
 
 	emit nextAudioBuffer( m_readBuf );
 
 	runChangesInModel();
 
+	DeterministicRender::seedJob( 0 );
+
 	// and trigger LFOs
 	EnvelopeAndLfoParameters::instances()->trigger();
 	Controller::triggerFrameCounter();
@@ -487,12 +520,74 @@ const surroundSampleFrame * Mixer::renderNextBuffer()
 
 	m_profiler.finishPeriod( processingSampleRate(), m_framesPerPeriod );
 
+	// all scratch memory of this period may be reused now
+	PeriodArena::finishPeriod();
+
+	DeterministicRender::nextPeriod();
+
 	return m_readBuf;
 }
 
 
 
 
+const surroundSampleFrame * Mixer::nextBuffer()
+{
+	if( !hasFifoWriter() )
+	{
+		return renderNextBuffer();
+	}
+
+	bool underrun;
+	const surroundSampleFrame * b = m_fifo->read( underrun );
+	if( underrun )
+	{
+		m_profiler.reportUnderrun();
+	}
+	return b;
+}
+
+
+
+
+void Mixer::removeFinishedPlayHandles()
+{
+	// only the hot fields of the registry are scanned here, finished
+	// handles are the only ones we have to touch
+	const QThread * currentThread = QThread::currentThread();
+	for( int slot = 0; slot < m_playHandles.slots(); ++slot )
+	{
+		PlayHandle * handle = m_playHandles.at( slot );
+		if( handle == NULL || !m_playHandles.isFinished( slot ) ||
+			( m_playHandles.affinity( slot ) &&
+				m_playHandles.affinity( slot ) != currentThread ) )
+		{
+			continue;
+		}
+		m_playHandles.removeSlot( slot );
+		deletePlayHandle( handle );
+	}
+
+	// the only compaction per period
+	m_playHandles.compact();
+}
+
+
+
+
+void Mixer::deletePlayHandle( PlayHandle * handle )
+{
+	handle->audioPort()->removePlayHandle( handle );
+	if( handle->type() == PlayHandle::TypeNotePlayHandle )
+	{
+		NotePlayHandleManager::release( (NotePlayHandle*) handle );
+	}
+	else delete handle;
+}
+
+
+
+
 void Mixer::clear()
 {
 	m_clearSignal = true;
@@ -520,13 +615,14 @@ void Mixer::clearNewPlayHandles()
 void Mixer::clearInternal()
 {
 	// TODO: m_midiClient->noteOffAll();
-	for( PlayHandleList::Iterator it = m_playHandles.begin(); it != m_playHandles.end(); ++it )
+	for( int slot = 0; slot < m_playHandles.slots(); ++slot )
 	{
 		// we must not delete instrument-play-handles as they exist
 		// during the whole lifetime of an instrument
-		if( ( *it )->type() != PlayHandle::TypeInstrumentPlayHandle )
+		if( m_playHandles.at( slot ) &&
+			m_playHandles.type( slot ) != PlayHandle::TypeInstrumentPlayHandle )
 		{
-			m_playHandlesToRemove.push_back( *it );
+			m_playHandlesToRemove.push_back( m_playHandles.at( slot ) );
 		}
 	}
 }
@@ -674,10 +770,22 @@ void Mixer::removeAudioPort( AudioPort * _port )
 	{
 		m_audioPorts.erase( it );
 	}
+	invalidateRenderGraph();
 	doneChangeInModel();
 }
 
 
+
+
+void Mixer::invalidateRenderGraph()
+{
+	if( m_renderGraph )
+	{
+		m_renderGraph->invalidate();
+	}
+}
+
+
 bool Mixer::addPlayHandle( PlayHandle* handle )
 {
 	if( criticalXRuns() == false )
@@ -728,11 +836,8 @@ void Mixer::removePlayHandle( PlayHandle * _ph )
 			}
 		}
 		// Now check m_playHandles
-		PlayHandleList::Iterator it = std::find( m_playHandles.begin(),
-					m_playHandles.end(), _ph );
-		if( it != m_playHandles.end() )
+		if( m_playHandles.remove( _ph ) )
 		{
-			m_playHandles.erase( it );
 			removedFromList = true;
 		}
 		// Only deleting PlayHandles that were actually found in the list
@@ -740,6 +845,8 @@ void Mixer::removePlayHandle( PlayHandle * _ph )
 		// (See tobydox's 2008 commit 4583e48)
 		if ( removedFromList )
 		{
+			// it may have been queued for removal in another thread
+			m_playHandlesToRemove.removeAll( _ph );
 			if( _ph->type() == PlayHandle::TypeNotePlayHandle )
 			{
 				NotePlayHandleManager::release( (NotePlayHandle*) _ph );
@@ -760,22 +867,15 @@ void Mixer::removePlayHandle( PlayHandle * _ph )
 void Mixer::removePlayHandlesOfTypes( Track * _track, const quint8 types )
 {
 	requestChangeInModel();
-	PlayHandleList::Iterator it = m_playHandles.begin();
-	while( it != m_playHandles.end() )
+	for( int slot = 0; slot < m_playHandles.slots(); ++slot )
 	{
-		if( ( *it )->isFromTrack( _track ) && ( ( *it )->type() & types ) )
-		{
-			( *it )->audioPort()->removePlayHandle( ( *it ) );
-			if( ( *it )->type() == PlayHandle::TypeNotePlayHandle )
-			{
-				NotePlayHandleManager::release( (NotePlayHandle*) *it );
-			}
-			else delete *it;
-			it = m_playHandles.erase( it );
-		}
-		else
+		PlayHandle * handle = m_playHandles.at( slot );
+		if( handle && ( m_playHandles.type( slot ) & types ) &&
+						handle->isFromTrack( _track ) )
 		{
-			++it;
+			m_playHandles.removeSlot( slot );
+			m_playHandlesToRemove.removeAll( handle );
+			deletePlayHandle( handle );
 		}
 	}
 	doneChangeInModel();
@@ -1223,7 +1323,7 @@ MidiClient * Mixer::tryMidiClients()
 
 
 
-Mixer::fifoWriter::fifoWriter( Mixer* mixer, fifo * _fifo ) :
+Mixer::fifoWriter::fifoWriter( Mixer* mixer, PeriodFifo * _fifo ) :
 	m_mixer( mixer ),
 	m_fifo( _fifo ),
 	m_writing( true )
@@ -1246,24 +1346,11 @@ void Mixer::fifoWriter::run()
 {
 	disable_denormals();
 
-#if 0
-#if defined(LMMS_BUILD_LINUX) || defined(LMMS_BUILD_FREEBSD)
-#ifdef LMMS_HAVE_SCHED_H
-	cpu_set_t mask;
-	CPU_ZERO( &mask );
-	CPU_SET( 0, &mask );
-	sched_setaffinity( 0, sizeof( mask ), &mask );
-#endif
-#endif
-#endif
+	ThreadPolicy::apply( "Mixer", 0 );
 
-	const fpp_t frames = m_mixer->framesPerPeriod();
 	while( m_writing )
 	{
-		surroundSampleFrame * buffer = new surroundSampleFrame[frames];
-		const surroundSampleFrame * b = m_mixer->renderNextBuffer();
-		memcpy( buffer, b, frames * sizeof( surroundSampleFrame ) );
-		write( buffer );
+		write( m_mixer->renderNextBuffer() );
 	}
 
 	// Let audio backend stop processing
@@ -1274,14 +1361,21 @@ void Mixer::fifoWriter::run()
 
 
 
-void Mixer::fifoWriter::write( surroundSampleFrame * buffer )
+void Mixer::fifoWriter::write( const surroundSampleFrame * buffer )
 {
 	m_mixer->m_waitChangesMutex.lock();
 	m_mixer->m_waitingForWrite = true;
 	m_mixer->m_waitChangesMutex.unlock();
 	m_mixer->runChangesInModel();
 
-	m_fifo->write( buffer );
+	// the device should take a period at least every period, give it some
+	// slack before counting an overrun
+	const int maxWait = 2 * 1000000 * m_mixer->framesPerPeriod() /
+					m_mixer->processingSampleRate();
+	if( !m_fifo->write( buffer, maxWait ) )
+	{
+		m_mixer->m_profiler.reportOverrun();
+	}
 
 	m_mixer->m_doChangesMutex.lock();
 	m_mixer->m_waitingForWrite = false;
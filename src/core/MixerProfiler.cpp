@@ -24,11 +24,46 @@
 
 #include "MixerProfiler.h"
 
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <algorithm>
+
+#include "Effect.h"
+#include "FxMixer.h"
+#include "Instrument.h"
+#include "InstrumentTrack.h"
+#include "PlayHandle.h"
+
+
+// number of periods the statistics are computed from, unless all of them
+// are kept for a report - nodes not seen for that long are dropped
+const int HISTORY_LENGTH = 1024;
+
+static std::atomic_int s_profilerCount( 0 );
+
+thread_local MixerProfiler::ThreadLog * MixerProfiler::s_threadLog = NULL;
+thread_local int MixerProfiler::s_threadLogOwner = -1;
+
 
 MixerProfiler::MixerProfiler() :
 	m_periodTimer(),
 	m_cpuLoad( 0 ),
-	m_outputFile()
+	m_outputFile(),
+	m_reportFormat( NoReport ),
+	m_underruns( 0 ),
+	m_overruns( 0 ),
+	m_writtenUnderruns( 0 ),
+	m_writtenOverruns( 0 ),
+	m_skippedWork( 0 ),
+	m_lastSkippedWork( 0 ),
+	m_id( s_profilerCount++ ),
+	m_nodeProfilingUsers( 0 ),
+	m_keepAllPeriods( false ),
+	m_periodLength( 0 ),
+	m_lastNodeId( 0 )
 {
 }
 
@@ -36,6 +71,15 @@ MixerProfiler::MixerProfiler() :
 
 MixerProfiler::~MixerProfiler()
 {
+	if( m_outputFile.isOpen() && m_reportFormat != NoReport )
+	{
+		writeReport();
+	}
+
+	for( ThreadLog * log : m_threadLogs )
+	{
+		delete log;
+	}
 }
 
 
@@ -46,9 +90,30 @@ void MixerProfiler::finishPeriod( sample_rate_t sampleRate, fpp_t framesPerPerio
 	const float newCpuLoad = periodElapsed / 10000.0f * sampleRate / framesPerPeriod;
     m_cpuLoad = qBound<int>( 0, ( newCpuLoad * 0.1f + m_cpuLoad * 0.9f ), 100 );
 
-	if( m_outputFile.isOpen() )
+	m_lastSkippedWork = m_skippedWork.exchange( 0, std::memory_order_relaxed );
+	m_periodLength = framesPerPeriod * 1000000.0f / sampleRate;
+
+	if( nodeProfiling() )
 	{
-		m_outputFile.write( QString( "%1\n" ).arg( periodElapsed ).toLatin1() );
+		collectNodeTimes( periodElapsed * qint64( 1000 ) );
+	}
+	else
+	{
+		// probes which started before profiling was disabled still
+		// recorded - their nodes may be gone once it gets enabled again
+		dropNodeTimes();
+	}
+
+	if( m_outputFile.isOpen() && m_reportFormat == NoReport )
+	{
+		// along with the underruns and overruns since the last period
+		const int underruns = m_underruns;
+		const int overruns = m_overruns;
+		m_outputFile.write( QString( "%1 %2 %3\n" ).arg( periodElapsed ).
+					arg( underruns - m_writtenUnderruns ).
+					arg( overruns - m_writtenOverruns ).toLatin1() );
+		m_writtenUnderruns = underruns;
+		m_writtenOverruns = overruns;
 	}
 }
 
@@ -59,5 +124,281 @@ void MixerProfiler::setOutputFile( const QString& outputFile )
 	m_outputFile.close();
 	m_outputFile.setFileName( outputFile );
 	m_outputFile.open( QFile::WriteOnly | QFile::Truncate );
+
+	const QString suffix = QFileInfo( outputFile ).suffix().toLower();
+	if( suffix == "csv" || suffix == "json" )
+	{
+		if( m_reportFormat == NoReport )
+		{
+			enableNodeProfiling( true );
+		}
+		m_reportFormat = suffix == "csv" ? CsvReport : JsonReport;
+		QMutexLocker lock( &m_statsMutex );
+		m_keepAllPeriods = true;
+	}
+}
+
+
+
+void MixerProfiler::enableNodeProfiling( bool enable )
+{
+	m_nodeProfilingUsers.fetch_add( enable ? 1 : -1 );
+}
+
+
+
+QVector<MixerProfiler::NodeStats> MixerProfiler::nodeStats() const
+{
+	// copy the histories, so the audio thread isn't kept waiting while
+	// they are sorted
+	QVector<NodeHistory> nodes;
+	{
+		QMutexLocker lock( &m_statsMutex );
+		nodes.reserve( m_nodes.size() + m_retiredNodes.size() );
+		for( const NodeHistory & node : m_nodes )
+		{
+			nodes.append( node );
+		}
+		nodes += m_retiredNodes;
+	}
+
+	QVector<NodeStats> stats;
+	stats.reserve( nodes.size() );
+	for( const NodeHistory & node : nodes )
+	{
+		stats.append( statsOf( node ) );
+	}
+	return stats;
+}
+
+
+
+const char * MixerProfiler::nodeTypeName( NodeType type )
+{
+	switch( type )
+	{
+		case NodeType::PlayHandle: return "playhandle";
+		case NodeType::Instrument: return "instrument";
+		case NodeType::Effect: return "effect";
+		case NodeType::FxChannel: return "fxchannel";
+		case NodeType::Total: return "total";
+	}
+	return "";
+}
+
+
+
+void MixerProfiler::record( NodeType type, const void * node, qint64 nanoseconds )
+{
+	if( s_threadLogOwner != m_id )
+	{
+		// first sample of this thread
+		s_threadLog = new ThreadLog;
+		s_threadLog->samples.reserve( 1024 );
+		s_threadLogOwner = m_id;
+
+		QMutexLocker lock( &m_logsMutex );
+		m_threadLogs.push_back( s_threadLog );
+	}
+
+	s_threadLog->samples.push_back( Sample{ type, node, nanoseconds } );
 }
 
+
+
+void MixerProfiler::collectNodeTimes( qint64 periodNanoseconds )
+{
+	QMutexLocker statsLock( &m_statsMutex );
+
+	{
+		QMutexLocker logsLock( &m_logsMutex );
+		for( ThreadLog * log : m_threadLogs )
+		{
+			for( const Sample & sample : log->samples )
+			{
+				NodeHistory & node = m_nodes[NodeKey( static_cast<int>( sample.type ), sample.node )];
+				if( node.name.isNull() )
+				{
+					// a new node, which still exists as we're
+					// at the end of the period it was seen in
+					node.type = sample.type;
+					node.name = nodeName( sample.type, sample.node );
+					node.id = ++m_lastNodeId;
+				}
+				node.current += sample.nanoseconds;
+				node.seen = true;
+			}
+			log->samples.clear();
+		}
+	}
+
+	NodeHistory & total = m_nodes[NodeKey( static_cast<int>( NodeType::Total ), NULL )];
+	if( total.name.isNull() )
+	{
+		total.type = NodeType::Total;
+		total.name = "Total";
+		total.id = ++m_lastNodeId;
+	}
+	total.current = periodNanoseconds;
+	total.seen = true;
+
+	for( auto it = m_nodes.begin(); it != m_nodes.end(); )
+	{
+		NodeHistory & node = it.value();
+		node.unseen = node.seen ? 0 : node.unseen + 1;
+		if( node.unseen > HISTORY_LENGTH )
+		{
+			// most probably deleted, and its address could be
+			// reused by another one
+			if( m_keepAllPeriods )
+			{
+				m_retiredNodes.append( node );
+			}
+			it = m_nodes.erase( it );
+			continue;
+		}
+
+		const float time = node.current / 1000.0f;
+		if( m_keepAllPeriods || node.times.size() < HISTORY_LENGTH )
+		{
+			node.times.push_back( time );
+		}
+		else
+		{
+			node.times[node.next] = time;
+			node.next = ( node.next + 1 ) % HISTORY_LENGTH;
+		}
+		node.current = 0;
+		node.seen = false;
+		++it;
+	}
+}
+
+
+
+void MixerProfiler::dropNodeTimes()
+{
+	QMutexLocker logsLock( &m_logsMutex );
+	for( ThreadLog * log : m_threadLogs )
+	{
+		log->samples.clear();
+	}
+}
+
+
+
+void MixerProfiler::writeReport()
+{
+	QVector<NodeStats> stats = nodeStats();
+	std::sort( stats.begin(), stats.end(), []( const NodeStats & a, const NodeStats & b )
+		{
+			return a.mean > b.mean;
+		} );
+
+	if( m_reportFormat == CsvReport )
+	{
+		m_outputFile.write( "type,name,periods,mean_us,median_us,p95_us,p99_us,max_us\n" );
+		for( const NodeStats & s : stats )
+		{
+			QString name = s.name;
+			name.replace( "\"", "\"\"" );
+			m_outputFile.write( QString( "%1,\"%2\",%3,%4,%5,%6,%7,%8\n" ).
+						arg( nodeTypeName( s.type ) ).arg( name ).arg( s.periods ).
+						arg( s.mean ).arg( s.median ).arg( s.p95 ).arg( s.p99 ).arg( s.max ).toUtf8() );
+		}
+		// the periods which were missing or not taken in time
+		m_outputFile.write( QString( "underruns,\"Underruns\",%1,,,,,\n" ).arg( underruns() ).toUtf8() );
+		m_outputFile.write( QString( "overruns,\"Overruns\",%1,,,,,\n" ).arg( overruns() ).toUtf8() );
+	}
+	else
+	{
+		QJsonArray nodes;
+		for( const NodeStats & s : stats )
+		{
+			QJsonObject node;
+			node["type"] = nodeTypeName( s.type );
+			node["name"] = s.name;
+			node["periods"] = s.periods;
+			node["mean_us"] = s.mean;
+			node["median_us"] = s.median;
+			node["p95_us"] = s.p95;
+			node["p99_us"] = s.p99;
+			node["max_us"] = s.max;
+			nodes.append( node );
+		}
+		QJsonObject report;
+		report["period_us"] = m_periodLength;
+		report["underruns"] = underruns();
+		report["overruns"] = overruns();
+		report["nodes"] = nodes;
+		m_outputFile.write( QJsonDocument( report ).toJson() );
+	}
+	m_outputFile.close();
+}
+
+
+
+QString MixerProfiler::nodeName( NodeType type, const void * node )
+{
+	switch( type )
+	{
+		case NodeType::PlayHandle:
+			switch( static_cast<PlayHandle::Type>( reinterpret_cast<quintptr>( node ) ) )
+			{
+				case PlayHandle::TypeNotePlayHandle: return "Notes";
+				case PlayHandle::TypeInstrumentPlayHandle: return "Instruments";
+				case PlayHandle::TypeSamplePlayHandle: return "Samples";
+				case PlayHandle::TypePresetPreviewHandle: return "Preset previews";
+			}
+			break;
+		case NodeType::Instrument:
+		{
+			const Instrument * instrument = static_cast<const Instrument *>( node );
+			return QString( "%1 (%2)" ).arg( instrument->instrumentTrack()->name(),
+								instrument->displayName() );
+		}
+		case NodeType::Effect:
+			return static_cast<const Effect *>( node )->fullDisplayName();
+		case NodeType::FxChannel:
+		{
+			const FxChannel * channel = static_cast<const FxChannel *>( node );
+			return channel->m_channelIndex == 0 ? QString( "Master" ) :
+				QString( "FX %1: %2" ).arg( channel->m_channelIndex ).arg( channel->m_name );
+		}
+		case NodeType::Total:
+			break;
+	}
+	return "Total";
+}
+
+
+
+MixerProfiler::NodeStats MixerProfiler::statsOf( const NodeHistory & node )
+{
+	std::vector<float> times = node.times;
+	std::sort( times.begin(), times.end() );
+
+	NodeStats stats = { node.type, node.name, node.id, static_cast<int>( times.size() ), 0, 0, 0, 0, 0 };
+	if( times.empty() )
+	{
+		return stats;
+	}
+
+	double sum = 0;
+	for( float time : times )
+	{
+		sum += time;
+	}
+	// nearest rank
+	auto percentile = [&times]( float p )
+	{
+		return times[static_cast<size_t>( p * ( times.size() - 1 ) + 0.5f )];
+	};
+
+	stats.mean = sum / times.size();
+	stats.median = percentile( 0.5f );
+	stats.p95 = percentile( 0.95f );
+	stats.p99 = percentile( 0.99f );
+	stats.max = times.back();
+	return stats;
+}
@@ -31,18 +31,198 @@
 #include "denormals.h"
 #include "ThreadableJob.h"
 #include "Mixer.h"
+#include "PeriodArena.h"
+#include "PerfTrace.h"
+#include "ThreadPolicy.h"
 
 #if defined(LMMS_HOST_X86) || defined(LMMS_HOST_X86_64)
 #include <xmmintrin.h>
 #endif
 
+// number of polls of the job generation before an idle worker goes to sleep
+static const int WORKER_SPIN_COUNT = 4096;
+
+static thread_local int s_threadQueue = -1;
+
+static inline void cpuRelax()
+{
+#if defined(LMMS_HOST_X86) || defined(LMMS_HOST_X86_64)
+	_mm_pause();
+#endif
+}
+
 MixerWorkerThread::JobQueue MixerWorkerThread::globalJobQueue;
+QMutex * MixerWorkerThread::queueReadyMutex = NULL;
 QWaitCondition * MixerWorkerThread::queueReadyWaitCond = NULL;
 QList<MixerWorkerThread *> MixerWorkerThread::workerThreads;
+std::atomic_uint MixerWorkerThread::generation( 0 );
+std::atomic_int MixerWorkerThread::sleepingWorkers( 0 );
+
+
+
+// implementation of the work-stealing deques
+MixerWorkerThread::JobQueue::Deque::Deque() :
+	m_top( 0 ),
+	m_bottom( 0 )
+{
+	std::fill( m_items, m_items + JOB_QUEUE_SIZE, nullptr );
+}
+
+
+
+
+void MixerWorkerThread::JobQueue::Deque::clear()
+{
+	m_top.store( 0, std::memory_order_relaxed );
+	m_bottom.store( 0, std::memory_order_relaxed );
+}
+
+
+
+
+// only called by the owner of the deque (or while the queue is idle)
+bool MixerWorkerThread::JobQueue::Deque::push( ThreadableJob * _job )
+{
+	const int b = m_bottom.load( std::memory_order_relaxed );
+	const int t = m_top.load( std::memory_order_acquire );
+	if( b - t >= JOB_QUEUE_SIZE )
+	{
+		return false;
+	}
+	m_items[b % JOB_QUEUE_SIZE].store( _job, std::memory_order_relaxed );
+	std::atomic_thread_fence( std::memory_order_release );
+	m_bottom.store( b + 1, std::memory_order_relaxed );
+	return true;
+}
+
+
+
+
+// only called by the owner of the deque
+ThreadableJob * MixerWorkerThread::JobQueue::Deque::pop()
+{
+	const int b = m_bottom.load( std::memory_order_relaxed ) - 1;
+	m_bottom.store( b, std::memory_order_relaxed );
+	std::atomic_thread_fence( std::memory_order_seq_cst );
+	int t = m_top.load( std::memory_order_relaxed );
+
+	if( t > b )
+	{
+		// deque was empty
+		m_bottom.store( b + 1, std::memory_order_relaxed );
+		return nullptr;
+	}
+
+	ThreadableJob * job = m_items[b % JOB_QUEUE_SIZE].load( std::memory_order_relaxed );
+	if( t == b )
+	{
+		// last item - race against thieves
+		if( !m_top.compare_exchange_strong( t, t + 1,
+				std::memory_order_seq_cst, std::memory_order_relaxed ) )
+		{
+			job = nullptr;
+		}
+		m_bottom.store( b + 1, std::memory_order_relaxed );
+	}
+	return job;
+}
+
+
+
+
+// can be called by any thread
+ThreadableJob * MixerWorkerThread::JobQueue::Deque::steal()
+{
+	int t = m_top.load( std::memory_order_acquire );
+	std::atomic_thread_fence( std::memory_order_seq_cst );
+	int b = m_bottom.load( std::memory_order_acquire );
+
+	while( t < b )
+	{
+		ThreadableJob * job = m_items[t % JOB_QUEUE_SIZE].load( std::memory_order_relaxed );
+		if( m_top.compare_exchange_strong( t, t + 1,
+				std::memory_order_seq_cst, std::memory_order_relaxed ) )
+		{
+			return job;
+		}
+		// lost the race against another thief or the owner - t has
+		// been updated, so simply try again
+		b = m_bottom.load( std::memory_order_acquire );
+	}
+	return nullptr;
+}
+
+
+
 
 // implementation of internal JobQueue
+MixerWorkerThread::JobQueue::JobQueue( int queues ) :
+	m_deques(),
+	m_nextQueue( 0 ),
+	m_writeIndex( 0 ),
+	m_itemsDone( 0 ),
+	m_activeThreads( 0 ),
+	m_processing( false ),
+	m_opMode( Static )
+{
+	setQueueCount( queues );
+}
+
+
+
+
+MixerWorkerThread::JobQueue::~JobQueue()
+{
+	for( Deque * d : m_deques )
+	{
+		delete d;
+	}
+}
+
+
+
+
+void MixerWorkerThread::JobQueue::setQueueCount( int queues )
+{
+	reset( m_opMode );
+
+	queues = qMax( queues, 1 );
+	while( (int) m_deques.size() < queues )
+	{
+		m_deques.push_back( new Deque );
+	}
+	while( (int) m_deques.size() > queues )
+	{
+		delete m_deques.back();
+		m_deques.pop_back();
+	}
+}
+
+
+
+
+void MixerWorkerThread::JobQueue::setThreadQueue( int index )
+{
+	s_threadQueue = index;
+}
+
+
+
+
 void MixerWorkerThread::JobQueue::reset( OperationMode _opMode )
 {
+	// lock out all threads and wait for the ones still looking for work
+	m_processing = false;
+	while( m_activeThreads > 0 )
+	{
+		cpuRelax();
+	}
+
+	for( Deque * d : m_deques )
+	{
+		d->clear();
+	}
+	m_nextQueue = 0;
 	m_writeIndex = 0;
 	m_itemsDone = 0;
 	m_opMode = _opMode;
@@ -57,11 +237,26 @@ void MixerWorkerThread::JobQueue::addJob( ThreadableJob * _job )
 	{
 		// update job state
 		_job->queue();
-		// actually queue the job via atomic operations
-		auto index = m_writeIndex++;
-		if (index < JOB_QUEUE_SIZE) {
-			m_items[index] = _job;
-		} else {
+
+		// while the queue is idle nobody else touches the deques, so
+		// spread the jobs over all of them - otherwise only the owner
+		// of a deque may push
+		int index;
+		if( m_processing )
+		{
+			index = currentQueue();
+		}
+		else
+		{
+			index = m_nextQueue;
+			m_nextQueue = ( m_nextQueue + 1 ) % m_deques.size();
+		}
+
+		// count the job before it can be taken, so that the queue can't
+		// be seen as finished in the meantime
+		++m_writeIndex;
+		if( !m_deques[index]->push( _job ) )
+		{
 			qWarning() << "Job queue is full!";
 			++m_itemsDone;
 		}
@@ -70,25 +265,84 @@ void MixerWorkerThread::JobQueue::addJob( ThreadableJob * _job )
 
 
 
+
+void MixerWorkerThread::JobQueue::start()
+{
+	m_processing = true;
+}
+
+
+
+
+int MixerWorkerThread::JobQueue::currentQueue() const
+{
+	const int count = m_deques.size();
+	return ( s_threadQueue >= 0 && s_threadQueue < count ) ?
+						s_threadQueue : count - 1;
+}
+
+
+
+
+ThreadableJob * MixerWorkerThread::JobQueue::takeJob( int _index )
+{
+	ThreadableJob * job = m_deques[_index]->pop();
+	if( job )
+	{
+		return job;
+	}
+
+	const int count = m_deques.size();
+	for( int i = 1; i < count; ++i )
+	{
+		job = m_deques[( _index + i ) % count]->steal();
+		if( job )
+		{
+			return job;
+		}
+	}
+	return nullptr;
+}
+
+
+
+
+void MixerWorkerThread::JobQueue::processJob( ThreadableJob * _job )
+{
+	PerfTrace::Span span( "Job" );
+	_job->process();
+	++m_itemsDone;
+}
+
+
+
+
 void MixerWorkerThread::JobQueue::run()
 {
-	bool processedJob = true;
-	while (processedJob && m_itemsDone < m_writeIndex)
+	++m_activeThreads;
+	if( m_processing )
 	{
-		processedJob = false;
-		for( int i = 0; i < m_writeIndex && i < JOB_QUEUE_SIZE; ++i )
+		const int index = currentQueue();
+		while( m_processing && m_itemsDone < m_writeIndex )
 		{
-			ThreadableJob * job = m_items[i].exchange(nullptr);
+			ThreadableJob * job = takeJob( index );
 			if( job )
 			{
-				job->process();
-				processedJob = true;
-				++m_itemsDone;
+				processJob( job );
+			}
+			else if( m_opMode == Static )
+			{
+				// no jobs get added in static mode, so there's
+				// nothing left for us
+				break;
+			}
+			else
+			{
+				cpuRelax();
 			}
 		}
-		// always exit loop if we're not in dynamic mode
-		processedJob = processedJob && ( m_opMode == Dynamic );
 	}
+	--m_activeThreads;
 }
 
 
@@ -96,11 +350,20 @@ void MixerWorkerThread::JobQueue::run()
 
 void MixerWorkerThread::JobQueue::wait()
 {
-	while (m_itemsDone < m_writeIndex)
+	PerfTrace::Span span( "Wait for jobs" );
+	const int index = currentQueue();
+	while( m_itemsDone < m_writeIndex )
 	{
-#if defined(LMMS_HOST_X86) || defined(LMMS_HOST_X86_64)
-		_mm_pause();
-#endif
+		// rather help than just wait for the other threads
+		ThreadableJob * job = takeJob( index );
+		if( job )
+		{
+			processJob( job );
+		}
+		else
+		{
+			cpuRelax();
+		}
 	}
 }
 
@@ -112,11 +375,13 @@ void MixerWorkerThread::JobQueue::wait()
 
 MixerWorkerThread::MixerWorkerThread( Mixer* mixer ) :
 	QThread( mixer ),
+	m_index( workerThreads.size() ),
 	m_quit( false )
 {
 	// initialize global static data
 	if( queueReadyWaitCond == NULL )
 	{
+		queueReadyMutex = new QMutex;
 		queueReadyWaitCond = new QWaitCondition;
 	}
 
@@ -125,6 +390,9 @@ MixerWorkerThread::MixerWorkerThread( Mixer* mixer ) :
 	// MixerWorkerThread::startAndWaitForJobs() for details
 	workerThreads << this;
 
+	// one deque per worker - the one of the last worker thread is used
+	// by the thread processing it inline
+	globalJobQueue.setQueueCount( workerThreads.size() );
 	resetJobQueue();
 }
 
@@ -143,6 +411,7 @@ void MixerWorkerThread::quit()
 {
 	m_quit = true;
 	resetJobQueue();
+	wakeAll();
 }
 
 
@@ -150,7 +419,8 @@ void MixerWorkerThread::quit()
 
 void MixerWorkerThread::startAndWaitForJobs()
 {
-	queueReadyWaitCond->wakeAll();
+	globalJobQueue.start();
+	wakeAll();
 	// The last worker-thread is never started. Instead it's processed "inline"
 	// i.e. within the global Mixer thread. This way we can reduce latencies
 	// that otherwise would be caused by synchronizing with another thread.
@@ -161,19 +431,63 @@ void MixerWorkerThread::startAndWaitForJobs()
 
 
 
+void MixerWorkerThread::wakeAll()
+{
+	++generation;
+	// only take the slow path if somebody actually went to sleep
+	if( sleepingWorkers > 0 )
+	{
+		queueReadyMutex->lock();
+		queueReadyWaitCond->wakeAll();
+		queueReadyMutex->unlock();
+	}
+}
+
+
+
+
+unsigned int MixerWorkerThread::waitForJobs( unsigned int _generation )
+{
+	// spin for a while, as new jobs usually arrive within the same period
+	for( int i = 0; i < WORKER_SPIN_COUNT; ++i )
+	{
+		const unsigned int current = generation;
+		if( current != _generation || m_quit )
+		{
+			return current;
+		}
+		cpuRelax();
+	}
+
+	queueReadyMutex->lock();
+	++sleepingWorkers;
+	while( generation == _generation && m_quit == false )
+	{
+		queueReadyWaitCond->wait( queueReadyMutex );
+	}
+	--sleepingWorkers;
+	queueReadyMutex->unlock();
+
+	return generation;
+}
+
+
+
+
 void MixerWorkerThread::run()
 {
 	MemoryManager::ThreadGuard mmThreadGuard; Q_UNUSED(mmThreadGuard);
 	disable_denormals();
+	PeriodArena::markAudioThread();
+	ThreadPolicy::apply( QString( "Mixer worker %1" ).arg( m_index ),
+								m_index + 1 );
+
+	JobQueue::setThreadQueue( m_index );
 
-	QMutex m;
+	unsigned int lastGeneration = generation;
 	while( m_quit == false )
 	{
-		m.lock();
-		queueReadyWaitCond->wait( &m );
+		lastGeneration = waitForJobs( lastGeneration );
 		globalJobQueue.run();
-		m.unlock();
 	}
 }
-
-
@@ -24,7 +24,15 @@
  */
 
 #include "NotePlayHandle.h"
+
+#include <QtCore/QSemaphore>
+#include <QtCore/QThread>
+
+#include <atomic>
+#include <cstdint>
+
 #include "BasicFilters.h"
+#include "DeterministicRender.h"
 #include "DetuningHelper.h"
 #include "InstrumentSoundShaping.h"
 #include "InstrumentTrack.h"
@@ -60,6 +68,7 @@ NotePlayHandle::NotePlayHandle( InstrumentTrack* instrumentTrack,
 	m_releaseFramesToDo( 0 ),
 	m_releaseFramesDone( 0 ),
 	m_subNotes(),
+	m_subNotesCreated( 0 ),
 	m_released( false ),
 	m_releaseStarted( false ),
 	m_hasMidiNote( false ),
@@ -90,6 +99,10 @@ NotePlayHandle::NotePlayHandle( InstrumentTrack* instrumentTrack,
 
 		parent->m_subNotes.push_back( this );
 		parent->m_hadChildren = true;
+		// sub-notes are created by worker threads, derive their order
+		// from the parent instead of the creation sequence
+		setRenderOrder( DeterministicRender::childOrder(
+			parent->renderOrder(), parent->m_subNotesCreated++ ) );
 
 		m_bbTrack = parent->m_bbTrack;
 
@@ -436,11 +449,11 @@ void NotePlayHandle::mute()
 
 int NotePlayHandle::index() const
 {
-	const PlayHandleList & playHandles = Engine::mixer()->playHandles();
+	const PlayHandleRegistry & playHandles = Engine::mixer()->playHandles();
 	int idx = 0;
-	for( PlayHandleList::ConstIterator it = playHandles.begin(); it != playHandles.end(); ++it )
+	for( const PlayHandle * ph : playHandles )
 	{
-		const NotePlayHandle * nph = dynamic_cast<const NotePlayHandle *>( *it );
+		const NotePlayHandle * nph = dynamic_cast<const NotePlayHandle *>( ph );
 		if( nph == NULL || nph->m_instrumentTrack != m_instrumentTrack || nph->isReleased() || nph->hasParent() )
 		{
 			continue;
@@ -459,12 +472,12 @@ int NotePlayHandle::index() const
 
 ConstNotePlayHandleList NotePlayHandle::nphsOfInstrumentTrack( const InstrumentTrack * _it, bool _all_ph )
 {
-	const PlayHandleList & playHandles = Engine::mixer()->playHandles();
+	const PlayHandleRegistry & playHandles = Engine::mixer()->playHandles();
 	ConstNotePlayHandleList cnphv;
 
-	for( PlayHandleList::ConstIterator it = playHandles.begin(); it != playHandles.end(); ++it )
+	for( const PlayHandle * ph : playHandles )
 	{
-		const NotePlayHandle * nph = dynamic_cast<const NotePlayHandle *>( *it );
+		const NotePlayHandle * nph = dynamic_cast<const NotePlayHandle *>( ph );
 		if( nph != NULL && nph->m_instrumentTrack == _it && ( ( nph->isReleased() == false && nph->hasParent() == false ) || _all_ph == true ) )
 		{
 			cnphv.push_back( nph );
@@ -549,28 +562,226 @@ void NotePlayHandle::resize( const bpm_t _new_tempo )
 }
 
 
-NotePlayHandle ** NotePlayHandleManager::s_available;
-QReadWriteLock NotePlayHandleManager::s_mutex;
-std::atomic_int NotePlayHandleManager::s_availableIndex;
-int NotePlayHandleManager::s_size;
+
+
+
+
+namespace
+{
+
+struct Magazine
+{
+	int count;
+	// link inside a MagazineStack
+	std::atomic_int next;
+	void * handles[NPH_MAGAZINE_SIZE];
+};
+
+Magazine s_magazines[NPH_MAX_MAGAZINES];
+
+
+// Lock-free LIFO of magazine indices. The head carries a tag which is
+// incremented on every change to avoid the ABA problem.
+class MagazineStack
+{
+public:
+	MagazineStack() :
+		m_head( pack( -1, 0 ) ),
+		m_size( 0 )
+	{
+	}
+
+	void push( int index )
+	{
+		uint64_t head = m_head.load( std::memory_order_relaxed );
+		do
+		{
+			s_magazines[index].next.store( indexOf( head ),
+						std::memory_order_relaxed );
+		}
+		while( !m_head.compare_exchange_weak( head,
+					pack( index, tagOf( head ) + 1 ),
+					std::memory_order_release,
+					std::memory_order_relaxed ) );
+		++m_size;
+	}
+
+	int pop()
+	{
+		uint64_t head = m_head.load( std::memory_order_acquire );
+		while( indexOf( head ) >= 0 )
+		{
+			const int next = s_magazines[indexOf( head )].next.load(
+						std::memory_order_relaxed );
+			if( m_head.compare_exchange_weak( head,
+						pack( next, tagOf( head ) + 1 ),
+						std::memory_order_acquire,
+						std::memory_order_acquire ) )
+			{
+				--m_size;
+				return indexOf( head );
+			}
+		}
+		return -1;
+	}
+
+	// only a hint while other threads are pushing or popping
+	int size() const
+	{
+		return m_size.load( std::memory_order_relaxed );
+	}
+
+private:
+	static uint64_t pack( int index, uint32_t tag )
+	{
+		return ( (uint64_t) tag << 32 ) | (uint32_t) index;
+	}
+
+	static int indexOf( uint64_t head )
+	{
+		return (int32_t)( head & 0xffffffff );
+	}
+
+	static uint32_t tagOf( uint64_t head )
+	{
+		return head >> 32;
+	}
+
+	std::atomic<uint64_t> m_head;
+	std::atomic_int m_size;
+} ;
+
+
+// magazines with at least one free handle and magazines without any
+MagazineStack s_loadedMagazines;
+MagazineStack s_emptyMagazines;
+
+std::atomic_int s_handleCount( 0 );
+std::atomic_int s_hits( 0 );
+std::atomic_int s_misses( 0 );
+
+
+// The magazines of a thread. Both are handed back to the depot when the
+// thread exits, so no handles get lost.
+struct ThreadCache
+{
+	ThreadCache() :
+		loaded( -1 ),
+		previous( -1 )
+	{
+	}
+
+	~ThreadCache()
+	{
+		giveBack( loaded );
+		giveBack( previous );
+	}
+
+	static void giveBack( int index )
+	{
+		if( index >= 0 )
+		{
+			if( s_magazines[index].count > 0 )
+			{
+				s_loadedMagazines.push( index );
+			}
+			else
+			{
+				s_emptyMagazines.push( index );
+			}
+		}
+	}
+
+	int loaded;
+	int previous;
+} ;
+
+thread_local ThreadCache t_cache;
+
+
+class PoolGrowthThread : public QThread
+{
+public:
+	PoolGrowthThread() :
+		m_quit( false ),
+		m_requested( false )
+	{
+		setObjectName( "NotePlayHandleManager::growth" );
+	}
+
+	void request()
+	{
+		// wake up the thread only once per growth
+		if( !m_requested.exchange( true ) )
+		{
+			m_semaphore.release();
+		}
+	}
+
+	void stop()
+	{
+		m_quit = true;
+		m_semaphore.release();
+	}
+
+private:
+	void run() override
+	{
+		while( true )
+		{
+			m_semaphore.acquire();
+			if( m_quit )
+			{
+				break;
+			}
+			NotePlayHandleManager::extend( NPH_CACHE_INCREMENT );
+			m_requested = false;
+		}
+	}
+
+	std::atomic_bool m_quit;
+	std::atomic_bool m_requested;
+	QSemaphore m_semaphore;
+} ;
+
+PoolGrowthThread * s_growthThread = NULL;
+
+}
+
+
 
 
 void NotePlayHandleManager::init()
 {
-	s_available = MM_ALLOC( NotePlayHandle*, INITIAL_NPH_CACHE );
+	for( int i = NPH_MAX_MAGAZINES - 1; i >= 0; --i )
+	{
+		s_magazines[i].count = 0;
+		s_emptyMagazines.push( i );
+	}
+
+	extend( INITIAL_NPH_CACHE );
+
+	s_growthThread = new PoolGrowthThread;
+	s_growthThread->start( QThread::LowPriority );
+}
 
-	NotePlayHandle * n = MM_ALLOC( NotePlayHandle, INITIAL_NPH_CACHE );
 
-	for( int i=0; i < INITIAL_NPH_CACHE; ++i )
+
+
+void NotePlayHandleManager::cleanup()
+{
+	if( s_growthThread )
 	{
-		s_available[ i ] = n;
-		++n;
+		s_growthThread->stop();
+		s_growthThread->wait();
+		delete s_growthThread;
+		s_growthThread = NULL;
 	}
-	s_availableIndex = INITIAL_NPH_CACHE - 1;
-	s_size = INITIAL_NPH_CACHE;
 }
 
 
+
+
 NotePlayHandle * NotePlayHandleManager::acquire( InstrumentTrack* instrumentTrack,
 				const f_cnt_t offset,
 				const f_cnt_t frames,
@@ -579,38 +790,145 @@ NotePlayHandle * NotePlayHandleManager::acquire( InstrumentTrack* instrumentTrac
 				int midiEventChannel,
 				NotePlayHandle::Origin origin )
 {
-	// TODO: use some lockless data structures
-	s_mutex.lockForWrite();
-	if (s_availableIndex < 0) { extend(NPH_CACHE_INCREMENT); }
-	NotePlayHandle * nph = s_available[s_availableIndex--];
-	s_mutex.unlock();
-
+	NotePlayHandle * nph = (NotePlayHandle *) allocate();
 	new( (void*)nph ) NotePlayHandle( instrumentTrack, offset, frames, noteToPlay, parent, midiEventChannel, origin );
 	return nph;
 }
 
 
+
+
 void NotePlayHandleManager::release( NotePlayHandle * nph )
 {
 	nph->NotePlayHandle::~NotePlayHandle();
-	s_mutex.lockForRead();
-	s_available[++s_availableIndex] = nph;
-	s_mutex.unlock();
+	deallocate( nph );
 }
 
 
+
+
 void NotePlayHandleManager::extend( int c )
 {
-	s_size += c;
-	NotePlayHandle ** tmp = MM_ALLOC( NotePlayHandle*, s_size );
-	MM_FREE( s_available );
-	s_available = tmp;
+	// leave half of the magazines for being spread over the threads
+	const int maxHandles = NPH_MAX_MAGAZINES / 2 * NPH_MAGAZINE_SIZE;
+
+	for( int added = 0; added < c && s_handleCount < maxHandles;
+						added += NPH_MAGAZINE_SIZE )
+	{
+		const int index = s_emptyMagazines.pop();
+		if( index < 0 )
+		{
+			break;
+		}
+		Magazine & m = s_magazines[index];
+		for( m.count = 0; m.count < NPH_MAGAZINE_SIZE; ++m.count )
+		{
+			m.handles[m.count] = MM_ALLOC( NotePlayHandle, 1 );
+		}
+		s_handleCount += NPH_MAGAZINE_SIZE;
+		s_loadedMagazines.push( index );
+	}
+}
+
+
+
+
+void * NotePlayHandleManager::allocate()
+{
+	ThreadCache & cache = t_cache;
+
+	if( cache.loaded < 0 || s_magazines[cache.loaded].count == 0 )
+	{
+		if( cache.previous >= 0 && s_magazines[cache.previous].count > 0 )
+		{
+			std::swap( cache.loaded, cache.previous );
+		}
+		else
+		{
+			const int index = s_loadedMagazines.pop();
+			if( index >= 0 )
+			{
+				// both own magazines are empty
+				if( cache.previous >= 0 )
+				{
+					s_emptyMagazines.push( cache.previous );
+				}
+				cache.previous = cache.loaded;
+				cache.loaded = index;
+			}
+		}
+
+		if( s_growthThread &&
+			s_loadedMagazines.size() < NPH_LOW_WATERMARK )
+		{
+			s_growthThread->request();
+		}
+	}
+
+	if( cache.loaded >= 0 && s_magazines[cache.loaded].count > 0 )
+	{
+		Magazine & m = s_magazines[cache.loaded];
+		s_hits.fetch_add( 1, std::memory_order_relaxed );
+		return m.handles[--m.count];
+	}
+
+	// the pool ran dry
+	s_misses.fetch_add( 1, std::memory_order_relaxed );
+	++s_handleCount;
+	return MM_ALLOC( NotePlayHandle, 1 );
+}
 
-	NotePlayHandle * n = MM_ALLOC( NotePlayHandle, c );
 
-	for( int i=0; i < c; ++i )
+
+
+void NotePlayHandleManager::deallocate( void * ptr )
+{
+	ThreadCache & cache = t_cache;
+
+	if( cache.loaded < 0 ||
+		s_magazines[cache.loaded].count == NPH_MAGAZINE_SIZE )
 	{
-		s_available[++s_availableIndex] = n;
-		++n;
+		if( cache.previous >= 0 &&
+			s_magazines[cache.previous].count < NPH_MAGAZINE_SIZE )
+		{
+			std::swap( cache.loaded, cache.previous );
+		}
+		else
+		{
+			const int index = s_emptyMagazines.pop();
+			if( index < 0 )
+			{
+				// all magazines are in use - the pool is big enough
+				--s_handleCount;
+				MM_FREE( ptr );
+				return;
+			}
+			// both own magazines are full
+			if( cache.previous >= 0 )
+			{
+				s_loadedMagazines.push( cache.previous );
+			}
+			cache.previous = cache.loaded;
+			cache.loaded = index;
+		}
 	}
+
+	Magazine & m = s_magazines[cache.loaded];
+	m.handles[m.count++] = ptr;
+}
+
+
+
+
+int NotePlayHandleManager::hits()
+{
+	return s_hits.load( std::memory_order_relaxed );
+}
+
+
+
+
+int NotePlayHandleManager::misses()
+{
+	return s_misses.load( std::memory_order_relaxed );
 }
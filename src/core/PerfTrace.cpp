@@ -0,0 +1,170 @@
+/*
+ * PerfTrace.cpp - Timeline of the render pipeline in Chrome trace format
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#include "PerfTrace.h"
+
+#include <cstdio>
+#include <vector>
+
+#include <QtCore/QFile>
+#include <QtCore/QMutex>
+
+namespace
+{
+
+/// Number of spans kept per thread
+const quint64 RING_SIZE = 1 << 18;
+
+struct Event
+{
+	const char* name;
+	qint64 begin;
+	qint64 end;
+};
+
+struct ThreadRing
+{
+	ThreadRing(int id, const QString& name) :
+		id(id),
+		name(name),
+		events(RING_SIZE),
+		written(0)
+	{
+	}
+
+	const int id;
+	QString name;
+	std::vector<Event> events;
+	// only written by the owning thread, the ring is read by finish()
+	std::atomic<quint64> written;
+};
+
+QMutex s_ringsMutex;
+std::vector<ThreadRing*> s_rings;
+QString s_outputFile;
+qint64 s_start = 0;
+
+thread_local ThreadRing* t_ring = nullptr;
+thread_local QString t_threadName;
+
+}
+
+
+std::atomic<bool> PerfTrace::s_enabled(false);
+
+
+void PerfTrace::start(const QString& outputFile)
+{
+	s_outputFile = outputFile;
+	s_start = now();
+	s_enabled = true;
+}
+
+bool PerfTrace::finish()
+{
+	if (!s_enabled)
+	{
+		return false;
+	}
+	s_enabled = false;
+
+	QFile file(s_outputFile);
+	if (!file.open(QFile::WriteOnly | QFile::Truncate))
+	{
+		qWarning("PerfTrace: could not open %s", qPrintable(s_outputFile));
+		return false;
+	}
+
+	QMutexLocker lock(&s_ringsMutex);
+
+	file.write("{\"traceEvents\":[\n");
+	bool first = true;
+	for (ThreadRing* ring : s_rings)
+	{
+		QString name = ring->name;
+		name.replace('\\', "\\\\").replace('"', "\\\"");
+		file.write(QString("%1{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%2,"
+					"\"args\":{\"name\":\"%3\"}}").
+				arg(first ? "" : ",\n").arg(ring->id).arg(name).toUtf8());
+		first = false;
+
+		const quint64 written = ring->written.load(std::memory_order_acquire);
+		const quint64 oldest = written > RING_SIZE ? written - RING_SIZE : 0;
+		if (oldest > 0)
+		{
+			printf("Notice: the trace lacks the first %llu spans of thread \"%s\"\n",
+				static_cast<unsigned long long>(oldest), qPrintable(ring->name));
+		}
+
+		QByteArray events;
+		for (quint64 i = oldest; i < written; ++i)
+		{
+			const Event& e = ring->events[i % RING_SIZE];
+			// timestamps are in microseconds
+			events += QString::asprintf(",\n{\"name\":\"%s\",\"cat\":\"lmms\",\"ph\":\"X\",\"pid\":1,"
+							"\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+							e.name, ring->id, (e.begin - s_start) / 1000.0,
+							(e.end - e.begin) / 1000.0).toUtf8();
+		}
+		file.write(events);
+	}
+	file.write("\n],\"displayTimeUnit\":\"ns\"}\n");
+
+	// nobody records anymore
+	for (ThreadRing* ring : s_rings)
+	{
+		delete ring;
+	}
+	s_rings.clear();
+
+	return true;
+}
+
+void PerfTrace::setThreadName(const QString& name)
+{
+	t_threadName = name;
+
+	QMutexLocker lock(&s_ringsMutex);
+	if (t_ring)
+	{
+		t_ring->name = name;
+	}
+}
+
+void PerfTrace::record(const char* name, qint64 begin, qint64 end)
+{
+	ThreadRing* ring = t_ring;
+	if (!ring)
+	{
+		QMutexLocker lock(&s_ringsMutex);
+		const int id = s_rings.size() + 1;
+		ring = new ThreadRing(id, t_threadName.isEmpty() ?
+					QString("Thread %1").arg(id) : t_threadName);
+		s_rings.push_back(ring);
+		t_ring = ring;
+	}
+
+	const quint64 n = ring->written.load(std::memory_order_relaxed);
+	ring->events[n % RING_SIZE] = Event{name, begin, end};
+	ring->written.store(n + 1, std::memory_order_release);
+}
@@ -0,0 +1,223 @@
+/*
+ * PeriodArena.cpp - thread-local scratch memory which lives for one mixer period
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#include "PeriodArena.h"
+
+#include <QtCore/QtGlobal>
+
+#include <atomic>
+#include <vector>
+
+#include "MemoryHelper.h"
+
+
+namespace
+{
+
+const size_t CACHE_LINE_SIZE = 64;
+const size_t INITIAL_ARENA_SIZE = 64 * 1024;
+// periods after which heap allocations are considered a bug
+const int WARM_UP_PERIODS = 16;
+
+std::atomic_uint s_period( 0 );
+std::atomic_bool s_inPeriod( false );
+std::atomic_int s_heapAllocations( 0 );
+std::atomic_int s_lastHeapAllocations( 0 );
+bool s_allocationCheck = false;
+int s_periodsDone = 0;
+
+thread_local bool t_audioThread = false;
+
+
+class Arena
+{
+public:
+	Arena() :
+		m_data( NULL ),
+		m_size( 0 ),
+		m_used( 0 ),
+		m_overflowSize( 0 ),
+		m_period( s_period )
+	{
+	}
+
+	~Arena()
+	{
+		freeOverflow();
+		MemoryHelper::alignedFree( m_data );
+	}
+
+	void * alloc( size_t bytes )
+	{
+		if( m_period != s_period.load( std::memory_order_relaxed ) )
+		{
+			reset();
+		}
+
+		if( m_data == NULL )
+		{
+			grow( INITIAL_ARENA_SIZE );
+		}
+
+		const size_t misalign = (size_t)( m_data + m_used ) % CACHE_LINE_SIZE;
+		const size_t begin = m_used + ( misalign ?
+					CACHE_LINE_SIZE - misalign : 0 );
+		if( begin + bytes <= m_size )
+		{
+			m_used = begin + bytes;
+			return m_data + begin;
+		}
+
+		// out of memory for this period - get it from the heap and
+		// make the arena bigger next time
+		PeriodArena::countHeapAllocation();
+		char * overflow = static_cast<char *>(
+			MemoryHelper::alignedMalloc( bytes + CACHE_LINE_SIZE ) );
+		m_overflow.push_back( overflow );
+		m_overflowSize += bytes + CACHE_LINE_SIZE;
+		const size_t off = (size_t) overflow % CACHE_LINE_SIZE;
+		return overflow + ( off ? CACHE_LINE_SIZE - off : 0 );
+	}
+
+private:
+	void reset()
+	{
+		m_period = s_period.load( std::memory_order_relaxed );
+		if( !m_overflow.empty() )
+		{
+			const size_t needed = m_size + m_overflowSize;
+			freeOverflow();
+			grow( qMax( needed, 2 * m_size ) );
+		}
+		m_used = 0;
+	}
+
+	void grow( size_t size )
+	{
+		PeriodArena::countHeapAllocation();
+		MemoryHelper::alignedFree( m_data );
+		m_data = static_cast<char *>( MemoryHelper::alignedMalloc( size ) );
+		m_size = size;
+		// reserve once so recording overflows doesn't allocate
+		m_overflow.reserve( 64 );
+	}
+
+	void freeOverflow()
+	{
+		for( char * overflow : m_overflow )
+		{
+			MemoryHelper::alignedFree( overflow );
+		}
+		m_overflow.clear();
+		m_overflowSize = 0;
+	}
+
+	char * m_data;
+	size_t m_size;
+	size_t m_used;
+	std::vector<char *> m_overflow;
+	size_t m_overflowSize;
+	unsigned int m_period;
+} ;
+
+thread_local Arena t_arena;
+
+}
+
+
+
+
+void * PeriodArena::alloc( size_t bytes )
+{
+	return t_arena.alloc( bytes );
+}
+
+
+
+
+void PeriodArena::startPeriod()
+{
+	s_inPeriod = true;
+}
+
+
+
+
+void PeriodArena::finishPeriod()
+{
+	s_inPeriod = false;
+
+	const int allocations = s_heapAllocations.exchange( 0 );
+	s_lastHeapAllocations = allocations;
+
+	if( s_periodsDone < WARM_UP_PERIODS )
+	{
+		++s_periodsDone;
+	}
+#ifdef LMMS_DEBUG
+	else if( s_allocationCheck )
+	{
+		Q_ASSERT_X( allocations == 0, "PeriodArena::finishPeriod",
+				"heap allocation in audio thread while rendering" );
+	}
+#endif
+
+	// all arenas get reset with their next allocation
+	++s_period;
+}
+
+
+
+
+void PeriodArena::markAudioThread()
+{
+	t_audioThread = true;
+}
+
+
+
+
+void PeriodArena::countHeapAllocation()
+{
+	if( t_audioThread && s_inPeriod.load( std::memory_order_relaxed ) )
+	{
+		s_heapAllocations.fetch_add( 1, std::memory_order_relaxed );
+	}
+}
+
+
+
+
+int PeriodArena::heapAllocations()
+{
+	return s_lastHeapAllocations;
+}
+
+
+
+
+void PeriodArena::setAllocationCheck( bool enabled )
+{
+	s_allocationCheck = enabled;
+	s_periodsDone = 0;
+}
@@ -0,0 +1,129 @@
+/*
+ * PeriodFifo.cpp - FIFO of preallocated period buffers between mixer and audio device
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#include "PeriodFifo.h"
+
+#include <QtCore/QThread>
+
+#include <cstring>
+
+#include "MemoryHelper.h"
+
+
+PeriodFifo::PeriodFifo( int size, fpp_t frames ) :
+	m_size( size ),
+	m_frames( frames ),
+	m_buffers( new surroundSampleFrame *[size + 1] ),
+	m_items( new const surroundSampleFrame *[size + 1] ),
+	m_silence( NULL ),
+	m_writeIndex( 0 ),
+	m_readIndex( 0 )
+{
+	const size_t bytes = frames * sizeof( surroundSampleFrame );
+	for( int i = 0; i < m_size + 1; ++i )
+	{
+		m_buffers[i] = (surroundSampleFrame *)
+					MemoryHelper::alignedMalloc( bytes );
+		memset( m_buffers[i], 0, bytes );
+		m_items[i] = m_buffers[i];
+	}
+	m_silence = (surroundSampleFrame *) MemoryHelper::alignedMalloc( bytes );
+	memset( m_silence, 0, bytes );
+}
+
+
+
+
+PeriodFifo::~PeriodFifo()
+{
+	for( int i = 0; i < m_size + 1; ++i )
+	{
+		MemoryHelper::alignedFree( m_buffers[i] );
+	}
+	MemoryHelper::alignedFree( m_silence );
+	delete[] m_buffers;
+	delete[] m_items;
+}
+
+
+
+
+bool PeriodFifo::write( const surroundSampleFrame * period, int maxWaitUs )
+{
+	// poll a few times per period instead of blocking on a semaphore the
+	// reader would have to release
+	const int interval = qMax( 50, maxWaitUs / 8 );
+	int waited = 0;
+	while( isFull() )
+	{
+		QThread::usleep( interval );
+		waited += interval;
+	}
+
+	const unsigned int index = m_writeIndex.load( std::memory_order_relaxed );
+	const int slot = index % ( m_size + 1 );
+	if( period )
+	{
+		memcpy( m_buffers[slot], period,
+				m_frames * sizeof( surroundSampleFrame ) );
+		m_items[slot] = m_buffers[slot];
+	}
+	else
+	{
+		m_items[slot] = NULL;
+	}
+	m_writeIndex.store( index + 1, std::memory_order_release );
+
+	return waited <= maxWaitUs;
+}
+
+
+
+
+const surroundSampleFrame * PeriodFifo::read( bool & underrun )
+{
+	const unsigned int index = m_readIndex.load( std::memory_order_relaxed );
+	if( index == m_writeIndex.load( std::memory_order_acquire ) )
+	{
+		underrun = true;
+		return m_silence;
+	}
+
+	underrun = false;
+	const surroundSampleFrame * period = m_items[index % ( m_size + 1 )];
+	// from now on the writer may refill all buffers except this one
+	m_readIndex.store( index + 1, std::memory_order_release );
+	return period;
+}
+
+
+
+
+void PeriodFifo::waitUntilRead()
+{
+	while( available() )
+	{
+		QThread::usleep( 100 );
+	}
+}
+
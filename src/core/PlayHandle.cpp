@@ -24,6 +24,7 @@
  
 #include "PlayHandle.h"
 #include "BufferManager.h"
+#include "DeterministicRender.h"
 #include "Engine.h"
 #include "Mixer.h"
 
@@ -36,30 +37,43 @@ PlayHandle::PlayHandle(const Type type, f_cnt_t offset) :
 		m_type(type),
 		m_offset(offset),
 		m_affinity(QThread::currentThread()),
-		m_playHandleBuffer(BufferManager::acquire()),
+		m_playHandleBuffer(NULL),
 		m_bufferReleased(true),
-		m_usesBuffer(true)
+		m_usesBuffer(true),
+		m_silent(false),
+		m_audioPort(NULL),
+		m_slot(-1),
+		m_renderOrder(DeterministicRender::nextHandleOrder())
 {
 }
 
 
 PlayHandle::~PlayHandle()
 {
-	BufferManager::release(m_playHandleBuffer);
 }
 
 
 void PlayHandle::doProcessing()
 {
+	// profiled per type, there can be lots of play handles
+	MixerProfiler::Probe probe( Engine::mixer()->profiler(), MixerProfiler::NodeType::PlayHandle,
+					reinterpret_cast<const void *>( static_cast<quintptr>( m_type ) ) );
+	DeterministicRender::seedJob( m_renderOrder );
+
+	m_silent = false;
 	if( m_usesBuffer )
 	{
 		m_bufferReleased = false;
+		// only needed until the audio port mixed it in this period
+		m_playHandleBuffer = BufferManager::acquireScratch();
 		BufferManager::clear(m_playHandleBuffer, Engine::mixer()->framesPerPeriod());
 		play( buffer() );
+		updateRegistry( buffer() );
 	}
 	else
 	{
 		play( NULL );
+		updateRegistry( NULL );
 	}
 }
 
@@ -67,6 +81,22 @@ void PlayHandle::doProcessing()
 void PlayHandle::releaseBuffer()
 {
 	m_bufferReleased = true;
+	if( m_slot >= 0 )
+	{
+		Engine::mixer()->playHandles().setBuffer( m_slot, NULL );
+	}
+}
+
+
+void PlayHandle::updateRegistry( sampleFrame * buffer )
+{
+	if( m_slot >= 0 )
+	{
+		PlayHandleRegistry & registry = Engine::mixer()->playHandles();
+		registry.setFinished( m_slot, isFinished() );
+		registry.setBuffer( m_slot, buffer );
+		registry.setSilent( m_slot, m_silent );
+	}
 }
 
 sampleFrame* PlayHandle::buffer()
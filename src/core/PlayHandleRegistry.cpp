@@ -0,0 +1,145 @@
+/*
+ * PlayHandleRegistry.cpp - slot-indexed list of all play handles of the mixer
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#include "PlayHandleRegistry.h"
+
+#include "MixerWorkerThread.h"
+
+
+PlayHandleRegistry::PlayHandleRegistry() :
+	m_handles(),
+	m_types(),
+	m_finished(),
+	m_affinities(),
+	m_buffers(),
+	m_silent(),
+	m_count( 0 )
+{
+	// enough for a dense project, so it usually doesn't reallocate
+	m_handles.reserve( PlayHandle::MaxNumber );
+	m_types.reserve( PlayHandle::MaxNumber );
+	m_finished.reserve( PlayHandle::MaxNumber );
+	m_affinities.reserve( PlayHandle::MaxNumber );
+	m_buffers.reserve( PlayHandle::MaxNumber );
+	m_silent.reserve( PlayHandle::MaxNumber );
+}
+
+
+
+
+void PlayHandleRegistry::add( PlayHandle * handle )
+{
+	handle->m_slot = slots();
+	m_handles.push_back( handle );
+	m_types.push_back( handle->type() );
+	m_finished.push_back( false );
+	m_affinities.push_back( handle->affinityMatters() ?
+						handle->affinity() : NULL );
+	m_buffers.push_back( NULL );
+	m_silent.push_back( false );
+	++m_count;
+}
+
+
+
+
+bool PlayHandleRegistry::remove( const PlayHandle * handle )
+{
+	if( !contains( handle ) )
+	{
+		return false;
+	}
+	removeSlot( handle->m_slot );
+	return true;
+}
+
+
+
+
+void PlayHandleRegistry::removeSlot( int slot )
+{
+	m_handles[slot]->m_slot = -1;
+	m_handles[slot] = NULL;
+	--m_count;
+}
+
+
+
+
+void PlayHandleRegistry::compact()
+{
+	if( m_count == slots() )
+	{
+		return;
+	}
+
+	int to = 0;
+	for( int from = 0; from < slots(); ++from )
+	{
+		if( m_handles[from] == NULL )
+		{
+			continue;
+		}
+		if( to != from )
+		{
+			m_handles[to] = m_handles[from];
+			m_types[to] = m_types[from];
+			m_finished[to] = m_finished[from];
+			m_affinities[to] = m_affinities[from];
+			m_buffers[to] = m_buffers[from];
+			m_silent[to] = m_silent[from];
+			m_handles[to]->m_slot = to;
+		}
+		++to;
+	}
+
+	m_handles.resize( to );
+	m_types.resize( to );
+	m_finished.resize( to );
+	m_affinities.resize( to );
+	m_buffers.resize( to );
+	m_silent.resize( to );
+}
+
+
+
+
+void PlayHandleRegistry::queueJobs()
+{
+	for( int slot = 0; slot < slots(); ++slot )
+	{
+		PlayHandle * handle = m_handles[slot];
+		if( handle == NULL )
+		{
+			continue;
+		}
+		if( handle->requiresProcessing() )
+		{
+			MixerWorkerThread::addJob( handle );
+		}
+		else
+		{
+			m_finished[slot] = true;
+		}
+	}
+}
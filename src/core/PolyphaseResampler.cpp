@@ -0,0 +1,260 @@
+/*
+ * PolyphaseResampler.cpp - windowed-sinc resampler for playing samples
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+
+#include "PolyphaseResampler.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <samplerate.h>
+
+#include "lmms_constants.h"
+#include "MixHelpers.h"
+
+
+namespace
+{
+
+//! The filter gets stretched for reading up to that many frames per output
+//! frame, higher steps alias
+const double MaxStretch = 4;
+
+//! MixHelpers::convolve() needs taps in multiples of that
+const int TapMultiple = 8;
+
+//! Output frames whose coefficients are computed at once
+const int ChunkFrames = 16;
+
+const int MaxHalfTaps = 16;
+const int MaxTaps = 2 * MaxHalfTaps * int( MaxStretch );
+
+
+double besselI0( double x )
+{
+	double sum = 1;
+	double term = 1;
+	for( int k = 1; term > sum * 1e-12; ++k )
+	{
+		term *= ( x / ( 2 * k ) ) * ( x / ( 2 * k ) );
+		sum += term;
+	}
+	return sum;
+}
+
+
+double sinc( double x )
+{
+	return x == 0 ? 1 : sin( D_PI * x ) / ( D_PI * x );
+}
+
+}
+
+
+
+
+// indexed by libsamplerate's converter types
+const PolyphaseResampler PolyphaseResampler::s_resamplers[] =
+{
+	PolyphaseResampler( Sinc, 16, 1024, 0.96f, 10 ),	// SRC_SINC_BEST_QUALITY
+	PolyphaseResampler( Sinc, 8, 512, 0.94f, 8 ),		// SRC_SINC_MEDIUM_QUALITY
+	PolyphaseResampler( Sinc, 4, 256, 0.9f, 6 ),		// SRC_SINC_FASTEST
+	PolyphaseResampler( Nearest ),				// SRC_ZERO_ORDER_HOLD
+	PolyphaseResampler( Linear )				// SRC_LINEAR
+} ;
+
+
+
+
+PolyphaseResampler::PolyphaseResampler( Types type, int halfTaps, int phases,
+						float cutoff, float beta ) :
+	m_type( type ),
+	m_halfTaps( halfTaps ),
+	m_phases( phases )
+{
+	if( type != Sinc )
+	{
+		return;
+	}
+
+	// Kaiser windowed sinc
+	m_filter.resize( halfTaps * phases + 1 );
+	for( size_t i = 0; i < m_filter.size(); ++i )
+	{
+		const double t = double( i ) / phases;
+		const double x = t / halfTaps;
+		m_filter[i] = cutoff * sinc( cutoff * t ) *
+			besselI0( beta * sqrt( std::max( 0.0, 1 - x * x ) ) ) /
+							besselI0( beta );
+	}
+
+	const int taps = 2 * halfTaps;
+	m_rows.resize( ( phases + 1 ) * taps );
+	for( int phase = 0; phase <= phases; ++phase )
+	{
+		float * row = &m_rows[phase * taps];
+		float sum = 0;
+		for( int k = 0; k < taps; ++k )
+		{
+			row[k] = filter( fabsf( float( phase ) / phases +
+							halfTaps - 1 - k ) );
+			sum += row[k];
+		}
+		// no change in volume
+		for( int k = 0; k < taps; ++k )
+		{
+			row[k] /= sum;
+		}
+	}
+}
+
+
+
+
+const PolyphaseResampler & PolyphaseResampler::forConverter( int converter )
+{
+	switch( converter )
+	{
+		case SRC_SINC_BEST_QUALITY:
+		case SRC_SINC_MEDIUM_QUALITY:
+		case SRC_SINC_FASTEST:
+		case SRC_ZERO_ORDER_HOLD:
+			return s_resamplers[converter];
+		default:
+			return s_resamplers[SRC_LINEAR];
+	}
+}
+
+
+
+
+int PolyphaseResampler::reach( double step ) const
+{
+	if( m_type != Sinc )
+	{
+		return 1;
+	}
+	const double stretch = std::min( std::max( fabs( step ), 1.0 ), MaxStretch );
+	const int halfTaps = (int) ceil( m_halfTaps * stretch );
+	return ( halfTaps + TapMultiple / 2 - 1 ) /
+				( TapMultiple / 2 ) * ( TapMultiple / 2 );
+}
+
+
+
+
+void PolyphaseResampler::process( sampleFrame * dst, const sampleFrame * src,
+				double pos, double step, int frames ) const
+{
+	if( m_type == Sinc )
+	{
+		processSinc( dst, src, pos, step, frames );
+		return;
+	}
+
+	for( int f = 0; f < frames; ++f )
+	{
+		const double p = pos + f * step;
+		const int i = (int) floor( p );
+		if( m_type == Nearest )
+		{
+			dst[f][0] = src[i][0];
+			dst[f][1] = src[i][1];
+		}
+		else
+		{
+			const float fraction = float( p - i );
+			dst[f][0] = src[i][0] + fraction * ( src[i + 1][0] - src[i][0] );
+			dst[f][1] = src[i][1] + fraction * ( src[i + 1][1] - src[i][1] );
+		}
+	}
+}
+
+
+
+
+inline float PolyphaseResampler::filter( float t ) const
+{
+	const float index = t * m_phases;
+	const int i = (int) index;
+	if( i >= m_halfTaps * m_phases )
+	{
+		return 0;
+	}
+	return m_filter[i] + ( index - i ) * ( m_filter[i + 1] - m_filter[i] );
+}
+
+
+
+
+void PolyphaseResampler::processSinc( sampleFrame * dst, const sampleFrame * src,
+				double pos, double step, int frames ) const
+{
+	const double stretch = std::min( std::max( fabs( step ), 1.0 ), MaxStretch );
+	const int r = reach( step );
+	const int taps = 2 * r;
+
+	int offsets[ChunkFrames];
+	float coeffs[ChunkFrames * MaxTaps];
+	for( int done = 0; done < frames; done += ChunkFrames )
+	{
+		const int count = std::min( ChunkFrames, frames - done );
+		for( int f = 0; f < count; ++f )
+		{
+			const double p = pos + ( done + f ) * step;
+			const double first = floor( p );
+			const float fraction = float( p - first );
+			offsets[f] = (int) first - r + 1;
+
+			float * c = coeffs + f * taps;
+			if( stretch == 1.0 )
+			{
+				// interpolate between the two closest phases
+				const float phase = fraction * m_phases;
+				const int row = std::min( (int) phase, m_phases - 1 );
+				const float mix = phase - row;
+				const float * a = &m_rows[row * taps];
+				const float * b = a + taps;
+				for( int k = 0; k < taps; ++k )
+				{
+					c[k] = a[k] + mix * ( b[k] - a[k] );
+				}
+			}
+			else
+			{
+				const float scale = float( 1 / stretch );
+				float sum = 0;
+				for( int k = 0; k < taps; ++k )
+				{
+					c[k] = filter( fabsf( fraction + r - 1 - k ) * scale );
+					sum += c[k];
+				}
+				for( int k = 0; k < taps; ++k )
+				{
+					c[k] /= sum;
+				}
+			}
+		}
+		MixHelpers::convolve( dst + done, src, offsets, coeffs, taps, count );
+	}
+}
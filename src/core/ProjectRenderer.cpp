@@ -23,20 +23,40 @@
  */
 
 
+#include <QCoreApplication>
 #include <QFile>
+#include <QFileInfo>
+#include <QProcess>
+#include <QTemporaryDir>
+
+#include <cmath>
 
 #include "ProjectRenderer.h"
+#include "BufferManager.h"
+#include "denormals.h"
 #include "Song.h"
 #include "PerfLog.h"
+#include "StemWriter.h"
+#include "ThreadPolicy.h"
 
 #include "AudioFileWave.h"
 #include "AudioFileOgg.h"
 #include "AudioFileMP3.h"
 #include "AudioFileFlac.h"
 
-#ifdef LMMS_HAVE_SCHED_H
-#include "sched.h"
-#endif
+
+// What the mixer renders for when only a segment gets rendered into a stream
+// file - nothing is written, it just has the sample rate of the output
+class SegmentDevice : public AudioDevice
+{
+public:
+	SegmentDevice( const OutputSettings & outputSettings, Mixer * mixer ) :
+		AudioDevice( DEFAULT_CHANNELS, mixer )
+	{
+		setSampleRate( outputSettings.getSampleRate() );
+	}
+} ;
+
 
 const ProjectRenderer::FileEncodeDevice ProjectRenderer::fileEncodeDevices[] =
 {
@@ -82,33 +102,126 @@ ProjectRenderer::ProjectRenderer( const Mixer::qualitySettings & qualitySettings
 					ExportFileFormats exportFileFormat,
 					const QString & outputFilename ) :
 	QThread( Engine::mixer() ),
+	m_device( NULL ),
 	m_fileDev( NULL ),
+	m_jobs( 1 ),
+	m_verify( false ),
+	m_segment(),
 	m_qualitySettings( qualitySettings ),
 	m_progress( 0 ),
-	m_abort( false )
+	m_abort( false ),
+	m_failed( false )
 {
-	AudioFileDeviceInstantiaton audioEncoderFactory = fileEncodeDevices[exportFileFormat].m_getDevInst;
+	m_fileDev = createFileDevice( outputSettings, exportFileFormat,
+							outputFilename );
+	m_device = m_fileDev;
+}
 
-	if (audioEncoderFactory)
+
+
+
+ProjectRenderer::ProjectRenderer( const Mixer::qualitySettings & qualitySettings,
+					const OutputSettings & outputSettings,
+					ExportFileFormats exportFileFormat,
+					const QVector<const AudioPort *> & ports,
+					const QStringList & outputFilenames ) :
+	QThread( Engine::mixer() ),
+	m_device( NULL ),
+	m_fileDev( NULL ),
+	m_jobs( 1 ),
+	m_verify( false ),
+	m_segment(),
+	m_qualitySettings( qualitySettings ),
+	m_progress( 0 ),
+	m_abort( false ),
+	m_failed( false )
+{
+	for( int i = 0; i < ports.size(); ++i )
 	{
-		bool successful = false;
+		AudioFileDevice * dev = createFileDevice( outputSettings,
+				exportFileFormat, outputFilenames[i] );
+		if( dev == NULL )
+		{
+			break;
+		}
+		m_stems.push_back( new StemWriter( dev, ports[i] ) );
+	}
 
-		m_fileDev = audioEncoderFactory(
-					outputFilename, outputSettings, DEFAULT_CHANNELS,
-					Engine::mixer(), successful );
-		if( !successful )
+	if( m_stems.size() == ports.size() && !m_stems.isEmpty() )
+	{
+		// the mixer needs a device to render for - it takes ownership
+		m_fileDev = m_stems.front()->device();
+		m_device = m_fileDev;
+	}
+	else
+	{
+		for( StemWriter * stem : m_stems )
 		{
-			delete m_fileDev;
-			m_fileDev = NULL;
+			delete stem->device();
+			delete stem;
 		}
+		m_stems.clear();
 	}
 }
 
 
 
 
+ProjectRenderer::ProjectRenderer( const Mixer::qualitySettings & qualitySettings,
+					const OutputSettings & outputSettings,
+					const SegmentedRender::Segment & segment,
+					const QString & streamFile ) :
+	QThread( Engine::mixer() ),
+	m_device( new SegmentDevice( outputSettings, Engine::mixer() ) ),
+	m_fileDev( NULL ),
+	m_jobs( 1 ),
+	m_verify( false ),
+	m_segment( segment ),
+	m_streamFile( streamFile ),
+	m_qualitySettings( qualitySettings ),
+	m_progress( 0 ),
+	m_abort( false ),
+	m_failed( false )
+{
+}
+
+
+
+
 ProjectRenderer::~ProjectRenderer()
 {
+	for( StemWriter * stem : m_stems )
+	{
+		delete stem;
+	}
+}
+
+
+
+
+AudioFileDevice * ProjectRenderer::createFileDevice(
+					const OutputSettings & outputSettings,
+					ExportFileFormats exportFileFormat,
+					const QString & outputFilename )
+{
+	AudioFileDeviceInstantiaton audioEncoderFactory = fileEncodeDevices[exportFileFormat].m_getDevInst;
+
+	if (audioEncoderFactory)
+	{
+		bool successful = false;
+
+		AudioFileDevice * fileDev = audioEncoderFactory(
+					outputFilename, outputSettings, DEFAULT_CHANNELS,
+					Engine::mixer(), successful );
+		if( !successful )
+		{
+			delete fileDev;
+			return NULL;
+		}
+		return fileDev;
+	}
+
+	return NULL;
 }
 
 
@@ -144,6 +257,17 @@ QString ProjectRenderer::getFileExtensionFromFormat(
 
 
 
+void ProjectRenderer::setParallelRender( int jobs, bool verify,
+					const QStringList & processArgs )
+{
+	m_jobs = jobs;
+	m_verify = verify;
+	m_processArgs = processArgs;
+}
+
+
+
+
 void ProjectRenderer::startProcessing()
 {
 
@@ -151,7 +275,7 @@ void ProjectRenderer::startProcessing()
 	{
 		// Have to do mixer stuff with GUI-thread affinity in order to
 		// make slots connected to sampleRateChanged()-signals being called immediately.
-		Engine::mixer()->setAudioDevice( m_fileDev,
+		Engine::mixer()->setAudioDevice( m_device,
 						m_qualitySettings, false, false );
 
 		start(
@@ -167,19 +291,25 @@ void ProjectRenderer::startProcessing()
 void ProjectRenderer::run()
 {
 	MemoryManager::ThreadGuard mmThreadGuard; Q_UNUSED(mmThreadGuard);
-#if 0
-#if defined(LMMS_BUILD_LINUX) || defined(LMMS_BUILD_FREEBSD)
-#ifdef LMMS_HAVE_SCHED_H
-	cpu_set_t mask;
-	CPU_ZERO( &mask );
-	CPU_SET( 0, &mask );
-	sched_setaffinity( 0, sizeof( mask ), &mask );
-#endif
-#endif
-#endif
+	ThreadPolicy::apply( "Mixer", 0 );
+	// this thread processes jobs too, they must give the same results
+	// as in the worker threads
+	disable_denormals();
 
 	PerfLogTimer perfLog("Project Render");
 
+	if( !m_streamFile.isEmpty() )
+	{
+		renderSegment();
+		return;
+	}
+
+	if( m_jobs > 1 && renderInParallel() )
+	{
+		perfLog.end();
+		return;
+	}
+
 	Engine::getSong()->startExport();
 	Engine::getSong()->updateLength();
 	// Skip first empty buffer.
@@ -190,10 +320,27 @@ void ProjectRenderer::run()
 	// Now start processing
 	Engine::mixer()->startProcessing(false);
 
+	for( StemWriter * stem : m_stems )
+	{
+		stem->start();
+	}
+
 	// Continually track and emit progress percentage to listeners.
 	while (!Engine::getSong()->isExportDone() && !m_abort)
 	{
-		m_fileDev->processNextBuffer();
+		if( m_stems.isEmpty() )
+		{
+			m_fileDev->processNextBuffer();
+		}
+		else
+		{
+			// the master output isn't of interest, just the ports
+			Engine::mixer()->nextBuffer();
+			for( StemWriter * stem : m_stems )
+			{
+				stem->pushPeriod();
+			}
+		}
 		const int nprog = Engine::getSong()->getExportProgress();
 		if (m_progress != nprog)
 		{
@@ -207,14 +354,223 @@ void ProjectRenderer::run()
 
 	Engine::getSong()->stopExport();
 
+	QStringList files;
+	files << m_fileDev->outputFile();
+	for( int i = 0; i < m_stems.size(); ++i )
+	{
+		m_stems[i]->finish();
+		// the mixer still uses the first device and deletes it later
+		if( i > 0 )
+		{
+			files << m_stems[i]->device()->outputFile();
+			delete m_stems[i]->device();
+		}
+	}
+
 	perfLog.end();
 
-	// If the user aborted export-process, the file has to be deleted.
-	const QString f = m_fileDev->outputFile();
+	// If the user aborted export-process, the files have to be deleted.
 	if( m_abort )
 	{
-		QFile( f ).remove();
+		for( const QString & f : files )
+		{
+			QFile( f ).remove();
+		}
+	}
+}
+
+
+
+
+void ProjectRenderer::renderSegment()
+{
+	QFile stream( m_streamFile );
+	if( !stream.open( QIODevice::WriteOnly ) )
+	{
+		fprintf( stderr, "Could not open %s for writing\n",
+				m_streamFile.toUtf8().constData() );
+		m_failed = true;
+		return;
+	}
+
+	SegmentedRender::render( m_segment, stream, m_abort );
+}
+
+
+
+
+// Renders the segments of the song in processes of their own and puts their
+// mixer output together. Returns false if the song can't be split or the
+// segments don't add up to the whole song, which then gets rendered in a
+// single process.
+bool ProjectRenderer::renderInParallel()
+{
+	const QVector<SegmentedRender::Segment> segments =
+					SegmentedRender::split( m_jobs );
+	if( segments.size() < 2 )
+	{
+		printf( "Notice: song can't be split into segments, "
+					"rendering in a single process\n" );
+		return false;
+	}
+
+	QTemporaryDir dir;
+	if( !dir.isValid() )
+	{
+		return false;
+	}
+
+	QVector<QProcess *> processes;
+	for( int i = 0; i < segments.size(); ++i )
+	{
+		const QString base = dir.filePath( QString( "segment%1" ).arg( i ) );
+		QStringList args = m_processArgs;
+		// the output file only makes the process render, it writes
+		// just the stream file
+		args << "--output" << base
+			<< "--segment" << QString( "%1:%2:%3" ).
+						arg( segments[i].start ).
+						arg( segments[i].firstPeriod ).
+						arg( segments[i].periods )
+			<< base + ".stream";
+
+		QProcess * process = new QProcess;
+		process->setStandardOutputFile( QProcess::nullDevice() );
+		process->setProcessChannelMode( QProcess::ForwardedErrorChannel );
+		process->start( QCoreApplication::applicationFilePath(), args );
+		processes.push_back( process );
+	}
+
+	// render the whole song meanwhile for comparing
+	QFile serial( dir.filePath( "serial.stream" ) );
+	if( m_verify && serial.open( QIODevice::ReadWrite ) )
+	{
+		SegmentedRender::render( SegmentedRender::Segment{ 0, 0, -1 },
+							serial, m_abort );
+		serial.seek( 0 );
+	}
+
+	bool failed = false;
+	for( int i = 0; i < processes.size(); ++i )
+	{
+		if( m_abort )
+		{
+			processes[i]->kill();
+		}
+		processes[i]->waitForFinished( -1 );
+		failed |= processes[i]->exitStatus() != QProcess::NormalExit ||
+						processes[i]->exitCode() != 0;
+		delete processes[i];
+
+		m_progress = ( i + 1 ) * 100 / processes.size();
+		emit progressChanged( m_progress );
+	}
+
+	if( failed || m_abort )
+	{
+		if( failed )
+		{
+			fprintf( stderr, "Rendering a segment failed\n" );
+			m_failed = true;
+		}
+		QFile( m_fileDev->outputFile() ).remove();
+		return true;
+	}
+
+	const fpp_t fpp = Engine::mixer()->framesPerPeriod();
+	const qint64 periodBytes = fpp * sizeof( surroundSampleFrame );
+
+	// sound continuing into the next segment depends on what the next
+	// segment plays, e.g. in nonlinear effects
+	for( int i = 0; i < segments.size() - 1; ++i )
+	{
+		const qint64 size = QFileInfo( dir.filePath(
+			QString( "segment%1.stream" ).arg( i ) ) ).size();
+		if( size > segments[i].periods * periodBytes )
+		{
+			printf( "Notice: sound continues past tick %d, rendering "
+				"in a single process\n", segments[i + 1].start );
+			return false;
+		}
+	}
+
+	sampleFrame * period = BufferManager::acquire();
+	sampleFrame * reference = BufferManager::acquire();
+
+	f_cnt_t frame = 0;
+	f_cnt_t firstDifference = -1;
+	float maxDifference = 0;
+	bool lengthDiffers = false;
+
+	for( int i = 0; i < segments.size(); ++i )
+	{
+		QFile stream( dir.filePath( QString( "segment%1.stream" ).arg( i ) ) );
+		stream.open( QIODevice::ReadOnly );
+
+		const bool last = i == segments.size() - 1;
+		for( int p = 0; last ? !stream.atEnd() : p < segments[i].periods; ++p )
+		{
+			if( stream.read( (char *) period, periodBytes ) != periodBytes )
+			{
+				BufferManager::clear( period, fpp );
+			}
+
+			if( serial.isOpen() )
+			{
+				if( serial.read( (char *) reference, periodBytes ) !=
+								periodBytes )
+				{
+					lengthDiffers = true;
+					BufferManager::clear( reference, fpp );
+				}
+				for( f_cnt_t f = 0; f < fpp; ++f )
+				{
+					for( ch_cnt_t ch = 0; ch < DEFAULT_CHANNELS; ++ch )
+					{
+						const float d = fabsf( period[f][ch] -
+								reference[f][ch] );
+						if( d > 0 && firstDifference < 0 )
+						{
+							firstDifference = frame + f;
+						}
+						maxDifference = qMax( maxDifference, d );
+					}
+				}
+			}
+
+			m_fileDev->processBuffer( period );
+			frame += fpp;
+		}
+	}
+
+	if( serial.isOpen() )
+	{
+		if( !serial.atEnd() )
+		{
+			lengthDiffers = true;
+		}
+		if( lengthDiffers && firstDifference < 0 )
+		{
+			firstDifference = frame;
+		}
+		if( firstDifference < 0 )
+		{
+			printf( "Verification: output is identical to rendering "
+						"in a single process\n" );
+		}
+		else
+		{
+			printf( "Verification: output differs from rendering in a "
+				"single process from frame %d on, maximum "
+				"difference %g%s\n", firstDifference, maxDifference,
+				lengthDiffers ? ", length differs" : "" );
+		}
 	}
+
+	BufferManager::release( period );
+	BufferManager::release( reference );
+
+	return true;
 }
 
 
@@ -32,6 +32,7 @@
 #include "RemotePlugin.h"
 #include "Mixer.h"
 #include "Engine.h"
+#include "PerfTrace.h"
 
 #include <QDebug>
 #include <QDir>
@@ -345,18 +346,23 @@ bool RemotePlugin::process( const sampleFrame * _in_buf,
 		}
 	}
 
-	lock();
-	sendMessage( IdStartProcessing );
-
-	if( m_failed || _out_buf == NULL || m_outputCount == 0 )
 	{
+		// the round trip to the plugin process
+		PerfTrace::Span span( "RemotePlugin::process" );
+
+		lock();
+		sendMessage( IdStartProcessing );
+
+		if( m_failed || _out_buf == NULL || m_outputCount == 0 )
+		{
+			unlock();
+			return false;
+		}
+
+		waitForMessage( IdProcessingDone );
 		unlock();
-		return false;
 	}
 
-	waitForMessage( IdProcessingDone );
-	unlock();
-
 	const ch_cnt_t outputs = qMin<ch_cnt_t>( m_outputCount,
 							DEFAULT_CHANNELS );
 	if( m_splitChannels )
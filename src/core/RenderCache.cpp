@@ -0,0 +1,862 @@
+/*
+ * RenderCache.cpp - reuse the output of tracks from earlier exports
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+
+#include "RenderCache.h"
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDateTime>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QTextStream>
+#include <QtXml/QDomDocument>
+
+#include <cstdio>
+#include <cstring>
+
+#include "AutomationTrack.h"
+#include "BBTrackContainer.h"
+#include "BufferManager.h"
+#include "ConfigManager.h"
+#include "Controller.h"
+#include "Engine.h"
+#include "InstrumentTrack.h"
+#include "Mixer.h"
+#include "MixHelpers.h"
+#include "PeriodArena.h"
+#include "SampleBuffer.h"
+#include "SampleTrack.h"
+#include "Song.h"
+
+#include "lmmsversion.h"
+
+
+namespace
+{
+
+struct FileHeader
+{
+	char magic[4];
+	quint32 silent;
+	quint64 frames;
+	//! key of the range before if the track wasn't quiet when the range
+	//! started, all zero if it was
+	char previous[40];
+} ;
+
+const char Magic[4] = { 'L', 'R', 'C', '2' };
+
+
+bool readHeader( QFile & file, FileHeader & header )
+{
+	if( file.read( (char *) &header, sizeof( header ) ) != sizeof( header ) ||
+		memcmp( header.magic, Magic, sizeof( Magic ) ) != 0 )
+	{
+		return false;
+	}
+	const qint64 dataSize = header.silent ? 0 :
+				header.frames * sizeof( sampleFrame );
+	return file.size() == qint64( sizeof( header ) ) + dataSize;
+}
+
+
+
+
+bool readCacheFile( const QString & fileName, FileHeader & header )
+{
+	QFile file( fileName );
+	return file.open( QFile::ReadOnly ) && readHeader( file, header );
+}
+
+
+
+
+bool startedQuiet( const FileHeader & header )
+{
+	for( char c : header.previous )
+	{
+		if( c != 0 )
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+
+
+
+QByteArray toBytes( const QDomElement & element )
+{
+	QString text;
+	QTextStream stream( &text );
+	element.save( stream, 0 );
+	stream.flush();
+	return text.toUtf8();
+}
+
+
+
+
+//! Drop what differs between two loads of the same project and what
+//! doesn't change the sound
+void stripElement( QDomElement & element )
+{
+	element.removeAttribute( "name" );
+	element.removeAttribute( "trackheight" );
+	element.removeAttribute( "muted" );
+	element.removeAttribute( "solo" );
+	QDomNodeList journals = element.elementsByTagName( "journallingObject" );
+	for( int i = journals.count() - 1; i >= 0; --i )
+	{
+		journals.at( i ).parentNode().removeChild( journals.at( i ) );
+	}
+}
+
+
+
+
+//! Serialized TCO starting at @p start, leaving out the notes not playing in
+//! [@p from, @p to) and automation points after @p to but the first one, as
+//! values are interpolated towards it
+QByteArray windowed( const QDomElement & tco, int start, int from, int to )
+{
+	QDomElement copy = tco.cloneNode().toElement();
+	bool nextPoint = true;
+	for( QDomElement e = copy.firstChildElement(); !e.isNull(); )
+	{
+		QDomElement next = e.nextSiblingElement();
+		const int pos = start + e.attribute( "pos" ).toInt();
+		bool keep = true;
+		if( e.tagName() == "note" )
+		{
+			keep = pos < to &&
+				pos + qMax( e.attribute( "len" ).toInt(), 1 ) > from;
+		}
+		else if( e.tagName() == "time" && pos >= to )
+		{
+			keep = nextPoint;
+			nextPoint = false;
+		}
+		if( !keep )
+		{
+			copy.removeChild( e );
+		}
+		e = next;
+	}
+	return toBytes( copy );
+}
+
+
+
+
+//! What changes the output of all tracks
+QByteArray globalState( Song * song, QDomDocument & doc, QDomElement & root )
+{
+	const Mixer * mixer = Engine::mixer();
+	QByteArray global = QString( "%1 %2 %3 %4 %5 %6 %7 %8 %9" ).
+		arg( LMMS_VERSION ).
+		arg( mixer->processingSampleRate() ).
+		arg( mixer->framesPerPeriod() ).
+		arg( mixer->currentQualitySettings().interpolation ).
+		arg( mixer->currentQualitySettings().oversampling ).
+		arg( song->getTempo() ).
+		arg( song->masterPitch() ).
+		arg( song->getTimeSigModel().getNumerator() ).
+		arg( song->getTimeSigModel().getDenominator() ).toUtf8();
+	for( Controller * controller : song->controllers() )
+	{
+		QDomElement element = controller->saveState( doc, root );
+		stripElement( element );
+		global += toBytes( element );
+	}
+	// automation in the beat/bassline editor plays along with any BB track
+	for( Track * track : Engine::getBBTrackContainer()->tracks() )
+	{
+		if( track->type() == Track::AutomationTrack )
+		{
+			QDomElement element = track->saveState( doc, root );
+			stripElement( element );
+			global += toBytes( element );
+		}
+	}
+	return global;
+}
+
+
+
+
+TrackList automationTracks( Song * song )
+{
+	TrackList tracks;
+	tracks << song->globalAutomationTrack();
+	for( Track * track : song->tracks() )
+	{
+		if( track->type() == Track::AutomationTrack )
+		{
+			tracks << track;
+		}
+	}
+	return tracks;
+}
+
+
+
+
+//! Size and modification time of the files loaded by @p element, like the
+//! samples of sample TCOs and instruments and user waves of LFOs, as they
+//! may change on disk
+QByteArray fileState( const QDomElement & element )
+{
+	QByteArray state;
+	for( const char * attribute : { "src", "userwavefile" } )
+	{
+		const QString file = element.attribute( attribute );
+		if( !file.isEmpty() )
+		{
+			QFileInfo info( SampleBuffer::tryToMakeAbsolute( file ) );
+			state += QByteArray::number( info.size() ) + ' ' +
+				QByteArray::number( info.lastModified().toMSecsSinceEpoch() ) + ' ';
+		}
+	}
+	for( QDomElement e = element.firstChildElement(); !e.isNull();
+						e = e.nextSiblingElement() )
+	{
+		state += fileState( e );
+	}
+	return state;
+}
+
+
+
+
+//! Whether a model saved in @p element is connected to a peak controller,
+//! which follows the audio of other tracks
+bool usesPeakController( const QDomElement & element, bool connection = false )
+{
+	if( connection && element.hasAttribute( "id" ) )
+	{
+		const ControllerVector & controllers =
+					Engine::getSong()->controllers();
+		const int id = element.attribute( "id" ).toInt();
+		if( id >= 0 && id < controllers.size() &&
+			controllers[id]->type() == Controller::PeakController )
+		{
+			return true;
+		}
+	}
+	connection = connection || element.tagName() == "connection";
+	for( QDomElement e = element.firstChildElement(); !e.isNull();
+						e = e.nextSiblingElement() )
+	{
+		if( usesPeakController( e, connection ) )
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+}
+
+
+
+
+QString RenderCache::s_directory;
+
+
+
+
+RenderCache::RenderCache( const QString & dir, Song * song,
+						const MidiTime & end ) :
+	m_dir( dir ),
+	m_rangeTicks( RangeTacts * MidiTime::ticksPerTact() ),
+	m_ranges( ( end.getTicks() + m_rangeTicks - 1 ) / m_rangeTicks ),
+	m_endTick( end.getTicks() ),
+	m_lastTick( -1 ),
+	m_range( -1 ),
+	m_segmentCount( 0 )
+{
+	if( !QDir().mkpath( m_dir ) )
+	{
+		printf( "Notice: could not create render cache directory %s\n",
+							qPrintable( m_dir ) );
+		return;
+	}
+
+	QDomDocument doc;
+	QDomElement root = doc.createElement( "rendercache" );
+	doc.appendChild( root );
+
+	const QByteArray global = globalState( song, doc, root );
+
+	// an automated value stays until the next point, so each range depends
+	// on all automation before its end
+	QVector<QPair<int, QDomElement> > automation;
+	for( Track * track : automationTracks( song ) )
+	{
+		for( TrackContentObject * tco : track->getTCOs() )
+		{
+			QDomElement element = tco->saveState( doc, root );
+			stripElement( element );
+			automation << qMakePair( tco->startPosition().getTicks(), element );
+		}
+	}
+	QVector<QByteArray> automationKeys( m_ranges );
+	for( int range = 0; range < m_ranges; ++range )
+	{
+		const int to = ( range + 1 ) * m_rangeTicks;
+		QCryptographicHash hash( QCryptographicHash::Sha1 );
+		hash.addData( global );
+		for( const auto & pattern : automation )
+		{
+			if( pattern.first < to )
+			{
+				hash.addData( windowed( pattern.second, pattern.first, 0, to ) );
+			}
+		}
+		automationKeys[range] = hash.result();
+	}
+
+	for( Track * track : song->tracks() )
+	{
+		if( track->isMuted() )
+		{
+			continue;
+		}
+		if( InstrumentTrack * instrumentTrack = dynamic_cast<InstrumentTrack *>( track ) )
+		{
+			addTrack( track, instrumentTrack->audioPort(), automationKeys );
+		}
+		else if( SampleTrack * sampleTrack = dynamic_cast<SampleTrack *>( track ) )
+		{
+			addTrack( track, sampleTrack->audioPort(), automationKeys );
+		}
+	}
+
+	int reused = 0;
+	for( const Entry * entry : m_tracks )
+	{
+		for( int range = 0; range < m_ranges; ++range )
+		{
+			reused += entry->cached.testBit( range ) &&
+					!entry->live.testBit( range );
+		}
+	}
+	printf( "Notice: render cache reuses %d of %d track ranges\n",
+					reused, m_tracks.size() * m_ranges );
+}
+
+
+
+
+RenderCache::~RenderCache()
+{
+	for( Entry * entry : m_tracks )
+	{
+		closeReader( entry );
+		closeWriter( entry, false );
+		delete entry;
+	}
+}
+
+
+
+
+void RenderCache::setDirectory( const QString & dir )
+{
+	s_directory = dir;
+}
+
+
+
+
+QString RenderCache::directory()
+{
+	if( !s_directory.isEmpty() )
+	{
+		return s_directory;
+	}
+	return ConfigManager::inst()->value( "mixer", "rendercache" );
+}
+
+
+
+
+void RenderCache::finish( tick_t position )
+{
+	for( Entry * entry : m_tracks )
+	{
+		closeReader( entry );
+		// ranges are written while playing on from their start, so the
+		// one being written is complete once we got past its end
+		if( entry->writer )
+		{
+			const int end = qMin( ( entry->writerRange + 1 ) * m_rangeTicks,
+								m_endTick );
+			closeWriter( entry, position >= end );
+		}
+	}
+}
+
+
+
+
+QByteArray RenderCache::trackKey( Track * track )
+{
+	Song * song = Engine::getSong();
+	QDomDocument doc;
+	QDomElement root = doc.createElement( "rendercache" );
+	doc.appendChild( root );
+
+	QCryptographicHash hash( QCryptographicHash::Sha1 );
+	hash.addData( globalState( song, doc, root ) );
+	for( Track * automationTrack : automationTracks( song ) )
+	{
+		QDomElement element = automationTrack->saveState( doc, root );
+		stripElement( element );
+		hash.addData( toBytes( element ) );
+	}
+	QDomElement element = track->saveState( doc, root );
+	stripElement( element );
+	hash.addData( toBytes( element ) );
+	hash.addData( fileState( element ) );
+	return hash.result();
+}
+
+
+
+
+void RenderCache::startPeriod()
+{
+	m_segmentCount = 0;
+}
+
+
+
+
+void RenderCache::playTick( tick_t tick, f_cnt_t offset )
+{
+	const bool rangeStart = tick % m_rangeTicks == 0;
+	if( m_lastTick >= 0 && tick == m_lastTick + 1 && !rangeStart )
+	{
+		m_lastTick = tick;
+		return;
+	}
+
+	// a new range starts or playback jumped
+	Segment segment;
+	segment.offset = offset;
+	segment.range = rangeStart ? tick / m_rangeTicks : -1;
+	segment.previousComplete = m_range >= 0 &&
+				( m_lastTick + 1 ) % m_rangeTicks == 0;
+	if( m_segmentCount < MaxSegments )
+	{
+		m_segments[m_segmentCount++] = segment;
+	}
+	else
+	{
+		// too many jumps in one period, don't trust any of them
+		m_segments[MaxSegments - 1].range = -1;
+		segment.range = -1;
+	}
+
+	m_lastTick = tick;
+	m_range = segment.range;
+}
+
+
+
+
+bool RenderCache::isCached( const Track * track ) const
+{
+	if( m_range < 0 || m_range >= m_ranges )
+	{
+		return false;
+	}
+	const Entry * entry = m_tracks.value( track );
+	return entry && !entry->live.testBit( m_range );
+}
+
+
+
+
+const sampleFrame * RenderCache::processPort( const AudioPort * port,
+					const sampleFrame * buffer, bool silent,
+					f_cnt_t quietFrames )
+{
+	Entry * entry = m_ports.value( port );
+	if( entry == NULL )
+	{
+		return silent ? NULL : buffer;
+	}
+
+	const fpp_t fpp = Engine::mixer()->framesPerPeriod();
+	sampleFrame * output = NULL;
+	sampleFrame * zeros = NULL;
+
+	f_cnt_t begin = 0;
+	for( int i = 0; i <= m_segmentCount; ++i )
+	{
+		const f_cnt_t end = i < m_segmentCount ? m_segments[i].offset : fpp;
+		const f_cnt_t frames = end - begin;
+		if( frames > 0 && entry->writer )
+		{
+			if( silent && zeros == NULL )
+			{
+				zeros = PeriodArena::alloc<sampleFrame>( fpp );
+				BufferManager::clear( zeros, fpp );
+			}
+			const sampleFrame * src = silent ? zeros : buffer + begin;
+			if( !silent && entry->writerSilent )
+			{
+				entry->writerSilent = MixHelpers::isSilent( src, frames );
+			}
+			entry->writer->write( (const char *) src,
+						frames * sizeof( sampleFrame ) );
+		}
+		if( frames > 0 && entry->reader )
+		{
+			if( output == NULL )
+			{
+				// frames before come from the port
+				output = PeriodArena::alloc<sampleFrame>( fpp );
+				if( silent )
+				{
+					BufferManager::clear( output, begin );
+				}
+				else
+				{
+					memcpy( output, buffer, begin * sizeof( sampleFrame ) );
+				}
+			}
+			const f_cnt_t available = entry->data ?
+				qBound( 0, entry->frames - entry->position, frames ) : 0;
+			if( available > 0 )
+			{
+				memcpy( output + begin, entry->data + entry->position,
+						available * sizeof( sampleFrame ) );
+			}
+			BufferManager::clear( output + begin + available,
+							frames - available );
+			entry->position += frames;
+		}
+		else if( frames > 0 && output )
+		{
+			if( silent )
+			{
+				BufferManager::clear( output + begin, frames );
+			}
+			else
+			{
+				memcpy( output + begin, buffer + begin,
+						frames * sizeof( sampleFrame ) );
+			}
+		}
+
+		if( i < m_segmentCount )
+		{
+			// nothing sounded since the end of the last period and no
+			// note started before the range
+			const bool quiet = entry->quiet && end <= quietFrames;
+			enterRange( entry, m_segments[i], quiet );
+		}
+		begin = end;
+	}
+	entry->quiet = quietFrames >= fpp;
+
+	if( output )
+	{
+		return output;
+	}
+	return silent ? NULL : buffer;
+}
+
+
+
+
+void RenderCache::addTrack( Track * track, AudioPort * port,
+				const QVector<QByteArray> & automationKeys )
+{
+	QDomDocument doc;
+	QDomElement root = doc.createElement( "rendercache" );
+	doc.appendChild( root );
+
+	// settings, instrument and effects without the TCOs
+	track->setSimpleSerializing();
+	QDomElement settings = track->saveState( doc, root );
+	if( usesPeakController( settings ) )
+	{
+		printf( "Notice: render cache skips track %s as it follows a "
+				"peak controller\n", qPrintable( track->name() ) );
+		return;
+	}
+	stripElement( settings );
+	const QByteArray trackKey = toBytes( settings ) + fileState( settings );
+
+	struct Content
+	{
+		int start;
+		int end;
+		QDomElement element;
+		QByteArray file;
+	} ;
+	QVector<Content> contents;
+	for( TrackContentObject * tco : track->getTCOs() )
+	{
+		Content content;
+		content.start = tco->startPosition().getTicks();
+		content.end = tco->endPosition().getTicks();
+		content.element = tco->saveState( doc, root );
+		stripElement( content.element );
+		content.file = fileState( content.element );
+		contents << content;
+	}
+
+	Entry * entry = new Entry;
+	entry->keys.resize( m_ranges );
+	entry->cached.resize( m_ranges );
+	entry->live.resize( m_ranges );
+	entry->reader = NULL;
+	entry->data = NULL;
+	entry->frames = 0;
+	entry->position = 0;
+	entry->writer = NULL;
+	entry->writerRange = -1;
+	entry->writerSilent = true;
+	entry->writerQuiet = true;
+	entry->quiet = true;
+
+	QBitArray quietStart( m_ranges );
+	for( int range = 0; range < m_ranges; ++range )
+	{
+		const int from = ( range - TailRanges ) * m_rangeTicks;
+		const int to = ( range + 1 ) * m_rangeTicks;
+		QCryptographicHash hash( QCryptographicHash::Sha1 );
+		hash.addData( automationKeys[range] );
+		hash.addData( trackKey );
+		hash.addData( QByteArray::number( range ) );
+		for( const Content & content : contents )
+		{
+			if( content.start < to && content.end > from )
+			{
+				hash.addData( windowed( content.element,
+							content.start, from, to ) );
+				hash.addData( content.file );
+			}
+		}
+		entry->keys[range] = QString( hash.result().toHex() );
+
+		// a range which didn't start quiet depends on the range before
+		// it was rendered after
+		FileHeader header;
+		if( readCacheFile( fileName( entry->keys[range] ), header ) )
+		{
+			quietStart.setBit( range, startedQuiet( header ) );
+			entry->cached.setBit( range, quietStart.testBit( range ) ||
+				( range > 0 && entry->cached.testBit( range - 1 ) &&
+					QByteArray( header.previous, sizeof( header.previous ) ) ==
+						entry->keys[range - 1].toLatin1() ) );
+		}
+	}
+
+	// play ahead of ranges to render from where the track was quiet, so
+	// they start with the right notes, releases and effect tails
+	for( int range = 0; range < m_ranges; ++range )
+	{
+		if( entry->cached.testBit( range ) )
+		{
+			continue;
+		}
+		entry->live.setBit( range );
+		for( int before = range - 1; before >= 0 &&
+				entry->cached.testBit( before ); --before )
+		{
+			entry->live.setBit( before );
+			if( quietStart.testBit( before ) )
+			{
+				break;
+			}
+		}
+	}
+
+	m_tracks[track] = entry;
+	m_ports[port] = entry;
+}
+
+
+
+
+void RenderCache::enterRange( Entry * entry, const Segment & segment,
+								bool quiet )
+{
+	closeWriter( entry, segment.previousComplete );
+	closeReader( entry );
+
+	// we jumped into the middle of a range or beyond the end
+	if( segment.range < 0 || segment.range >= m_ranges )
+	{
+		return;
+	}
+
+	if( entry->cached.testBit( segment.range ) )
+	{
+		openReader( entry, segment.range );
+	}
+	else
+	{
+		openWriter( entry, segment.range, quiet );
+	}
+}
+
+
+
+
+bool RenderCache::openReader( Entry * entry, int range )
+{
+	QFile * file = new QFile( fileName( entry->keys[range] ) );
+	FileHeader header;
+	if( !file->open( QFile::ReadOnly ) || !readHeader( *file, header ) )
+	{
+		printf( "Notice: could not read %s from render cache\n",
+						qPrintable( file->fileName() ) );
+		delete file;
+		return false;
+	}
+
+	entry->data = NULL;
+	entry->frames = header.frames;
+	entry->position = 0;
+	if( !header.silent && header.frames > 0 )
+	{
+		entry->data = (const sampleFrame *) file->map( sizeof( header ),
+					header.frames * sizeof( sampleFrame ) );
+		if( entry->data == NULL )
+		{
+			printf( "Notice: could not map %s from render cache\n",
+						qPrintable( file->fileName() ) );
+			delete file;
+			return false;
+		}
+	}
+	entry->reader = file;
+	return true;
+}
+
+
+
+
+void RenderCache::closeReader( Entry * entry )
+{
+	// deleting the file unmaps it
+	delete entry->reader;
+	entry->reader = NULL;
+	entry->data = NULL;
+}
+
+
+
+
+void RenderCache::openWriter( Entry * entry, int range, bool quiet )
+{
+	QFile * file = new QFile( tempFileName( entry->keys[range] ) );
+	FileHeader header = FileHeader();
+	if( !file->open( QFile::WriteOnly | QFile::Truncate ) ||
+		file->write( (const char *) &header, sizeof( header ) ) !=
+							sizeof( header ) )
+	{
+		printf( "Notice: could not write %s to render cache\n",
+						qPrintable( file->fileName() ) );
+		delete file;
+		return;
+	}
+	entry->writer = file;
+	entry->writerRange = range;
+	entry->writerSilent = true;
+	entry->writerQuiet = quiet;
+}
+
+
+
+
+void RenderCache::closeWriter( Entry * entry, bool commit )
+{
+	QFile * file = entry->writer;
+	if( file == NULL )
+	{
+		return;
+	}
+	entry->writer = NULL;
+
+	FileHeader header;
+	memcpy( header.magic, Magic, sizeof( Magic ) );
+	header.silent = entry->writerSilent;
+	header.frames = ( file->pos() - sizeof( header ) ) / sizeof( sampleFrame );
+	memset( header.previous, 0, sizeof( header.previous ) );
+	if( !entry->writerQuiet )
+	{
+		// nothing to depend on before the first range, so never reuse it
+		const QByteArray previous = entry->writerRange > 0 ?
+			entry->keys[entry->writerRange - 1].toLatin1() :
+			QByteArray( sizeof( header.previous ), '-' );
+		memcpy( header.previous, previous.constData(),
+			qMin<int>( previous.size(), sizeof( header.previous ) ) );
+	}
+
+	bool ok = commit && file->error() == QFile::NoError;
+	if( ok && entry->writerSilent )
+	{
+		ok = file->resize( sizeof( header ) );
+	}
+	ok = ok && file->seek( 0 ) &&
+		file->write( (const char *) &header, sizeof( header ) ) ==
+							sizeof( header );
+	file->close();
+
+	// another process may have rendered the same range meanwhile
+	const QString name = fileName( entry->keys[entry->writerRange] );
+	if( !ok || QFile::exists( name ) || !file->rename( name ) )
+	{
+		file->remove();
+	}
+	delete file;
+}
+
+
+
+
+QString RenderCache::fileName( const QString & key ) const
+{
+	return m_dir + QDir::separator() + key + ".cache";
+}
+
+
+
+
+QString RenderCache::tempFileName( const QString & key ) const
+{
+	return fileName( key ) + '.' +
+		QString::number( QCoreApplication::applicationPid() ) + ".tmp";
+}
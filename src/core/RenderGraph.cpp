@@ -0,0 +1,243 @@
+/*
+ * RenderGraph.cpp - dependency graph of play handles, audio ports and FX channels
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#include "RenderGraph.h"
+
+#include "AudioPort.h"
+#include "Engine.h"
+#include "FxMixer.h"
+#include "MixerWorkerThread.h"
+#include "PlayHandleRegistry.h"
+
+
+RenderGraph::Node::Node( Types type, ThreadableJob * job ) :
+	m_type( type ),
+	m_job( job ),
+	m_dependencies( 0 ),
+	m_pending( 0 ),
+	m_successors()
+{
+}
+
+
+
+
+void RenderGraph::Node::doProcessing()
+{
+	switch( m_type )
+	{
+		case PlayHandleNode:
+		case AudioPortNode:
+			m_job->process();
+			break;
+		case FxChannelNode:
+			static_cast<FxChannel *>( m_job )->processChannel();
+			break;
+	}
+
+	// queue all nodes for which we were the last missing input
+	for( Node * successor : m_successors )
+	{
+		if( --successor->m_pending == 0 )
+		{
+			MixerWorkerThread::addJob( successor );
+		}
+	}
+}
+
+
+
+
+RenderGraph::RenderGraph() :
+	m_valid( false )
+{
+}
+
+
+
+
+RenderGraph::~RenderGraph()
+{
+	clear();
+	for( Node * n : m_handleNodes )
+	{
+		delete n;
+	}
+}
+
+
+
+
+void RenderGraph::clear()
+{
+	for( Node * n : m_portNodes )
+	{
+		delete n;
+	}
+	for( Node * n : m_channelNodes )
+	{
+		delete n;
+	}
+	m_portNodes.clear();
+	m_channelNodes.clear();
+	m_nodeOfPort.clear();
+}
+
+
+
+
+void RenderGraph::rebuild( const QVector<AudioPort *> & audioPorts )
+{
+	clear();
+
+	FxMixer * fxMixer = Engine::fxMixer();
+
+	for( fx_ch_t i = 0; i < fxMixer->numChannels(); ++i )
+	{
+		m_channelNodes.push_back( new Node( Node::FxChannelNode,
+						fxMixer->effectChannel( i ) ) );
+	}
+
+	// channel -> channel edges
+	for( Node * n : m_channelNodes )
+	{
+		for( const FxRoute * route : static_cast<FxChannel *>( n->m_job )->m_sends )
+		{
+			Node * receiver = m_channelNodes[route->receiverIndex()];
+			n->m_successors.push_back( receiver );
+			++receiver->m_dependencies;
+		}
+	}
+
+	// port -> channel edges
+	for( AudioPort * port : audioPorts )
+	{
+		Node * n = new Node( Node::AudioPortNode, port );
+
+		fx_ch_t channel = port->nextFxChannel();
+		if( channel >= m_channelNodes.size() )
+		{
+			channel = 0;
+		}
+		n->m_successors.push_back( m_channelNodes[channel] );
+		++m_channelNodes[channel]->m_dependencies;
+
+		m_portNodes.push_back( n );
+		m_nodeOfPort.insert( port, n );
+	}
+
+	m_valid = true;
+}
+
+
+
+
+RenderGraph::Node * RenderGraph::nodeForHandle( int index )
+{
+	if( index >= (int) m_handleNodes.size() )
+	{
+		m_handleNodes.push_back( new Node( Node::PlayHandleNode, NULL ) );
+	}
+	return m_handleNodes[index];
+}
+
+
+
+
+void RenderGraph::render( PlayHandleRegistry & playHandles,
+				const QVector<AudioPort *> & audioPorts,
+				sampleFrame * masterOut )
+{
+	if( !m_valid )
+	{
+		rebuild( audioPorts );
+	}
+
+	for( Node * n : m_portNodes )
+	{
+		n->m_pending = n->m_dependencies;
+	}
+	for( Node * n : m_channelNodes )
+	{
+		n->m_pending = n->m_dependencies;
+		// determine mute state once per period
+		FxChannel * ch = static_cast<FxChannel *>( n->m_job );
+		ch->m_muted = ch->m_muteModel.value();
+	}
+
+	// attach this period's play handles to their ports
+	int handles = 0;
+	for( int slot = 0; slot < playHandles.slots(); ++slot )
+	{
+		PlayHandle * ph = playHandles.at( slot );
+		if( ph == NULL )
+		{
+			continue;
+		}
+		if( !ph->requiresProcessing() )
+		{
+			playHandles.setFinished( slot, true );
+			continue;
+		}
+		Node * n = nodeForHandle( handles++ );
+		n->m_job = ph;
+		n->m_successors.clear();
+
+		Node * port = m_nodeOfPort.value( ph->audioPort(), NULL );
+		if( port )
+		{
+			n->m_successors.push_back( port );
+			++port->m_pending;
+		}
+	}
+
+	// queue all nodes without pending inputs - everything else gets
+	// queued by its last input
+	MixerWorkerThread::resetJobQueue( MixerWorkerThread::JobQueue::Dynamic );
+	for( Node * n : m_portNodes )
+	{
+		n->m_job->queue();
+	}
+	for( int i = 0; i < handles; ++i )
+	{
+		m_handleNodes[i]->m_job->queue();
+		MixerWorkerThread::addJob( m_handleNodes[i] );
+	}
+	for( Node * n : m_portNodes )
+	{
+		if( n->m_pending == 0 )
+		{
+			MixerWorkerThread::addJob( n );
+		}
+	}
+	for( Node * n : m_channelNodes )
+	{
+		if( n->m_pending == 0 )
+		{
+			MixerWorkerThread::addJob( n );
+		}
+	}
+	MixerWorkerThread::startAndWaitForJobs();
+
+	Engine::fxMixer()->finishMasterMix( masterOut );
+}
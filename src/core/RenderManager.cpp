@@ -29,6 +29,10 @@
 #include "Song.h"
 #include "BBTrackContainer.h"
 #include "BBTrack.h"
+#include "Controller.h"
+#include "FxMixer.h"
+#include "InstrumentTrack.h"
+#include "SampleTrack.h"
 #include "stdshims.h"
 
 
@@ -41,7 +45,12 @@ RenderManager::RenderManager(
 	m_oldQualitySettings( Engine::mixer()->currentQualitySettings() ),
 	m_outputSettings(outputSettings),
 	m_format(fmt),
-	m_outputPath(outputPath)
+	m_outputPath(outputPath),
+	m_onePass(false),
+	m_failed(false),
+	m_jobs(1),
+	m_verify(false),
+	m_segment()
 {
 	Engine::mixer()->storeAudioDevice();
 }
@@ -65,6 +74,10 @@ void RenderManager::abortProcessing()
 // Called to render each new track when rendering tracks individually.
 void RenderManager::renderNextTrack()
 {
+	if( m_activeRenderer && m_activeRenderer->hasFailed() )
+	{
+		m_failed = true;
+	}
 	m_activeRenderer.reset();
 
 	if( m_tracksToRender.isEmpty() )
@@ -129,13 +142,121 @@ void RenderManager::renderTracks()
 	// we need to remember which tracks were unmuted to restore state at the end.
 	m_tracksToRender = m_unmuted;
 
-	renderNextTrack();
+	if( !renderTracksInOnePass() )
+	{
+		renderNextTrack();
+	}
+}
+
+static const AudioPort * audioPortOf( Track * track )
+{
+	switch( track->type() )
+	{
+		case Track::InstrumentTrack:
+			return static_cast<InstrumentTrack *>( track )->audioPort();
+		case Track::SampleTrack:
+			return static_cast<SampleTrack *>( track )->audioPort();
+		default:
+			return NULL;
+	}
+}
+
+// Rendering a single track with all others muted gives exactly what its audio
+// port sends to the FX mixer as long as nothing on the way to the master
+// output changes it and no peak controller follows the audio of the tracks.
+// In that case all tracks can be written while rendering the song once
+// instead of once per track.
+bool RenderManager::renderTracksInOnePass()
+{
+	// with the other tracks muted, peak controllers follow a different
+	// signal than when rendering the song
+	for( Controller * controller : Engine::getSong()->controllers() )
+	{
+		if( controller->type() == Controller::PeakController )
+		{
+			return false;
+		}
+	}
+
+	QVector<const AudioPort *> ports;
+	QStringList paths;
+	for( int i = 0; i < m_tracksToRender.size(); ++i )
+	{
+		const AudioPort * port = audioPortOf( m_tracksToRender[i] );
+		bool sanitizesFirst, clamps;
+		if( port == NULL || !Engine::fxMixer()->isTransparentPath(
+				port->nextFxChannel(), sanitizesFirst, clamps ) )
+		{
+			return false;
+		}
+		ports.push_back( port );
+		// same numbering as when rendering track by track
+		paths.push_back( pathForTrack( m_tracksToRender[i], i + 1 ) );
+	}
+
+	if( ports.size() < 2 )
+	{
+		return false;
+	}
+
+	m_activeRenderer = make_unique<ProjectRenderer>(
+			m_qualitySettings,
+			m_outputSettings,
+			m_format,
+			ports,
+			paths);
+
+	if( !m_activeRenderer->isReady() )
+	{
+		// let the single renders report which file failed
+		m_activeRenderer.reset();
+		return false;
+	}
+
+	m_onePass = true;
+	m_tracksToRender.clear();
+	startRenderer();
+	return true;
+}
+
+void RenderManager::setParallelRender( int jobs, bool verify,
+					const QStringList & processArgs )
+{
+	m_jobs = jobs;
+	m_verify = verify;
+	m_processArgs = processArgs;
+}
+
+void RenderManager::setSegment( const SegmentedRender::Segment & segment,
+					const QString & streamFile )
+{
+	m_segment = segment;
+	m_streamFile = streamFile;
 }
 
 // Render the song into a single track
 void RenderManager::renderProject()
 {
-	render( m_outputPath );
+	if( !m_streamFile.isEmpty() )
+	{
+		m_activeRenderer = make_unique<ProjectRenderer>(
+				m_qualitySettings,
+				m_outputSettings,
+				m_segment,
+				m_streamFile);
+		startRenderer();
+		return;
+	}
+
+	m_activeRenderer = make_unique<ProjectRenderer>(
+			m_qualitySettings,
+			m_outputSettings,
+			m_format,
+			m_outputPath);
+
+	m_activeRenderer->setParallelRender( m_jobs, m_verify, m_processArgs );
+
+	startRenderer();
 }
 
 void RenderManager::render(QString outputPath)
@@ -146,6 +267,11 @@ void RenderManager::render(QString outputPath)
 			m_format,
 			outputPath);
 
+	startRenderer();
+}
+
+void RenderManager::startRenderer()
+{
 	if( m_activeRenderer->isReady() )
 	{
 		// pass progress signals through
@@ -194,7 +320,11 @@ void RenderManager::updateConsoleProgress()
 		m_activeRenderer->updateConsoleProgress();
 
 		int totalNum = m_unmuted.size();
-		if ( totalNum > 0 )
+		if ( m_onePass )
+		{
+			fprintf( stderr, "(%d tracks)", totalNum );
+		}
+		else if ( totalNum > 0 )
 		{
 			// we are rendering multiple tracks, append a track counter to the output
 			int trackNum = totalNum - m_tracksToRender.size();
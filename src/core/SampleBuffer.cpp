@@ -26,11 +26,18 @@
 
 
 #include <QBuffer>
+#include <QCoreApplication>
 #include <QFile>
 #include <QFileInfo>
 #include <QMessageBox>
+#include <QMutex>
 #include <QPainter>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
 
+#include <algorithm>
+#include <atomic>
 
 #include <sndfile.h>
 
@@ -55,11 +62,99 @@
 #include "Engine.h"
 #include "GuiApplication.h"
 #include "Mixer.h"
+#include "PeriodArena.h"
+#include "PolyphaseResampler.h"
+#include "SampleCache.h"
+#include "SamplePeaks.h"
+#include "SampleStream.h"
+#include "Song.h"
 
 #include "FileDialog.h"
 
 
 
+// shared by the buffer and the task building its overview, so a buffer
+// which goes away doesn't have to wait for a task which didn't start
+struct SampleBuffer::PeaksJob
+{
+	const sampleFrame * data;
+	f_cnt_t frames;
+	QByteArray cacheKey;
+	std::atomic_bool cancelled;
+	// held while building, so the buffer keeps the data until done
+	QMutex mutex;
+	QAtomicPointer<SamplePeaks> peaks;
+
+	~PeaksJob()
+	{
+		delete peaks.load();
+	}
+} ;
+
+
+
+class SampleBuffer::PeaksTask : public QRunnable
+{
+public:
+	PeaksTask( const QSharedPointer<PeaksJob> & _job ) :
+		m_job( _job )
+	{
+	}
+
+	void run() override
+	{
+		QMutexLocker locker( &m_job->mutex );
+		if( !m_job->cancelled )
+		{
+			m_job->peaks.storeRelease( SamplePeaks::create( m_job->data,
+					m_job->frames, m_job->cacheKey, &m_job->cancelled ) );
+		}
+	}
+
+private:
+	QSharedPointer<PeaksJob> m_job;
+
+} ;
+
+
+
+// File size and sample length limits
+static const int FileSizeMax = 300; // MB
+static const int SampleLengthMax = 90; // Minutes
+
+// whether a file is too large to be decoded, @p frames is set to its length
+// at its own sample rate if libsndfile can read it
+static bool exceedsLimits( const QString & file, f_cnt_t & frames )
+{
+	frames = 0;
+	if( QFileInfo( file ).size() > FileSizeMax * 1024 * 1024 )
+	{
+		return true;
+	}
+
+	bool tooLong = false;
+	// Use QFile to handle unicode file names on Windows
+	QFile f(file);
+	f.open(QIODevice::ReadOnly);
+	SNDFILE * snd_file;
+	SF_INFO sf_info;
+	sf_info.format = 0;
+	if( ( snd_file = sf_open_fd( f.handle(), SFM_READ, &sf_info, false ) ) != NULL )
+	{
+		frames = sf_info.frames;
+		int rate = sf_info.samplerate;
+		if( frames / rate > SampleLengthMax * 60 )
+		{
+			tooLong = true;
+		}
+		sf_close( snd_file );
+	}
+	f.close();
+	return tooLong;
+}
+
+
+
 SampleBuffer::SampleBuffer() :
 	m_audioFile( "" ),
 	m_origData( NULL ),
@@ -73,7 +168,10 @@ SampleBuffer::SampleBuffer() :
 	m_amplification( 1.0f ),
 	m_reversed( false ),
 	m_frequency( BaseFreq ),
-	m_sampleRate( mixerSampleRate () )
+	m_sampleRate( mixerSampleRate () ),
+	m_streamingEnabled( false ),
+	m_stream( NULL ),
+	m_dataCached( false )
 {
 
 	connect( Engine::mixer(), SIGNAL( sampleRateChanged() ), this, SLOT( sampleRateChanged() ) );
@@ -132,8 +230,78 @@ SampleBuffer::SampleBuffer( const f_cnt_t _frames )
 
 SampleBuffer::~SampleBuffer()
 {
+	stopPeaks();
 	MM_FREE( m_origData );
-	MM_FREE( m_data );
+	releaseData();
+	delete m_stream;
+}
+
+
+
+
+void SampleBuffer::releaseData()
+{
+	if( m_dataCached )
+	{
+		SampleCache::release( m_data );
+		m_dataCached = false;
+	}
+	else
+	{
+		MM_FREE( m_data );
+	}
+	m_data = NULL;
+}
+
+
+
+
+void SampleBuffer::reverseData()
+{
+	if( m_dataCached )
+	{
+		// the mapped data is shared and read-only
+		sampleFrame * data = MM_ALLOC( sampleFrame, m_frames );
+		for( f_cnt_t frame = 0; frame < m_frames; ++frame )
+		{
+			data[frame][0] = m_data[m_frames - 1 - frame][0];
+			data[frame][1] = m_data[m_frames - 1 - frame][1];
+		}
+		releaseData();
+		m_data = data;
+	}
+	else
+	{
+		std::reverse( m_data, m_data + m_frames );
+	}
+}
+
+
+
+
+void SampleBuffer::startPeaks( const QByteArray & _cache_key )
+{
+	m_peaks = QSharedPointer<PeaksJob>( new PeaksJob );
+	m_peaks->data = m_data;
+	m_peaks->frames = m_frames;
+	m_peaks->cacheKey = _cache_key;
+	m_peaks->cancelled = false;
+	QThreadPool::globalInstance()->start( new PeaksTask( m_peaks ) );
+}
+
+
+
+
+void SampleBuffer::stopPeaks()
+{
+	if( m_peaks )
+	{
+		// a task which didn't start yet won't touch the data anymore
+		m_peaks->cancelled = true;
+		m_peaks->mutex.lock();
+		m_peaks->mutex.unlock();
+		m_peaks.clear();
+	}
 }
 
 
@@ -151,20 +319,42 @@ sample_rate_t SampleBuffer::mixerSampleRate()
 
 void SampleBuffer::update( bool _keep_settings )
 {
-	const bool lock = ( m_data != NULL );
+	stopPeaks();
+
+	const bool lock = ( m_data != NULL || m_stream != NULL );
 	if( lock )
 	{
 		Engine::mixer()->requestChangeInModel();
 		m_varLock.lockForWrite();
-		MM_FREE( m_data );
+		releaseData();
+		delete m_stream;
+		m_stream = NULL;
 	}
 
-	// File size and sample length limits
-	const int fileSizeMax = 300; // MB
-	const int sampleLengthMax = 90; // Minutes
+	// long files are read from disk while playing - keep decoding OGG
+	// files with the OGG Vorbis decoder, see below
+	if( m_streamingEnabled && !m_audioFile.isEmpty() &&
+			QFileInfo( m_audioFile ).suffix() != "ogg" )
+	{
+		m_stream = SampleStream::open( tryToMakeAbsolute( m_audioFile ),
+								m_reversed );
+	}
 
 	bool fileLoadError = false;
-	if( m_audioFile.isEmpty() && m_origData != NULL && m_origFrames > 0 )
+	QByteArray cacheKey;
+	if( m_stream != NULL )
+	{
+		// played at the file's sample rate, like samples not converted
+		// when the mixer's sample rate changes
+		m_frames = m_stream->frames();
+		m_sampleRate = m_stream->sampleRate();
+		if( _keep_settings == false )
+		{
+			m_loopStartFrame = m_startFrame = 0;
+			m_loopEndFrame = m_endFrame = m_frames;
+		}
+	}
+	else if( m_audioFile.isEmpty() && m_origData != NULL && m_origFrames > 0 )
 	{
 		// TODO: reverse- and amplification-property is not covered
 		// by following code...
@@ -180,69 +370,32 @@ void SampleBuffer::update( bool _keep_settings )
 	else if( !m_audioFile.isEmpty() )
 	{
 		QString file = tryToMakeAbsolute( m_audioFile );
-		int_sample_t * buf = NULL;
-		sample_t * fbuf = NULL;
-		ch_cnt_t channels = DEFAULT_CHANNELS;
 		sample_rate_t samplerate = mixerSampleRate();
 		m_frames = 0;
 
-		const QFileInfo fileInfo( file );
-		if( fileInfo.size() > fileSizeMax * 1024 * 1024 )
+		f_cnt_t fileFrames;
+		fileLoadError = exceedsLimits( file, fileFrames );
+
+		if( !fileLoadError )
 		{
-			fileLoadError = true;
+			// decoded by this or another LMMS before?
+			cacheKey = SampleCache::key( file, mixerSampleRate() );
+			m_data = const_cast<sampleFrame *>(
+				SampleCache::acquire( cacheKey, m_frames ) );
+			m_dataCached = m_data != NULL;
 		}
-		else
+
+		if( !fileLoadError && !m_dataCached )
 		{
-			// Use QFile to handle unicode file names on Windows
-			QFile f(file);
-			f.open(QIODevice::ReadOnly);
-			SNDFILE * snd_file;
-			SF_INFO sf_info;
-			sf_info.format = 0;
-			if( ( snd_file = sf_open_fd( f.handle(), SFM_READ, &sf_info, false ) ) != NULL )
-			{
-				f_cnt_t frames = sf_info.frames;
-				int rate = sf_info.samplerate;
-				if( frames / rate > sampleLengthMax * 60 )
-				{
-					fileLoadError = true;
-				}
-				sf_close( snd_file );
-			}
-			f.close();
+			m_frames = decodeFile( file, samplerate );
 		}
 
-		if( !fileLoadError )
+		if( m_dataCached )
 		{
-#ifdef LMMS_HAVE_OGGVORBIS
-			// workaround for a bug in libsndfile or our libsndfile decoder
-			// causing some OGG files to be distorted -> try with OGG Vorbis
-			// decoder first if filename extension matches "ogg"
-			if( m_frames == 0 && fileInfo.suffix() == "ogg" )
-			{
-				m_frames = decodeSampleOGGVorbis( file, buf, channels, samplerate );
-			}
-#endif
-			if( m_frames == 0 )
-			{
-				m_frames = decodeSampleSF( file, fbuf, channels,
-									samplerate );
-			}
-#ifdef LMMS_HAVE_OGGVORBIS
-			if( m_frames == 0 )
-			{
-				m_frames = decodeSampleOGGVorbis( file, buf, channels,
-									samplerate );
-			}
-#endif
-			if( m_frames == 0 )
-			{
-				m_frames = decodeSampleDS( file, buf, channels,
-									samplerate );
-			}
+			// already at our sample rate
+			normalizeSampleRate( mixerSampleRate(), _keep_settings );
 		}
-
-		if ( m_frames == 0 || fileLoadError )  // if still no frames, bail
+		else if ( m_frames == 0 || fileLoadError )  // if still no frames, bail
 		{
 			// sample couldn't be decoded, create buffer containing
 			// one sample-frame
@@ -255,6 +408,23 @@ void SampleBuffer::update( bool _keep_settings )
 		else // otherwise normalize sample rate
 		{
 			normalizeSampleRate( samplerate, _keep_settings );
+
+			const sampleFrame * cached = SampleCache::store( cacheKey,
+								m_data, m_frames );
+			if( cached != NULL )
+			{
+				// share the memory with everyone using the sample
+				MM_FREE( m_data );
+				m_data = const_cast<sampleFrame *>( cached );
+				m_dataCached = true;
+			}
+		}
+
+		if( m_reversed && !fileLoadError && m_frames > 1 )
+		{
+			// the cache holds the sample as in the file, for
+			// buffers playing it either way
+			reverseData();
 		}
 	}
 	else
@@ -274,6 +444,14 @@ void SampleBuffer::update( bool _keep_settings )
 		Engine::mixer()->doneChangeInModel();
 	}
 
+	// for drawing long samples quickly - the overview of a reversed
+	// sample is cached apart
+	if( m_data != NULL && m_frames > SamplePeaks::BaseFrames )
+	{
+		startPeaks( m_reversed && !cacheKey.isEmpty() ?
+						cacheKey + "-r" : cacheKey );
+	}
+
 	emit sampleUpdated();
 
 	if( fileLoadError )
@@ -281,51 +459,74 @@ void SampleBuffer::update( bool _keep_settings )
 		QString title = tr( "Fail to open file" );
 		QString message = tr( "Audio files are limited to %1 MB "
 				"in size and %2 minutes of playing time"
-				).arg( fileSizeMax ).arg( sampleLengthMax );
-		if( gui )
+				).arg( FileSizeMax ).arg( SampleLengthMax );
+		// not when preloading in another thread
+		if( gui && QThread::currentThread() == QCoreApplication::instance()->thread() )
 		{
 			QMessageBox::information( NULL,
 				title, message,	QMessageBox::Ok );
 		}
 		else
 		{
-			fprintf( stderr, "%s\n", message.toUtf8().constData() );
+			// there's nobody to show a message box to, say which
+			// file it was
+			printf( "Notice: could not load %s: %s\n",
+				qPrintable( m_audioFile ), qPrintable( message ) );
 		}
 	}
 }
 
 
+f_cnt_t SampleBuffer::decodeFile( const QString & _file,
+						sample_rate_t & _samplerate )
+{
+	int_sample_t * buf = NULL;
+	sample_t * fbuf = NULL;
+	ch_cnt_t channels = DEFAULT_CHANNELS;
+	f_cnt_t frames = 0;
+#ifdef LMMS_HAVE_OGGVORBIS
+	// workaround for a bug in libsndfile or our libsndfile decoder
+	// causing some OGG files to be distorted -> try with OGG Vorbis
+	// decoder first if filename extension matches "ogg"
+	if( QFileInfo( _file ).suffix() == "ogg" )
+	{
+		frames = decodeSampleOGGVorbis( _file, buf, channels, _samplerate );
+	}
+#endif
+	if( frames == 0 )
+	{
+		frames = decodeSampleSF( _file, fbuf, channels, _samplerate );
+	}
+#ifdef LMMS_HAVE_OGGVORBIS
+	if( frames == 0 )
+	{
+		frames = decodeSampleOGGVorbis( _file, buf, channels, _samplerate );
+	}
+#endif
+	if( frames == 0 )
+	{
+		frames = decodeSampleDS( _file, buf, channels, _samplerate );
+	}
+	return frames;
+}
+
+
 void SampleBuffer::convertIntToFloat ( int_sample_t * & _ibuf, f_cnt_t _frames, int _channels)
 {
 	// following code transforms int-samples into
-	// float-samples and does amplifying & reversing
+	// float-samples - reversing is done by update() once the sample
+	// is in the cache
 	const float fac = 1 / OUTPUT_SAMPLE_MULTIPLIER;
 	m_data = MM_ALLOC( sampleFrame, _frames );
 	const int ch = ( _channels > 1 ) ? 1 : 0;
 
-	// if reversing is on, we also reverse when
-	// scaling
-	if( m_reversed )
-	{
-		int idx = ( _frames - 1 ) * _channels;
-		for( f_cnt_t frame = 0; frame < _frames;
-						++frame )
-		{
-			m_data[frame][0] = _ibuf[idx+0] * fac;
-			m_data[frame][1] = _ibuf[idx+ch] * fac;
-			idx -= _channels;
-		}
-	}
-	else
+	int idx = 0;
+	for( f_cnt_t frame = 0; frame < _frames;
+					++frame )
 	{
-		int idx = 0;
-		for( f_cnt_t frame = 0; frame < _frames;
-						++frame )
-		{
-			m_data[frame][0] = _ibuf[idx+0] * fac;
-			m_data[frame][1] = _ibuf[idx+ch] * fac;
-			idx += _channels;
-		}
+		m_data[frame][0] = _ibuf[idx+0] * fac;
+		m_data[frame][1] = _ibuf[idx+ch] * fac;
+		idx += _channels;
 	}
 
 	delete[] _ibuf;
@@ -338,29 +539,13 @@ void SampleBuffer::directFloatWrite ( sample_t * & _fbuf, f_cnt_t _frames, int _
 	m_data = MM_ALLOC( sampleFrame, _frames );
 	const int ch = ( _channels > 1 ) ? 1 : 0;
 
-	// if reversing is on, we also reverse when
-	// scaling
-	if( m_reversed )
-	{
-		int idx = ( _frames - 1 ) * _channels;
-		for( f_cnt_t frame = 0; frame < _frames;
-						++frame )
-		{
-			m_data[frame][0] = _fbuf[idx+0];
-			m_data[frame][1] = _fbuf[idx+ch];
-			idx -= _channels;
-		}
-	}
-	else
+	int idx = 0;
+	for( f_cnt_t frame = 0; frame < _frames;
+					++frame )
 	{
-		int idx = 0;
-		for( f_cnt_t frame = 0; frame < _frames;
-						++frame )
-		{
-			m_data[frame][0] = _fbuf[idx+0];
-			m_data[frame][1] = _fbuf[idx+ch];
-			idx += _channels;
-		}
+		m_data[frame][0] = _fbuf[idx+0];
+		m_data[frame][1] = _fbuf[idx+ch];
+		idx += _channels;
 	}
 
 	delete[] _fbuf;
@@ -371,19 +556,19 @@ void SampleBuffer::normalizeSampleRate( const sample_rate_t _src_sr,
 							bool _keep_settings )
 {
 	const sample_rate_t old_rate = m_sampleRate;
-	// do samplerate-conversion to our default-samplerate
+	// do samplerate-conversion to our default-samplerate - straight into
+	// memory of our own, a temporary SampleBuffer would lock the mixer
+	// for updating itself
 	if( _src_sr != mixerSampleRate() )
 	{
-		SampleBuffer * resampled = resample( _src_sr,
-					mixerSampleRate() );
+		f_cnt_t frames;
+		sampleFrame * resampled = resampleFrames( m_data, m_frames,
+					_src_sr, mixerSampleRate(), frames );
 
 		m_sampleRate = mixerSampleRate();
 		MM_FREE( m_data );
-		m_frames = resampled->frames();
-		m_data = MM_ALLOC( sampleFrame, m_frames );
-		memcpy( m_data, resampled->data(), m_frames *
-							sizeof( sampleFrame ) );
-		delete resampled;
+		m_frames = frames;
+		m_data = resampled;
 	}
 
 	if( _keep_settings == false )
@@ -391,6 +576,8 @@ void SampleBuffer::normalizeSampleRate( const sample_rate_t _src_sr,
 		// update frame-variables
 		m_loopStartFrame = m_startFrame = 0;
 		m_loopEndFrame = m_endFrame = m_frames;
+		// a stream played before may have had another rate
+		m_sampleRate = mixerSampleRate();
 	}
 	else if( old_rate != mixerSampleRate() )
 	{
@@ -665,6 +852,9 @@ bool SampleBuffer::play( sampleFrame * _ab, handleState * _state,
 
 	// this holds the index of the first frame to play
 	f_cnt_t play_frame = qMax(_state->m_frameIndex, startFrame);
+	bool looped = _state->m_looped;
+
+	const bool resample = freq_factor != 1.0 || _state->m_varyingPitch;
 
 	if( _loopmode == LoopOff )
 	{
@@ -674,6 +864,10 @@ bool SampleBuffer::play( sampleFrame * _ab, handleState * _state,
 			return false;
 		}
 	}
+	else if( resample )
+	{
+		// interpolate() follows the loop itself
+	}
 	else if( _loopmode == LoopOn )
 	{
 		play_frame = getLoopedIndex( play_frame, loopStartFrame, loopEndFrame );
@@ -683,68 +877,72 @@ bool SampleBuffer::play( sampleFrame * _ab, handleState * _state,
 		play_frame = getPingPongIndex( play_frame, loopStartFrame, loopEndFrame );
 	}
 
-	f_cnt_t fragment_size = (f_cnt_t)( _frames * freq_factor ) + MARGIN[ _state->interpolationMode() ];
+	if( m_stream != NULL && _loopmode != LoopOff )
+	{
+		// we'll jump back there
+		m_stream->prefetch( loopStartFrame );
+	}
 
 	sampleFrame * tmp = NULL;
+	double sub_frame = 0;
 
 	// check whether we have to change pitch...
-	if( freq_factor != 1.0 || _state->m_varyingPitch )
+	if( resample )
 	{
-		SRC_DATA src_data;
-		// Generate output
-		src_data.data_in =
-			getSampleFragment( play_frame, fragment_size, _loopmode, &tmp, &is_backwards,
-			loopStartFrame, loopEndFrame, endFrame )[0];
-		src_data.data_out = _ab[0];
-		src_data.input_frames = fragment_size;
-		src_data.output_frames = _frames;
-		src_data.src_ratio = 1.0 / freq_factor;
-		src_data.end_of_input = 0;
-		int error = src_process( _state->m_resamplingData,
-								&src_data );
-		if( error )
+		const PolyphaseResampler & resampler =
+			PolyphaseResampler::forConverter( _state->interpolationMode() );
+		const f_cnt_t loopFrames = loopEndFrame - loopStartFrame;
+		const bool loops = _loopmode != LoopOff && loopFrames > 0;
+
+		// positions run on past the loop end, one loop (forth and back
+		// for ping-pong) after it reads the same as the loop
+		double pos = play_frame + _state->m_subFrame;
+		if( loops && is_backwards )
 		{
-			printf( "SampleBuffer: error while resampling: %s\n",
-							src_strerror( error ) );
+			pos = 2 * loopEndFrame - pos;
 		}
-		if( src_data.output_frames_gen > _frames )
+		else if( loops && looped && pos < loopEndFrame )
 		{
-			printf( "SampleBuffer: not enough frames: %ld / %d\n",
-					src_data.output_frames_gen, _frames );
+			pos += _loopmode == LoopOn ? loopFrames : 2 * loopFrames;
 		}
-		// Advance
-		switch( _loopmode )
+
+		// frames until reaching the end, looped samples don't end
+		const f_cnt_t limit = _loopmode == LoopOff ? endFrame : loopEndFrame;
+		const fpp_t todo = loops ? _frames : (fpp_t) qBound<double>( 0,
+				ceil( ( limit - pos ) / freq_factor ), _frames );
+		if( todo > 0 )
 		{
-			case LoopOff:
-				play_frame += src_data.input_frames_used;
-				break;
-			case LoopOn:
-				play_frame += src_data.input_frames_used;
-				play_frame = getLoopedIndex( play_frame, loopStartFrame, loopEndFrame );
-				break;
-			case LoopPingPong:
+			interpolate( _ab, resampler, pos, freq_factor, todo,
+				loops ? _loopmode : LoopOff, loopStartFrame, loopEndFrame );
+		}
+		memset( _ab + todo, 0, ( _frames - todo ) * BYTES_PER_FRAME );
+		pos += todo * freq_factor;
+
+		// Advance, saving the position within the loop
+		if( loops && pos >= loopEndFrame )
+		{
+			looped = true;
+			const double period = _loopmode == LoopOn ? loopFrames : 2 * loopFrames;
+			pos = loopEndFrame + fmod( pos - loopEndFrame, period );
+			if( _loopmode == LoopOn )
 			{
-				f_cnt_t left = src_data.input_frames_used;
-				if( _state->isBackwards() )
-				{
-					play_frame -= src_data.input_frames_used;
-					if( play_frame < loopStartFrame )
-					{
-						left -= ( loopStartFrame - play_frame );
-						play_frame = loopStartFrame;
-					}
-					else left = 0;
-				}
-				play_frame += left;
-				play_frame = getPingPongIndex( play_frame, loopStartFrame, loopEndFrame  );
-				break;
+				pos -= loopFrames;
+			}
+			else
+			{
+				is_backwards = pos < loopEndFrame + loopFrames;
+				pos = is_backwards ? 2 * loopEndFrame - pos : pos - 2 * loopFrames;
 			}
 		}
+		play_frame = (f_cnt_t) floor( pos );
+		sub_frame = pos - play_frame;
 	}
 	else
 	{
 		// we don't have to pitch, so we just copy the sample-data
 		// as is into pitched-copy-buffer
+		looped = looped || ( _loopmode != LoopOff &&
+					play_frame + _frames >= loopEndFrame );
 
 		// Generate output
 		memcpy( _ab,
@@ -781,13 +979,10 @@ bool SampleBuffer::play( sampleFrame * _ab, handleState * _state,
 		}
 	}
 
-	if( tmp != NULL ) 
-	{
-		MM_FREE( tmp );
-	}
-
 	_state->setBackwards( is_backwards );
 	_state->setFrameIndex( play_frame );
+	_state->m_subFrame = sub_frame;
+	_state->m_looped = looped;
 
 	for( fpp_t i = 0; i < _frames; ++i )
 	{
@@ -801,50 +996,134 @@ bool SampleBuffer::play( sampleFrame * _ab, handleState * _state,
 
 
 
+void SampleBuffer::interpolate( sampleFrame * _dst,
+				const PolyphaseResampler & _resampler,
+				double _pos, double _step, fpp_t _frames,
+				LoopMode _loopmode, f_cnt_t _loopstart,
+				f_cnt_t _loopend ) const
+{
+	const double last_pos = _pos + ( _frames - 1 ) * _step;
+	const int reach = _resampler.reach( _step );
+	const f_cnt_t first = (f_cnt_t) floor( qMin( _pos, last_pos ) ) - reach + 1;
+	const f_cnt_t last = (f_cnt_t) floor( qMax( _pos, last_pos ) ) + reach;
+
+	if( m_stream == NULL && first >= 0 && last < m_frames &&
+				( _loopmode == LoopOff || last < _loopend ) )
+	{
+		// read from the sample directly
+		_resampler.process( _dst, m_data, _pos, _step, _frames );
+		return;
+	}
+
+	// copy what's needed, silence before and after the sample, and
+	// continue past the loop end like playback does so the filter sees
+	// no jump at the loop points
+	sampleFrame * tmp = PeriodArena::alloc<sampleFrame>( last - first + 1 );
+	memset( tmp, 0, ( last - first + 1 ) * BYTES_PER_FRAME );
+	const f_cnt_t loopFrames = _loopend - _loopstart;
+	f_cnt_t i = first;
+	while( i <= last )
+	{
+		// a run of frames read in one direction
+		f_cnt_t index = i;
+		f_cnt_t count = last - i + 1;
+		bool backwards = false;
+		if( _loopmode != LoopOff && i < _loopend )
+		{
+			count = qMin( count, _loopend - i );
+		}
+		else if( _loopmode == LoopOn )
+		{
+			const f_cnt_t offset = ( i - _loopend ) % loopFrames;
+			index = _loopstart + offset;
+			count = qMin( count, loopFrames - offset );
+		}
+		else if( _loopmode == LoopPingPong )
+		{
+			// back from the loop end, then forth from the loop start
+			const f_cnt_t offset = ( i - _loopend ) % ( 2 * loopFrames );
+			backwards = offset < loopFrames;
+			index = backwards ? _loopend - offset :
+						_loopstart + offset - loopFrames;
+			count = qMin( count, backwards ? loopFrames - offset :
+						2 * loopFrames - offset );
+		}
+
+		sampleFrame * dst = tmp + i - first;
+		if( backwards )
+		{
+			const f_cnt_t top = qMin<f_cnt_t>( index, m_frames - 1 );
+			if( count > index - top )
+			{
+				copyFramesBackwards( dst + index - top, top,
+							count - ( index - top ) );
+			}
+		}
+		else
+		{
+			const f_cnt_t from = qMax<f_cnt_t>( index, 0 );
+			const f_cnt_t to = qMin<f_cnt_t>( index + count, m_frames );
+			if( from < to )
+			{
+				copyFrames( dst + from - index, from, to - from );
+			}
+		}
+		i += count;
+	}
+	_resampler.process( _dst, tmp, _pos - first, _step, _frames );
+}
+
+
+
+
 sampleFrame * SampleBuffer::getSampleFragment( f_cnt_t _index,
 		f_cnt_t _frames, LoopMode _loopmode, sampleFrame * * _tmp, bool * _backwards,
 		f_cnt_t _loopstart, f_cnt_t _loopend, f_cnt_t _end ) const
 {
-	if( _loopmode == LoopOff )
+	// streamed samples always get copied
+	if( m_stream == NULL )
 	{
-		if( _index + _frames <= _end )
+		if( _loopmode == LoopOff )
 		{
-			return m_data + _index;
+			if( _index + _frames <= _end )
+			{
+				return m_data + _index;
+			}
 		}
-	}
-	else if( _loopmode == LoopOn )
-	{
-		if( _index + _frames <= _loopend )
+		else if( _loopmode == LoopOn )
 		{
-			return m_data + _index;
+			if( _index + _frames <= _loopend )
+			{
+				return m_data + _index;
+			}
 		}
-	}
-	else
-	{
-		if( ! *_backwards && _index + _frames < _loopend )
+		else
 		{
-			return m_data + _index;
+			if( ! *_backwards && _index + _frames < _loopend )
+			{
+				return m_data + _index;
+			}
 		}
 	}
 
-	*_tmp = MM_ALLOC( sampleFrame, _frames );
+	*_tmp = PeriodArena::alloc<sampleFrame>( _frames );
 
 	if( _loopmode == LoopOff )
 	{
 		f_cnt_t available = _end - _index;
-		memcpy( *_tmp, m_data + _index, available * BYTES_PER_FRAME );
+		copyFrames( *_tmp, _index, available );
 		memset( *_tmp + available, 0, ( _frames - available ) *
 							BYTES_PER_FRAME );
 	}
 	else if( _loopmode == LoopOn )
 	{
 		f_cnt_t copied = qMin( _frames, _loopend - _index );
-		memcpy( *_tmp, m_data + _index, copied * BYTES_PER_FRAME );
+		copyFrames( *_tmp, _index, copied );
 		f_cnt_t loop_frames = _loopend - _loopstart;
 		while( copied < _frames )
 		{
 			f_cnt_t todo = qMin( _frames - copied, loop_frames );
-			memcpy( *_tmp + copied, m_data + _loopstart, todo * BYTES_PER_FRAME );
+			copyFrames( *_tmp + copied, _loopstart, todo );
 			copied += todo;
 		}
 	}
@@ -860,18 +1139,14 @@ sampleFrame * SampleBuffer::getSampleFragment( f_cnt_t _index,
 		if( backwards )
 		{
 			copied = qMin( _frames, pos - _loopstart );
-			for( int i=0; i < copied; i++ )
-			{
-				(*_tmp)[i][0] = m_data[ pos - i ][0];
-				(*_tmp)[i][1] = m_data[ pos - i ][1];
-			}
+			copyFramesBackwards( *_tmp, pos, copied );
 			pos -= copied;
 			if( pos == _loopstart ) backwards = false;
 		}
 		else
 		{
 			copied = qMin( _frames, _loopend - pos );
-			memcpy( *_tmp, m_data + pos, copied * BYTES_PER_FRAME );
+			copyFrames( *_tmp, pos, copied );
 			pos += copied;
 			if( pos == _loopend ) backwards = true;
 		}
@@ -881,11 +1156,7 @@ sampleFrame * SampleBuffer::getSampleFragment( f_cnt_t _index,
 			if( backwards )
 			{
 				f_cnt_t todo = qMin( _frames - copied, pos - _loopstart );
-				for ( int i=0; i < todo; i++ )
-				{
-					(*_tmp)[ copied + i ][0] = m_data[ pos - i ][0];
-					(*_tmp)[ copied + i ][1] = m_data[ pos - i ][1];
-				}
+				copyFramesBackwards( *_tmp + copied, pos, todo );
 				pos -= todo;
 				copied += todo;
 				if( pos <= _loopstart ) backwards = false;
@@ -893,7 +1164,7 @@ sampleFrame * SampleBuffer::getSampleFragment( f_cnt_t _index,
 			else
 			{
 				f_cnt_t todo = qMin( _frames - copied, _loopend - pos );
-				memcpy( *_tmp + copied, m_data + pos, todo * BYTES_PER_FRAME );
+				copyFrames( *_tmp + copied, pos, todo );
 				pos += todo;
 				copied += todo;
 				if( pos >= _loopend ) backwards = true;
@@ -908,6 +1179,46 @@ sampleFrame * SampleBuffer::getSampleFragment( f_cnt_t _index,
 
 
 
+void SampleBuffer::copyFrames( sampleFrame * _dst, f_cnt_t _index,
+						f_cnt_t _frames ) const
+{
+	if( m_stream != NULL )
+	{
+		// there's time to wait for the disk when exporting
+		m_stream->read( _dst, _index, _frames,
+					Engine::getSong()->isExporting() );
+	}
+	else
+	{
+		memcpy( _dst, m_data + _index, _frames * BYTES_PER_FRAME );
+	}
+}
+
+
+
+
+void SampleBuffer::copyFramesBackwards( sampleFrame * _dst, f_cnt_t _index,
+						f_cnt_t _frames ) const
+{
+	if( m_stream != NULL )
+	{
+		m_stream->read( _dst, _index - _frames + 1, _frames,
+					Engine::getSong()->isExporting() );
+		std::reverse( _dst, _dst + _frames );
+	}
+	else
+	{
+		for( f_cnt_t i = 0; i < _frames; ++i )
+		{
+			_dst[i][0] = m_data[_index - i][0];
+			_dst[i][1] = m_data[_index - i][1];
+		}
+	}
+}
+
+
+
+
 f_cnt_t SampleBuffer::getLoopedIndex( f_cnt_t _index, f_cnt_t _startf, f_cnt_t _endf ) const
 {
 	if( _index < _endf )
@@ -949,13 +1260,69 @@ void SampleBuffer::visualize( QPainter & _p, const QRect & _dr,
 	const float y_space = h*0.5f;
 	const int nb_frames = focus_on_range ? _to_frame - _from_frame : m_frames;
 
+	const int xb = _dr.x();
+	const int first = focus_on_range ? _from_frame : 0;
+	const int last = focus_on_range ? _to_frame : m_frames;
+
+	// only columns to be painted
+	const int x_first = qMax( 0, _clip.left() - xb );
+	const int x_last = qMin( w, _clip.right() + 1 - xb );
+
+	if( m_stream != NULL )
+	{
+		// draw the overview of the stream, which may not be complete yet
+		for( int x = x_first; x < x_last; ++x )
+		{
+			const f_cnt_t from = first + f_cnt_t( double( x ) * nb_frames / w );
+			const f_cnt_t to = qMax( from + 1,
+				first + f_cnt_t( double( x + 1 ) * nb_frames / w ) );
+			for( int ch = 0; ch < 2; ++ch )
+			{
+				float min, max;
+				if( m_stream->peak( from, to, ch, min, max ) )
+				{
+					_p.drawLine( QPointF( xb + x, yb - max * y_space * m_amplification ),
+						QPointF( xb + x, yb - min * y_space * m_amplification ) );
+				}
+			}
+		}
+		return;
+	}
+
+	const SamplePeaks * peaks = m_peaks ? m_peaks->peaks.loadAcquire() : NULL;
+	if( peaks != NULL && nb_frames / w >= SamplePeaks::BaseFrames )
+	{
+		// zoomed out - draw the range of each column and its RMS
+		// lighter inside
+		QVector<QLineF> ranges;
+		QVector<QLineF> rms;
+		for( int x = x_first; x < x_last; ++x )
+		{
+			const f_cnt_t from = first + f_cnt_t( double( x ) * nb_frames / w );
+			const f_cnt_t to = first + f_cnt_t( double( x + 1 ) * nb_frames / w );
+			for( int ch = 0; ch < 2; ++ch )
+			{
+				const SamplePeaks::Peak p = peaks->peak( from, to, ch );
+				ranges << QLineF( xb + x, yb - p.max * y_space * m_amplification,
+						xb + x, yb - p.min * y_space * m_amplification );
+				rms << QLineF( xb + x, yb - p.rms * y_space * m_amplification,
+						xb + x, yb + p.rms * y_space * m_amplification );
+			}
+		}
+		_p.drawLines( ranges );
+		_p.save();
+		QPen pen = _p.pen();
+		pen.setColor( pen.color().lighter( 150 ) );
+		_p.setPen( pen );
+		_p.drawLines( rms );
+		_p.restore();
+		return;
+	}
+
 	const int fpp = qBound<int>( 1, nb_frames / w, 20 );
 	QPointF * l = new QPointF[nb_frames / fpp + 1];
 	QPointF * r = new QPointF[nb_frames / fpp + 1];
 	int n = 0;
-	const int xb = _dr.x();
-	const int first = focus_on_range ? _from_frame : 0;
-	const int last = focus_on_range ? _to_frame : m_frames;
 	for( int frame = first; frame < last; frame += fpp )
 	{
 		l[n] = QPointF( xb + ( (frame - first) * double( w ) / nb_frames ),
@@ -1182,12 +1549,28 @@ QString & SampleBuffer::toBase64( QString & _dst ) const
 SampleBuffer * SampleBuffer::resample( const sample_rate_t _src_sr,
 						const sample_rate_t _dst_sr )
 {
-	sampleFrame * data = m_data;
-	const f_cnt_t frames = m_frames;
+	f_cnt_t dst_frames;
+	sampleFrame * dst_buf = resampleFrames( m_data, m_frames, _src_sr,
+							_dst_sr, dst_frames );
+	SampleBuffer * dst_sb = new SampleBuffer( dst_buf, dst_frames );
+	MM_FREE( dst_buf );
+	return dst_sb;
+}
+
+
+
+
+sampleFrame * SampleBuffer::resampleFrames( const sampleFrame * _data,
+		f_cnt_t _frames, sample_rate_t _src_sr, sample_rate_t _dst_sr,
+							f_cnt_t & _dst_frames )
+{
+	const sampleFrame * data = _data;
+	const f_cnt_t frames = _frames;
 	const f_cnt_t dst_frames = static_cast<f_cnt_t>( frames /
 					(float) _src_sr * (float) _dst_sr );
-	SampleBuffer * dst_sb = new SampleBuffer( dst_frames );
-	sampleFrame * dst_buf = dst_sb->m_origData;
+	_dst_frames = dst_frames;
+	sampleFrame * dst_buf = MM_ALLOC( sampleFrame, qMax<f_cnt_t>( dst_frames, 1 ) );
+	memset( dst_buf, 0, dst_frames * sizeof( sampleFrame ) );
 
 	// yeah, libsamplerate, let's rock with sinc-interpolation!
 	int error;
@@ -1197,7 +1580,7 @@ SampleBuffer * SampleBuffer::resample( const sample_rate_t _src_sr,
 	{
 		SRC_DATA src_data;
 		src_data.end_of_input = 1;
-		src_data.data_in = data[0];
+		src_data.data_in = const_cast<float *>( data[0] );
 		src_data.data_out = dst_buf[0];
 		src_data.input_frames = frames;
 		src_data.output_frames = dst_frames;
@@ -1213,8 +1596,7 @@ SampleBuffer * SampleBuffer::resample( const sample_rate_t _src_sr,
 	{
 		printf( "Error: src_new() failed in sample_buffer.cpp!\n" );
 	}
-	dst_sb->update();
-	return dst_sb;
+	return dst_buf;
 }
 
 
@@ -1321,6 +1703,53 @@ void flacStreamDecoderErrorCallback( const FLAC__StreamDecoder *,
 #endif
 
 
+void SampleBuffer::preload( const QString & _audio_file )
+{
+	const QString file = tryToMakeAbsolute( _audio_file );
+	f_cnt_t fileFrames;
+	// long files get streamed anyway, see update()
+	if( exceedsLimits( file, fileFrames ) ||
+		( QFileInfo( file ).suffix() != "ogg" &&
+				SampleStream::isStreamed( fileFrames ) ) )
+	{
+		return;
+	}
+
+	const QByteArray cacheKey = SampleCache::key( file, mixerSampleRate() );
+	if( cacheKey.isEmpty() )
+	{
+		// nowhere to keep it
+		return;
+	}
+	f_cnt_t frames;
+	const sampleFrame * cached = SampleCache::acquire( cacheKey, frames );
+	if( cached != NULL )
+	{
+		SampleCache::release( cached );
+		return;
+	}
+
+	// decode into a buffer the mixer doesn't know about - going through
+	// update() would make the mixer wait for every file being preloaded
+	SampleBuffer buffer;
+	buffer.releaseData();
+	sample_rate_t samplerate = mixerSampleRate();
+	buffer.m_frames = buffer.decodeFile( file, samplerate );
+	if( buffer.m_frames > 0 )
+	{
+		buffer.normalizeSampleRate( samplerate );
+		cached = SampleCache::store( cacheKey, buffer.m_data,
+							buffer.m_frames );
+		if( cached != NULL )
+		{
+			SampleCache::release( cached );
+		}
+	}
+}
+
+
+
+
 void SampleBuffer::loadFromBase64( const QString & _data )
 {
 	char * dst = NULL;
@@ -1388,6 +1817,10 @@ void SampleBuffer::loadFromBase64( const QString & _data )
 void SampleBuffer::setStartFrame( const f_cnt_t _s )
 {
 	m_startFrame = _s;
+	if( m_stream != NULL )
+	{
+		m_stream->prefetch( _s );
+	}
 }
 
 
@@ -1483,16 +1916,12 @@ QString SampleBuffer::tryToMakeAbsolute(const QString& file)
 
 SampleBuffer::handleState::handleState( bool _varying_pitch, int interpolation_mode ) :
 	m_frameIndex( 0 ),
+	m_subFrame( 0 ),
 	m_varyingPitch( _varying_pitch ),
-	m_isBackwards( false )
+	m_isBackwards( false ),
+	m_looped( false ),
+	m_interpolationMode( interpolation_mode )
 {
-	int error;
-	m_interpolationMode = interpolation_mode;
-	
-	if( ( m_resamplingData = src_new( interpolation_mode, DEFAULT_CHANNELS, &error ) ) == NULL )
-	{
-		qDebug( "Error: src_new() failed in sample_buffer.cpp!\n" );
-	}
 }
 
 
@@ -1500,5 +1929,4 @@ SampleBuffer::handleState::handleState( bool _varying_pitch, int interpolation_m
 
 SampleBuffer::handleState::~handleState()
 {
-	src_delete( m_resamplingData );
 }
@@ -0,0 +1,391 @@
+/*
+ * SampleCache.cpp - on-disk cache of decoded samples
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+
+#include "SampleCache.h"
+
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDateTime>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QSaveFile>
+#include <QtCore/QStandardPaths>
+
+#include <cstring>
+
+#include "ConfigManager.h"
+
+#ifdef LMMS_BUILD_WIN32
+#include <sys/utime.h>
+#else
+#include <utime.h>
+#endif
+
+
+namespace
+{
+
+//! Cache size in MB if not configured
+const int DefaultCacheSize = 2048;
+
+//! Bump when changing the decoders, so old files don't get used anymore
+const int CacheVersion = 1;
+
+struct Header
+{
+	char magic[8];
+	qint64 frames;
+} ;
+
+const char Magic[8] = { 'L', 'M', 'M', 'S', 'P', 'C', 'M', '1' };
+
+struct Mapping
+{
+	QFile * file;
+	const sampleFrame * data;
+	f_cnt_t frames;
+	int refs;
+} ;
+
+QMutex s_mutex;
+QHash<QByteArray, Mapping> s_mappings;
+QHash<const sampleFrame *, QByteArray> s_keys;
+// size of the cache as of the last listing plus what was written since, -1
+// before the first listing
+qint64 s_size = -1;
+
+
+qint64 cacheSize()
+{
+	bool ok;
+	const int size = ConfigManager::inst()->value( "mixer",
+					"samplecachesize" ).toInt( &ok );
+	return qint64( ok ? size : DefaultCacheSize ) * 1024 * 1024;
+}
+
+
+QString cacheDir()
+{
+	QString dir = ConfigManager::inst()->value( "mixer", "samplecachedir" );
+	if( dir.isEmpty() )
+	{
+		dir = QStandardPaths::writableLocation(
+				QStandardPaths::CacheLocation ) + "/samples";
+	}
+	return dir;
+}
+
+
+QString fileName( const QByteArray & key, const char * suffix = ".pcm" )
+{
+	return cacheDir() + "/" + QString::fromLatin1( key ) + suffix;
+}
+
+
+//! Mark a cache file as used now, trim() removes the files used least
+//! recently
+void touch( const QString & fileName )
+{
+	utime( QFile::encodeName( fileName ).constData(), NULL );
+}
+
+
+//! Remove the oldest files until the cache fits into its size again, must
+//! be called with s_mutex locked
+void trim()
+{
+	const QFileInfoList files = QDir( cacheDir() ).entryInfoList(
+			QStringList() << "*.pcm" << "*.peaks" << "*.hash",
+			QDir::Files, QDir::Time );
+	qint64 size = 0;
+	for( const QFileInfo & info : files )
+	{
+		size += info.size();
+	}
+	// sorted newest first
+	for( int i = files.size() - 1; i >= 0 && size > cacheSize(); --i )
+	{
+		// mapped files stay readable where they're still used
+		if( QFile::remove( files[i].filePath() ) )
+		{
+			size -= files[i].size();
+		}
+	}
+	s_size = size;
+}
+
+
+//! Account for @p bytes written to the cache and trim it if it may have
+//! become too large - this way loading a project doesn't list the cache
+//! for every sample. Must be called with s_mutex locked.
+void grow( qint64 bytes )
+{
+	if( s_size >= 0 )
+	{
+		s_size += bytes;
+		if( s_size <= cacheSize() )
+		{
+			return;
+		}
+	}
+	trim();
+}
+
+
+//! Hash of the content of @p file, remembered in the cache by the file's
+//! path, size and modification time
+QByteArray contentHash( const QString & file )
+{
+	const QFileInfo info( file );
+	const QByteArray stamp = QByteArray::number( info.size() ) + ' ' +
+		QByteArray::number( info.lastModified().toMSecsSinceEpoch() );
+	const QString memo = fileName( QCryptographicHash::hash(
+			info.absoluteFilePath().toUtf8(),
+			QCryptographicHash::Sha1 ).toHex(), ".hash" );
+
+	QFile memoFile( memo );
+	if( memoFile.open( QFile::ReadOnly ) )
+	{
+		const QList<QByteArray> lines = memoFile.readAll().split( '\n' );
+		if( lines.size() >= 2 && lines[0] == stamp && !lines[1].isEmpty() )
+		{
+			memoFile.close();
+			touch( memo );
+			return lines[1];
+		}
+	}
+
+	QFile f( file );
+	if( !f.open( QFile::ReadOnly ) )
+	{
+		return QByteArray();
+	}
+	QCryptographicHash hash( QCryptographicHash::Sha1 );
+	while( !f.atEnd() )
+	{
+		hash.addData( f.read( 1024 * 1024 ) );
+	}
+	const QByteArray result = hash.result().toHex();
+
+	QSaveFile save( memo );
+	const QByteArray content = stamp + '\n' + result + '\n';
+	if( QDir().mkpath( cacheDir() ) && save.open( QFile::WriteOnly ) &&
+		save.write( content ) > 0 && save.commit() )
+	{
+		QMutexLocker locker( &s_mutex );
+		grow( content.size() );
+	}
+	return result;
+}
+
+
+//! Map a cache file, check it and register the mapping
+const sampleFrame * map( const QByteArray & key, f_cnt_t & frames )
+{
+	QFile * file = new QFile( fileName( key ) );
+	if( !file->open( QFile::ReadOnly ) || file->size() < qint64( sizeof( Header ) ) )
+	{
+		delete file;
+		return NULL;
+	}
+
+	const uchar * mapped = file->map( 0, file->size() );
+	const Header * header = reinterpret_cast<const Header *>( mapped );
+	if( mapped == NULL || memcmp( header->magic, Magic, sizeof( Magic ) ) ||
+		header->frames <= 0 ||
+		file->size() != qint64( sizeof( Header ) ) +
+				header->frames * qint64( sizeof( sampleFrame ) ) )
+	{
+		// not written completely by an old version or damaged
+		printf( "Notice: removing broken sample cache file %s\n",
+					qPrintable( file->fileName() ) );
+		file->remove();
+		delete file;
+		return NULL;
+	}
+
+	Mapping m;
+	m.file = file;
+	m.data = reinterpret_cast<const sampleFrame *>( mapped + sizeof( Header ) );
+	m.frames = header->frames;
+	m.refs = 1;
+	s_mappings[key] = m;
+	s_keys[m.data] = key;
+
+	frames = m.frames;
+	return m.data;
+}
+
+}
+
+
+
+
+bool SampleCache::isEnabled()
+{
+	return cacheSize() > 0;
+}
+
+
+
+
+QByteArray SampleCache::key( const QString & file, sample_rate_t sampleRate )
+{
+	if( !isEnabled() )
+	{
+		return QByteArray();
+	}
+	const QByteArray hash = contentHash( file );
+	if( hash.isEmpty() )
+	{
+		return QByteArray();
+	}
+	return hash + "-" + QByteArray::number( sampleRate ) +
+		"-" + QByteArray::number( CacheVersion );
+}
+
+
+
+
+const sampleFrame * SampleCache::acquire( const QByteArray & key,
+							f_cnt_t & frames )
+{
+	if( key.isEmpty() )
+	{
+		return NULL;
+	}
+
+	QMutexLocker locker( &s_mutex );
+	auto it = s_mappings.find( key );
+	if( it != s_mappings.end() )
+	{
+		++it->refs;
+		frames = it->frames;
+		return it->data;
+	}
+	touch( fileName( key ) );
+	return map( key, frames );
+}
+
+
+
+
+const sampleFrame * SampleCache::store( const QByteArray & key,
+				const sampleFrame * data, f_cnt_t frames )
+{
+	if( key.isEmpty() || frames <= 0 )
+	{
+		return NULL;
+	}
+
+	QMutexLocker locker( &s_mutex );
+	auto it = s_mappings.find( key );
+	if( it != s_mappings.end() )
+	{
+		++it->refs;
+		return it->data;
+	}
+	if( !QDir().mkpath( cacheDir() ) )
+	{
+		return NULL;
+	}
+
+	// other processes see the file once it's complete
+	QSaveFile file( fileName( key ) );
+	Header header;
+	memcpy( header.magic, Magic, sizeof( Magic ) );
+	header.frames = frames;
+	if( !file.open( QFile::WriteOnly ) ||
+		file.write( reinterpret_cast<const char *>( &header ),
+					sizeof( header ) ) != sizeof( header ) ||
+		file.write( reinterpret_cast<const char *>( data ),
+			frames * qint64( sizeof( sampleFrame ) ) ) !=
+				frames * qint64( sizeof( sampleFrame ) ) ||
+		!file.commit() )
+	{
+		return NULL;
+	}
+	grow( sizeof( header ) + frames * qint64( sizeof( sampleFrame ) ) );
+
+	return map( key, frames );
+}
+
+
+
+
+void SampleCache::release( const sampleFrame * data )
+{
+	QMutexLocker locker( &s_mutex );
+	auto it = s_keys.find( data );
+	if( it == s_keys.end() )
+	{
+		return;
+	}
+	Mapping & m = s_mappings[*it];
+	if( --m.refs == 0 )
+	{
+		delete m.file;
+		s_mappings.remove( *it );
+		s_keys.erase( it );
+	}
+}
+
+
+
+
+QByteArray SampleCache::loadPeaks( const QByteArray & key )
+{
+	if( key.isEmpty() )
+	{
+		return QByteArray();
+	}
+	QFile file( fileName( key, ".peaks" ) );
+	if( !file.open( QFile::ReadOnly ) )
+	{
+		return QByteArray();
+	}
+	touch( file.fileName() );
+	return file.readAll();
+}
+
+
+
+
+void SampleCache::storePeaks( const QByteArray & key, const QByteArray & peaks )
+{
+	if( key.isEmpty() )
+	{
+		return;
+	}
+
+	QMutexLocker locker( &s_mutex );
+	QSaveFile file( fileName( key, ".peaks" ) );
+	if( QDir().mkpath( cacheDir() ) && file.open( QFile::WriteOnly ) &&
+		file.write( peaks ) == peaks.size() && file.commit() )
+	{
+		grow( peaks.size() );
+	}
+}
@@ -0,0 +1,214 @@
+/*
+ * SamplePeaks.cpp - multi-resolution overview of a sample
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+
+#include "SamplePeaks.h"
+
+#include <cmath>
+#include <cstring>
+
+#include "SampleCache.h"
+
+
+namespace
+{
+
+const char Magic[8] = { 'L', 'M', 'M', 'S', 'P', 'K', 'S', '1' };
+
+}
+
+
+
+
+SamplePeaks::SamplePeaks( f_cnt_t frames ) :
+	m_frames( frames )
+{
+	int count = ( frames + BaseFrames - 1 ) / BaseFrames;
+	m_levels.resize( 1 );
+	m_levels[0].resize( count * 2 );
+	while( count > 1 )
+	{
+		count = ( count + LevelFactor - 1 ) / LevelFactor;
+		m_levels.resize( m_levels.size() + 1 );
+		m_levels.last().resize( count * 2 );
+	}
+}
+
+
+
+
+SamplePeaks * SamplePeaks::create( const sampleFrame * data, f_cnt_t frames,
+					const QByteArray & cacheKey,
+					const std::atomic_bool * cancelled )
+{
+	SamplePeaks * peaks = new SamplePeaks( frames );
+	if( !peaks->fromByteArray( SampleCache::loadPeaks( cacheKey ) ) )
+	{
+		if( !peaks->build( data, cancelled ) )
+		{
+			delete peaks;
+			return NULL;
+		}
+		SampleCache::storePeaks( cacheKey, peaks->toByteArray() );
+	}
+	return peaks;
+}
+
+
+
+
+SamplePeaks::Peak SamplePeaks::peak( f_cnt_t from, f_cnt_t to, int ch ) const
+{
+	from = qBound<f_cnt_t>( 0, from, m_frames - 1 );
+	to = qBound<f_cnt_t>( from + 1, to, m_frames );
+
+	// the coarsest level with peaks not longer than the range
+	int level = 0;
+	f_cnt_t frames = BaseFrames;
+	while( level + 1 < m_levels.size() && frames * LevelFactor <= to - from )
+	{
+		++level;
+		frames *= LevelFactor;
+	}
+
+	const QVector<Peak> & peaks = m_levels[level];
+	const int first = from / frames;
+	const int last = ( to - 1 ) / frames;
+	Peak p = peaks[first * 2 + ch];
+	float sum = p.rms * p.rms;
+	for( int i = first + 1; i <= last; ++i )
+	{
+		const Peak & q = peaks[i * 2 + ch];
+		p.min = qMin( p.min, q.min );
+		p.max = qMax( p.max, q.max );
+		sum += q.rms * q.rms;
+	}
+	p.rms = sqrtf( sum / ( last - first + 1 ) );
+	return p;
+}
+
+
+
+
+bool SamplePeaks::build( const sampleFrame * data,
+					const std::atomic_bool * cancelled )
+{
+	QVector<Peak> & base = m_levels[0];
+	for( int i = 0; i < base.size() / 2; ++i )
+	{
+		// check every few seconds of the sample
+		if( cancelled && i % 4096 == 0 && *cancelled )
+		{
+			return false;
+		}
+		const f_cnt_t begin = i * BaseFrames;
+		const f_cnt_t end = qMin( begin + BaseFrames, m_frames );
+		for( int ch = 0; ch < 2; ++ch )
+		{
+			Peak p = { data[begin][ch], data[begin][ch], 0 };
+			float sum = 0;
+			for( f_cnt_t f = begin; f < end; ++f )
+			{
+				p.min = qMin( p.min, data[f][ch] );
+				p.max = qMax( p.max, data[f][ch] );
+				sum += data[f][ch] * data[f][ch];
+			}
+			p.rms = sqrtf( sum / ( end - begin ) );
+			base[i * 2 + ch] = p;
+		}
+	}
+
+	for( int level = 1; level < m_levels.size(); ++level )
+	{
+		const QVector<Peak> & below = m_levels[level - 1];
+		QVector<Peak> & peaks = m_levels[level];
+		for( int i = 0; i < peaks.size() / 2; ++i )
+		{
+			const int first = i * LevelFactor;
+			const int last = qMin( first + LevelFactor, below.size() / 2 );
+			for( int ch = 0; ch < 2; ++ch )
+			{
+				Peak p = below[first * 2 + ch];
+				float sum = p.rms * p.rms;
+				for( int j = first + 1; j < last; ++j )
+				{
+					const Peak & q = below[j * 2 + ch];
+					p.min = qMin( p.min, q.min );
+					p.max = qMax( p.max, q.max );
+					sum += q.rms * q.rms;
+				}
+				p.rms = sqrtf( sum / ( last - first ) );
+				peaks[i * 2 + ch] = p;
+			}
+		}
+	}
+
+	return true;
+}
+
+
+
+
+bool SamplePeaks::fromByteArray( const QByteArray & array )
+{
+	qint64 size = sizeof( Magic ) + sizeof( qint64 );
+	for( const QVector<Peak> & peaks : m_levels )
+	{
+		size += peaks.size() * qint64( sizeof( Peak ) );
+	}
+	qint64 frames;
+	if( array.size() != size ||
+		memcmp( array.constData(), Magic, sizeof( Magic ) ) )
+	{
+		return false;
+	}
+	memcpy( &frames, array.constData() + sizeof( Magic ), sizeof( frames ) );
+	if( frames != m_frames )
+	{
+		return false;
+	}
+
+	const char * pos = array.constData() + sizeof( Magic ) + sizeof( frames );
+	for( QVector<Peak> & peaks : m_levels )
+	{
+		memcpy( peaks.data(), pos, peaks.size() * sizeof( Peak ) );
+		pos += peaks.size() * sizeof( Peak );
+	}
+	return true;
+}
+
+
+
+
+QByteArray SamplePeaks::toByteArray() const
+{
+	const qint64 frames = m_frames;
+	QByteArray array( Magic, sizeof( Magic ) );
+	array.append( reinterpret_cast<const char *>( &frames ), sizeof( frames ) );
+	for( const QVector<Peak> & peaks : m_levels )
+	{
+		array.append( reinterpret_cast<const char *>( peaks.constData() ),
+					peaks.size() * sizeof( Peak ) );
+	}
+	return array;
+}
@@ -90,6 +90,7 @@ void SamplePlayHandle::play( sampleFrame * buffer )
 	if( framesDone() >= totalFrames() )
 	{
 		memset( buffer, 0, sizeof( sampleFrame ) * fpp );
+		setSilent( true );
 		return;
 	}
 
@@ -104,18 +105,25 @@ void SamplePlayHandle::play( sampleFrame * buffer )
 		frames -= offset();
 	}
 
+	// the buffer comes cleared, so it stays silent when muted
+	bool silent = true;
 	if( !( m_track && m_track->isMuted() )
 				&& !( m_bbTrack && m_bbTrack->isMuted() ) )
 	{
 /*		stereoVolumeVector v =
 			{ { m_volumeModel->value() / DefaultVolume,
 				m_volumeModel->value() / DefaultVolume } };*/
-		if( ! m_sampleBuffer->play( workingBuffer, &m_state, frames,
+		if( m_sampleBuffer->play( workingBuffer, &m_state, frames,
 								BaseFreq ) )
+		{
+			silent = false;
+		}
+		else
 		{
 			memset( workingBuffer, 0, frames * sizeof( sampleFrame ) );
 		}
 	}
+	setSilent( silent );
 
 	m_frame += frames;
 }
@@ -141,7 +149,7 @@ bool SamplePlayHandle::isFromTrack( const Track * _track ) const
 
 f_cnt_t SamplePlayHandle::totalFrames() const
 {
-	return ( m_sampleBuffer->endFrame() - m_sampleBuffer->startFrame() ) * ( Engine::mixer()->processingSampleRate() / m_sampleBuffer->sampleRate() );
+	return ( m_sampleBuffer->endFrame() - m_sampleBuffer->startFrame() ) * ( (double) Engine::mixer()->processingSampleRate() / m_sampleBuffer->sampleRate() );
 }
 
 
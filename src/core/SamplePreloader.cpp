@@ -0,0 +1,153 @@
+/*
+ * SamplePreloader.cpp - decodes the samples of a project in parallel
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+
+#include "SamplePreloader.h"
+
+#include <QCoreApplication>
+#include <QFileInfo>
+#include <QStringList>
+#include <QProgressDialog>
+#include <QRunnable>
+#include <QThreadPool>
+
+#include <atomic>
+
+#include "GuiApplication.h"
+#include "MainWindow.h"
+#include "SampleBuffer.h"
+#include "SampleCache.h"
+
+
+namespace
+{
+
+//! How often to update the progress while waiting, in ms
+const int ProgressInterval = 50;
+
+class PreloadTask : public QRunnable
+{
+public:
+	PreloadTask( const QString & file, std::atomic_bool & cancelled,
+						std::atomic_int & done ) :
+		m_file( file ),
+		m_cancelled( cancelled ),
+		m_done( done )
+	{
+	}
+
+	void run() override
+	{
+		if( !m_cancelled )
+		{
+			SampleBuffer::preload( m_file );
+		}
+		++m_done;
+	}
+
+private:
+	QString m_file;
+	std::atomic_bool & m_cancelled;
+	std::atomic_int & m_done;
+
+} ;
+
+
+void addSample( QStringList & samples, const QString & file )
+{
+	// DrumSynth's decoder isn't reentrant
+	if( !file.isEmpty() && QFileInfo( file ).suffix().toLower() != "ds" &&
+		!samples.contains( file ) )
+	{
+		samples << file;
+	}
+}
+
+}
+
+
+
+
+bool SamplePreloader::preload( const QDomElement & project )
+{
+	if( !SampleCache::isEnabled() )
+	{
+		return true;
+	}
+
+	// the cache holds samples unreversed, so it doesn't matter whether
+	// an AudioFileProcessor plays them backwards
+	QStringList samples;
+	QDomNodeList nodes = project.elementsByTagName( "sampletco" );
+	for( int i = 0; i < nodes.count(); ++i )
+	{
+		addSample( samples, nodes.at( i ).toElement().attribute( "src" ) );
+	}
+	nodes = project.elementsByTagName( "audiofileprocessor" );
+	for( int i = 0; i < nodes.count(); ++i )
+	{
+		addSample( samples, nodes.at( i ).toElement().attribute( "src" ) );
+	}
+	if( samples.isEmpty() )
+	{
+		return true;
+	}
+
+	std::atomic_bool cancelled( false );
+	std::atomic_int done( 0 );
+	QThreadPool pool;
+	for( const QString & sample : samples )
+	{
+		pool.start( new PreloadTask( sample, cancelled, done ) );
+	}
+
+	if( gui == NULL )
+	{
+		pool.waitForDone();
+		return true;
+	}
+
+	QProgressDialog pd( QCoreApplication::translate( "SamplePreloader",
+						"Decoding samples..." ),
+			QCoreApplication::translate( "SamplePreloader", "Cancel" ),
+			0, samples.size(), gui->mainWindow() );
+	pd.setWindowModality( Qt::ApplicationModal );
+	pd.setWindowTitle( QCoreApplication::translate( "SamplePreloader",
+							"Please wait..." ) );
+	pd.show();
+	while( !pool.waitForDone( ProgressInterval ) )
+	{
+		pd.setValue( done );
+		pd.setLabelText( QCoreApplication::translate( "SamplePreloader",
+					"Decoding samples (%1/Total %2)" ).
+					arg( done ).arg( samples.size() ) );
+		QCoreApplication::processEvents( QEventLoop::AllEvents,
+							ProgressInterval );
+		if( pd.wasCanceled() )
+		{
+			// samples being decoded are finished
+			cancelled = true;
+		}
+	}
+	return !cancelled;
+}
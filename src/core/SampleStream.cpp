@@ -0,0 +1,507 @@
+/*
+ * SampleStream.cpp - stream long audio files from disk
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#include "SampleStream.h"
+
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QThread>
+
+#include <algorithm>
+#include <cstring>
+
+#include "ConfigManager.h"
+
+
+class SampleStreamer;
+
+
+namespace
+{
+
+//! Decoded size in MB from which on files get streamed if not configured
+const int DefaultStreamThreshold = 64;
+
+//! How long the I/O thread sleeps when there's nothing to do, in ms
+const int IdleInterval = 5;
+
+//! Blocks used within that many I/O thread iterations aren't dropped
+const int MinBlockAge = 200;
+
+//! Blocks decoded per stream and iteration, so no stream waits too long
+const int MaxLoadsPerIteration = 4;
+
+QMutex s_streamsMutex;
+QList<SampleStream *> s_streams;
+SampleStreamer * s_streamer = NULL;
+std::atomic_int s_epoch( 0 );
+
+//! Configured stream threshold in MB, 0 or less if streaming is disabled
+int streamThreshold()
+{
+	bool ok;
+	int threshold = ConfigManager::inst()->value( "mixer",
+					"streamthreshold" ).toInt( &ok );
+	return ok ? threshold : DefaultStreamThreshold;
+}
+
+}
+
+
+
+
+//! Decodes requested blocks of all streams, drops unused ones and builds
+//! the waveform overviews
+class SampleStreamer : public QThread
+{
+public:
+	SampleStreamer() :
+		m_quit( false )
+	{
+	}
+
+	void finish()
+	{
+		m_quit = true;
+	}
+
+private:
+	void run() override
+	{
+		while( !m_quit )
+		{
+			bool busy = false;
+			s_streamsMutex.lock();
+			++s_epoch;
+			for( SampleStream * stream : s_streams )
+			{
+				busy |= stream->service();
+			}
+			s_streamsMutex.unlock();
+
+			if( !busy )
+			{
+				msleep( IdleInterval );
+			}
+		}
+	}
+
+	std::atomic_bool m_quit;
+
+} ;
+
+
+
+
+SampleStream::SampleStream( bool reversed ) :
+	m_reversed( reversed ),
+	m_sndFile( NULL ),
+	m_channels( 0 ),
+	m_frames( 0 ),
+	m_sampleRate( 0 ),
+	m_blockCount( 0 ),
+	m_loadedBlocks( 0 ),
+	m_decodeBuffer( NULL ),
+	m_peakCount( 0 ),
+	m_peaksDone( 0 )
+{
+}
+
+
+
+
+SampleStream * SampleStream::open( const QString & file, bool reversed )
+{
+	if( streamThreshold() <= 0 )
+	{
+		return NULL;
+	}
+
+	SampleStream * stream = new SampleStream( reversed );
+	if( !stream->openFile( file ) || !isStreamed( stream->m_frames ) )
+	{
+		delete stream;
+		return NULL;
+	}
+
+	// decode the beginning right away, so playback can start without
+	// waiting for the I/O thread
+	for( int block = 0; block < qMin( HeadBlocks, stream->m_blockCount ); ++block )
+	{
+		stream->loadBlock( block );
+	}
+
+	QMutexLocker locker( &s_streamsMutex );
+	s_streams << stream;
+	if( s_streamer == NULL )
+	{
+		s_streamer = new SampleStreamer;
+		s_streamer->start();
+	}
+	return stream;
+}
+
+
+
+
+bool SampleStream::isStreamed( f_cnt_t frames )
+{
+	const int threshold = streamThreshold();
+	return threshold > 0 && qint64( frames ) * sizeof( sampleFrame ) >=
+					qint64( threshold ) * 1024 * 1024;
+}
+
+
+
+
+SampleStream::~SampleStream()
+{
+	SampleStreamer * finished = NULL;
+	s_streamsMutex.lock();
+	if( s_streams.removeOne( this ) && s_streams.isEmpty() )
+	{
+		finished = s_streamer;
+		s_streamer = NULL;
+		finished->finish();
+	}
+	s_streamsMutex.unlock();
+	if( finished )
+	{
+		finished->wait();
+		delete finished;
+	}
+
+	for( int block = 0; block < m_blockCount; ++block )
+	{
+		delete[] m_blocks[block].data.load();
+	}
+	if( m_sndFile )
+	{
+		sf_close( m_sndFile );
+	}
+	delete[] m_decodeBuffer;
+}
+
+
+
+
+void SampleStream::read( sampleFrame * dest, f_cnt_t index, f_cnt_t count,
+								bool wait )
+{
+	const int epoch = s_epoch.load( std::memory_order_relaxed );
+	f_cnt_t done = 0;
+	while( done < count )
+	{
+		const f_cnt_t frame = index + done;
+		if( frame < 0 || frame >= m_frames )
+		{
+			const f_cnt_t todo = frame < 0 ?
+				qMin( count - done, -frame ) : count - done;
+			memset( dest + done, 0, todo * sizeof( sampleFrame ) );
+			done += todo;
+			continue;
+		}
+
+		const int b = frame / BlockFrames;
+		const f_cnt_t offset = frame - b * BlockFrames;
+		const f_cnt_t todo = qMin( count - done,
+				qMin( BlockFrames - offset, m_frames - frame ) );
+
+		// the I/O thread doesn't free the block while we're reading
+		Block & block = m_blocks[b];
+		block.readers.fetch_add( 1 );
+		const sampleFrame * data = block.data.load();
+		while( data == NULL && wait )
+		{
+			block.readers.fetch_sub( 1 );
+			request( b );
+			QThread::usleep( 100 );
+			block.readers.fetch_add( 1 );
+			data = block.data.load();
+		}
+		if( data )
+		{
+			memcpy( dest + done, data + offset, todo * sizeof( sampleFrame ) );
+			block.lastUse.store( epoch, std::memory_order_relaxed );
+		}
+		else
+		{
+			// not decoded yet
+			memset( dest + done, 0, todo * sizeof( sampleFrame ) );
+			request( b );
+		}
+		block.readers.fetch_sub( 1 );
+
+		for( int next = b + 1; next <= b + ReadAheadBlocks &&
+						next < m_blockCount; ++next )
+		{
+			request( next );
+		}
+		done += todo;
+	}
+}
+
+
+
+
+void SampleStream::prefetch( f_cnt_t index )
+{
+	if( index >= 0 && index < m_frames )
+	{
+		request( index / BlockFrames );
+	}
+}
+
+
+
+
+bool SampleStream::peak( f_cnt_t from, f_cnt_t to, int ch,
+					float & min, float & max ) const
+{
+	from = qBound<f_cnt_t>( 0, from, m_frames );
+	to = qBound<f_cnt_t>( 0, to, m_frames );
+	if( from >= to )
+	{
+		return false;
+	}
+	if( m_reversed )
+	{
+		const f_cnt_t reversedFrom = m_frames - to;
+		to = m_frames - from;
+		from = reversedFrom;
+	}
+
+	const int first = from / PeakFrames;
+	const int last = ( to - 1 ) / PeakFrames;
+	if( last >= m_peaksDone.load( std::memory_order_acquire ) )
+	{
+		return false;
+	}
+	min = m_peaks[first * 4 + ch * 2];
+	max = m_peaks[first * 4 + ch * 2 + 1];
+	for( int p = first + 1; p <= last; ++p )
+	{
+		min = qMin( min, m_peaks[p * 4 + ch * 2] );
+		max = qMax( max, m_peaks[p * 4 + ch * 2 + 1] );
+	}
+	return true;
+}
+
+
+
+
+bool SampleStream::openFile( const QString & file )
+{
+	// use QFile to handle unicode file names on Windows
+	m_file.setFileName( file );
+	if( !m_file.open( QFile::ReadOnly ) )
+	{
+		return false;
+	}
+	SF_INFO info;
+	info.format = 0;
+	m_sndFile = sf_open_fd( m_file.handle(), SFM_READ, &info, false );
+	if( m_sndFile == NULL || !info.seekable || info.frames <= 0 ||
+		info.channels <= 0 || info.frames > 0x7fffffff - BlockFrames )
+	{
+		return false;
+	}
+	m_channels = info.channels;
+	m_frames = info.frames;
+	m_sampleRate = info.samplerate;
+
+	m_blockCount = ( m_frames + BlockFrames - 1 ) / BlockFrames;
+	m_blocks.reset( new Block[m_blockCount] );
+	for( int block = 0; block < m_blockCount; ++block )
+	{
+		m_blocks[block].data.store( NULL );
+		m_blocks[block].state.store( BlockEmpty );
+		m_blocks[block].readers.store( 0 );
+		m_blocks[block].lastUse.store( 0 );
+	}
+	m_decodeBuffer = new float[BlockFrames * m_channels];
+
+	m_peakCount = ( m_frames + PeakFrames - 1 ) / PeakFrames;
+	m_peaks.reset( new float[m_peakCount * 4] );
+	return true;
+}
+
+
+
+
+void SampleStream::request( int block )
+{
+	std::atomic_int & state = m_blocks[block].state;
+	int expected = BlockEmpty;
+	if( state.load( std::memory_order_relaxed ) == BlockEmpty )
+	{
+		state.compare_exchange_strong( expected, BlockRequested );
+	}
+}
+
+
+
+
+void SampleStream::decode( sampleFrame * dest, f_cnt_t from, f_cnt_t count )
+{
+	sf_count_t read = 0;
+	if( sf_seek( m_sndFile, from, SEEK_SET ) == from )
+	{
+		read = qMax<sf_count_t>( 0, sf_readf_float( m_sndFile,
+						m_decodeBuffer, count ) );
+	}
+
+	const int ch = m_channels > 1 ? 1 : 0;
+	for( f_cnt_t frame = 0; frame < read; ++frame )
+	{
+		dest[frame][0] = m_decodeBuffer[frame * m_channels];
+		dest[frame][1] = m_decodeBuffer[frame * m_channels + ch];
+	}
+	// zeros where the file couldn't be read
+	memset( dest + read, 0, ( count - read ) * sizeof( sampleFrame ) );
+}
+
+
+
+
+void SampleStream::loadBlock( int block )
+{
+	const f_cnt_t first = block * BlockFrames;
+	const f_cnt_t count = qMin( BlockFrames, m_frames - first );
+	// played backwards, the first block comes from the end of the file
+	const f_cnt_t from = m_reversed ? m_frames - first - count : first;
+
+	sampleFrame * data = new sampleFrame[count];
+	decode( data, from, count );
+	if( m_reversed )
+	{
+		std::reverse( data, data + count );
+	}
+
+	Block & b = m_blocks[block];
+	b.lastUse.store( s_epoch.load() );
+	b.data.store( data );
+	b.state.store( BlockLoaded );
+	++m_loadedBlocks;
+}
+
+
+
+
+void SampleStream::evictBlocks()
+{
+	const int epoch = s_epoch.load();
+	while( m_loadedBlocks > CacheBlocks + HeadBlocks )
+	{
+		// drop the block not used for the longest time, but never the
+		// head
+		int oldest = -1;
+		for( int block = HeadBlocks; block < m_blockCount; ++block )
+		{
+			const Block & b = m_blocks[block];
+			if( b.state.load() == BlockLoaded &&
+				epoch - b.lastUse.load() > MinBlockAge &&
+				( oldest < 0 || b.lastUse.load() <
+					m_blocks[oldest].lastUse.load() ) )
+			{
+				oldest = block;
+			}
+		}
+		if( oldest < 0 )
+		{
+			return;
+		}
+
+		Block & b = m_blocks[oldest];
+		sampleFrame * data = b.data.exchange( NULL );
+		b.state.store( BlockEmpty );
+		// readers which got the data before are done soon
+		while( b.readers.load() > 0 )
+		{
+			QThread::yieldCurrentThread();
+		}
+		delete[] data;
+		--m_loadedBlocks;
+	}
+}
+
+
+
+
+void SampleStream::scanPeaks()
+{
+	// the decode buffer is big enough for a block
+	const int peaksPerBlock = BlockFrames / PeakFrames;
+	const int first = m_peaksDone.load();
+	const int last = qMin( first + peaksPerBlock, m_peakCount );
+	const f_cnt_t from = first * PeakFrames;
+	const f_cnt_t count = qMin( last * PeakFrames, m_frames ) - from;
+
+	sampleFrame * frames = new sampleFrame[count];
+	decode( frames, from, count );
+	for( int p = first; p < last; ++p )
+	{
+		const f_cnt_t begin = p * PeakFrames - from;
+		const f_cnt_t end = qMin( begin + PeakFrames, count );
+		for( int ch = 0; ch < 2; ++ch )
+		{
+			float min = frames[begin][ch];
+			float max = min;
+			for( f_cnt_t f = begin + 1; f < end; ++f )
+			{
+				min = qMin( min, frames[f][ch] );
+				max = qMax( max, frames[f][ch] );
+			}
+			m_peaks[p * 4 + ch * 2] = min;
+			m_peaks[p * 4 + ch * 2 + 1] = max;
+		}
+	}
+	delete[] frames;
+	m_peaksDone.store( last, std::memory_order_release );
+}
+
+
+
+
+bool SampleStream::service()
+{
+	int loads = 0;
+	for( int block = 0; block < m_blockCount &&
+				loads < MaxLoadsPerIteration; ++block )
+	{
+		if( m_blocks[block].state.load() == BlockRequested )
+		{
+			loadBlock( block );
+			++loads;
+		}
+	}
+	evictBlocks();
+
+	if( loads == 0 && m_peaksDone.load() < m_peakCount )
+	{
+		// playback comes first
+		scanPeaks();
+		return true;
+	}
+	return loads > 0;
+}
@@ -0,0 +1,321 @@
+/*
+ * SegmentedRender.cpp - splitting a song into segments which can be rendered independently
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#include "SegmentedRender.h"
+
+#include <QtCore/QIODevice>
+#include <QtCore/QMap>
+
+#include <cmath>
+
+#include "AutomatableModel.h"
+#include "BBTrackContainer.h"
+#include "Controller.h"
+#include "EffectChain.h"
+#include "EnvelopeAndLfoParameters.h"
+#include "Engine.h"
+#include "FxMixer.h"
+#include "InstrumentTrack.h"
+#include "Mixer.h"
+#include "MixHelpers.h"
+#include "Pattern.h"
+#include "SampleTrack.h"
+#include "Song.h"
+#include "Track.h"
+
+
+namespace SegmentedRender
+{
+
+// longest tail written after a segment in seconds
+static const int MAX_TAIL_LENGTH = 30;
+
+
+// Replays how Song::processNextBuffer() advances the play position when
+// exporting and returns the ticks which start right at the beginning of a
+// period without a frame fraction, mapped to that period. Only these can be
+// the start of a segment, as its periods and the timing of its ticks have to
+// be exactly the same as when rendering the whole song.
+static QMap<tick_t, int> periodAlignedTicks( tick_t endTick )
+{
+	const float framesPerTick = Engine::framesPerTick();
+	const fpp_t fpp = Engine::mixer()->framesPerPeriod();
+
+	QMap<tick_t, int> aligned;
+	tick_t ticks = 0;
+	float currentFrame = 0;
+	for( int period = 0; ticks < endTick; ++period )
+	{
+		f_cnt_t framesPlayed = 0;
+		while( framesPlayed < fpp )
+		{
+			if( currentFrame >= framesPerTick )
+			{
+				ticks += (int)( currentFrame / framesPerTick );
+				currentFrame = fmodf( currentFrame, framesPerTick );
+				if( framesPlayed == 0 && currentFrame == 0 )
+				{
+					aligned[ticks] = period;
+				}
+			}
+
+			f_cnt_t framesToPlay = fpp - framesPlayed;
+			const f_cnt_t framesLeft = (f_cnt_t) framesPerTick -
+							(f_cnt_t) currentFrame;
+			// skip last frame fraction
+			if( framesLeft == 0 )
+			{
+				++framesPlayed;
+				currentFrame = currentFrame + 1.0f;
+				continue;
+			}
+			if( framesLeft < framesToPlay )
+			{
+				framesToPlay = framesLeft;
+			}
+
+			framesPlayed += framesToPlay;
+			currentFrame = framesToPlay + currentFrame;
+		}
+	}
+
+	return aligned;
+}
+
+
+
+
+// frames a track may keep sounding after its patterns ended - note
+// releases and effects fading out
+static f_cnt_t tailFrames( Track * track )
+{
+	if( InstrumentTrack * it = dynamic_cast<InstrumentTrack *>( track ) )
+	{
+		return it->releaseFrames() + it->audioPort()->effects()->tailFrames();
+	}
+	if( SampleTrack * st = dynamic_cast<SampleTrack *>( track ) )
+	{
+		return st->audioPort()->effects()->tailFrames();
+	}
+	if( track->type() == Track::BBTrack )
+	{
+		f_cnt_t frames = 0;
+		for( Track * t : Engine::getBBTrackContainer()->tracks() )
+		{
+			frames = qMax( frames, tailFrames( t ) );
+		}
+		return frames;
+	}
+	return 0;
+}
+
+
+
+
+// where a pattern stops sounding - notes may be longer than the pattern
+static tick_t endOf( const TrackContentObject * tco )
+{
+	tick_t end = tco->endPosition();
+	if( const Pattern * p = dynamic_cast<const Pattern *>( tco ) )
+	{
+		for( const Note * note : p->notes() )
+		{
+			end = qMax<tick_t>( end, tco->startPosition() + note->endPos() );
+		}
+	}
+	return end;
+}
+
+
+
+
+// nothing which starts before the tick sounds past it, including releases,
+// effect tails and automation - sound which still continues gets caught by
+// render() nevertheless
+static bool isQuietAt( tick_t tick )
+{
+	const float framesPerTick = Engine::framesPerTick();
+
+	// the FX channels may fade out after any track
+	f_cnt_t fxTail = 0;
+	FxMixer * fxMixer = Engine::fxMixer();
+	for( fx_ch_t ch = 0; ch < fxMixer->numChannels(); ++ch )
+	{
+		fxTail += fxMixer->effectChannel( ch )->m_fxChain.tailFrames();
+	}
+
+	for( Track * track : Engine::getSong()->tracks() )
+	{
+		if( track->isMuted() || ( track->type() != Track::InstrumentTrack &&
+				track->type() != Track::SampleTrack &&
+				track->type() != Track::BBTrack &&
+				track->type() != Track::AutomationTrack ) )
+		{
+			continue;
+		}
+
+		const tick_t tail = track->type() == Track::AutomationTrack ? 0 :
+			(tick_t) ceilf( ( tailFrames( track ) + fxTail ) / framesPerTick );
+		for( const TrackContentObject * tco : track->getTCOs() )
+		{
+			if( !tco->isMuted() && tco->startPosition() < tick &&
+						endOf( tco ) + tail > tick )
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+
+
+
+QVector<Segment> split( int count )
+{
+	Song * song = Engine::getSong();
+
+	QVector<Segment> segments;
+	segments.push_back( Segment{ 0, 0, -1 } );
+
+	// ticks can only be mapped to periods without playing the song if all
+	// of them have the same length
+	if( count < 2 || song->getTempoModel().isAutomatedOrControlled() ||
+					song->getLoopRenderCount() > 1 )
+	{
+		return segments;
+	}
+
+	song->updateLength();
+	const tick_t length = song->length() * MidiTime::ticksPerTact();
+	const QMap<tick_t, int> aligned = periodAlignedTicks( length );
+
+	QVector<tick_t> candidates;
+	for( auto it = aligned.begin(); it != aligned.end(); ++it )
+	{
+		if( it.key() > 0 && it.key() < length && isQuietAt( it.key() ) )
+		{
+			candidates.push_back( it.key() );
+		}
+	}
+
+	// take the candidate next to each ideal split point
+	int next = 0;
+	for( int i = 1; i < count && next < candidates.size(); ++i )
+	{
+		const tick_t target = (tick_t)( (qint64) length * i / count );
+		while( next + 1 < candidates.size() &&
+			qAbs( candidates[next + 1] - target ) <=
+					qAbs( candidates[next] - target ) )
+		{
+			++next;
+		}
+
+		const tick_t start = candidates[next++];
+		Segment & previous = segments.last();
+		// the first segment skips the first period like ProjectRenderer
+		previous.periods = aligned[start] - previous.firstPeriod -
+						( previous.start == 0 ? 1 : 0 );
+		segments.push_back( Segment{ start, aligned[start], -1 } );
+	}
+
+	return segments;
+}
+
+
+
+
+f_cnt_t render( const Segment & segment, QIODevice & stream,
+						const volatile bool & abort )
+{
+	Song * song = Engine::getSong();
+	Mixer * mixer = Engine::mixer();
+	const fpp_t fpp = mixer->framesPerPeriod();
+	const qint64 periodBytes = fpp * sizeof( surroundSampleFrame );
+
+	song->setExportStart( segment.start );
+	song->startExport();
+	song->updateLength();
+
+	if( segment.start == 0 )
+	{
+		// Skip first empty buffer.
+		mixer->nextBuffer();
+	}
+	else
+	{
+		// continue LFOs where they are when rendering the whole song
+		EnvelopeAndLfoParameters::instances()->reset(
+						segment.firstPeriod * fpp );
+		Controller::resetFrameCounter( segment.firstPeriod );
+
+		// values of automation which ended before the segment stay
+		// where they are when rendering the whole song, apply them
+		// before the first period so nothing ramps towards them
+		const AutomatedValueMap values =
+				song->automatedValuesAt( segment.start );
+		for( auto it = values.begin(); it != values.end(); ++it )
+		{
+			it.key()->setAutomatedValue( it.value() );
+		}
+	}
+
+	mixer->startProcessing( false );
+
+	for( int period = 0; !abort && ( segment.periods < 0 ?
+			!song->isExportDone() : period < segment.periods );
+								++period )
+	{
+		stream.write( (const char *) mixer->nextBuffer(), periodBytes );
+	}
+
+	// the next segment starts here, so don't play anything new but let
+	// notes and effects still sounding fade out - if there's anything,
+	// the segments don't add up to the whole song
+	f_cnt_t tail = 0;
+	if( segment.periods >= 0 )
+	{
+		song->togglePause();
+		const f_cnt_t maxTail = mixer->processingSampleRate() *
+							MAX_TAIL_LENGTH;
+		while( !abort && tail < maxTail )
+		{
+			const surroundSampleFrame * buf = mixer->nextBuffer();
+			if( mixer->playHandles().isEmpty() &&
+					MixHelpers::isSilent( buf, fpp ) )
+			{
+				break;
+			}
+			stream.write( (const char *) buf, periodBytes );
+			tail += fpp;
+		}
+	}
+
+	mixer->stopProcessing();
+	song->stopExport();
+
+	return tail;
+}
+
+}
@@ -40,6 +40,7 @@
 #include "ConfigManager.h"
 #include "ControllerRackView.h"
 #include "ControllerConnection.h"
+#include "DeterministicRender.h"
 #include "embed.h"
 #include "EnvelopeAndLfoParameters.h"
 #include "FxMixer.h"
@@ -50,9 +51,11 @@
 #include "PianoRoll.h"
 #include "ProjectJournal.h"
 #include "ProjectNotes.h"
+#include "SamplePreloader.h"
 #include "SongEditor.h"
 #include "TimeLineWidget.h"
 #include "PeakController.h"
+#include "RenderCache.h"
 
 
 tick_t MidiTime::s_ticksPerTact = DefaultTicksPerTact;
@@ -77,6 +80,8 @@ Song::Song() :
 	m_exporting( false ),
 	m_exportLoop( false ),
 	m_renderBetweenMarkers( false ),
+	m_exportStart( 0 ),
+	m_renderCache( NULL ),
 	m_playing( false ),
 	m_paused( false ),
 	m_loadingProject( false ),
@@ -117,6 +122,7 @@ Song::Song() :
 Song::~Song()
 {
 	m_playing = false;
+	delete m_renderCache;
 	delete m_globalAutomationTrack;
 }
 
@@ -136,11 +142,10 @@ void Song::setTempo()
 {
 	Engine::mixer()->requestChangeInModel();
 	const bpm_t tempo = ( bpm_t ) m_tempoModel.value();
-	PlayHandleList & playHandles = Engine::mixer()->playHandles();
-	for( PlayHandleList::Iterator it = playHandles.begin();
-						it != playHandles.end(); ++it )
+	const PlayHandleRegistry & playHandles = Engine::mixer()->playHandles();
+	for( PlayHandle * ph : playHandles )
 	{
-		NotePlayHandle * nph = dynamic_cast<NotePlayHandle *>( *it );
+		NotePlayHandle * nph = dynamic_cast<NotePlayHandle *>( ph );
 		if( nph && !nph->isReleased() )
 		{
 			nph->lock();
@@ -191,6 +196,11 @@ void Song::processNextBuffer()
 {
 	m_vstSyncController.setPlaybackJumped( false );
 
+	if( m_renderCache )
+	{
+		m_renderCache->startPeriod();
+	}
+
 	// if not playing, nothing to do
 	if( m_playing == false )
 	{
@@ -393,9 +403,20 @@ void Song::processNextBuffer()
 		{
 			processAutomations(trackList, m_playPos[m_playMode], framesToPlay);
 
+			if( m_renderCache )
+			{
+				m_renderCache->playTick( m_playPos[m_playMode].getTicks(),
+								framesPlayed );
+			}
+
 			// loop through all tracks and play them
 			for( int i = 0; i < trackList.size(); ++i )
 			{
+				// the output of cached tracks comes from the render cache
+				if( m_renderCache && m_renderCache->isCached( trackList[i] ) )
+				{
+					continue;
+				}
 				trackList[i]->play( m_playPos[m_playMode],
 						framesToPlay,
 						framesPlayed, tcoNum );
@@ -482,6 +503,10 @@ void Song::setModified(bool value)
 		m_modified = value;
 		emit modified();
 	}
+	if( !m_loadingProject && value )
+	{
+		emit edited();
+	}
 }
 
 bool Song::isExportDone() const
@@ -742,6 +767,7 @@ void Song::stop()
 void Song::startExport()
 {
 	stop();
+	DeterministicRender::restart();
 	if (m_renderBetweenMarkers)
 	{
 		m_exportSongBegin = m_exportLoopBegin = m_playPos[Mode_PlaySong].m_timeLine->loopBegin();
@@ -762,7 +788,7 @@ void Song::startExport()
 		if (!m_exportLoop) 
 			m_exportSongEnd += MidiTime(1,0);
         
-		m_exportSongBegin = MidiTime(0,0);
+		m_exportSongBegin = m_exportStart;
 		m_exportLoopBegin = m_playPos[Mode_PlaySong].m_timeLine->loopBegin() < m_exportSongEnd && 
 			m_playPos[Mode_PlaySong].m_timeLine->loopEnd() <= m_exportSongEnd ?
 			m_playPos[Mode_PlaySong].m_timeLine->loopBegin() : MidiTime(0,0);
@@ -770,13 +796,22 @@ void Song::startExport()
 			m_playPos[Mode_PlaySong].m_timeLine->loopEnd() <= m_exportSongEnd ?
 			m_playPos[Mode_PlaySong].m_timeLine->loopEnd() : MidiTime(0,0);
 
-		m_playPos[Mode_PlaySong].setTicks( 0 );
+		m_playPos[Mode_PlaySong].setTicks( m_exportStart.getTicks() );
 	}
 
 	m_exportEffectiveLength = (m_exportLoopBegin - m_exportSongBegin) + (m_exportLoopEnd - m_exportLoopBegin) 
 		* m_loopRenderCount + (m_exportSongEnd - m_exportLoopEnd);
 	m_loopRenderRemaining = m_loopRenderCount;
 
+	// reuse what didn't change since earlier exports
+	delete m_renderCache;
+	m_renderCache = NULL;
+	const QString renderCacheDir = RenderCache::directory();
+	if( !renderCacheDir.isEmpty() )
+	{
+		m_renderCache = new RenderCache( renderCacheDir, this, m_exportSongEnd );
+	}
+
 	playSong();
 
 	m_exporting = true;
@@ -789,9 +824,18 @@ void Song::startExport()
 
 void Song::stopExport()
 {
+	if( m_renderCache )
+	{
+		// keep the range which was rendered up to its end
+		m_renderCache->finish( m_playPos[Mode_PlaySong].getTicks() );
+	}
 	stop();
 	m_exporting = false;
 	m_exportLoop = false;
+	m_exportStart = 0;
+
+	delete m_renderCache;
+	m_renderCache = NULL;
 
 	m_vstSyncController.setPlaybackState( m_playing );
 }
@@ -976,6 +1020,7 @@ void Song::createNewProject()
 	m_loadingProject = true;
 
 	clearProject();
+	DeterministicRender::startProject();
 
 	Engine::projectJournal()->setJournalling( false );
 
@@ -1058,9 +1103,17 @@ void Song::loadProject( const QString & fileName )
 	m_oldFileName = m_fileName;
 
 	clearProject();
+	DeterministicRender::startProject();
 
 	clearErrors();
 
+	// decode the samples on all cores first, the tracks created below
+	// only map them from the sample cache then
+	if( !SamplePreloader::preload( dataFile.content() ) )
+	{
+		loadingCancelled();
+	}
+
 	Engine::mixer()->requestChangeInModel();
 
 	// get the header information from the DOM
@@ -0,0 +1,123 @@
+/*
+ * StemWriter.cpp - writes the output of a single audio port to a file while rendering
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#include "StemWriter.h"
+
+#include "AudioFileDevice.h"
+#include "AudioPort.h"
+#include "BufferManager.h"
+#include "Engine.h"
+#include "FxMixer.h"
+#include "Mixer.h"
+#include "MixHelpers.h"
+
+
+// periods the writer thread may lag behind the rendering
+static const int STEM_FIFO_SIZE = 16;
+
+
+StemWriter::StemWriter( AudioFileDevice * device, const AudioPort * port ) :
+	m_device( device ),
+	m_port( port ),
+	m_sanitizesFirst( false ),
+	m_clamps( false ),
+	m_period( BufferManager::acquire() ),
+	m_fifo( STEM_FIFO_SIZE, Engine::mixer()->framesPerPeriod() ),
+	m_queued( 0 )
+{
+	setObjectName( "StemWriter" );
+	Engine::fxMixer()->isTransparentPath( m_port->nextFxChannel(),
+						m_sanitizesFirst, m_clamps );
+}
+
+
+
+
+StemWriter::~StemWriter()
+{
+	BufferManager::release( m_period );
+}
+
+
+
+
+void StemWriter::pushPeriod()
+{
+	const fpp_t fpp = Engine::mixer()->framesPerPeriod();
+
+	BufferManager::clear( m_period, fpp );
+	const sampleFrame * output = m_port->lastOutput();
+	if( output )
+	{
+		// do what the FX mixer does to the track's output when nothing
+		// else is playing
+		if( m_sanitizesFirst )
+		{
+			// adding to the cleared buffer like the channel does turns
+			// -0.0 into +0.0
+			MixHelpers::add( m_period, output, fpp );
+			MixHelpers::sanitize( m_period, fpp );
+		}
+		else
+		{
+			MixHelpers::addSanitizedMultiplied( m_period, output,
+								1.0f, fpp );
+			if( m_clamps )
+			{
+				MixHelpers::sanitize( m_period, fpp );
+			}
+		}
+	}
+
+	m_fifo.write( m_period, 0 );
+	m_queued.release();
+}
+
+
+
+
+void StemWriter::finish()
+{
+	m_fifo.write( NULL, 0 );
+	m_queued.release();
+	wait();
+}
+
+
+
+
+void StemWriter::run()
+{
+	while( true )
+	{
+		m_queued.acquire();
+
+		bool underrun;
+		const surroundSampleFrame * period = m_fifo.read( underrun );
+		if( period == NULL )
+		{
+			break;
+		}
+		m_device->processBuffer( period );
+	}
+}
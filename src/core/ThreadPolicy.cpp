@@ -0,0 +1,203 @@
+/*
+ * ThreadPolicy.cpp - CPU placement and scheduling of audio threads
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#include "ThreadPolicy.h"
+
+#include <QtCore/QStringList>
+
+#include "lmmsconfig.h"
+
+#include <cstdio>
+
+#include "ConfigManager.h"
+#include "PerfTrace.h"
+
+#ifdef LMMS_HAVE_SCHED_H
+#include <sched.h>
+#endif
+
+#ifdef LMMS_HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+
+static QList<int> s_cpus;
+static bool s_realtime = false;
+static int s_priority = -1;
+
+static QString s_cpusOverride;
+static QString s_priorityOverride;
+
+
+
+
+void ThreadPolicy::init()
+{
+	ConfigManager * c = ConfigManager::inst();
+
+	const QString cpus = s_cpusOverride.isEmpty() ?
+			c->value( "mixer", "cpuaffinity" ) : s_cpusOverride;
+	s_cpus = parseCpuList( cpus );
+	if( !cpus.isEmpty() && s_cpus.isEmpty() )
+	{
+		printf( "Notice: invalid CPU list \"%s\", not pinning threads.\n",
+						cpus.toUtf8().constData() );
+	}
+
+	if( s_priorityOverride.isEmpty() )
+	{
+		s_realtime = c->value( "mixer", "realtime" ).toInt();
+		s_priority = c->value( "mixer", "rtpriority", "-1" ).toInt();
+	}
+	else
+	{
+		s_realtime = true;
+		s_priority = s_priorityOverride.toInt();
+	}
+}
+
+
+
+
+void ThreadPolicy::setOverrides( const QString & cpus, const QString & priority )
+{
+	s_cpusOverride = cpus;
+	s_priorityOverride = priority;
+}
+
+
+
+
+void ThreadPolicy::apply( const QString & name, int index )
+{
+	PerfTrace::setThreadName( name );
+
+	if( s_cpus.isEmpty() && !s_realtime )
+	{
+		return;
+	}
+
+	QString placement;
+
+	if( !s_cpus.isEmpty() )
+	{
+		const int cpu = s_cpus[index % s_cpus.size()];
+#if defined(LMMS_BUILD_LINUX) && defined(LMMS_HAVE_SCHED_H)
+		cpu_set_t mask;
+		CPU_ZERO( &mask );
+		CPU_SET( cpu, &mask );
+		if( sched_setaffinity( 0, sizeof( mask ), &mask ) == -1 )
+		{
+			printf( "Notice: could not pin %s to CPU %d.\n",
+					name.toUtf8().constData(), cpu );
+		}
+
+		// report what we actually got
+		QStringList cpus;
+		if( sched_getaffinity( 0, sizeof( mask ), &mask ) == 0 )
+		{
+			for( int i = 0; i < CPU_SETSIZE; ++i )
+			{
+				if( CPU_ISSET( i, &mask ) )
+				{
+					cpus << QString::number( i );
+				}
+			}
+		}
+		placement += QString( "CPU %1" ).arg( cpus.join( "," ) );
+#else
+		Q_UNUSED( cpu );
+		placement += "CPU pinning not supported";
+#endif
+	}
+
+	if( s_realtime )
+	{
+		if( !placement.isEmpty() )
+		{
+			placement += ", ";
+		}
+#if defined(LMMS_HAVE_PTHREAD_H) && defined(LMMS_HAVE_SCHED_H) && !defined(LMMS_BUILD_WIN32)
+		struct sched_param sparam;
+		sparam.sched_priority = s_priority >= 0 ? s_priority :
+					( sched_get_priority_max( SCHED_FIFO ) +
+					sched_get_priority_min( SCHED_FIFO ) ) / 2;
+		if( pthread_setschedparam( pthread_self(), SCHED_FIFO,
+								&sparam ) != 0 )
+		{
+			printf( "Notice: could not set realtime priority for %s.\n",
+						name.toUtf8().constData() );
+		}
+
+		int policy;
+		if( pthread_getschedparam( pthread_self(), &policy,
+							&sparam ) == 0 &&
+							policy == SCHED_FIFO )
+		{
+			placement += QString( "SCHED_FIFO priority %1" ).
+						arg( sparam.sched_priority );
+		}
+		else
+		{
+			placement += "no realtime scheduling";
+		}
+#else
+		placement += "realtime scheduling not supported";
+#endif
+	}
+
+	printf( "%s: %s\n", name.toUtf8().constData(),
+					placement.toUtf8().constData() );
+}
+
+
+
+
+QList<int> ThreadPolicy::parseCpuList( const QString & list )
+{
+	QList<int> cpus;
+	if( list.trimmed().isEmpty() )
+	{
+		return cpus;
+	}
+
+	for( const QString & part : list.split( ',' ) )
+	{
+		const QStringList range = part.trimmed().split( '-' );
+		bool ok1 = false;
+		bool ok2 = false;
+		const int first = range[0].toInt( &ok1 );
+		const int last = range.size() == 2 ? range[1].toInt( &ok2 ) : first;
+		if( !ok1 || ( range.size() == 2 && !ok2 ) || range.size() > 2 ||
+					first < 0 || last < first )
+		{
+			return QList<int>();
+		}
+		for( int cpu = first; cpu <= last; ++cpu )
+		{
+			cpus << cpu;
+		}
+	}
+
+	return cpus;
+}
@@ -2029,6 +2029,13 @@ void TrackOperationsWidget::updateMenu()
 	{
 		toMenu->addSeparator();
 		toMenu->addMenu(trackView->midiMenu());
+		// frozen tracks play along with the song only
+		if (trackView->model()->trackContainer() == Engine::getSong())
+		{
+			toMenu->addAction(trackView->model()->isFrozen() ?
+						tr("Unfreeze") : tr("Freeze"),
+						trackView, SLOT(toggleFreeze()));
+		}
 	}
 	if( dynamic_cast<AutomationTrackView *>( m_trackView ) )
 	{
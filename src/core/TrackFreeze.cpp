@@ -0,0 +1,293 @@
+/*
+ * TrackFreeze.cpp - render an instrument track to audio
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#include "TrackFreeze.h"
+
+#include <cstdio>
+#include <cstring>
+
+#include "denormals.h"
+#include "Engine.h"
+#include "InstrumentTrack.h"
+#include "MemoryManager.h"
+#include "Mixer.h"
+#include "PeriodArena.h"
+#include "ProjectJournal.h"
+#include "Song.h"
+#include "ThreadPolicy.h"
+
+
+
+TrackFreeze::TrackFreeze( InstrumentTrack * track ) :
+	m_track( track ),
+	m_data( NULL ),
+	m_frames( 0 ),
+	m_rendering( false ),
+	m_abort( false ),
+	m_writeFailed( false ),
+	m_progress( 0 ),
+	m_journalling( false ),
+	m_position( -1 ),
+	m_segmentCount( 0 )
+{
+	connect( this, SIGNAL( finished() ), this, SLOT( finishRendering() ) );
+}
+
+
+
+
+TrackFreeze::~TrackFreeze()
+{
+	abortRendering();
+	if( m_data )
+	{
+		m_file.unmap( (uchar *) m_data );
+	}
+}
+
+
+
+
+bool TrackFreeze::startRendering()
+{
+	if( !m_file.open() )
+	{
+		printf( "Notice: could not create file for freezing track %s\n",
+						qPrintable( m_track->name() ) );
+		return false;
+	}
+
+	Song * song = Engine::getSong();
+
+	// play the track alone, without anything ending up in the undo history
+	ProjectJournal * journal = Engine::projectJournal();
+	m_journalling = journal->isJournalling();
+	journal->setJournalling( false );
+	m_mutedStates.clear();
+	for( Track * track : song->tracks() )
+	{
+		m_mutedStates << qMakePair( track, track->isMuted() );
+		track->setMuted( track != m_track );
+	}
+
+	Engine::mixer()->stopProcessing();
+
+	song->setExportLoop( false );
+	song->setRenderBetweenMarkers( false );
+	song->setLoopRenderCount( 1 );
+	song->startExport();
+
+	m_abort = false;
+	m_writeFailed = false;
+	m_progress = 0;
+	m_rendering = true;
+	start(
+#ifndef LMMS_BUILD_WIN32
+		QThread::HighPriority
+#endif
+					);
+	return true;
+}
+
+
+
+
+void TrackFreeze::abortRendering()
+{
+	m_abort = true;
+	finishRendering();
+}
+
+
+
+
+void TrackFreeze::run()
+{
+	MemoryManager::ThreadGuard mmThreadGuard; Q_UNUSED(mmThreadGuard);
+	ThreadPolicy::apply( "Mixer", 0 );
+	// this thread processes jobs too, they must give the same results
+	// as in the worker threads
+	disable_denormals();
+
+	Song * song = Engine::getSong();
+	Mixer * mixer = Engine::mixer();
+
+	const fpp_t fpp = mixer->framesPerPeriod();
+	const qint64 bytes = fpp * sizeof( sampleFrame );
+	const QByteArray silence( bytes, 0 );
+	while( !song->isExportDone() && !m_abort )
+	{
+		mixer->nextBuffer();
+		const sampleFrame * output = m_track->audioPort()->lastOutput();
+		if( m_file.write( output ? (const char *) output :
+					silence.constData(), bytes ) != bytes )
+		{
+			m_writeFailed = true;
+			break;
+		}
+		m_frames += fpp;
+
+		const int progress = song->getExportProgress();
+		if( m_progress != progress )
+		{
+			m_progress = progress;
+			emit progressChanged( m_progress );
+		}
+	}
+}
+
+
+
+
+void TrackFreeze::finishRendering()
+{
+	if( !m_rendering )
+	{
+		return;
+	}
+	wait();
+	m_rendering = false;
+
+	Engine::getSong()->stopExport();
+	Engine::mixer()->startProcessing();
+
+	for( const auto & mutedState : m_mutedStates )
+	{
+		mutedState.first->setMuted( mutedState.second );
+	}
+	m_mutedStates.clear();
+	Engine::projectJournal()->setJournalling( m_journalling );
+
+	if( !m_abort && !m_writeFailed && m_file.flush() )
+	{
+		m_data = (const sampleFrame *) m_file.map( 0, m_file.size() );
+	}
+	if( m_data == NULL && !m_abort )
+	{
+		printf( "Notice: could not store frozen track %s\n",
+						qPrintable( m_track->name() ) );
+	}
+
+	if( !m_abort )
+	{
+		emit rendered( m_data != NULL );
+	}
+}
+
+
+
+
+void TrackFreeze::playTick( tick_t tick, f_cnt_t offset )
+{
+	if( m_rendering )
+	{
+		while( m_tickFrames.size() <= tick )
+		{
+			m_tickFrames << -1;
+		}
+		m_tickFrames[tick] = m_frames + offset;
+		return;
+	}
+
+	if( tick < 0 || tick >= m_tickFrames.size() || m_tickFrames[tick] < 0 )
+	{
+		return;
+	}
+
+	// where playback would continue without a jump
+	f_cnt_t expected = m_position + offset;
+	if( m_segmentCount > 0 )
+	{
+		const Segment & last = m_segments[m_segmentCount - 1];
+		expected = last.position + offset - last.offset;
+	}
+	if( qAbs( m_tickFrames[tick] - expected ) <= MaxDrift )
+	{
+		return;
+	}
+
+	if( m_segmentCount > 0 && m_segments[m_segmentCount - 1].offset == offset )
+	{
+		m_segments[m_segmentCount - 1].position = m_tickFrames[tick];
+	}
+	else if( m_segmentCount < MaxSegments )
+	{
+		m_segments[m_segmentCount].offset = offset;
+		m_segments[m_segmentCount].position = m_tickFrames[tick];
+		++m_segmentCount;
+	}
+}
+
+
+
+
+const sampleFrame * TrackFreeze::nextPeriod()
+{
+	const fpp_t fpp = Engine::mixer()->framesPerPeriod();
+	const Song * song = Engine::getSong();
+	if( m_data == NULL || song->playMode() != Song::Mode_PlaySong ||
+				!( song->isPlaying() || song->isExporting() ) )
+	{
+		m_segmentCount = 0;
+		return NULL;
+	}
+
+	// usually the period can be played right from the file
+	if( m_segmentCount == 0 && m_position >= 0 && m_position + fpp <= m_frames )
+	{
+		const sampleFrame * output = m_data + m_position;
+		m_position += fpp;
+		return output;
+	}
+
+	sampleFrame * buffer = PeriodArena::alloc<sampleFrame>( fpp );
+	f_cnt_t offset = 0;
+	f_cnt_t position = m_position;
+	for( int s = 0; s <= m_segmentCount; ++s )
+	{
+		const f_cnt_t end = s < m_segmentCount ? m_segments[s].offset : fpp;
+		copyFrames( buffer + offset, position, end - offset );
+		position = s < m_segmentCount ? m_segments[s].position :
+							position + end - offset;
+		offset = end;
+	}
+	m_position = position;
+	m_segmentCount = 0;
+	return buffer;
+}
+
+
+
+
+void TrackFreeze::copyFrames( sampleFrame * dest, f_cnt_t position,
+							f_cnt_t frames ) const
+{
+	const f_cnt_t from = qBound<f_cnt_t>( 0, position, m_frames );
+	const f_cnt_t to = qBound<f_cnt_t>( 0, position + frames, m_frames );
+	memset( dest, 0, frames * sizeof( sampleFrame ) );
+	if( to > from )
+	{
+		memcpy( dest + from - position, m_data + from,
+					( to - from ) * sizeof( sampleFrame ) );
+	}
+}
@@ -78,39 +78,53 @@ void AudioDevice::processNextBuffer()
 
 
 
+void AudioDevice::processBuffer( const surroundSampleFrame * _buf )
+{
+	const fpp_t frames = convertBuffer( _buf, m_buffer );
+	writeBuffer( m_buffer, frames, mixer()->masterGain() );
+}
+
+
+
+
 fpp_t AudioDevice::getNextBuffer( surroundSampleFrame * _ab )
 {
-	fpp_t frames = mixer()->framesPerPeriod();
 	const surroundSampleFrame * b = mixer()->nextBuffer();
 	if( !b )
 	{
 		return 0;
 	}
 
+	return convertBuffer( b, _ab );
+}
+
+
+
+
+fpp_t AudioDevice::convertBuffer( const surroundSampleFrame * _src,
+					surroundSampleFrame * _dst )
+{
+	fpp_t frames = mixer()->framesPerPeriod();
+
 	// make sure, no other thread is accessing device
 	lock();
 
 	// resample if necessary
 	if( mixer()->processingSampleRate() != m_sampleRate )
 	{
-		resample( b, frames, _ab, mixer()->processingSampleRate(),
+		resample( _src, frames, _dst, mixer()->processingSampleRate(),
 								m_sampleRate );
 		frames = frames * m_sampleRate /
 					mixer()->processingSampleRate();
 	}
 	else
 	{
-		memcpy( _ab, b, frames * sizeof( surroundSampleFrame ) );
+		memcpy( _dst, _src, frames * sizeof( surroundSampleFrame ) );
 	}
 
 	// release lock
 	unlock();
 
-	if( mixer()->hasFifoWriter() )
-	{
-		delete[] b;
-	}
-
 	return frames;
 }
 
@@ -25,9 +25,55 @@
 
 #include <QMessageBox>
 
+#include <cstring>
+
 #include "AudioFileDevice.h"
 #include "ExportProjectDialog.h"
 #include "GuiApplication.h"
+#include "MemoryManager.h"
+#include "MixHelpers.h"
+#include "Mixer.h"
+
+
+// number of buffers which can be waiting for the encoder before rendering
+// has to wait for it
+const int ENCODER_QUEUE_SIZE = 8;
+
+// dither noise is read from a table, so every export of a project gets the
+// same one - long enough for the repetition not to be audible
+const int DITHER_TABLE_SIZE = 1 << 17;
+
+
+static QVector<float> createDitherTable()
+{
+	QVector<float> table( DITHER_TABLE_SIZE );
+	uint32_t state = 0x9e3779b9;
+	for( int i = 0; i < DITHER_TABLE_SIZE; ++i )
+	{
+		// the difference of two uniformly distributed values gives
+		// triangular noise in (-1, 1)
+		float r[2];
+		for( int j = 0; j < 2; ++j )
+		{
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			r[j] = state / 4294967296.0f;
+		}
+		table[i] = r[0] - r[1];
+	}
+	return table;
+}
+
+
+
+
+static const float * ditherTable()
+{
+	static const QVector<float> table = createDitherTable();
+	return table.constData();
+}
+
 
 
 AudioFileDevice::AudioFileDevice( OutputSettings const & outputSettings,
@@ -36,10 +82,23 @@ AudioFileDevice::AudioFileDevice( OutputSettings const & outputSettings,
 					Mixer*  _mixer ) :
 	AudioDevice( _channels, _mixer ),
 	m_outputFile( _file ),
-	m_outputSettings(outputSettings)
+	m_outputSettings(outputSettings),
+	m_encoderThread( this ),
+	m_queue( ENCODER_QUEUE_SIZE ),
+	m_freeBuffers( ENCODER_QUEUE_SIZE ),
+	m_queuedBuffers( 0 ),
+	m_writeIndex( 0 ),
+	m_readIndex( 0 ),
+	m_ditherPos( 0 )
 {
 	setSampleRate( outputSettings.getSampleRate() );
 
+	for( QueuedBuffer & buffer : m_queue )
+	{
+		buffer.capacity = _mixer->framesPerPeriod();
+		buffer.frames = MM_ALLOC( surroundSampleFrame, buffer.capacity );
+	}
+
 	if( m_outputFile.open( QFile::WriteOnly | QFile::Truncate ) == false )
 	{
 		QString title, message;
@@ -71,12 +130,98 @@ AudioFileDevice::AudioFileDevice( OutputSettings const & outputSettings,
 
 AudioFileDevice::~AudioFileDevice()
 {
+	finishQueue();
+
+	for( QueuedBuffer & buffer : m_queue )
+	{
+		MM_FREE( buffer.frames );
+	}
+
 	m_outputFile.close();
 }
 
 
 
 
+void AudioFileDevice::finishQueue()
+{
+	if( m_encoderThread.isRunning() )
+	{
+		m_freeBuffers.acquire();
+		m_queue[m_writeIndex].last = true;
+		m_writeIndex = ( m_writeIndex + 1 ) % ENCODER_QUEUE_SIZE;
+		m_queuedBuffers.release();
+
+		m_encoderThread.wait();
+	}
+}
+
+
+
+
+const int_sample_t * AudioFileDevice::quantizeToS16(
+					const surroundSampleFrame * _ab,
+					const fpp_t _frames,
+					const float _master_gain )
+{
+	quantize( _ab, _frames, _master_gain, OUTPUT_SAMPLE_MULTIPLIER );
+
+	if( m_s16Buffer.size() < _frames * DEFAULT_CHANNELS )
+	{
+		m_s16Buffer.resize( _frames * DEFAULT_CHANNELS );
+	}
+	for( int i = 0; i < _frames * DEFAULT_CHANNELS; ++i )
+	{
+		m_s16Buffer[i] = m_intBuffer[i];
+	}
+
+	return m_s16Buffer.constData();
+}
+
+
+
+
+const int32_t * AudioFileDevice::quantizeToS24(
+					const surroundSampleFrame * _ab,
+					const fpp_t _frames,
+					const float _master_gain )
+{
+	quantize( _ab, _frames, _master_gain, 8388607.0f );
+
+	for( int i = 0; i < _frames * DEFAULT_CHANNELS; ++i )
+	{
+		m_intBuffer[i] *= 256;
+	}
+
+	return m_intBuffer.constData();
+}
+
+
+
+
+const float * AudioFileDevice::interleave( const surroundSampleFrame * _ab,
+						const fpp_t _frames,
+						const float _master_gain )
+{
+	if( m_floatBuffer.size() < _frames * channels() )
+	{
+		m_floatBuffer.resize( _frames * channels() );
+	}
+	for( fpp_t frame = 0; frame < _frames; ++frame )
+	{
+		for( ch_cnt_t chnl = 0; chnl < channels(); ++chnl )
+		{
+			m_floatBuffer[frame*channels()+chnl] = _ab[frame][chnl] *
+								_master_gain;
+		}
+	}
+
+	return m_floatBuffer.constData();
+}
+
+
+
+
 int AudioFileDevice::writeData( const void* data, int len )
 {
 	if( m_outputFile.isOpen() )
@@ -87,3 +232,88 @@ int AudioFileDevice::writeData( const void* data, int len )
 	return -1;
 }
 
+
+
+
+void AudioFileDevice::writeBuffer( const surroundSampleFrame * _ab,
+						const fpp_t _frames,
+						const float _master_gain )
+{
+	if( !m_encoderThread.isRunning() )
+	{
+		m_encoderThread.start();
+	}
+
+	m_freeBuffers.acquire();
+
+	QueuedBuffer & buffer = m_queue[m_writeIndex];
+	if( _frames > buffer.capacity )
+	{
+		// can happen when resampling to a higher samplerate
+		MM_FREE( buffer.frames );
+		buffer.capacity = _frames;
+		buffer.frames = MM_ALLOC( surroundSampleFrame, buffer.capacity );
+	}
+	memcpy( buffer.frames, _ab, _frames * sizeof( surroundSampleFrame ) );
+	buffer.frameCount = _frames;
+	buffer.masterGain = _master_gain;
+	buffer.last = false;
+
+	m_writeIndex = ( m_writeIndex + 1 ) % ENCODER_QUEUE_SIZE;
+	m_queuedBuffers.release();
+}
+
+
+
+
+void AudioFileDevice::encodeQueuedBuffers()
+{
+	while( true )
+	{
+		m_queuedBuffers.acquire();
+		const QueuedBuffer & buffer = m_queue[m_readIndex];
+		m_readIndex = ( m_readIndex + 1 ) % ENCODER_QUEUE_SIZE;
+
+		const bool last = buffer.last;
+		if( !last )
+		{
+			encodeBuffer( buffer.frames, buffer.frameCount,
+							buffer.masterGain );
+		}
+
+		m_freeBuffers.release();
+		if( last )
+		{
+			break;
+		}
+	}
+}
+
+
+
+
+void AudioFileDevice::quantize( const surroundSampleFrame * _ab,
+					const fpp_t _frames,
+					const float _master_gain,
+					const float _scale )
+{
+	// file devices are always stereo, so frames can be passed to the
+	// mixing kernels as they are
+	if( m_intBuffer.size() < _frames * DEFAULT_CHANNELS )
+	{
+		m_intBuffer.resize( _frames * DEFAULT_CHANNELS );
+	}
+
+	const float * dither = ditherTable();
+	for( int done = 0; done < _frames; )
+	{
+		const int frames = qMin<int>( _frames - done,
+			( DITHER_TABLE_SIZE - m_ditherPos ) / DEFAULT_CHANNELS );
+		MixHelpers::quantize( m_intBuffer.data() + done * DEFAULT_CHANNELS,
+					_ab + done, _master_gain, _scale,
+					dither + m_ditherPos, frames );
+		m_ditherPos = ( m_ditherPos + frames * DEFAULT_CHANNELS ) %
+							DITHER_TABLE_SIZE;
+		done += frames;
+	}
+}
@@ -22,10 +22,7 @@
  *
  */
 
-#include <memory>
-
 #include "AudioFileFlac.h"
-#include "endian_handling.h"
 #include "Mixer.h"
 
 AudioFileFlac::AudioFileFlac(OutputSettings const& outputSettings, ch_cnt_t const channels, bool& successful, QString const& file, Mixer* mixer):
@@ -37,6 +34,7 @@ AudioFileFlac::AudioFileFlac(OutputSettings const& outputSettings, ch_cnt_t cons
 
 AudioFileFlac::~AudioFileFlac()
 {
+	finishQueue();
 	finishEncoding();
 }
 
@@ -83,29 +81,18 @@ bool AudioFileFlac::startEncoding()
 	return true;
 }
 
-void AudioFileFlac::writeBuffer(surroundSampleFrame const* _ab, fpp_t const frames, float master_gain)
+void AudioFileFlac::encodeBuffer(surroundSampleFrame const* _ab, fpp_t const frames, float master_gain)
 {
 	OutputSettings::BitDepth depth = getOutputSettings().getBitDepth();
 
-	if (depth == OutputSettings::Depth_24Bit || depth == OutputSettings::Depth_32Bit) // Float encoding
+	if (depth == OutputSettings::Depth_24Bit || depth == OutputSettings::Depth_32Bit)
 	{
-		std::unique_ptr<sample_t[]> buf{ new sample_t[frames*channels()] };
-		for(fpp_t frame = 0; frame < frames; ++frame)
-		{
-			for(ch_cnt_t channel=0; channel<channels(); ++channel)
-			{
-				buf[frame*channels() + channel] = _ab[frame][channel] * master_gain;
-			}
-		}
-		sf_writef_float(m_sf,static_cast<float*>(buf.get()),frames);
+		sf_writef_int(m_sf, quantizeToS24(_ab, frames, master_gain), frames);
 	}
-	else // integer PCM encoding
+	else
 	{
-		std::unique_ptr<int_sample_t[]> buf{ new int_sample_t[frames*channels()] };
-		convertToS16(_ab, frames, master_gain, buf.get(), !isLittleEndian());
-		sf_writef_short(m_sf, static_cast<short*>(buf.get()), frames);
+		sf_writef_short(m_sf, quantizeToS16(_ab, frames, master_gain), frames);
 	}
-
 }
 
 
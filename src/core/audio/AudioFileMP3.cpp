@@ -48,11 +48,12 @@ AudioFileMP3::AudioFileMP3(	OutputSettings const & outputSettings,
 
 AudioFileMP3::~AudioFileMP3()
 {
+	finishQueue();
 	flushRemainingBuffers();
 	tearDownEncoder();
 }
 
-void AudioFileMP3::writeBuffer( const surroundSampleFrame * _buf,
+void AudioFileMP3::encodeBuffer( const surroundSampleFrame * _buf,
 					const fpp_t _frames,
 					const float _master_gain )
 {
@@ -62,20 +63,18 @@ void AudioFileMP3::writeBuffer( const surroundSampleFrame * _buf,
 	}
 
 	// TODO Why isn't the gain applied by the driver but inside the device?
-	std::vector<float> interleavedDataBuffer(_frames * 2);
-	for (fpp_t i = 0; i < _frames; ++i)
-	{
-		interleavedDataBuffer[2*i] = _buf[i][0] * _master_gain;
-		interleavedDataBuffer[2*i + 1] = _buf[i][1] * _master_gain;
-	}
+	const float * interleavedDataBuffer = interleave(_buf, _frames, _master_gain);
 
 	size_t minimumBufferSize = 1.25 * _frames + 7200;
-	std::vector<unsigned char> encodingBuffer(minimumBufferSize);
+	if (m_encodingBuffer.size() < minimumBufferSize)
+	{
+		m_encodingBuffer.resize(minimumBufferSize);
+	}
 
-	int bytesWritten = lame_encode_buffer_interleaved_ieee_float(m_lame, &interleavedDataBuffer[0], _frames, &encodingBuffer[0], static_cast<int>(encodingBuffer.size()));
+	int bytesWritten = lame_encode_buffer_interleaved_ieee_float(m_lame, interleavedDataBuffer, _frames, &m_encodingBuffer[0], static_cast<int>(m_encodingBuffer.size()));
 	assert (bytesWritten >= 0);
 
-	writeData(&encodingBuffer[0], bytesWritten);
+	writeData(&m_encodingBuffer[0], bytesWritten);
 }
 
 void AudioFileMP3::flushRemainingBuffers()
@@ -52,6 +52,7 @@ AudioFileOgg::AudioFileOgg(	OutputSettings const & outputSettings,
 
 AudioFileOgg::~AudioFileOgg()
 {
+	finishQueue();
 	finishEncoding();
 }
 
@@ -179,7 +180,7 @@ bool AudioFileOgg::startEncoding()
 
 
 
-void AudioFileOgg::writeBuffer( const surroundSampleFrame * _ab,
+void AudioFileOgg::encodeBuffer( const surroundSampleFrame * _ab,
 						const fpp_t _frames,
 						const float _master_gain )
 {
@@ -249,7 +250,7 @@ void AudioFileOgg::finishEncoding()
 	if( m_ok )
 	{
 		// just for flushing buffers...
-		writeBuffer( NULL, 0, 0.0f );
+		encodeBuffer( NULL, 0, 0.0f );
 
 		// clean up
 		ogg_stream_clear( &m_os );
@@ -24,7 +24,6 @@
  */
 
 #include "AudioFileWave.h"
-#include "endian_handling.h"
 #include "Mixer.h"
 
 #include <QFile>
@@ -46,6 +45,7 @@ AudioFileWave::AudioFileWave( OutputSettings const & outputSettings,
 
 AudioFileWave::~AudioFileWave()
 {
+	finishQueue();
 	finishEncoding();
 }
 
@@ -96,34 +96,25 @@ bool AudioFileWave::startEncoding()
 
 
 
-void AudioFileWave::writeBuffer( const surroundSampleFrame * _ab,
+void AudioFileWave::encodeBuffer( const surroundSampleFrame * _ab,
 						const fpp_t _frames,
 						const float _master_gain )
 {
-	OutputSettings::BitDepth bitDepth = getOutputSettings().getBitDepth();
-
-	if( bitDepth == OutputSettings::Depth_32Bit || bitDepth == OutputSettings::Depth_24Bit )
-	{
-		float *  buf = new float[_frames*channels()];
-		for( fpp_t frame = 0; frame < _frames; ++frame )
-		{
-			for( ch_cnt_t chnl = 0; chnl < channels(); ++chnl )
-			{
-				buf[frame*channels()+chnl] = _ab[frame][chnl] *
-								_master_gain;
-			}
-		}
-		sf_writef_float( m_sf, buf, _frames );
-		delete[] buf;
-	}
-	else
+	switch( getOutputSettings().getBitDepth() )
 	{
-		int_sample_t * buf = new int_sample_t[_frames * channels()];
-		convertToS16( _ab, _frames, _master_gain, buf,
-							!isLittleEndian() );
-
-		sf_writef_short( m_sf, buf, _frames );
-		delete[] buf;
+	case OutputSettings::Depth_32Bit:
+		sf_writef_float( m_sf, interleave( _ab, _frames, _master_gain ),
+								_frames );
+		break;
+	case OutputSettings::Depth_24Bit:
+		sf_writef_int( m_sf, quantizeToS24( _ab, _frames, _master_gain ),
+								_frames );
+		break;
+	case OutputSettings::Depth_16Bit:
+	default:
+		sf_writef_short( m_sf, quantizeToS16( _ab, _frames, _master_gain ),
+								_frames );
+		break;
 	}
 }
 
@@ -24,11 +24,16 @@
 
 #include "AudioPort.h"
 #include "AudioDevice.h"
+#include "DeterministicRender.h"
 #include "EffectChain.h"
 #include "FxMixer.h"
 #include "Engine.h"
 #include "Mixer.h"
 #include "MixHelpers.h"
+#include "PeriodArena.h"
+#include "RenderCache.h"
+#include "Song.h"
+#include "TrackFreeze.h"
 #include "BufferManager.h"
 
 
@@ -36,6 +41,8 @@ AudioPort::AudioPort( const QString & _name, bool _has_effect_chain,
 		FloatModel * volumeModel, FloatModel * panningModel,
 		BoolModel * mutedModel ) :
 	m_bufferUsage( false ),
+	m_bufferSilent( false ),
+	m_lastOutput( NULL ),
 	m_portBuffer( BufferManager::acquire() ),
 	m_extOutputEnabled( false ),
 	m_nextFxChannel( 0 ),
@@ -43,7 +50,9 @@ AudioPort::AudioPort( const QString & _name, bool _has_effect_chain,
 	m_effects( _has_effect_chain ? new EffectChain( NULL ) : NULL ),
 	m_volumeModel( volumeModel ),
 	m_panningModel( panningModel ),
-	m_mutedModel( mutedModel )
+	m_mutedModel( mutedModel ),
+	m_renderOrder( DeterministicRender::nextObjectOrder() ),
+	m_freeze( NULL )
 {
 	Engine::mixer()->addAudioPort( this );
 	setExtOutputEnabled( true );
@@ -94,7 +103,7 @@ bool AudioPort::processEffects()
 {
 	if( m_effects )
 	{
-		bool more = m_effects->processAudioBuffer( m_portBuffer, Engine::mixer()->framesPerPeriod(), m_bufferUsage );
+		bool more = m_effects->processAudioBuffer( m_portBuffer, Engine::mixer()->framesPerPeriod(), m_bufferUsage, m_bufferSilent );
 		return more;
 	}
 	return false;
@@ -103,128 +112,156 @@ bool AudioPort::processEffects()
 
 void AudioPort::doProcessing()
 {
+	m_lastOutput = NULL;
+
+	RenderCache * renderCache = Engine::getSong()->renderCache();
+
 	if( m_mutedModel && m_mutedModel->value() )
 	{
+		if( m_freeze )
+		{
+			// keep following the song
+			m_freeze->nextPeriod();
+		}
+		if( renderCache )
+		{
+			// keep the cached ranges in sync
+			renderCache->processPort( this, NULL, true,
+					Engine::mixer()->framesPerPeriod() );
+		}
 		return;
 	}
 
 	const fpp_t fpp = Engine::mixer()->framesPerPeriod();
 
-	// clear the buffer
-	BufferManager::clear( m_portBuffer, fpp );
+	DeterministicRender::seedJob( m_renderOrder );
 
 	//qDebug( "Playhandles: %d", m_playHandles.size() );
-	for( PlayHandle * ph : m_playHandles ) // now we mix all playhandle buffers into the audioport buffer
+	// with the render graph, play handles of other ports may still be
+	// running and adding sub-handles while we mix
+	m_playHandleLock.lock();
+	// collect the buffers to mix first, so the port buffer gets written
+	// only once below
+	const sampleFrame ** buffers = PeriodArena::alloc<const sampleFrame *>( m_playHandles.size() );
+	// their order depends on the threads which created the handles, so
+	// sort them for a deterministic sum
+	const bool sorted = DeterministicRender::isEnabled();
+	uint64_t * orders = sorted ? PeriodArena::alloc<uint64_t>( m_playHandles.size() ) : NULL;
+	int bufferCount = 0;
+	// frames before the first note starts, for the render cache - the
+	// handle of single-streamed instruments always plays, their notes
+	// have handles too
+	f_cnt_t quietFrames = fpp;
+	// type and buffer come from the registry, handles which aren't
+	// registered yet didn't play in this period
+	const PlayHandleRegistry & registry = Engine::mixer()->playHandles();
+	for( PlayHandle * ph : m_playHandles )
 	{
-		if( ph->buffer() )
+		const int slot = registry.slotOf( ph );
+		const quint8 type = slot >= 0 ? registry.type( slot ) : ph->type();
+		if( type != PlayHandle::TypeInstrumentPlayHandle )
 		{
-			if( ph->usesBuffer()
-				&& ( ph->type() == PlayHandle::TypeNotePlayHandle
-					|| !MixHelpers::isSilent( ph->buffer(), fpp ) ) )
-			{
-				m_bufferUsage = true;
-				MixHelpers::add( m_portBuffer, ph->buffer(), fpp );
-			}
-			ph->releaseBuffer(); 	// gets rid of playhandle's buffer and sets
-									// pointer to null, so if it doesn't get re-acquired we know to skip it next time
+			quietFrames = qMin<f_cnt_t>( quietFrames, ph->offset() );
 		}
-	}
-
-	if( m_bufferUsage )
-	{
-		// handle volume and panning
-		// has both vol and pan models
-		if( m_volumeModel && m_panningModel )
+		const sampleFrame * buffer = slot >= 0 ? registry.buffer( slot ) : NULL;
+		if( buffer )
 		{
-			ValueBuffer * volBuf = m_volumeModel->valueBuffer();
-			ValueBuffer * panBuf = m_panningModel->valueBuffer();
-
-			// both vol and pan have s.ex.data:
-			if( volBuf && panBuf )
+			if( type == PlayHandle::TypeNotePlayHandle
+					|| !registry.isSilent( slot ) )
 			{
-				for( f_cnt_t f = 0; f < fpp; ++f )
-				{
-					float v = volBuf->values()[ f ] * 0.01f;
-					float p = panBuf->values()[ f ] * 0.01f;
-					m_portBuffer[f][0] *= ( p <= 0 ? 1.0f : 1.0f - p ) * v;
-					m_portBuffer[f][1] *= ( p >= 0 ? 1.0f : 1.0f + p ) * v;
-				}
-			}
-
-			// only vol has s.ex.data:
-			else if( volBuf )
-			{
-				float p = m_panningModel->value() * 0.01f;
-				float l = ( p <= 0 ? 1.0f : 1.0f - p );
-				float r = ( p >= 0 ? 1.0f : 1.0f + p );
-				for( f_cnt_t f = 0; f < fpp; ++f )
+				m_bufferUsage = true;
+				if( sorted )
 				{
-					float v = volBuf->values()[ f ] * 0.01f;
-					m_portBuffer[f][0] *= v * l;
-					m_portBuffer[f][1] *= v * r;
+					// insertion sort, there are only a few handles per port
+					int i = bufferCount;
+					for( ; i > 0 && orders[i - 1] > ph->renderOrder(); --i )
+					{
+						orders[i] = orders[i - 1];
+						buffers[i] = buffers[i - 1];
+					}
+					orders[i] = ph->renderOrder();
+					buffers[i] = buffer;
+					++bufferCount;
 				}
-			}
-
-			// only pan has s.ex.data:
-			else if( panBuf )
-			{
-				float v = m_volumeModel->value() * 0.01f;
-				for( f_cnt_t f = 0; f < fpp; ++f )
+				else
 				{
-					float p = panBuf->values()[ f ] * 0.01f;
-					m_portBuffer[f][0] *= ( p <= 0 ? 1.0f : 1.0f - p ) * v;
-					m_portBuffer[f][1] *= ( p >= 0 ? 1.0f : 1.0f + p ) * v;
+					buffers[bufferCount++] = buffer;
 				}
 			}
+			ph->releaseBuffer(); 	// gets rid of playhandle's buffer and sets
+									// pointer to null, so if it doesn't get re-acquired we know to skip it next time.
+									// The memory itself stays valid until the end of the period.
+		}
+	}
+	m_playHandleLock.unlock();
 
-			// neither has s.ex.data:
-			else
-			{
-				float p = m_panningModel->value() * 0.01f;
-				float v = m_volumeModel->value() * 0.01f;
-				for( f_cnt_t f = 0; f < fpp; ++f )
-				{
-					m_portBuffer[f][0] *= ( p <= 0 ? 1.0f : 1.0f - p ) * v;
-					m_portBuffer[f][1] *= ( p >= 0 ? 1.0f : 1.0f + p ) * v;
-				}
-			}
+	const sampleFrame * output = NULL;
+	if( m_freeze )
+	{
+		// the frozen output already went through volume, panning and
+		// effects
+		output = m_freeze->nextPeriod();
+	}
+	else
+	{
+		// volume and panning as gains per frame
+		// as of now there's no situation where we only have panning model but no volume model
+		// if we have neither, we don't have to do anything here - just pass the audio as is
+		sampleFrame * gains = NULL;
+		if( m_bufferUsage && m_volumeModel )
+		{
+			gains = PeriodArena::alloc<sampleFrame>( fpp );
+			MixHelpers::volumePanGains( gains,
+				m_volumeModel->valueBuffer(), m_volumeModel->value(),
+				m_panningModel ? m_panningModel->valueBuffer() : NULL,
+				m_panningModel ? m_panningModel->value() : 0.0f,
+				fpp );
 		}
 
-		// has vol model only
-		else if( m_volumeModel )
+		// mix all playhandle buffers into the audioport buffer and apply the
+		// gains - without any buffers this just clears it
+		if( bufferCount == 0 && m_bufferSilent )
 		{
-			ValueBuffer * volBuf = m_volumeModel->valueBuffer();
+			Engine::mixer()->profiler().reportSkippedWork();
+		}
+		else
+		{
+			MixHelpers::sumMultipliedByGains( m_portBuffer, buffers, bufferCount, gains, fpp );
+			m_bufferSilent = bufferCount == 0;
+		}
 
-			if( volBuf )
-			{
-				for( f_cnt_t f = 0; f < fpp; ++f )
-				{
-					float v = volBuf->values()[ f ] * 0.01f;
-					m_portBuffer[f][0] *= v;
-					m_portBuffer[f][1] *= v;
-				}
-			}
-			else
-			{
-				float v = m_volumeModel->value() * 0.01f;
-				for( f_cnt_t f = 0; f < fpp; ++f )
-				{
-					m_portBuffer[f][0] *= v;
-					m_portBuffer[f][1] *= v;
-				}
-			}
+		// handle effects
+		const bool me = processEffects();
+		output = ( me || m_bufferUsage ) && !m_bufferSilent ? m_portBuffer : NULL;
+	}
+	m_bufferUsage = false;
+
+	if( renderCache )
+	{
+		// effect tails without any notes sound from the start
+		if( output && quietFrames == fpp )
+		{
+			quietFrames = 0;
 		}
+		output = renderCache->processPort( this, output, output == NULL,
+								quietFrames );
 	}
-	// as of now there's no situation where we only have panning model but no volume model
-	// if we have neither, we don't have to do anything here - just pass the audio as is
 
-	// handle effects
-	const bool me = processEffects();
-	if( me || m_bufferUsage )
+	if( output )
+	{
+		Engine::fxMixer()->mixToChannel( output, m_nextFxChannel, m_renderOrder ); 	// send output to fx mixer
+																		// TODO: improve the flow here - convert to pull model
+		m_lastOutput = output;
+	}
+}
+
+
+void AudioPort::setNextFxChannel( const fx_ch_t _chnl )
+{
+	if( _chnl != m_nextFxChannel )
 	{
-		Engine::fxMixer()->mixToChannel( m_portBuffer, m_nextFxChannel ); 	// send output to fx mixer
-																			// TODO: improve the flow here - convert to pull model
-		m_bufferUsage = false;
+		m_nextFxChannel = _chnl;
+		Engine::mixer()->invalidateRenderGraph();
 	}
 }
 
@@ -59,6 +59,7 @@
 
 #include "MainApplication.h"
 #include "ConfigManager.h"
+#include "DeterministicRender.h"
 #include "NotePlayHandle.h"
 #include "embed.h"
 #include "Engine.h"
@@ -67,7 +68,10 @@
 #include "MainWindow.h"
 #include "MixHelpers.h"
 #include "OutputSettings.h"
+#include "PerfTrace.h"
 #include "ProjectRenderer.h"
+#include "RenderCache.h"
+#include "ThreadPolicy.h"
 #include "RenderManager.h"
 #include "Song.h"
 #include "SetupDialog.h"
@@ -180,8 +184,14 @@ void printHelp()
 		"          If -e is specified lmms exits after importing the file.\n"
 		"\nOptions for \"render\" and \"rendertracks\":\n"
 		"  -a, --float                    Use 32bit float bit depth\n"
+		"      --cpu-affinity <cpus>      Pin the mixer threads to the given CPUs,\n"
+		"          e.g. 0-3,8. The mixer thread uses the first one,\n"
+		"          each worker the next one\n"
 		"  -b, --bitrate <bitrate>        Specify output bitrate in KBit/s\n"
 		"          Default: 160.\n"
+		"      --deterministic            Render the same samples on every run,\n"
+		"          independent of how the work is spread over threads\n"
+		"          (except for LADSPA plugins using rand(), e.g. CMT noise)\n"
 		"  -f, --format <format>         Specify format of render-output where\n"
 		"          Format is either 'wav', 'flac', 'ogg' or 'mp3'.\n"
 		"  -i, --interpolation <method>   Specify interpolation method\n"
@@ -190,6 +200,8 @@ void printHelp()
 		"            - sincfastest (default)\n"
 		"            - sincmedium\n"
 		"            - sincbest\n"
+		"  -j, --jobs <count>             Split the song and render the parts\n"
+		"          in up to <count> processes at once (\"render\" only)\n"
 		"  -l, --loop                     Render as a loop\n"
 		"  -m, --mode                     Stereo mode used for MP3 export\n"
 		"          Possible values: s, j, m\n"
@@ -203,8 +215,21 @@ void printHelp()
 		"          If not specified, render will overwrite the input file\n"
 		"          For \"rendertracks\", this might be required\n"
 		"  -p, --profile <out>            Dump profiling information to file <out>\n"
+		"          Every line has the time of a period in microseconds\n"
+		"          and the underruns and overruns of the audio device\n"
+		"          If <out> ends in .csv or .json, write the times\n"
+		"          of every instrument, effect and FX channel and the\n"
+		"          total underruns and overruns\n"
+		"      --realtime <priority>      Run the mixer threads with SCHED_FIFO\n"
+		"          and the given priority (1-99)\n"
+		"      --render-cache <dir>       Keep the output of tracks in <dir> and\n"
+		"          reuse unchanged parts when rendering again\n"
 		"  -s, --samplerate <samplerate>  Specify output samplerate in Hz\n"
 		"          Range: 44100 (default) to 192000\n"
+		"      --trace <out>              Write a timeline of the audio threads\n"
+		"          to <out> in Chrome trace format, e.g. for Perfetto\n"
+		"      --verify                   With --jobs, also render the song in a\n"
+		"          single process and compare the results\n"
 		"  -x, --oversampling <value>     Specify oversampling\n"
 		"          Possible values: 1, 2, 4, 8\n"
 		"          Default: 2\n\n",
@@ -301,6 +326,15 @@ int main( int argc, char * * argv )
 	bool renderLoop = false;
 	bool renderTracks = false;
 	QString fileToLoad, fileToImport, renderOut, profilerOutputFile, configFile;
+	QString traceOutputFile;
+	QString cpuAffinity, realtimePriority;
+	int renderJobs = 1;
+	bool verifyRender = false;
+	bool deterministicRender = false;
+	QString renderCacheDir;
+	SegmentedRender::Segment renderSegment = SegmentedRender::Segment();
+	QString segmentStreamFile;
+	RenderManager * renderManager = NULL;
 
 	// first of two command-line parsing stages
 	for( int i = 1; i < argc; ++i )
@@ -662,6 +696,105 @@ int main( int argc, char * * argv )
 
 			profilerOutputFile = QString::fromLocal8Bit( argv[i] );
 		}
+		else if( arg == "--trace" )
+		{
+			++i;
+
+			if( i == argc )
+			{
+				return usageError( "No trace file specified" );
+			}
+
+			traceOutputFile = QString::fromLocal8Bit( argv[i] );
+		}
+		else if( arg == "--cpu-affinity" )
+		{
+			++i;
+
+			if( i == argc )
+			{
+				return usageError( "No CPU list specified" );
+			}
+
+			cpuAffinity = QString( argv[i] );
+			if( ThreadPolicy::parseCpuList( cpuAffinity ).isEmpty() )
+			{
+				return usageError( QString( "Invalid CPU list %1" ).arg( argv[i] ) );
+			}
+		}
+		else if( arg == "--realtime" )
+		{
+			++i;
+
+			if( i == argc )
+			{
+				return usageError( "No realtime priority specified" );
+			}
+
+			bool ok;
+			const int prio = QString( argv[i] ).toInt( &ok );
+			if( !ok || prio < 1 || prio > 99 )
+			{
+				return usageError( QString( "Invalid realtime priority %1" ).arg( argv[i] ) );
+			}
+			realtimePriority = QString::number( prio );
+		}
+		else if( arg == "--jobs" || arg == "-j" )
+		{
+			++i;
+
+			if( i == argc )
+			{
+				return usageError( "No number of jobs specified" );
+			}
+
+			bool ok;
+			renderJobs = QString( argv[i] ).toInt( &ok );
+			if( !ok || renderJobs < 1 )
+			{
+				return usageError( QString( "Invalid number of jobs %1" ).arg( argv[i] ) );
+			}
+		}
+		else if( arg == "--verify" )
+		{
+			verifyRender = true;
+		}
+		else if( arg == "--deterministic" )
+		{
+			deterministicRender = true;
+		}
+		else if( arg == "--render-cache" )
+		{
+			++i;
+
+			if( i == argc )
+			{
+				return usageError( "No render cache directory specified" );
+			}
+
+			renderCacheDir = QString::fromLocal8Bit( argv[i] );
+		}
+		else if( arg == "--segment" )
+		{
+			// internal: start:first period:periods and the file to write
+			// the mixer output to, used by the processes of --jobs
+			i += 2;
+
+			if( i >= argc )
+			{
+				return usageError( "No segment specified" );
+			}
+
+			const QStringList segment = QString( argv[i - 1] ).split( ':' );
+			if( segment.size() != 3 )
+			{
+				return usageError( QString( "Invalid segment %1" ).arg( argv[i - 1] ) );
+			}
+			renderSegment.start = segment[0].toInt();
+			renderSegment.firstPeriod = segment[1].toInt();
+			renderSegment.periods = segment[2].toInt();
+			segmentStreamFile = QString::fromLocal8Bit( argv[i] );
+		}
 		else if( arg == "--config" || arg == "-c" )
 		{
 			++i;
@@ -695,6 +828,33 @@ int main( int argc, char * * argv )
 
 	ConfigManager::inst()->loadConfigFile(configFile);
 
+	// thread policy given on the command line overrides the configuration
+	// for this session
+	ThreadPolicy::setOverrides( cpuAffinity, realtimePriority );
+
+	if( deterministicRender )
+	{
+		DeterministicRender::setEnabled( true );
+	}
+	if( !renderCacheDir.isEmpty() )
+	{
+		RenderCache::setDirectory(
+				QFileInfo( renderCacheDir ).absoluteFilePath() );
+	}
+	deterministicRender = DeterministicRender::isEnabled() ||
+		ConfigManager::inst()->value( "mixer", "deterministic" ).toInt();
+	if( deterministicRender )
+	{
+		// e.g. DrumSynth samples are generated using rand()
+		srand( 1 );
+	}
+
+	if( !traceOutputFile.isEmpty() )
+	{
+		PerfTrace::start( traceOutputFile );
+		PerfTrace::setThreadName( "Main" );
+	}
+
 	// Hidden settings
 	MixHelpers::setNaNHandler( ConfigManager::inst()->value( "app",
 						"nanhandler", "1" ).toInt() );
@@ -786,9 +946,39 @@ int main( int argc, char * * argv )
 
 		// create renderer
 		RenderManager * r = new RenderManager( qs, os, eff, renderOut );
+		renderManager = r;
 		QCoreApplication::instance()->connect( r,
 				SIGNAL( finished() ), SLOT( quit() ) );
 
+		if( renderJobs > 1 )
+		{
+			// the processes get the same options except for those
+			// about where and how to write the output
+			QStringList processArgs;
+			for( int i = 1; i < argc; ++i )
+			{
+				const QString arg = argv[i];
+				if( arg == "--jobs" || arg == "-j" ||
+					arg == "--output" || arg == "-o" ||
+					arg == "--format" || arg == "-f" ||
+					arg == "--profile" || arg == "-p" ||
+					arg == "--trace" ||
+					arg == "--cpu-affinity" || arg == "--realtime" )
+				{
+					++i;
+				}
+				else if( arg != "--verify" )
+				{
+					processArgs << QString::fromLocal8Bit( argv[i] );
+				}
+			}
+			r->setParallelRender( renderJobs, verifyRender, processArgs );
+		}
+		if( !segmentStreamFile.isEmpty() )
+		{
+			r->setSegment( renderSegment, segmentStreamFile );
+		}
+
 		// timer for progress-updates
 		QTimer * t = new QTimer( r );
 		r->connect( t, SIGNAL( timeout() ),
@@ -816,7 +1006,7 @@ int main( int argc, char * * argv )
 
 		// re-intialize RNG - shared libraries might have srand() or
 		// srandom() calls in their init procedure
-		srand( getpid() + time( 0 ) );
+		srand( deterministicRender ? 1 : getpid() + time( 0 ) );
 
 		// recover a file?
 		QString recoveryFile = ConfigManager::inst()->recoveryFile();
@@ -969,7 +1159,11 @@ int main( int argc, char * * argv )
 		}
 	}
 
-	const int ret = app->exec();
+	int ret = app->exec();
+	if( renderManager && renderManager->hasFailed() )
+	{
+		ret = EXIT_FAILURE;
+	}
 	delete app;
 
 	if( destroyEngine )
@@ -977,6 +1171,11 @@ int main( int argc, char * * argv )
 		Engine::destroy();
 	}
 
+	// all audio threads are gone now
+	PerfTrace::finish();
+
+	NotePlayHandleManager::cleanup();
+
 	// ProjectRenderer::updateConsoleProgress() doesn't return line after render
 	if( coreOnly )
 	{
@@ -24,12 +24,15 @@
  */
 
 
+#include <QMouseEvent>
 #include <QPainter>
 
 #include "CPULoadWidget.h"
 #include "embed.h"
 #include "Engine.h"
 #include "Mixer.h"
+#include "ProfilerView.h"
+#include "ToolTip.h"
 
 
 CPULoadWidget::CPULoadWidget( QWidget * _parent ) :
@@ -39,10 +42,13 @@ CPULoadWidget::CPULoadWidget( QWidget * _parent ) :
 	m_background( embed::getIconPixmap( "cpuload_bg" ) ),
 	m_leds( embed::getIconPixmap( "cpuload_leds" ) ),
 	m_changed( true ),
-	m_updateTimer()
+	m_updateTimer(),
+	m_profilerView( NULL )
 {
 	setAttribute( Qt::WA_OpaquePaintEvent, true );
 	setFixedSize( m_background.width(), m_background.height() );
+	ToolTip::add( this, tr( "Click to see the CPU usage of every "
+				"instrument, effect and FX channel" ) );
 
 	m_temp = QPixmap( width(), height() );
 	
@@ -104,5 +110,22 @@ void CPULoadWidget::updateCpuLoad()
 
 
 
+void CPULoadWidget::mousePressEvent( QMouseEvent * _me )
+{
+	if( _me->button() != Qt::LeftButton )
+	{
+		QWidget::mousePressEvent( _me );
+		return;
+	}
 
-
+	if( m_profilerView == NULL )
+	{
+		// shown as a tool window of its own
+		m_profilerView = new ProfilerView( this );
+	}
+	m_profilerView->setVisible( !m_profilerView->isVisible() );
+	if( m_profilerView->isVisible() )
+	{
+		m_profilerView->raise();
+	}
+}
@@ -0,0 +1,186 @@
+/*
+ * ProfilerView.cpp - window showing the time taken by every node of the mixer
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+
+#include <QHeaderView>
+#include <QLabel>
+#include <QTreeWidget>
+#include <QVBoxLayout>
+
+#include "ProfilerView.h"
+#include "Engine.h"
+#include "Mixer.h"
+
+
+enum Columns
+{
+	NameColumn,
+	TypeColumn,
+	MeanColumn,
+	MedianColumn,
+	P95Column,
+	P99Column,
+	MaxColumn,
+	LoadColumn,
+	ColumnCount
+} ;
+
+
+
+static QString typeName( MixerProfiler::NodeType _type )
+{
+	switch( _type )
+	{
+		case MixerProfiler::NodeType::PlayHandle:
+			return ProfilerView::tr( "Play handles" );
+		case MixerProfiler::NodeType::Instrument:
+			return ProfilerView::tr( "Instrument" );
+		case MixerProfiler::NodeType::Effect:
+			return ProfilerView::tr( "Effect" );
+		case MixerProfiler::NodeType::FxChannel:
+			return ProfilerView::tr( "FX channel" );
+		case MixerProfiler::NodeType::Total:
+			break;
+	}
+	return ProfilerView::tr( "Period" );
+}
+
+
+
+
+ProfilerView::ProfilerView( QWidget * _parent ) :
+	QWidget( _parent, Qt::Tool ),
+	m_nodeList( new QTreeWidget( this ) ),
+	m_xrunLabel( new QLabel( this ) ),
+	m_items(),
+	m_profiling( false ),
+	m_updateTimer()
+{
+	setWindowTitle( tr( "CPU usage per node" ) );
+	resize( 640, 360 );
+
+	m_nodeList->setColumnCount( ColumnCount );
+	m_nodeList->setHeaderLabels( QStringList() << tr( "Name" )
+				<< tr( "Type" ) << tr( "Mean (µs)" )
+				<< tr( "Median (µs)" ) << tr( "95% (µs)" )
+				<< tr( "99% (µs)" ) << tr( "Max (µs)" )
+				<< tr( "Load (%)" ) );
+	m_nodeList->setRootIsDecorated( false );
+	m_nodeList->setSortingEnabled( true );
+	m_nodeList->sortByColumn( MeanColumn, Qt::DescendingOrder );
+	m_nodeList->header()->setSectionResizeMode( NameColumn, QHeaderView::Stretch );
+	m_nodeList->header()->setStretchLastSection( false );
+
+	QVBoxLayout * layout = new QVBoxLayout( this );
+	layout->setMargin( 0 );
+	layout->addWidget( m_nodeList );
+	layout->addWidget( m_xrunLabel );
+
+	connect( &m_updateTimer, SIGNAL( timeout() ),
+					this, SLOT( updateStats() ) );
+}
+
+
+
+
+ProfilerView::~ProfilerView()
+{
+	setProfiling( false );
+}
+
+
+
+
+void ProfilerView::showEvent( QShowEvent * _se )
+{
+	setProfiling( true );
+	m_updateTimer.start( 500 );
+	QWidget::showEvent( _se );
+}
+
+
+
+
+void ProfilerView::hideEvent( QHideEvent * _he )
+{
+	m_updateTimer.stop();
+	setProfiling( false );
+	QWidget::hideEvent( _he );
+}
+
+
+
+
+void ProfilerView::updateStats()
+{
+	const MixerProfiler & profiler = Engine::mixer()->profiler();
+	const QVector<MixerProfiler::NodeStats> stats = profiler.nodeStats();
+	const float periodLength = profiler.periodLength();
+
+	// keep the items, so selection and scroll position survive updates
+	QHash<quint64, QTreeWidgetItem *> items;
+	for( const MixerProfiler::NodeStats & node : stats )
+	{
+		QTreeWidgetItem * item = m_items.take( node.id );
+		if( item == NULL )
+		{
+			item = new QTreeWidgetItem( m_nodeList );
+			item->setText( NameColumn, node.name );
+			item->setText( TypeColumn, typeName( node.type ) );
+			for( int column = MeanColumn; column < ColumnCount; ++column )
+			{
+				item->setTextAlignment( column, Qt::AlignRight );
+			}
+		}
+		items[node.id] = item;
+
+		const float values[] = { node.mean, node.median, node.p95,
+				node.p99, node.max,
+				periodLength > 0 ? node.mean * 100 / periodLength : 0 };
+		for( int column = MeanColumn; column < ColumnCount; ++column )
+		{
+			// numbers, so columns are sorted by value
+			item->setData( column, Qt::DisplayRole,
+				qRound( values[column - MeanColumn] * 10 ) / 10.0 );
+		}
+	}
+
+	// nodes which are gone
+	qDeleteAll( m_items );
+	m_items = items;
+
+	m_xrunLabel->setText( tr( "Underruns: %1, overruns: %2" ).
+			arg( profiler.underruns() ).arg( profiler.overruns() ) );
+}
+
+
+
+
+void ProfilerView::setProfiling( bool _on )
+{
+	if( _on != m_profiling && Engine::mixer() )
+	{
+		m_profiling = _on;
+		Engine::mixer()->profiler().enableNodeProfiling( _on );
+	}
+}
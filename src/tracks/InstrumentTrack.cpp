@@ -35,6 +35,7 @@
 #include <QMessageBox>
 #include <QMdiSubWindow>
 #include <QPainter>
+#include <QProgressDialog>
 
 #include "FileDialog.h"
 #include "InstrumentTrack.h"
@@ -43,6 +44,7 @@
 #include "CaptionMenu.h"
 #include "ConfigManager.h"
 #include "ControllerConnection.h"
+#include "DummyInstrument.h"
 #include "EffectChain.h"
 #include "EffectRackView.h"
 #include "embed.h"
@@ -69,10 +71,12 @@
 #include "Pattern.h"
 #include "PluginFactory.h"
 #include "PluginView.h"
+#include "RenderCache.h"
 #include "SamplePlayHandle.h"
 #include "Song.h"
 #include "StringPairDrag.h"
 #include "TrackContainerView.h"
+#include "TrackFreeze.h"
 #include "TrackLabelButton.h"
 
 
@@ -110,7 +114,8 @@ InstrumentTrack::InstrumentTrack( TrackContainer* tc ) :
 	m_soundShaping( this ),
 	m_arpeggio( this ),
 	m_noteStacking( this ),
-	m_piano( this )
+	m_piano( this ),
+	m_freeze( NULL )
 {
 	m_pitchModel.setCenterValue( 0 );
 	m_panningModel.setCenterValue( DefaultPanning );
@@ -149,6 +154,8 @@ int InstrumentTrack::baseNote() const
 
 InstrumentTrack::~InstrumentTrack()
 {
+	releaseFreeze();
+
 	// kill all running notes and the iph
 	silenceAllNotes( true );
 
@@ -489,6 +496,7 @@ void InstrumentTrack::playNote( NotePlayHandle* n, sampleFrame* workingBuffer )
 	if( n->isMasterNote() == false && m_instrument != NULL )
 	{
 		// all is done, so now lets play the note!
+		MixerProfiler::Probe probe( Engine::mixer()->profiler(), MixerProfiler::NodeType::Instrument, m_instrument );
 		m_instrument->playNote( n, workingBuffer );
 	}
 }
@@ -611,6 +619,15 @@ void InstrumentTrack::removeMidiPortNode( DataFile & _dataFile )
 bool InstrumentTrack::play( const MidiTime & _start, const fpp_t _frames,
 							const f_cnt_t _offset, int _tco_num )
 {
+	if( m_freeze && _tco_num < 0 )
+	{
+		m_freeze->playTick( _start.getTicks(), _offset );
+		if( m_freeze->isRendered() )
+		{
+			return false;
+		}
+	}
+
 	if( ! m_instrument || ! tryLock() )
 	{
 		return false;
@@ -740,15 +757,14 @@ void InstrumentTrack::saveTrackSpecificSettings( QDomDocument& doc, QDomElement
 	m_baseNoteModel.saveSettings( doc, thisElement, "basenote" );
 	m_useMasterPitchModel.saveSettings( doc, thisElement, "usemasterpitch");
 
-	if( m_instrument != NULL )
+	if( isFrozen() )
 	{
-		QDomElement i = doc.createElement( "instrument" );
-		i.setAttribute( "name", m_instrument->descriptor()->name );
-		QDomElement ins = m_instrument->saveState( doc, i );
-		if(m_instrument->key().isValid()) {
-			ins.appendChild( m_instrument->key().saveXML( doc ) );
-		}
-		thisElement.appendChild( i );
+		thisElement.appendChild( doc.importNode(
+				m_frozenInstrument.documentElement(), true ) );
+	}
+	else if( m_instrument != NULL )
+	{
+		thisElement.appendChild( saveInstrument( doc ) );
 	}
 	m_soundShaping.saveState( doc, thisElement );
 	m_noteStacking.saveState( doc, thisElement );
@@ -769,6 +785,9 @@ void InstrumentTrack::saveTrackSpecificSettings( QDomDocument& doc, QDomElement
 
 void InstrumentTrack::loadTrackSpecificSettings( const QDomElement & thisElement )
 {
+	// the instrument gets loaded from the settings again
+	releaseFreeze();
+
 	silenceAllNotes( true );
 
 	lock();
@@ -815,16 +834,7 @@ void InstrumentTrack::loadTrackSpecificSettings( const QDomElement & thisElement
 			}
 			else if( node.nodeName() == "instrument" )
 			{
-				typedef Plugin::Descriptor::SubPluginFeatures::Key PluginKey;
-				PluginKey key( node.toElement().elementsByTagName( "key" ).item( 0 ).toElement() );
-
-				delete m_instrument;
-				m_instrument = NULL;
-				m_instrument = Instrument::instantiate(
-					node.toElement().attribute( "name" ), this, &key);
-				m_instrument->restoreState( node.firstChildElement() );
-
-				emit instrumentChanged();
+				loadInstrumentState( node.toElement() );
 			}
 			// compat code - if node-name doesn't match any known
 			// one, we assume that it is an instrument-plugin
@@ -867,6 +877,8 @@ Instrument * InstrumentTrack::loadInstrument(const QString & _plugin_name,
 	if(keyFromDnd)
 		Q_ASSERT(!key);
 
+	releaseFreeze();
+
 	silenceAllNotes( true );
 
 	lock();
@@ -885,6 +897,181 @@ Instrument * InstrumentTrack::loadInstrument(const QString & _plugin_name,
 
 
 
+TrackFreeze * InstrumentTrack::freeze()
+{
+	if( m_freeze )
+	{
+		return m_freeze;
+	}
+
+	silenceAllNotes( true );
+
+	// the freeze records the ticks played while rendering
+	TrackFreeze * freeze = new TrackFreeze( this );
+	// queued, so the freeze can be deleted when it failed
+	connect( freeze, SIGNAL( rendered( bool ) ),
+			this, SLOT( finishFreeze( bool ) ), Qt::QueuedConnection );
+	Engine::mixer()->requestChangeInModel();
+	m_freeze = freeze;
+	Engine::mixer()->doneChangeInModel();
+
+	if( !freeze->startRendering() )
+	{
+		releaseFreeze();
+		return NULL;
+	}
+	return freeze;
+}
+
+
+
+
+void InstrumentTrack::finishFreeze( bool ok )
+{
+	if( m_freeze == NULL || sender() != m_freeze )
+	{
+		return;
+	}
+	if( !ok )
+	{
+		releaseFreeze();
+		return;
+	}
+
+	// keep the instrument's state for saving the project and unfreezing
+	m_frozenInstrument = QDomDocument();
+	m_frozenInstrument.appendChild( saveInstrument( m_frozenInstrument ) );
+
+	silenceAllNotes( true );
+	lock();
+	delete m_instrument;
+	m_instrument = new DummyInstrument( this );
+	unlock();
+
+	Engine::mixer()->requestChangeInModel();
+	m_audioPort.setFreeze( m_freeze );
+	Engine::mixer()->doneChangeInModel();
+
+	m_freezeKey = RenderCache::trackKey( this );
+
+	Song * song = Engine::getSong();
+	connect( song, SIGNAL( edited() ), this, SLOT( checkFreeze() ),
+							Qt::QueuedConnection );
+	connect( song, SIGNAL( playbackStateChanged() ),
+						this, SLOT( checkFreeze() ) );
+	connect( Engine::mixer(), SIGNAL( sampleRateChanged() ),
+						this, SLOT( checkFreeze() ) );
+	connect( Engine::mixer(), SIGNAL( qualitySettingsChanged() ),
+						this, SLOT( checkFreeze() ) );
+
+	emit instrumentChanged();
+}
+
+
+
+
+void InstrumentTrack::unfreeze()
+{
+	if( !isFrozen() )
+	{
+		// still rendering
+		releaseFreeze();
+		return;
+	}
+
+	const QDomDocument frozenInstrument = m_frozenInstrument;
+	releaseFreeze();
+
+	// notes started from MIDI or the piano still use the DummyInstrument
+	silenceAllNotes( true );
+
+	lock();
+	loadInstrumentState( frozenInstrument.documentElement() );
+	unlock();
+}
+
+
+
+
+bool InstrumentTrack::isFrozen() const
+{
+	return m_freeze && m_freeze->isRendered();
+}
+
+
+
+
+void InstrumentTrack::checkFreeze()
+{
+	if( isFrozen() && RenderCache::trackKey( this ) != m_freezeKey )
+	{
+		unfreeze();
+	}
+}
+
+
+
+
+QDomElement InstrumentTrack::saveInstrument( QDomDocument & doc )
+{
+	QDomElement i = doc.createElement( "instrument" );
+	i.setAttribute( "name", m_instrument->descriptor()->name );
+	QDomElement ins = m_instrument->saveState( doc, i );
+	if(m_instrument->key().isValid()) {
+		ins.appendChild( m_instrument->key().saveXML( doc ) );
+	}
+	return i;
+}
+
+
+
+
+void InstrumentTrack::loadInstrumentState( const QDomElement & element )
+{
+	typedef Plugin::Descriptor::SubPluginFeatures::Key PluginKey;
+	PluginKey key( element.elementsByTagName( "key" ).item( 0 ).toElement() );
+
+	delete m_instrument;
+	m_instrument = NULL;
+	m_instrument = Instrument::instantiate(
+		element.attribute( "name" ), this, &key);
+	m_instrument->restoreState( element.firstChildElement() );
+
+	emit instrumentChanged();
+}
+
+
+
+
+void InstrumentTrack::releaseFreeze()
+{
+	if( m_freeze == NULL )
+	{
+		return;
+	}
+
+	disconnect( Engine::getSong(), NULL, this, SLOT( checkFreeze() ) );
+	disconnect( Engine::mixer(), NULL, this, SLOT( checkFreeze() ) );
+	disconnect( m_freeze, NULL, this, NULL );
+
+	// the mixer only processes again when rendering is over
+	m_freeze->abortRendering();
+
+	Engine::mixer()->requestChangeInModel();
+	m_audioPort.setFreeze( NULL );
+	TrackFreeze * freeze = m_freeze;
+	m_freeze = NULL;
+	Engine::mixer()->doneChangeInModel();
+
+	delete freeze;
+	m_frozenInstrument = QDomDocument();
+	m_freezeKey.clear();
+}
+
+
+
+
+
 // #### ITV:
 
 
@@ -1175,6 +1362,65 @@ void InstrumentTrackView::toggleInstrumentWindow( bool _on )
 
 
 
+void InstrumentTrackView::toggleFreeze()
+{
+	if( model()->isFrozen() )
+	{
+		model()->unfreeze();
+		return;
+	}
+
+	TrackFreeze * freeze = model()->freeze();
+	if( freeze == NULL )
+	{
+		freezeRendered( false );
+		return;
+	}
+
+	QProgressDialog * progress = new QProgressDialog(
+				tr( "Freezing %1..." ).arg( model()->name() ),
+				tr( "Cancel" ), 0, 100, this );
+	progress->setWindowTitle( tr( "Freeze" ) );
+	progress->setWindowModality( Qt::WindowModal );
+	progress->setAttribute( Qt::WA_DeleteOnClose );
+	progress->setMinimumDuration( 0 );
+	connect( freeze, SIGNAL( progressChanged( int ) ),
+					progress, SLOT( setValue( int ) ) );
+	connect( freeze, SIGNAL( rendered( bool ) ), progress, SLOT( close() ) );
+	connect( freeze, SIGNAL( rendered( bool ) ),
+					this, SLOT( freezeRendered( bool ) ) );
+	connect( progress, SIGNAL( canceled() ), this, SLOT( cancelFreeze() ) );
+	connect( progress, SIGNAL( canceled() ), progress, SLOT( close() ) );
+	progress->show();
+}
+
+
+
+
+void InstrumentTrackView::cancelFreeze()
+{
+	if( !model()->isFrozen() )
+	{
+		model()->unfreeze();
+	}
+}
+
+
+
+
+void InstrumentTrackView::freezeRendered( bool ok )
+{
+	if( !ok )
+	{
+		QMessageBox::warning( this, tr( "Freeze failed" ),
+			tr( "The track could not be rendered. Please make sure "
+				"there is enough space for temporary files." ) );
+	}
+}
+
+
+
+
 void InstrumentTrackView::activityIndicatorPressed()
 {
 	model()->processInEvent( MidiEvent( MidiNoteOn, 0, DefaultKey, MidiDefaultVelocity ) );
@@ -58,6 +58,8 @@ SampleTCO::SampleTCO( Track * _track ) :
 	m_sampleBuffer( new SampleBuffer ),
 	m_isPlaying( false )
 {
+	m_sampleBuffer->setStreamingEnabled( true );
+
 	saveJournallingState( false );
 	setSampleFile( "" );
 	restoreJournallingState();
@@ -232,7 +234,7 @@ void SampleTCO::updateLength()
 
 MidiTime SampleTCO::sampleLength() const
 {
-	return (int)( m_sampleBuffer->frames() / Engine::framesPerTick() );
+	return (int)( m_sampleBuffer->frames() / Engine::framesPerTick( m_sampleBuffer->sampleRate() ) );
 }
 
 
@@ -296,7 +298,8 @@ void SampleTCO::loadSettings( const QDomElement & _this )
 	setMuted( _this.attribute( "muted" ).toInt() );
 	setStartTimeOffset( _this.attribute( "off" ).toInt() );
 
-	if (_this.hasAttribute("sample_rate")) {
+	// streamed samples always play at the rate of their file
+	if (_this.hasAttribute("sample_rate") && !m_sampleBuffer->isStreamed()) {
 		m_sampleBuffer->setSampleRate(_this.attribute("sample_rate").toInt());
 	}
 }
@@ -463,7 +466,7 @@ void SampleTCOView::mouseDoubleClickEvent( QMouseEvent * )
 	if ( af.isEmpty() ) {} //Don't do anything if no file is loaded
 	else if ( af == m_tco->m_sampleBuffer->audioFile() )
 	{	//Instead of reloading the existing file, just reset the size
-		int length = (int) ( m_tco->m_sampleBuffer->frames() / Engine::framesPerTick() );
+		int length = (int) ( m_tco->m_sampleBuffer->frames() / Engine::framesPerTick( m_tco->m_sampleBuffer->sampleRate() ) );
 		m_tco->changeLength(length);
 	}
 	else
@@ -0,0 +1,31 @@
+#include "BenchmarkSuite.h"
+
+#include <cstdio>
+
+QList<BenchmarkSuite*> BenchmarkSuite::m_suites;
+QList<BenchmarkSuite::Result> BenchmarkSuite::m_results;
+
+BenchmarkSuite::BenchmarkSuite(const QString& name) :
+	m_name(name)
+{
+	m_suites << this;
+}
+
+BenchmarkSuite::~BenchmarkSuite()
+{
+	m_suites.removeAll(this);
+}
+
+QList<BenchmarkSuite*> BenchmarkSuite::suites()
+{
+	return m_suites;
+}
+
+void BenchmarkSuite::report(const QString& what, double value, const char* unit,
+	Better better) const
+{
+	m_results << Result{m_name, what, value, unit, better};
+
+	printf("%-20s | %-40s | %12.3f %s\n", qPrintable(m_name), qPrintable(what), value, unit);
+	fflush(stdout);
+}
@@ -0,0 +1,67 @@
+#ifndef BENCHMARKSUITE_H
+#define BENCHMARKSUITE_H
+
+#include <QList>
+#include <QString>
+
+#include <chrono>
+
+class BenchmarkSuite
+{
+public:
+	//! Tells how a result compares against a baseline
+	enum class Better
+	{
+		Lower,
+		Higher,
+		//! Not compared, e.g. counters depending on the machine
+		Neither
+	};
+
+	struct Result
+	{
+		QString suite;
+		QString what;
+		double value;
+		QString unit;
+		Better better;
+	};
+
+	explicit BenchmarkSuite(const QString& name);
+	virtual ~BenchmarkSuite();
+
+	const QString& name() const
+	{
+		return m_name;
+	}
+
+	virtual void run() = 0;
+
+	static QList<BenchmarkSuite*> suites();
+
+	//! All results reported so far, by all suites
+	static const QList<Result>& results()
+	{
+		return m_results;
+	}
+
+protected:
+	using Clock = std::chrono::steady_clock;
+
+	static double secondsSince(Clock::time_point begin)
+	{
+		return std::chrono::duration<double>(Clock::now() - begin).count();
+	}
+
+	//! Print a single result line and record it
+	void report(const QString& what, double value, const char* unit,
+		Better better = Better::Lower) const;
+
+private:
+	QString m_name;
+
+	static QList<BenchmarkSuite*> m_suites;
+	static QList<Result> m_results;
+};
+
+#endif // BENCHMARKSUITE_H
@@ -0,0 +1,342 @@
+/*
+ * EngineBenchmark.cpp - render synthetic projects through the mixer
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#include "BenchmarkSuite.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#include "AutomationPattern.h"
+#include "AutomationTrack.h"
+#include "DummyInstrument.h"
+#include "Effect.h"
+#include "EffectChain.h"
+#include "Engine.h"
+#include "FxMixer.h"
+#include "InstrumentTrack.h"
+#include "Mixer.h"
+#include "Pattern.h"
+#include "PeriodArena.h"
+#include "SampleBuffer.h"
+#include "SampleTrack.h"
+#include "Song.h"
+#include "lmms_constants.h"
+
+// The engine counts MemoryManager allocations and PeriodArena overflows done
+// by audio threads while rendering a period. Count plain C++ allocations
+// done there as well, so allocations per period covers both.
+void* operator new(std::size_t size)
+{
+	PeriodArena::countHeapAllocation();
+	if (void* p = std::malloc(size ? size : 1))
+	{
+		return p;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+
+class EngineBenchmark : BenchmarkSuite
+{
+public:
+	EngineBenchmark() :
+		BenchmarkSuite("engine")
+	{
+	}
+
+	void run() override
+	{
+		Engine::init(true);
+
+		measure("tripleosc x32", buildInstruments);
+		measure("fx send chains 4x8", buildFxChains);
+		measure("automation x48", buildAutomation);
+		measure("sample tracks x32", buildSamples);
+		measure("ladspa chains x8", buildLadspaChains);
+
+		Engine::destroy();
+	}
+
+private:
+	using Key = Plugin::Descriptor::SubPluginFeatures::Key;
+
+	static const int Bars = 8;
+	// periods not taken into account for allocations, buffers grow while
+	// the first notes start
+	static const int WarmUpPeriods = 16;
+
+	static int ticksPerBeat()
+	{
+		return MidiTime::ticksPerTact() / 4;
+	}
+
+	//! Add a TripleOscillator track playing a chord on every beat
+	static InstrumentTrack* addInstrumentTrack(int index)
+	{
+		InstrumentTrack* track = dynamic_cast<InstrumentTrack*>(
+			Track::create(Track::InstrumentTrack, Engine::getSong()));
+		track->loadInstrument("tripleoscillator");
+		if (dynamic_cast<DummyInstrument*>(track->instrument()))
+		{
+			fprintf(stderr, "Notice: TripleOscillator not found, set "
+				"LMMS_PLUGIN_DIR to the plugin directory\n");
+			return NULL;
+		}
+
+		Pattern* pattern = dynamic_cast<Pattern*>(track->createTCO(0));
+		const int root = 48 + index * 5 % 24;
+		for (int beat = 0; beat < Bars * 4; ++beat)
+		{
+			for (int interval : {0, 4, 7})
+			{
+				pattern->addNote(Note(ticksPerBeat(), beat * ticksPerBeat(),
+							root + interval), false);
+			}
+		}
+		return track;
+	}
+
+	static bool addEffect(EffectChain* chain, const QString& plugin,
+		const Key::AttributeMap& attributes = Key::AttributeMap())
+	{
+		Key key(NULL, plugin, attributes);
+		Effect* effect = Effect::instantiate(plugin, chain, &key);
+		if (effect == NULL || !effect->isOkay())
+		{
+			delete effect;
+			fprintf(stderr, "Notice: effect %s %s not available\n",
+				qPrintable(plugin), qPrintable(attributes.value("plugin")));
+			return false;
+		}
+		chain->appendEffect(effect);
+		return true;
+	}
+
+	static bool buildInstruments()
+	{
+		for (int i = 0; i < 32; ++i)
+		{
+			if (addInstrumentTrack(i) == NULL)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	//! Chains of FX channels each sending into the next one only, so they
+	//! have to be processed one after another
+	static bool buildFxChains()
+	{
+		FxMixer* mixer = Engine::fxMixer();
+		for (int chain = 0; chain < 4; ++chain)
+		{
+			int previous = -1;
+			for (int depth = 0; depth < 8; ++depth)
+			{
+				const int channel = mixer->createChannel();
+				if (!addEffect(&mixer->effectChannel(channel)->m_fxChain, "amplifier"))
+				{
+					return false;
+				}
+				if (previous < 0)
+				{
+					for (int i = 0; i < 2; ++i)
+					{
+						InstrumentTrack* track = addInstrumentTrack(chain * 2 + i);
+						if (track == NULL)
+						{
+							return false;
+						}
+						track->effectChannelModel()->setValue(channel);
+					}
+				}
+				else
+				{
+					mixer->deleteChannelSend(previous, 0);
+					mixer->createChannelSend(previous, channel);
+				}
+				previous = channel;
+			}
+		}
+		return true;
+	}
+
+	//! Volume, panning and pitch of every track ramp on each 1/16 note
+	static bool buildAutomation()
+	{
+		const int step = ticksPerBeat() / 4;
+		for (int i = 0; i < 16; ++i)
+		{
+			InstrumentTrack* track = addInstrumentTrack(i);
+			if (track == NULL)
+			{
+				return false;
+			}
+			for (FloatModel* model : {track->volumeModel(),
+					track->panningModel(), track->pitchModel()})
+			{
+				Track* automationTrack = Track::create(Track::AutomationTrack,
+							Engine::getSong());
+				AutomationPattern* pattern = dynamic_cast<AutomationPattern*>(
+							automationTrack->createTCO(0));
+				pattern->setProgressionType(AutomationPattern::LinearProgression);
+				pattern->addObject(model);
+				for (int t = 0; t < Bars * MidiTime::ticksPerTact(); t += step)
+				{
+					const float phase = (t / step + i) % 8 / 8.0f;
+					pattern->putValue(t, model->minValue() +
+						phase * (model->maxValue() - model->minValue()), false);
+				}
+			}
+		}
+		return true;
+	}
+
+	//! Tracks retriggering a two seconds long sample on every bar
+	static bool buildSamples()
+	{
+		const sample_rate_t sampleRate = Engine::mixer()->processingSampleRate();
+		const f_cnt_t frames = sampleRate * 2;
+		sampleFrame* data = new sampleFrame[frames];
+		for (int i = 0; i < 32; ++i)
+		{
+			const float freq = 55.0f * (i + 1);
+			for (f_cnt_t f = 0; f < frames; ++f)
+			{
+				const float decay = 1.0f - f / float(frames);
+				const float s = sinf(2 * F_PI * freq * f / sampleRate) * decay;
+				data[f][0] = s;
+				data[f][1] = -s;
+			}
+			SampleBuffer* buffer = new SampleBuffer(data, frames);
+
+			Track* track = Track::create(Track::SampleTrack, Engine::getSong());
+			for (int bar = 0; bar < Bars; ++bar)
+			{
+				SampleTCO* tco = dynamic_cast<SampleTCO*>(
+						track->createTCO(MidiTime(bar, 0)));
+				tco->setSampleBuffer(sharedObject::ref(buffer));
+				tco->changeLength(tco->sampleLength());
+			}
+			sharedObject::unref(buffer);
+		}
+		delete[] data;
+		return true;
+	}
+
+	//! Tracks with a chain of CAPS plugins each, as shipped with LMMS
+	static bool buildLadspaChains()
+	{
+		for (int i = 0; i < 8; ++i)
+		{
+			InstrumentTrack* track = addInstrumentTrack(i);
+			if (track == NULL)
+			{
+				return false;
+			}
+			EffectChain* chain = track->audioPort()->effects();
+			for (const char* label : {"Eq2x2", "StereoChorusII", "Plate2x2"})
+			{
+				Key::AttributeMap attributes;
+				attributes["file"] = "caps";
+				attributes["plugin"] = label;
+				if (!addEffect(chain, "ladspaeffect", attributes))
+				{
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	//! Build a project and export it period by period like ProjectRenderer
+	//! does. Scenarios needing missing plugins are skipped.
+	void measure(const QString& scenario, bool (*build)())
+	{
+		Song* song = Engine::getSong();
+		Mixer* mixer = Engine::mixer();
+
+		if (!build())
+		{
+			song->clearProject();
+			return;
+		}
+
+		song->updateLength();
+		song->startExport();
+		// skip first empty buffer
+		mixer->nextBuffer();
+
+		std::vector<double> latencies;
+		latencies.reserve(Bars * MidiTime::ticksPerTact() *
+			Engine::framesPerTick() / mixer->framesPerPeriod() + 64);
+		long allocations = 0;
+
+		const auto begin = Clock::now();
+		while (!song->isExportDone())
+		{
+			const auto start = Clock::now();
+			mixer->nextBuffer();
+			latencies.push_back(secondsSince(start));
+			if (latencies.size() > size_t(WarmUpPeriods))
+			{
+				allocations += PeriodArena::heapAllocations();
+			}
+		}
+		const double elapsed = secondsSince(begin);
+
+		song->stopExport();
+		song->clearProject();
+
+		const size_t periods = latencies.size();
+		if (periods <= size_t(WarmUpPeriods))
+		{
+			return;
+		}
+		std::sort(latencies.begin(), latencies.end());
+		auto percentile = [&](double p) {
+			return latencies[std::min(periods - 1, size_t(p * periods))] * 1e6;
+		};
+
+		const double fps = periods * mixer->framesPerPeriod() / elapsed;
+		report(scenario + ", frames per second", fps, "frames/s", Better::Higher);
+		report(scenario + ", realtime factor",
+			fps / mixer->processingSampleRate(), "x", Better::Higher);
+		report(scenario + ", period p50", percentile(0.5), "us");
+		report(scenario + ", period p95", percentile(0.95), "us");
+		report(scenario + ", period p99", percentile(0.99), "us");
+		report(scenario + ", period max", latencies.back() * 1e6, "us");
+		report(scenario + ", allocations per period",
+			double(allocations) / (periods - WarmUpPeriods), "");
+	}
+} EngineBenchmarks;
@@ -0,0 +1,124 @@
+/*
+ * JobQueueBenchmark.cpp - dispatch overhead of the mixer job queue
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "BenchmarkSuite.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "MixerWorkerThread.h"
+#include "ThreadableJob.h"
+
+namespace
+{
+
+class EmptyJob : public ThreadableJob
+{
+public:
+	bool requiresProcessing() const override
+	{
+		return true;
+	}
+
+protected:
+	void doProcessing() override
+	{
+	}
+};
+
+}
+
+class JobQueueBenchmark : BenchmarkSuite
+{
+public:
+	JobQueueBenchmark() :
+		BenchmarkSuite("jobqueue")
+	{
+	}
+
+	void run() override
+	{
+		for (int workers : {1, 4, 8, 16})
+		{
+			measure(workers);
+		}
+	}
+
+private:
+	// roughly the number of note play handles of a dense project
+	static const int JobsPerPeriod = 300;
+	static const int Periods = 20000;
+
+	void measure(int workers)
+	{
+		using Queue = MixerWorkerThread::JobQueue;
+
+		Queue queue(workers);
+		std::vector<EmptyJob> jobs(JobsPerPeriod);
+
+		// same scheme as MixerWorkerThread: workers-1 threads plus
+		// the calling thread, which processes the last deque inline
+		std::atomic_uint generation(0);
+		std::atomic_bool quit(false);
+		std::vector<std::thread> threads;
+		for (int i = 0; i < workers - 1; ++i)
+		{
+			threads.emplace_back([&, i]() {
+				Queue::setThreadQueue(i);
+				unsigned int last = 0;
+				while (!quit)
+				{
+					if (generation != last)
+					{
+						last = generation;
+						queue.run();
+					}
+				}
+			});
+		}
+
+		const auto begin = Clock::now();
+		for (int p = 0; p < Periods; ++p)
+		{
+			queue.reset(Queue::Static);
+			for (EmptyJob& job : jobs)
+			{
+				queue.addJob(&job);
+			}
+			queue.start();
+			++generation;
+			queue.run();
+			queue.wait();
+		}
+		const double elapsed = secondsSince(begin);
+
+		quit = true;
+		for (std::thread& t : threads)
+		{
+			t.join();
+		}
+
+		report(QString("%1 worker(s), per job").arg(workers),
+			elapsed * 1e9 / (double(Periods) * JobsPerPeriod), "ns");
+	}
+} JobQueueBenchmarks;
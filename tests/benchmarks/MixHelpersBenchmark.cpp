@@ -0,0 +1,137 @@
+/*
+ * MixHelpersBenchmark.cpp - throughput of the MixHelpers kernels per instruction set
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+
+#include "BenchmarkSuite.h"
+
+#include <cstring>
+#include <vector>
+
+#include "MixHelpers.h"
+#include "ValueBuffer.h"
+
+using MixHelpers::Implementation;
+
+class MixHelpersBenchmark : BenchmarkSuite
+{
+public:
+	MixHelpersBenchmark() :
+		BenchmarkSuite("mixhelpers")
+	{
+	}
+
+	void run() override
+	{
+		const Implementation previous = MixHelpers::implementation();
+		const bool nanHandler = MixHelpers::useNaNHandler();
+		MixHelpers::setNaNHandler(true);
+
+		for (int frames : {64, 256, 1024})
+		{
+			for (Implementation impl : {Implementation::Scalar, Implementation::SSE2,
+							Implementation::AVX2, Implementation::AVX512})
+			{
+				if (MixHelpers::setImplementation(impl))
+				{
+					measure(impl, frames);
+				}
+			}
+		}
+
+		MixHelpers::setNaNHandler(nanHandler);
+		MixHelpers::setImplementation(previous);
+	}
+
+private:
+	static const int Samples = 1 << 24;
+
+	void measure(Implementation impl, int frames)
+	{
+		std::vector<sampleFrame> dst(frames);
+		std::vector<sampleFrame> src(frames);
+		ValueBuffer coeffs(frames);
+		for (int f = 0; f < frames; ++f)
+		{
+			src[f][0] = (f % 100) / 100.0f - 0.5f;
+			src[f][1] = (f % 37) / 37.0f - 0.5f;
+			coeffs.values()[f] = (f % 11) / 11.0f;
+		}
+		memset(dst.data(), 0, sizeof(sampleFrame) * frames);
+		// isSilent() has to look at every frame of a silent buffer
+		std::vector<sampleFrame> silence(frames);
+		memset(silence.data(), 0, sizeof(sampleFrame) * frames);
+
+		const int rounds = Samples / frames;
+		const QString prefix = QString("%1, %2 frames, ").arg(MixHelpers::implementationName(impl)).arg(frames);
+
+		auto begin = Clock::now();
+		for (int r = 0; r < rounds; ++r)
+		{
+			MixHelpers::add(dst.data(), src.data(), frames);
+		}
+		report(prefix + "add", secondsSince(begin) * 1e9 / Samples, "ns/frame");
+
+		begin = Clock::now();
+		for (int r = 0; r < rounds; ++r)
+		{
+			MixHelpers::addSanitizedMultiplied(dst.data(), src.data(), 0.5f, frames);
+		}
+		report(prefix + "addSanitizedMultiplied", secondsSince(begin) * 1e9 / Samples, "ns/frame");
+
+		begin = Clock::now();
+		for (int r = 0; r < rounds; ++r)
+		{
+			MixHelpers::addSanitizedMultipliedByBuffer(dst.data(), src.data(), 0.5f, &coeffs, frames);
+		}
+		report(prefix + "addSanitizedMultipliedByBuffer", secondsSince(begin) * 1e9 / Samples, "ns/frame");
+
+		begin = Clock::now();
+		for (int r = 0; r < rounds; ++r)
+		{
+			MixHelpers::sanitize(dst.data(), frames);
+		}
+		report(prefix + "sanitize", secondsSince(begin) * 1e9 / Samples, "ns/frame");
+
+		begin = Clock::now();
+		bool silent = false;
+		for (int r = 0; r < rounds; ++r)
+		{
+			silent |= MixHelpers::isSilent(silence.data(), frames);
+		}
+		report(prefix + "isSilent", secondsSince(begin) * 1e9 / Samples, "ns/frame");
+		Q_UNUSED(silent);
+
+		std::vector<int32_t> quantized(frames * 2);
+		std::vector<float> dither(frames * 2);
+		for (int i = 0; i < frames * 2; ++i)
+		{
+			dither[i] = (i % 13) / 6.5f - 1.0f;
+		}
+		begin = Clock::now();
+		for (int r = 0; r < rounds; ++r)
+		{
+			MixHelpers::quantize(quantized.data(), src.data(), 0.9f, 32767.0f, dither.data(), frames);
+		}
+		report(prefix + "quantize", secondsSince(begin) * 1e9 / Samples, "ns/frame");
+	}
+} MixHelpersBenchmarks;
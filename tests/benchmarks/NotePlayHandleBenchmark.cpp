@@ -0,0 +1,144 @@
+/*
+ * NotePlayHandleBenchmark.cpp - acquire/release throughput of the note play handle pool
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#include "BenchmarkSuite.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "NotePlayHandle.h"
+
+class NotePlayHandleBenchmark : BenchmarkSuite
+{
+public:
+	NotePlayHandleBenchmark() :
+		BenchmarkSuite("nphpool")
+	{
+	}
+
+	void run() override
+	{
+		NotePlayHandleManager::init();
+
+		for (int threads : {1, 2, 4, 8})
+		{
+			measureLocal(threads);
+		}
+		for (int threads : {1, 2, 4, 8})
+		{
+			measureHandOver(threads);
+		}
+
+		report("pool hits", NotePlayHandleManager::hits(), "", Better::Neither);
+		report("pool misses", NotePlayHandleManager::misses(), "", Better::Neither);
+
+		NotePlayHandleManager::cleanup();
+	}
+
+private:
+	// handles alive at once per thread, e.g. a chord with arpeggio
+	static const int Batch = 24;
+	static const int Rounds = 200000;
+
+	//! Every thread releases the handles it acquired
+	void measureLocal(int threads)
+	{
+		const auto begin = Clock::now();
+		std::vector<std::thread> workers;
+		for (int t = 0; t < threads; ++t)
+		{
+			workers.emplace_back([]() {
+				void* handles[Batch];
+				for (int r = 0; r < Rounds; ++r)
+				{
+					for (void*& h : handles)
+					{
+						h = NotePlayHandleManager::allocate();
+					}
+					for (void* h : handles)
+					{
+						NotePlayHandleManager::deallocate(h);
+					}
+				}
+			});
+		}
+		for (std::thread& t : workers)
+		{
+			t.join();
+		}
+
+		report(QString("%1 thread(s), local").arg(threads),
+			secondsSince(begin) * 1e9 / (double(Rounds) * Batch), "ns");
+	}
+
+	//! Handles are acquired by several threads but released by a single
+	//! one, like the mixer does after a period
+	void measureHandOver(int threads)
+	{
+		const int rounds = Rounds / 10;
+		std::vector<std::vector<void*>> handles(threads,
+						std::vector<void*>(Batch));
+		std::atomic_int round(-1);
+		std::atomic_int done(0);
+
+		std::vector<std::thread> workers;
+		for (int t = 0; t < threads; ++t)
+		{
+			workers.emplace_back([&, t]() {
+				for (int r = 0; r < rounds; ++r)
+				{
+					while (round < r) {}
+					for (void*& h : handles[t])
+					{
+						h = NotePlayHandleManager::allocate();
+					}
+					++done;
+				}
+			});
+		}
+
+		const auto begin = Clock::now();
+		for (int r = 0; r < rounds; ++r)
+		{
+			round = r;
+			while (done < threads) {}
+			done = 0;
+			for (std::vector<void*>& h : handles)
+			{
+				for (void* p : h)
+				{
+					NotePlayHandleManager::deallocate(p);
+				}
+			}
+		}
+		const double elapsed = secondsSince(begin);
+		for (std::thread& t : workers)
+		{
+			t.join();
+		}
+
+		report(QString("%1 thread(s), hand over").arg(threads),
+			elapsed * 1e9 / (double(rounds) * Batch * threads), "ns");
+	}
+} NotePlayHandleBenchmarks;
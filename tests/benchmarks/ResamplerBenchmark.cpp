@@ -0,0 +1,171 @@
+/*
+ * ResamplerBenchmark.cpp - speed and quality of PolyphaseResampler and libsamplerate
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#include "BenchmarkSuite.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <samplerate.h>
+
+#include "PolyphaseResampler.h"
+#include "lmms_constants.h"
+
+class ResamplerBenchmark : BenchmarkSuite
+{
+public:
+	ResamplerBenchmark() :
+		BenchmarkSuite("resampler")
+	{
+	}
+
+	void run() override
+	{
+		std::vector<sampleFrame> input(InputFrames);
+		for (int f = 0; f < InputFrames; ++f)
+		{
+			const float s = 0.5f * float(sin(2 * D_PI * Frequency * f));
+			input[f][0] = s;
+			input[f][1] = -s;
+		}
+
+		for (int converter : {SRC_SINC_BEST_QUALITY, SRC_SINC_MEDIUM_QUALITY,
+					SRC_SINC_FASTEST, SRC_LINEAR, SRC_ZERO_ORDER_HOLD})
+		{
+			// an octave down, a fifth up and a bit more than an octave and
+			// a half up
+			for (double step : {0.5, 1.5, 3.0})
+			{
+				measure(input, converter, step);
+			}
+		}
+	}
+
+private:
+	static const int InputFrames = 1 << 16;
+	static const int PeriodFrames = 256;
+	static const int SpeedFrames = 1 << 22;
+	// libsamplerate starts and ends with silence, don't take that into
+	// account for the quality
+	static const int EdgeFrames = 256;
+	//! Cycles per input frame of the sine resampled, 4410 Hz at 44.1 kHz
+	static constexpr double Frequency = 0.1;
+
+	void measure(std::vector<sampleFrame>& input, int converter, double step)
+	{
+		const QString prefix = QString("%1, step %2, ").arg(src_get_name(converter)).arg(step);
+		const double omega = 2 * D_PI * Frequency * step;
+
+		const PolyphaseResampler& resampler = PolyphaseResampler::forConverter(converter);
+		const int reach = resampler.reach(step);
+		const int outputFrames = int((InputFrames - 2 * reach - 1) / step);
+
+		std::vector<sampleFrame> output(outputFrames);
+		resampler.process(output.data(), input.data(), reach, step, outputFrames);
+		report(prefix + "polyphase, signal to noise", signalToNoise(output, 0, outputFrames, omega), "dB", Better::Higher);
+
+		SRC_STATE* state = src_new(converter, DEFAULT_CHANNELS, NULL);
+		SRC_DATA data;
+		data.data_in = input[0];
+		data.data_out = output[0];
+		data.input_frames = InputFrames;
+		data.output_frames = outputFrames;
+		data.src_ratio = 1.0 / step;
+		data.end_of_input = 1;
+		src_process(state, &data);
+		report(prefix + "libsamplerate, signal to noise",
+			signalToNoise(output, EdgeFrames, data.output_frames_gen - EdgeFrames, omega),
+			"dB", Better::Neither);
+
+		// both read one period at a time like SampleBuffer::play() does
+		std::vector<sampleFrame> period(PeriodFrames);
+		const double end = InputFrames - reach - 1 - PeriodFrames * step;
+		double pos = reach;
+		auto begin = Clock::now();
+		for (int done = 0; done < SpeedFrames; done += PeriodFrames)
+		{
+			if (pos >= end)
+			{
+				pos = reach;
+			}
+			resampler.process(period.data(), input.data(), pos, step, PeriodFrames);
+			pos += PeriodFrames * step;
+		}
+		report(prefix + "polyphase", secondsSince(begin) * 1e9 / SpeedFrames, "ns/frame");
+
+		const int fragmentFrames = int(PeriodFrames * step) + 64;
+		int index = 0;
+		src_reset(state);
+		begin = Clock::now();
+		for (int done = 0; done < SpeedFrames; done += PeriodFrames)
+		{
+			if (index + fragmentFrames > InputFrames)
+			{
+				src_reset(state);
+				index = 0;
+			}
+			data.data_in = input[index];
+			data.data_out = period[0];
+			data.input_frames = fragmentFrames;
+			data.output_frames = PeriodFrames;
+			data.end_of_input = 0;
+			src_process(state, &data);
+			index += data.input_frames_used;
+		}
+		report(prefix + "libsamplerate", secondsSince(begin) * 1e9 / SpeedFrames, "ns/frame", Better::Neither);
+
+		src_delete(state);
+	}
+
+	//! Power of the sine with @p omega radians per frame in the left channel
+	//! of @p frames from @p from to @p to against the power of everything
+	//! else, in dB
+	static double signalToNoise(const std::vector<sampleFrame>& frames, int from, int to, double omega)
+	{
+		// least squares fit of a * sin + b * cos
+		double ss = 0, cc = 0, sc = 0, ys = 0, yc = 0;
+		for (int f = from; f < to; ++f)
+		{
+			const double s = sin(omega * f);
+			const double c = cos(omega * f);
+			ss += s * s;
+			cc += c * c;
+			sc += s * c;
+			ys += frames[f][0] * s;
+			yc += frames[f][0] * c;
+		}
+		const double det = ss * cc - sc * sc;
+		const double a = (ys * cc - yc * sc) / det;
+		const double b = (yc * ss - ys * sc) / det;
+
+		double signal = 0, noise = 0;
+		for (int f = from; f < to; ++f)
+		{
+			const double fit = a * sin(omega * f) + b * cos(omega * f);
+			signal += fit * fit;
+			noise += (frames[f][0] - fit) * (frames[f][0] - fit);
+		}
+		return 10 * log10(signal / std::max(noise, 1e-30));
+	}
+} ResamplerBenchmarks;
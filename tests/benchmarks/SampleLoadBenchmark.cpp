@@ -0,0 +1,220 @@
+/*
+ * SampleLoadBenchmark.cpp - load projects with many samples
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#include "BenchmarkSuite.h"
+
+#include <QDomDocument>
+#include <QStringList>
+#include <QTemporaryDir>
+#include <QThread>
+
+#include <sndfile.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "ConfigManager.h"
+#include "Engine.h"
+#include "Mixer.h"
+#include "SampleBuffer.h"
+#include "SamplePreloader.h"
+#include "lmms_constants.h"
+
+
+//! Requests changes in the model over and over like the GUI does, and keeps
+//! the longest time the mixer couldn't be locked for that
+class MixerWaitProbe : public QThread
+{
+public:
+	MixerWaitProbe() :
+		m_quit(false),
+		m_longestWait(0)
+	{
+	}
+
+	void finish()
+	{
+		m_quit = true;
+		wait();
+	}
+
+	double longestWait() const
+	{
+		return m_longestWait;
+	}
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	void run() override
+	{
+		while (!m_quit)
+		{
+			const auto start = Clock::now();
+			Engine::mixer()->requestChangeInModel();
+			Engine::mixer()->doneChangeInModel();
+			m_longestWait = std::max(m_longestWait,
+				std::chrono::duration<double>(Clock::now() - start).count());
+			msleep(1);
+		}
+	}
+
+	std::atomic_bool m_quit;
+	double m_longestWait;
+};
+
+
+class SampleLoadBenchmark : BenchmarkSuite
+{
+public:
+	SampleLoadBenchmark() :
+		BenchmarkSuite("sampleload")
+	{
+	}
+
+	void run() override
+	{
+		Engine::init(true);
+
+		QTemporaryDir dir;
+		const QStringList files = writeSamples(dir.path());
+		if (files.isEmpty())
+		{
+			Engine::destroy();
+			return;
+		}
+
+		// an empty cache for each run, the config isn't saved
+		ConfigManager* config = ConfigManager::inst();
+		config->setValue("mixer", "samplecachesize", "2048");
+		config->setValue("mixer", "streamthreshold", "64");
+
+		const QString scenario = QString("sample tracks x%1").arg(files.size());
+		double serialWait;
+		config->setValue("mixer", "samplecachedir", dir.path() + "/serial");
+		const double serial = measure(files, false, serialWait);
+		double preloadedWait;
+		config->setValue("mixer", "samplecachedir", dir.path() + "/preloaded");
+		const double preloaded = measure(files, true, preloadedWait);
+
+		report(scenario + ", serial load", serial * 1e3, "ms");
+		report(scenario + ", preloaded load", preloaded * 1e3, "ms");
+		report(scenario + ", preload speedup", serial / preloaded, "x",
+			Better::Higher);
+		report(scenario + ", longest mixer wait, serial", serialWait * 1e3,
+			"ms", Better::Neither);
+		report(scenario + ", longest mixer wait, preloaded",
+			preloadedWait * 1e3, "ms");
+
+		Engine::destroy();
+	}
+
+private:
+	static const int Samples = 48;
+	static const int SampleSeconds = 8;
+	// differs from the mixer's, so every sample gets resampled
+	static const int FileSampleRate = 48000;
+
+	//! Write a different decaying chord for every sample track, returns
+	//! the file names
+	static QStringList writeSamples(const QString& dir)
+	{
+		QStringList files;
+		const int frames = FileSampleRate * SampleSeconds;
+		std::vector<float> data(frames * 2);
+		for (int i = 0; i < Samples; ++i)
+		{
+			const float freq = 55.0f + i * 7.5f;
+			for (int f = 0; f < frames; ++f)
+			{
+				const float t = f / float(FileSampleRate);
+				const float s = (sinf(2 * F_PI * freq * t) +
+					sinf(2 * F_PI * freq * 1.5f * t)) * 0.4f *
+					(1.0f - f / float(frames));
+				data[f * 2] = s;
+				data[f * 2 + 1] = -s;
+			}
+
+			const QString file = QString("%1/sample%2.wav").arg(dir).arg(i);
+			SF_INFO info = {};
+			info.samplerate = FileSampleRate;
+			info.channels = 2;
+			info.format = SF_FORMAT_WAV | SF_FORMAT_PCM_16;
+			SNDFILE* sndFile = sf_open(qPrintable(file), SFM_WRITE, &info);
+			if (sndFile == NULL)
+			{
+				fprintf(stderr, "Notice: could not write %s\n", qPrintable(file));
+				return QStringList();
+			}
+			sf_writef_float(sndFile, data.data(), frames);
+			sf_close(sndFile);
+			files << file;
+		}
+		return files;
+	}
+
+	//! Load a sample buffer per file like a project's sample tracks do,
+	//! decoding the files up front if @p preload is set. Returns the
+	//! seconds taken, @p longestWait is set to the longest time the mixer
+	//! was kept locked meanwhile.
+	static double measure(const QStringList& files, bool preload,
+		double& longestWait)
+	{
+		QDomDocument project("lmms-project");
+		QDomElement song = project.createElement("song");
+		project.appendChild(song);
+		for (const QString& file : files)
+		{
+			QDomElement tco = project.createElement("sampletco");
+			tco.setAttribute("src", file);
+			song.appendChild(tco);
+		}
+
+		MixerWaitProbe probe;
+		probe.start();
+
+		const auto begin = Clock::now();
+		if (preload)
+		{
+			SamplePreloader::preload(project.documentElement());
+		}
+		QList<SampleBuffer*> buffers;
+		for (const QString& file : files)
+		{
+			buffers << new SampleBuffer(file);
+		}
+		const double elapsed = secondsSince(begin);
+
+		probe.finish();
+		longestWait = probe.longestWait();
+
+		for (SampleBuffer* buffer : buffers)
+		{
+			sharedObject::unref(buffer);
+		}
+		return elapsed;
+	}
+} SampleLoadBenchmarks;
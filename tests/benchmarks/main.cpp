@@ -0,0 +1,183 @@
+#include "BenchmarkSuite.h"
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QStringList>
+
+#include <cstdio>
+
+namespace
+{
+
+const char* betterName(BenchmarkSuite::Better better)
+{
+	switch (better)
+	{
+	case BenchmarkSuite::Better::Lower: return "lower";
+	case BenchmarkSuite::Better::Higher: return "higher";
+	default: return "none";
+	}
+}
+
+QString resultKey(const QString& suite, const QString& what)
+{
+	return suite + '/' + what;
+}
+
+bool writeJson(const QString& fileName)
+{
+	QJsonArray results;
+	for (const BenchmarkSuite::Result& r : BenchmarkSuite::results())
+	{
+		QJsonObject o;
+		o["suite"] = r.suite;
+		o["name"] = r.what;
+		o["value"] = r.value;
+		o["unit"] = r.unit;
+		o["better"] = betterName(r.better);
+		results.append(o);
+	}
+	QJsonObject root;
+	root["results"] = results;
+
+	QFile f(fileName);
+	if (!f.open(QFile::WriteOnly | QFile::Truncate))
+	{
+		fprintf(stderr, "Could not write %s\n", qPrintable(fileName));
+		return false;
+	}
+	f.write(QJsonDocument(root).toJson());
+	return true;
+}
+
+//! Compare all results against the ones saved in a baseline file, returns the
+//! number of regressions beyond the given tolerance (in percent)
+int compareWithBaseline(const QString& fileName, double tolerance)
+{
+	QFile f(fileName);
+	if (!f.open(QFile::ReadOnly))
+	{
+		fprintf(stderr, "Could not read baseline %s\n", qPrintable(fileName));
+		return -1;
+	}
+	QHash<QString, double> baseline;
+	for (const QJsonValue& v : QJsonDocument::fromJson(f.readAll()).object()["results"].toArray())
+	{
+		const QJsonObject o = v.toObject();
+		baseline[resultKey(o["suite"].toString(), o["name"].toString())] = o["value"].toDouble();
+	}
+
+	printf("\nComparison against %s (tolerance %.1f%%)\n", qPrintable(fileName), tolerance);
+	int regressions = 0;
+	for (const BenchmarkSuite::Result& r : BenchmarkSuite::results())
+	{
+		const QString key = resultKey(r.suite, r.what);
+		if (r.better == BenchmarkSuite::Better::Neither || !baseline.contains(key))
+		{
+			continue;
+		}
+		const double base = baseline[key];
+		const double limit = r.better == BenchmarkSuite::Better::Lower
+			? base * (1 + tolerance / 100)
+			: base * (1 - tolerance / 100);
+		const bool regressed = r.better == BenchmarkSuite::Better::Lower
+			? r.value > limit
+			: r.value < limit;
+		const double change = base != 0 ? (r.value - base) * 100 / base : 0;
+		printf("%-20s | %-40s | %12.3f -> %12.3f %-8s %+7.1f%%%s\n",
+			qPrintable(r.suite), qPrintable(r.what), base, r.value,
+			qPrintable(r.unit), change, regressed ? "  REGRESSION" : "");
+		regressions += regressed;
+	}
+	printf("%d regression(s)\n", regressions);
+	return regressions;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+	QCoreApplication app(argc, argv);
+
+	QString jsonFile;
+	QString baselineFile;
+	double tolerance = 10;
+
+	// run all suites or only the ones given on the command line
+	QStringList selected;
+	const QStringList args = app.arguments().mid(1);
+	for (int i = 0; i < args.size(); ++i)
+	{
+		const bool hasValue = i + 1 < args.size();
+		if (args[i] == "--json" && hasValue)
+		{
+			jsonFile = args[++i];
+		}
+		else if (args[i] == "--baseline" && hasValue)
+		{
+			baselineFile = args[++i];
+		}
+		else if (args[i] == "--tolerance" && hasValue)
+		{
+			tolerance = args[++i].toDouble();
+		}
+		else if (args[i] == "--help" || args[i] == "-h")
+		{
+			printf("Usage: %s [--json <file>] [--baseline <file>] "
+				"[--tolerance <percent>] [benchmark...]\n\n"
+				"  --json <file>          save all results to <file>\n"
+				"  --baseline <file>      compare against results saved "
+				"with --json before,\n"
+				"                         exit with 2 on regressions\n"
+				"  --tolerance <percent>  allowed deviation from the "
+				"baseline, default 10\n", argv[0]);
+			return 0;
+		}
+		else
+		{
+			selected << args[i];
+		}
+	}
+
+	int numRun = 0;
+	for (BenchmarkSuite* suite : BenchmarkSuite::suites())
+	{
+		if (selected.isEmpty() || selected.contains(suite->name()))
+		{
+			suite->run();
+			++numRun;
+		}
+	}
+
+	if (numRun == 0)
+	{
+		fprintf(stderr, "No matching benchmark. Available benchmarks:\n");
+		for (BenchmarkSuite* suite : BenchmarkSuite::suites())
+		{
+			fprintf(stderr, "  %s\n", qPrintable(suite->name()));
+		}
+		return 1;
+	}
+
+	if (!jsonFile.isEmpty() && !writeJson(jsonFile))
+	{
+		return 1;
+	}
+	if (!baselineFile.isEmpty())
+	{
+		const int regressions = compareWithBaseline(baselineFile, tolerance);
+		if (regressions < 0)
+		{
+			return 1;
+		}
+		if (regressions > 0)
+		{
+			return 2;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,293 @@
+/*
+ * MixHelpersTest.cpp
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "QTestSuite.h"
+
+#include "MixHelpers.h"
+#include "ValueBuffer.h"
+
+#include <QByteArray>
+#include <QStringList>
+
+#include <functional>
+#include <limits>
+
+namespace
+{
+
+// not a multiple of any vector width, so the remainders get tested too
+const int Frames = 61;
+
+struct Buffer
+{
+	sampleFrame frames[Frames];
+};
+
+// deterministic values in [-2, 2) with denormals, signed zeros and a huge
+// value, and NaN and infinities if special
+Buffer signal(unsigned seed, bool special)
+{
+	Buffer b;
+	unsigned state = seed;
+	for (int f = 0; f < Frames; ++f)
+	{
+		for (int ch = 0; ch < 2; ++ch)
+		{
+			state = state * 1664525u + 1013904223u;
+			b.frames[f][ch] = (state >> 8) / float(1 << 24) * 4.0f - 2.0f;
+		}
+	}
+	const float denormal = std::numeric_limits<float>::denorm_min() * 5;
+	b.frames[1][0] = denormal;
+	b.frames[2][1] = -denormal;
+	b.frames[3][0] = -0.0f;
+	b.frames[4][1] = 0.0f;
+	b.frames[Frames - 1][1] = 1e30f;
+	if (special)
+	{
+		b.frames[5][0] = std::numeric_limits<float>::quiet_NaN();
+		b.frames[8][1] = std::numeric_limits<float>::infinity();
+		b.frames[13][0] = -std::numeric_limits<float>::infinity();
+	}
+	return b;
+}
+
+ValueBuffer values(unsigned seed, float scale)
+{
+	ValueBuffer v(Frames);
+	const Buffer b = signal(seed, false);
+	for (int f = 0; f < Frames; ++f)
+	{
+		v.values()[f] = b.frames[f][0] * scale;
+	}
+	return v;
+}
+
+QByteArray bytes(const void* data, int size)
+{
+	return QByteArray(static_cast<const char*>(data), size);
+}
+
+}
+
+class MixHelpersTest : QTestSuite
+{
+	Q_OBJECT
+private:
+	// run with every implementation the CPU supports, the output has to be
+	// the same as the scalar one bit for bit
+	void compareImplementations(const QString& name, const std::function<QByteArray()>& run)
+	{
+		const MixHelpers::Implementation original = MixHelpers::implementation();
+		MixHelpers::setImplementation(MixHelpers::Implementation::Scalar);
+		const QByteArray expected = run();
+
+		QStringList mismatches;
+		for (MixHelpers::Implementation impl : { MixHelpers::Implementation::SSE2,
+				MixHelpers::Implementation::AVX2, MixHelpers::Implementation::AVX512 })
+		{
+			if (MixHelpers::setImplementation(impl) && run() != expected)
+			{
+				mismatches << MixHelpers::implementationName(impl);
+			}
+		}
+		MixHelpers::setImplementation(original);
+
+		QVERIFY2(mismatches.isEmpty(), qPrintable(name + " differs with " + mismatches.join(", ")));
+	}
+
+	// all kernels reading a source and adding to a destination
+	void compareAdding(bool special)
+	{
+		const Buffer src = signal(1, special);
+		const Buffer dst = signal(2, special);
+		ValueBuffer buf1 = values(3, 1.5f);
+		ValueBuffer buf2 = values(4, 0.5f);
+		const QString suffix = special ? " with NaN and infinities" : "";
+
+		typedef std::function<void(sampleFrame*)> Kernel;
+		const QList<QPair<QString, Kernel> > kernels = {
+			{ "add", [&](sampleFrame* d) { MixHelpers::add(d, src.frames, Frames); } },
+			{ "addMultiplied", [&](sampleFrame* d) { MixHelpers::addMultiplied(d, src.frames, 0.7f, Frames); } },
+			{ "addSwappedMultiplied", [&](sampleFrame* d) { MixHelpers::addSwappedMultiplied(d, src.frames, 0.7f, Frames); } },
+			{ "addMultipliedByBuffer", [&](sampleFrame* d) { MixHelpers::addMultipliedByBuffer(d, src.frames, 0.7f, &buf1, Frames); } },
+			{ "addMultipliedByBuffers", [&](sampleFrame* d) { MixHelpers::addMultipliedByBuffers(d, src.frames, &buf1, &buf2, Frames); } },
+			{ "addSanitizedMultiplied", [&](sampleFrame* d) { MixHelpers::addSanitizedMultiplied(d, src.frames, 0.7f, Frames); } },
+			{ "addSanitizedMultipliedByBuffer", [&](sampleFrame* d) { MixHelpers::addSanitizedMultipliedByBuffer(d, src.frames, 0.7f, &buf1, Frames); } },
+			{ "addSanitizedMultipliedByBuffers", [&](sampleFrame* d) { MixHelpers::addSanitizedMultipliedByBuffers(d, src.frames, &buf1, &buf2, Frames); } },
+			{ "addMultipliedStereo", [&](sampleFrame* d) { MixHelpers::addMultipliedStereo(d, src.frames, 0.3f, 0.9f, Frames); } },
+			{ "multiplyAndAddMultiplied", [&](sampleFrame* d) { MixHelpers::multiplyAndAddMultiplied(d, src.frames, 0.5f, 0.7f, Frames); } },
+		};
+		for (const auto& kernel : kernels)
+		{
+			compareImplementations(kernel.first + suffix, [&]() {
+				Buffer out = dst;
+				kernel.second(out.frames);
+				return bytes(out.frames, sizeof(out.frames));
+			});
+		}
+	}
+
+private slots:
+	void initTestCase()
+	{
+		m_nanHandler = MixHelpers::useNaNHandler();
+		MixHelpers::setNaNHandler(true);
+	}
+
+	void cleanupTestCase()
+	{
+		MixHelpers::setNaNHandler(m_nanHandler);
+	}
+
+	void AddingKernelsTest()
+	{
+		compareAdding(false);
+		compareAdding(true);
+	}
+
+	void IsSilentAndSanitizeTest()
+	{
+		for (bool special : { false, true })
+		{
+			const Buffer src = signal(5, special);
+			compareImplementations("isSilent", [&]() {
+				Buffer quiet;
+				for (int f = 0; f < Frames; ++f)
+				{
+					quiet.frames[f][0] = src.frames[f][0] * 1e-9f;
+					quiet.frames[f][1] = src.frames[f][1] * 1e-9f;
+				}
+				const bool results[] = { MixHelpers::isSilent(src.frames, Frames),
+						MixHelpers::isSilent(quiet.frames, Frames) };
+				return bytes(results, sizeof(results));
+			});
+			compareImplementations("sanitize", [&]() {
+				Buffer out = src;
+				const bool found = MixHelpers::sanitize(out.frames, Frames);
+				return bytes(out.frames, sizeof(out.frames)) + bytes(&found, sizeof(found));
+			});
+		}
+	}
+
+	void VolumePanGainsTest()
+	{
+		const ValueBuffer vol = values(6, 100.0f);
+		const ValueBuffer pan = values(7, 60.0f);
+		compareImplementations("volumePanGains", [&]() {
+			Buffer out;
+			QByteArray result;
+			MixHelpers::volumePanGains(out.frames, NULL, 80.0f, NULL, -30.0f, Frames);
+			result += bytes(out.frames, sizeof(out.frames));
+			MixHelpers::volumePanGains(out.frames, &vol, 80.0f, NULL, 40.0f, Frames);
+			result += bytes(out.frames, sizeof(out.frames));
+			MixHelpers::volumePanGains(out.frames, &vol, 80.0f, &pan, 0.0f, Frames);
+			result += bytes(out.frames, sizeof(out.frames));
+			return result;
+		});
+	}
+
+	void SumMultipliedByGainsTest()
+	{
+		for (bool special : { false, true })
+		{
+			const Buffer srcs[] = { signal(8, special), signal(9, false), signal(10, special) };
+			const Buffer gains = signal(11, false);
+			const sampleFrame* ptrs[] = { srcs[0].frames, srcs[1].frames, srcs[2].frames };
+			compareImplementations("sumMultipliedByGains", [&]() {
+				QByteArray result;
+				for (int count = 0; count <= 3; ++count)
+				{
+					Buffer out = signal(12, special);
+					MixHelpers::sumMultipliedByGains(out.frames, ptrs, count, NULL, Frames);
+					result += bytes(out.frames, sizeof(out.frames));
+					MixHelpers::sumMultipliedByGains(out.frames, ptrs, count, gains.frames, Frames);
+					result += bytes(out.frames, sizeof(out.frames));
+				}
+				return result;
+			});
+		}
+	}
+
+	void QuantizeTest()
+	{
+		float dither[Frames * 2];
+		const Buffer noise = signal(13, false);
+		for (int i = 0; i < Frames * 2; ++i)
+		{
+			dither[i] = noise.frames[i / 2][i % 2] * 0.5f;
+		}
+		for (bool special : { false, true })
+		{
+			const Buffer src = signal(14, special);
+			compareImplementations("quantize", [&]() {
+				QByteArray result;
+				int32_t out[Frames * 2];
+				// 16 and 24 bit, and 32 bit where the scale isn't exact
+				for (float scale : { 32767.0f, 8388607.0f, 2147483520.0f })
+				{
+					MixHelpers::quantize(out, src.frames, 0.8f, scale, NULL, Frames);
+					result += bytes(out, sizeof(out));
+					MixHelpers::quantize(out, src.frames, 0.8f, scale, dither, Frames);
+					result += bytes(out, sizeof(out));
+				}
+				return result;
+			});
+		}
+	}
+
+	void ConvolveTest()
+	{
+		const int MaxTaps = 24;
+		const int Outputs = Frames - MaxTaps;
+		float coeffs[Outputs * MaxTaps];
+		const Buffer c = signal(15, false);
+		for (int i = 0; i < Outputs * MaxTaps; ++i)
+		{
+			coeffs[i] = c.frames[i / 2 % Frames][i % 2] * 0.25f;
+		}
+		int offsets[Outputs];
+		for (int f = 0; f < Outputs; ++f)
+		{
+			offsets[f] = (f * 7) % (Frames - MaxTaps);
+		}
+		for (bool special : { false, true })
+		{
+			const Buffer src = signal(16, special);
+			compareImplementations("convolve", [&]() {
+				QByteArray result;
+				Buffer out;
+				for (int taps = 8; taps <= MaxTaps; taps += 8)
+				{
+					MixHelpers::convolve(out.frames, src.frames, offsets, coeffs, taps, Outputs);
+					result += bytes(out.frames, Outputs * sizeof(sampleFrame));
+				}
+				return result;
+			});
+		}
+	}
+
+private:
+	bool m_nanHandler;
+} MixHelpersTests;
+
+#include "MixHelpersTest.moc"